@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * bench_list - walking long lists out of the cache
+ *
+ *  1M entries of one cache line are linked in random order, so each
+ *  step of a walk is a cache miss. The list is walked with:
+ *  - list_for_each_entry();
+ *  - list_for_each_entry_prefetch() (next entry prefetched);
+ *  - list_for_each_entry_prefetch_ahead() at several distances;
+ *  with a body of 0, 50 and 200 rounds of work on each entry.
+ *
+ *  Following the links is serial: with an empty body no prefetching
+ *  helps, the walk runs at the memory latency. With a body which takes
+ *  about as long as a miss, the miss of the next entry is hidden behind
+ *  the work on the current one.
+ */
+
+#include <flibc/flibc.h>
+#include <flibc/list.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NODES_COUNT (1 << 20)
+#define RUNS 3
+
+struct node {
+        struct list_head list;
+        uint64_t key;
+} __attribute__((aligned(64)));
+
+static uint64_t sink;
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* some work which depends on the entry */
+static inline uint64_t node_work(const struct node *node, unsigned int rounds)
+{
+        uint64_t x = node->key;
+        unsigned int i;
+
+        for(i = 0; i < rounds; ++i)
+        {
+                x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+
+        return x;
+}
+
+static uint64_t walk_plain(struct list_head *list, unsigned int rounds,
+                           unsigned int distance)
+{
+        struct node *node = NULL;
+        uint64_t sum = 0;
+
+        (void) distance;
+        list_for_each_entry(node, list, list)
+        {
+                sum += node_work(node, rounds);
+        }
+
+        return sum;
+}
+
+static uint64_t walk_prefetch(struct list_head *list, unsigned int rounds,
+                              unsigned int distance)
+{
+        struct node *node = NULL;
+        uint64_t sum = 0;
+
+        (void) distance;
+        list_for_each_entry_prefetch(node, list, list)
+        {
+                sum += node_work(node, rounds);
+        }
+
+        return sum;
+}
+
+static uint64_t walk_ahead(struct list_head *list, unsigned int rounds,
+                           unsigned int distance)
+{
+        struct node *node = NULL;
+        struct list_head *ahead = NULL;
+        uint64_t sum = 0;
+
+        list_for_each_entry_prefetch_ahead(node, ahead, list, list, distance)
+        {
+                sum += node_work(node, rounds);
+        }
+
+        return sum;
+}
+
+/* evict the list from the cache */
+static void cache_flush(char *buffer, size_t size)
+{
+        size_t i;
+
+        for(i = 0; i < size; i += 64)
+        {
+                buffer[i] = (char) i;
+        }
+}
+
+static void bench_run(struct list_head *list, char *buffer, size_t size,
+                      const char *name,
+                      uint64_t (*walk)(struct list_head *, unsigned int,
+                                       unsigned int),
+                      unsigned int rounds, unsigned int distance)
+{
+        double start,
+                elapsed,
+                best = 0;
+        unsigned int run;
+
+        for(run = 0; run < RUNS; ++run)
+        {
+                cache_flush(buffer, size);
+
+                start = now();
+                sink += walk(list, rounds, distance);
+                elapsed = now() - start;
+
+                if(run == 0 || elapsed < best)
+                {
+                        best = elapsed;
+                }
+        }
+
+        printf("%-16s rounds=%-3u distance=%-3u %7.2f ns/node\n",
+               name, rounds, distance, best * 1e9 / NODES_COUNT);
+}
+
+int main(void)
+{
+        static const unsigned int rounds[] = { 0, 50, 200 };
+        static const unsigned int distances[] = { 4, 8, 16, 32 };
+        struct node *nodes = NULL;
+        unsigned int *order = NULL;
+        size_t flush_size = 64 << 20;
+        char *flush = NULL;
+        LIST_HEAD(list);
+        unsigned int i,
+                j,
+                tmp;
+
+        nodes = calloc(NODES_COUNT, sizeof(*nodes));
+        order = malloc(NODES_COUNT * sizeof(*order));
+        flush = malloc(flush_size);
+        if(nodes == NULL || order == NULL || flush == NULL)
+        {
+                perror("alloc");
+                return EXIT_FAILURE;
+        }
+
+        /* random order: the hardware prefetcher can't guess the next
+         * entry */
+        srand(42);
+        for(i = 0; i < NODES_COUNT; ++i)
+        {
+                order[i] = i;
+        }
+        for(i = NODES_COUNT - 1; i > 0; --i)
+        {
+                j = (unsigned int) rand() % (i + 1);
+                tmp = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
+        }
+        for(i = 0; i < NODES_COUNT; ++i)
+        {
+                nodes[order[i]].key = i;
+                list_add_tail(&nodes[order[i]].list, &list);
+        }
+
+        for(i = 0; i < ARRAY_SIZE(rounds); ++i)
+        {
+                bench_run(&list, flush, flush_size, "for_each",
+                          walk_plain, rounds[i], 0);
+                bench_run(&list, flush, flush_size, "prefetch",
+                          walk_prefetch, rounds[i], 1);
+                for(j = 0; j < ARRAY_SIZE(distances); ++j)
+                {
+                        bench_run(&list, flush, flush_size, "prefetch_ahead",
+                                  walk_ahead, rounds[i], distances[j]);
+                }
+        }
+
+        if(sink == 42)
+        {
+                printf("\n");
+        }
+
+        free(flush);
+        free(order);
+        free(nodes);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * bench_queue - throughput of thread queues
+ *
+ *  N producers push items to one consumer through:
+ *  - a list_head guarded by a mutex (the usual way);
+ *  - a struct mpsc_queue;
+ *  and one producer to one consumer through a struct spsc_ring.
+ */
+
+#include <flibc/flibc.h>
+#include <flibc/list.h>
+#include <flibc/queue.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ITEMS_COUNT 2000000
+
+struct item {
+        struct list_head list;
+        struct mpsc_node node;
+};
+
+struct bench {
+        /* mutex + list_head */
+        pthread_mutex_t lock;
+        struct list_head list;
+        /* lock-free queues */
+        struct mpsc_queue queue;
+        struct spsc_ring ring;
+
+        struct item *items;
+        unsigned int producers;
+};
+
+struct producer {
+        struct bench *bench;
+        struct item *items;
+        unsigned int count;
+};
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void *mutex_producer(void *arg)
+{
+        struct producer *producer = arg;
+        unsigned int i;
+
+        for(i = 0; i < producer->count; ++i)
+        {
+                pthread_mutex_lock(&producer->bench->lock);
+                list_add_tail(&producer->items[i].list, &producer->bench->list);
+                pthread_mutex_unlock(&producer->bench->lock);
+        }
+
+        return NULL;
+}
+
+static void mutex_consumer(struct bench *bench)
+{
+        LIST_HEAD(batch);
+        unsigned int received = 0;
+        struct item *item = NULL;
+
+        while(received < ITEMS_COUNT)
+        {
+                /* take the whole list at once (the best case for a mutex) */
+                pthread_mutex_lock(&bench->lock);
+                list_splice_init(&bench->list, &batch);
+                pthread_mutex_unlock(&bench->lock);
+
+                if(list_empty(&batch))
+                {
+                        sched_yield();
+                        continue;
+                }
+
+                list_for_each_entry(item, &batch, list)
+                {
+                        ++received;
+                }
+                INIT_LIST_HEAD(&batch);
+        }
+}
+
+static void *mpsc_producer(void *arg)
+{
+        struct producer *producer = arg;
+        unsigned int i;
+
+        for(i = 0; i < producer->count; ++i)
+        {
+                mpsc_push(&producer->bench->queue, &producer->items[i].node);
+        }
+
+        return NULL;
+}
+
+static void mpsc_consumer(struct bench *bench)
+{
+        struct mpsc_node *nodes[64];
+        unsigned int received = 0;
+        size_t n;
+
+        while(received < ITEMS_COUNT)
+        {
+                n = mpsc_pop_batch(&bench->queue, nodes, ARRAY_SIZE(nodes));
+                if(n == 0)
+                {
+                        sched_yield();
+                }
+
+                received += (unsigned int) n;
+        }
+}
+
+static void *spsc_producer(void *arg)
+{
+        struct producer *producer = arg;
+        unsigned int i;
+
+        for(i = 0; i < producer->count; ++i)
+        {
+                while(spsc_ring_push(&producer->bench->ring,
+                                     &producer->items[i]) != 0)
+                {
+                        sched_yield();
+                }
+        }
+
+        return NULL;
+}
+
+static void spsc_consumer(struct bench *bench)
+{
+        void *items[64];
+        unsigned int received = 0;
+        size_t n;
+
+        while(received < ITEMS_COUNT)
+        {
+                n = spsc_ring_pop_batch(&bench->ring, items, ARRAY_SIZE(items));
+                if(n == 0)
+                {
+                        sched_yield();
+                }
+
+                received += (unsigned int) n;
+        }
+}
+
+static void bench_run(struct bench *bench, const char *name,
+                      void *(*producer_run)(void *),
+                      void (*consumer_run)(struct bench *))
+{
+        struct producer producers[16];
+        pthread_t threads[16];
+        unsigned int i;
+        double start,
+                elapsed;
+
+        start = now();
+
+        for(i = 0; i < bench->producers; ++i)
+        {
+                producers[i].bench = bench;
+                producers[i].count = ITEMS_COUNT / bench->producers;
+                producers[i].items = bench->items + i * producers[i].count;
+                if(i == bench->producers - 1)
+                {
+                        producers[i].count += ITEMS_COUNT % bench->producers;
+                }
+
+                if(pthread_create(&threads[i], NULL, producer_run,
+                                  &producers[i]) != 0)
+                {
+                        perror("pthread_create");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        consumer_run(bench);
+
+        for(i = 0; i < bench->producers; ++i)
+        {
+                pthread_join(threads[i], NULL);
+        }
+
+        elapsed = now() - start;
+
+        printf("%-12s producers=%-2u %8.2f Mitems/s\n",
+               name, bench->producers, ITEMS_COUNT / elapsed / 1e6);
+}
+
+int main(void)
+{
+        static const unsigned int producers[] = { 1, 2, 4, 8 };
+        struct bench bench;
+        unsigned int i;
+
+        bench.items = calloc(ITEMS_COUNT, sizeof(struct item));
+        if(bench.items == NULL
+           || spsc_ring_init(&bench.ring, 4096) != 0)
+        {
+                perror("alloc");
+                return EXIT_FAILURE;
+        }
+
+        pthread_mutex_init(&bench.lock, NULL);
+        INIT_LIST_HEAD(&bench.list);
+        mpsc_queue_init(&bench.queue);
+
+        for(i = 0; i < ARRAY_SIZE(producers); ++i)
+        {
+                bench.producers = producers[i];
+                bench_run(&bench, "mutex+list", mutex_producer, mutex_consumer);
+                bench_run(&bench, "mpsc_queue", mpsc_producer, mpsc_consumer);
+        }
+
+        bench.producers = 1;
+        bench_run(&bench, "spsc_ring", spsc_producer, spsc_consumer);
+
+        spsc_ring_cleanup(&bench.ring);
+        pthread_mutex_destroy(&bench.lock);
+        free(bench.items);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * bench_rcu - read throughput of a read mostly list
+ *
+ *  N readers walk a list of 64 routes while one updater replaces a
+ *  route every millisecond. The list is protected by:
+ *  - a pthread_rwlock_t (the usual way);
+ *  - RCU (rcu_read_lock and call_rcu).
+ */
+
+#define _GNU_SOURCE
+
+#include <flibc/flibc.h>
+#include <flibc/list.h>
+#include <flibc/rcu.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ROUTES_COUNT 64
+#define DURATION_MS 500
+
+struct route {
+        unsigned long dst;
+        struct list_head node;
+        struct rcu_head rcu;
+};
+
+static LIST_HEAD(routes);
+static pthread_rwlock_t routes_lock;
+static _Atomic int running;
+static int use_rcu;
+
+struct reader {
+        pthread_t thread;
+        unsigned long long walks;
+        unsigned long sum;
+};
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void route_free(struct rcu_head *head)
+{
+        free(container_of(head, struct route, rcu));
+}
+
+static void *reader_run(void *arg)
+{
+        struct reader *reader = arg;
+        struct route *route = NULL;
+        unsigned long sum = 0;
+
+        rcu_register_thread();
+
+        while(atomic_load_explicit(&running, memory_order_relaxed))
+        {
+                if(use_rcu)
+                {
+                        rcu_read_lock();
+                        list_for_each_entry_rcu(route, &routes, node)
+                        {
+                                sum += route->dst;
+                        }
+                        rcu_read_unlock();
+                }
+                else
+                {
+                        pthread_rwlock_rdlock(&routes_lock);
+                        list_for_each_entry(route, &routes, node)
+                        {
+                                sum += route->dst;
+                        }
+                        pthread_rwlock_unlock(&routes_lock);
+                }
+
+                ++reader->walks;
+        }
+
+        reader->sum = sum;
+        rcu_unregister_thread();
+
+        return NULL;
+}
+
+static void update(unsigned long dst)
+{
+        struct route *route = malloc(sizeof(*route)),
+                *old = list_entry(routes.next, struct route, node);
+
+        if(route == NULL)
+        {
+                return;
+        }
+        route->dst = dst;
+
+        if(use_rcu)
+        {
+                list_del_rcu(&old->node);
+                list_add_tail_rcu(&route->node, &routes);
+                call_rcu(&old->rcu, route_free);
+        }
+        else
+        {
+                pthread_rwlock_wrlock(&routes_lock);
+                list_del(&old->node);
+                list_add_tail(&route->node, &routes);
+                pthread_rwlock_unlock(&routes_lock);
+                free(old);
+        }
+}
+
+static void bench_run(const char *name, unsigned int readers_count)
+{
+        struct reader readers[16];
+        unsigned long long walks = 0;
+        unsigned int i,
+                ms;
+        double start;
+
+        atomic_store(&running, 1);
+        start = now();
+
+        for(i = 0; i < readers_count; ++i)
+        {
+                readers[i].walks = 0;
+                readers[i].sum = 0;
+                if(pthread_create(&readers[i].thread, NULL, reader_run,
+                                  &readers[i]) != 0)
+                {
+                        perror("pthread_create");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        for(ms = 0; ms < DURATION_MS; ++ms)
+        {
+                usleep(1000);
+                update(ms);
+        }
+
+        atomic_store(&running, 0);
+
+        for(i = 0; i < readers_count; ++i)
+        {
+                pthread_join(readers[i].thread, NULL);
+                walks += readers[i].walks;
+        }
+
+        rcu_barrier();
+
+        printf("%-8s readers=%-2u %10.2f Mwalks/s\n", name, readers_count,
+               (double) walks / (now() - start) / 1e6);
+}
+
+int main(void)
+{
+        static const unsigned int readers[] = { 1, 2, 4, 8 };
+        struct route *route = NULL,
+                *tmp = NULL;
+        pthread_rwlockattr_t attr;
+        unsigned int i;
+
+        /* the default rwlock starves the updater */
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(&attr,
+                                      PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        pthread_rwlock_init(&routes_lock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+
+        for(i = 0; i < ROUTES_COUNT; ++i)
+        {
+                route = malloc(sizeof(*route));
+                if(route == NULL)
+                {
+                        perror("malloc");
+                        return EXIT_FAILURE;
+                }
+
+                route->dst = i;
+                list_add_tail(&route->node, &routes);
+        }
+
+        for(i = 0; i < ARRAY_SIZE(readers); ++i)
+        {
+                use_rcu = 0;
+                bench_run("rwlock", readers[i]);
+                use_rcu = 1;
+                bench_run("rcu", readers[i]);
+        }
+
+        list_for_each_entry_safe(route, tmp, &routes, node)
+        {
+                free(route);
+        }
+        pthread_rwlock_destroy(&routes_lock);
+
+        return EXIT_SUCCESS;
+}
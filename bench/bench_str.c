@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * bench_str - str module functions
+ *
+ *  Splitting a path-like string into a str_list with malloc, a pool, an
+ *  arena and interned strings, a few helpers on short strings and UTF-8
+ *  validation of a 64 KiB text (mostly ASCII, some 2, 3 and 4 bytes
+ *  characters).
+ *  Replacing 32 variables of a template with str_replace() calls and
+ *  with one str_multi_replace().
+ */
+
+#include <flibc/arena.h>
+#include <flibc/flibc.h>
+#include <flibc/pool.h>
+#include <flibc/str.h>
+#include <flibc/str_intern.h>
+#include <flibc/str_multi.h>
+#include <flibc/unit.h>
+
+static const char split_input[] =
+        "/usr/local/share/flibc/include/flibc/str.h/usr/lib/opt/bin";
+
+BENCH_DEF(bench_str_split)
+{
+        struct str_list list;
+
+        BENCH_SET_BYTES(sizeof(split_input) - 1);
+        BENCH_LOOP
+        {
+                str_split(split_input, "/", &list);
+                DO_NOT_OPTIMIZE(list.count);
+                str_list_cleanup(&list);
+        }
+}
+
+BENCH_DEF(bench_str_split_pool)
+{
+        struct str_list list;
+        struct pool pool;
+
+        pool_init(&pool, STR_LIST_POOL_SIZE(32), 0);
+
+        BENCH_SET_BYTES(sizeof(split_input) - 1);
+        BENCH_LOOP
+        {
+                str_split_pool(split_input, "/", &list, &pool);
+                DO_NOT_OPTIMIZE(list.count);
+                str_list_cleanup(&list);
+        }
+
+        pool_cleanup(&pool);
+}
+
+BENCH_DEF(bench_str_split_arena)
+{
+        struct str_list list;
+        struct arena arena;
+
+        arena_init(&arena, 0, 0);
+
+        BENCH_SET_BYTES(sizeof(split_input) - 1);
+        BENCH_LOOP
+        {
+                str_split_arena(split_input, "/", &list, &arena);
+                DO_NOT_OPTIMIZE(list.count);
+                str_list_cleanup(&list);
+                arena_reset(&arena);
+        }
+
+        arena_cleanup(&arena);
+}
+
+BENCH_DEF(bench_str_split_intern)
+{
+        struct str_list list;
+        struct str_intern intern;
+
+        str_intern_init(&intern, 0);
+
+        BENCH_SET_BYTES(sizeof(split_input) - 1);
+        BENCH_LOOP
+        {
+                str_split_intern(split_input, "/", &list, &intern);
+                DO_NOT_OPTIMIZE(list.count);
+                str_list_cleanup(&list);
+        }
+
+        str_intern_cleanup(&intern);
+}
+
+BENCH_DEF(bench_str_intern)
+{
+        struct str_intern intern;
+        const char *field = "content-type";
+
+        str_intern_init(&intern, 0);
+
+        BENCH_LOOP
+        {
+                DO_NOT_OPTIMIZE(field);
+                DO_NOT_OPTIMIZE(str_intern(&intern, field, 12));
+        }
+
+        str_intern_cleanup(&intern);
+}
+
+BENCH_DEF(bench_str_copy)
+{
+        char buffer[64];
+
+        BENCH_SET_BYTES(sizeof(split_input) - 1);
+        BENCH_LOOP
+        {
+                DO_NOT_OPTIMIZE(str_copy(buffer, sizeof(buffer),
+                                         split_input));
+                BENCH_CLOBBER();
+        }
+}
+
+BENCH_DEF(bench_str_tol)
+{
+        const char *value = "1234567";
+
+        BENCH_LOOP
+        {
+                DO_NOT_OPTIMIZE(value);
+                DO_NOT_OPTIMIZE(str_tol(value, NULL, 10, -1));
+        }
+}
+
+static char utf8_text[64 * 1024];
+
+static void utf8_text_init(void)
+{
+        static const char sample[] =
+                "Le caf\xc3\xa9 co\xc3\xbbte 2 \xe2\x82\xac, "
+                "\xe6\x97\xa5\xe6\x9c\xac \xf0\x9f\x98\x80 and some "
+                "plain ASCII text to make it realistic.\n";
+        size_t i;
+
+        /* whole samples only */
+        for(i = 0; i + sizeof(sample) - 1 <= sizeof(utf8_text);
+            i += sizeof(sample) - 1)
+        {
+                memcpy(utf8_text + i, sample, sizeof(sample) - 1);
+        }
+        memset(utf8_text + i, ' ', sizeof(utf8_text) - i);
+}
+
+BENCH_DEF(bench_str_utf8_valid)
+{
+        BENCH_SET_BYTES(sizeof(utf8_text));
+        BENCH_LOOP
+        {
+                DO_NOT_OPTIMIZE(str_utf8_valid(utf8_text, sizeof(utf8_text)));
+        }
+}
+
+BENCH_DEF(bench_str_utf8_valid_scalar)
+{
+        BENCH_SET_BYTES(sizeof(utf8_text));
+        BENCH_LOOP
+        {
+                DO_NOT_OPTIMIZE(str_utf8_valid_scalar(utf8_text,
+                                                      sizeof(utf8_text)));
+        }
+}
+
+BENCH_DEF(bench_str_utf8_len)
+{
+        BENCH_SET_BYTES(sizeof(utf8_text));
+        BENCH_LOOP
+        {
+                DO_NOT_OPTIMIZE(str_utf8_len(utf8_text, sizeof(utf8_text)));
+        }
+}
+
+BENCH_DEF(bench_str_casestr)
+{
+        BENCH_SET_BYTES(sizeof(utf8_text));
+        BENCH_LOOP
+        {
+                /* not found: the whole text is searched */
+                DO_NOT_OPTIMIZE(str_casestr_len(utf8_text, sizeof(utf8_text),
+                                                "Content-Length", 14));
+        }
+}
+
+BENCH_DEF(bench_str_casecmp)
+{
+        const char *name = "Content-Security-Policy-Report-Only",
+                *expected = "content-security-policy-report-only";
+
+        BENCH_LOOP
+        {
+                DO_NOT_OPTIMIZE(name);
+                DO_NOT_OPTIMIZE(str_casecmp(name, expected));
+        }
+}
+
+#define TEMPLATE_VARS 32
+
+static char template_text[4096];
+static char template_vars[TEMPLATE_VARS][16];
+
+static void template_init(void)
+{
+        unsigned int i;
+
+        for(i = 0; i < TEMPLATE_VARS; ++i)
+        {
+                str_printf(template_vars[i], sizeof(template_vars[i]),
+                           "{{var%u}}", i);
+        }
+
+        /* text with a variable every 64 bytes or so */
+        template_text[0] = '\0';
+        for(i = 0; str_catf(template_text, sizeof(template_text),
+                            "%s some words of text, %s", template_vars[i % 32],
+                            "and a few more around it. ")
+                    < sizeof(template_text) - 128; ++i)
+        {
+        }
+}
+
+BENCH_DEF(bench_str_replace_chain)
+{
+        char a[8192],
+                b[8192];
+        unsigned int i;
+
+        BENCH_SET_BYTES(strlen(template_text));
+        BENCH_LOOP
+        {
+                str_copy(a, sizeof(a), template_text);
+                for(i = 0; i < TEMPLATE_VARS; ++i)
+                {
+                        str_replace(a, template_vars[i], "value", b,
+                                    sizeof(b));
+                        str_copy(a, sizeof(a), b);
+                }
+                DO_NOT_OPTIMIZE(a[0]);
+        }
+}
+
+BENCH_DEF(bench_str_multi_replace)
+{
+        struct str_multi multi;
+        char output[8192];
+        unsigned int i;
+
+        str_multi_init(&multi);
+        for(i = 0; i < TEMPLATE_VARS; ++i)
+        {
+                str_multi_add(&multi, template_vars[i], "value");
+        }
+        str_multi_compile(&multi);
+
+        BENCH_SET_BYTES(strlen(template_text));
+        BENCH_LOOP
+        {
+                str_multi_replace(&multi, template_text, output,
+                                  sizeof(output));
+                DO_NOT_OPTIMIZE(output[0]);
+        }
+
+        str_multi_cleanup(&multi);
+}
+
+int main(void)
+{
+        utf8_text_init();
+        template_init();
+
+        BENCH_MODULE_INIT("flibc/str");
+
+        BENCH_RUN(bench_str_split);
+        BENCH_RUN(bench_str_split_pool);
+        BENCH_RUN(bench_str_split_arena);
+        BENCH_RUN(bench_str_split_intern);
+        BENCH_RUN(bench_str_intern);
+        BENCH_RUN(bench_str_copy);
+        BENCH_RUN(bench_str_tol);
+        BENCH_RUN(bench_str_utf8_valid);
+        BENCH_RUN(bench_str_utf8_valid_scalar);
+        BENCH_RUN(bench_str_utf8_len);
+        BENCH_RUN(bench_str_casestr);
+        BENCH_RUN(bench_str_casecmp);
+        BENCH_RUN(bench_str_replace_chain);
+        BENCH_RUN(bench_str_multi_replace);
+
+        return BENCH_MODULE_RETURN;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_ALLOC_H_
+#define _FLIBC_ALLOC_H_
+
+#include <stddef.h>
+
+/*
+ * alloc.h - count memory allocations (for tests and benchmarks)
+ *
+ *  libflibc_alloc replaces malloc(), calloc(), realloc(), free() and the
+ *  aligned variants by functions which count calls and bytes, per
+ *  thread, then call the ones of the C library. Link it before the C
+ *  library (-Wl,--no-as-needed -lflibc_alloc: else the linker may drop
+ *  it if the program doesn't call malloc() itself) or preload it
+ *  (LD_PRELOAD=libflibc_alloc.so). Functions of the C library which
+ *  allocate, like strdup(), are counted too.
+ *
+ * - libflibc_alloc is built for the tests and benchmarks of flibc (in
+ *   src/.libs), it isn't installed;
+ * - counters are per thread: allocations of other threads don't change
+ *   the result of a scope;
+ * - only the GNU C library is supported: elsewhere, alloc_tracking()
+ *   returns 0 and counters stay at 0;
+ * - see TEST_ASSERT_NO_ALLOC() in unit.h.
+ *
+ * Example:
+ * --------
+ *
+ * struct alloc_stats stats;
+ *
+ * ALLOC_COUNT(&stats, {
+ *      str_split(path, "/", &list);
+ * });
+ * printf("%lu allocations, %zu bytes\n", stats.allocs, stats.bytes);
+ */
+
+struct alloc_stats {
+        /* calls which returned memory (a realloc() counts as one) */
+        unsigned long allocs;
+        /* calls to free() with a non NULL pointer */
+        unsigned long frees;
+        /* bytes asked by allocations */
+        size_t bytes;
+};
+
+/*
+ * alloc_tracking
+ *
+ * \return 1 if allocations are counted, 0 otherwise
+ */
+int alloc_tracking(void);
+
+/*
+ * alloc_stats_get
+ *
+ *  Get the counters of the calling thread since it started.
+ */
+void alloc_stats_get(struct alloc_stats *stats);
+
+/*
+ * alloc_stats_sub
+ *
+ *  stats -= before: counters between two alloc_stats_get().
+ */
+static inline void alloc_stats_sub(struct alloc_stats *stats,
+                                   const struct alloc_stats *before)
+{
+        stats->allocs -= before->allocs;
+        stats->frees -= before->frees;
+        stats->bytes -= before->bytes;
+}
+
+/*
+ * ALLOC_COUNT
+ *
+ *  Count allocations of a block of code in stats.
+ */
+#define ALLOC_COUNT(stats, ...) do                                      \
+        {                                                               \
+                struct alloc_stats __alloc_before;                      \
+                                                                        \
+                alloc_stats_get(&__alloc_before);                       \
+                __VA_ARGS__;                                            \
+                alloc_stats_get(stats);                                 \
+                alloc_stats_sub(stats, &__alloc_before);                \
+        } while(0)
+
+#endif
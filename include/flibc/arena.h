@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_ARENA_H_
+#define _FLIBC_ARENA_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * arena.h - bump allocator for memory with the same lifetime
+ *
+ *  Allocations are carved one after another from big chunks: allocating
+ *  is a pointer increment and there is no free of single objects. All
+ *  the memory is freed at once by arena_reset() (or back to a mark with
+ *  arena_restore()), typically at the end of a request.
+ *
+ * - chunks are kept by arena_reset() and arena_restore() and reused:
+ *   once warm, an arena doesn't call malloc anymore;
+ * - with ARENA_HUGEPAGE, chunks are backed by huge pages (hugetlbfs if
+ *   pages are reserved, transparent huge pages otherwise) to save TLB
+ *   misses on big arenas;
+ * - an arena isn't thread safe: use one per thread (or per request).
+ *
+ * Example:
+ * --------
+ *
+ * struct arena arena;
+ *
+ * arena_init(&arena, 0, 0);
+ * while(next_request(&req))
+ * {
+ *      name = arena_strdup(&arena, req.name);
+ *      str_split_arena(req.path, "/", &parts, &arena);
+ *      // your stuff //
+ *      arena_reset(&arena);
+ * }
+ * arena_cleanup(&arena);
+ */
+
+/* default size of chunks */
+#define ARENA_CHUNK_SIZE (64 * 1024)
+/* size of huge pages (and of chunks with ARENA_HUGEPAGE) */
+#define ARENA_HUGEPAGE_SIZE (2 * 1024 * 1024)
+/* alignment of arena_alloc() */
+#define ARENA_ALIGN __alignof__(max_align_t)
+
+/* flags of arena_init() */
+#define ARENA_HUGEPAGE 0x1
+
+struct arena_chunk;
+
+struct arena {
+        /* free space of the current chunk */
+        char *pos;
+        char *end;
+        /* current chunk (chunks are linked to the previous ones) */
+        struct arena_chunk *chunk;
+        /* chunks kept for reuse */
+        struct arena_chunk *spare;
+        size_t chunk_size;
+        int flags;
+};
+
+struct arena_mark {
+        struct arena_chunk *chunk;
+        char *pos;
+};
+
+/*
+ * arena_init
+ *
+ *  Init an arena (and allocate its first chunk).
+ *
+ * \param arena The arena
+ * \param chunk_size Size of chunks (0 for ARENA_CHUNK_SIZE)
+ * \param flags 0 or ARENA_HUGEPAGE
+ * \return 0 if success, -1 otherwise
+ */
+int arena_init(struct arena *arena, size_t chunk_size, int flags);
+
+/*
+ * arena_cleanup
+ *
+ *  Free all the memory of an arena.
+ */
+void arena_cleanup(struct arena *arena);
+
+/*
+ * arena_reset
+ *
+ *  Free all allocations of an arena (chunks are kept).
+ */
+void arena_reset(struct arena *arena);
+
+/*
+ * arena_save
+ *
+ *  Save the current position of an arena.
+ */
+static inline void arena_save(const struct arena *arena,
+                              struct arena_mark *mark)
+{
+        mark->chunk = arena->chunk;
+        mark->pos = arena->pos;
+}
+
+/*
+ * arena_restore
+ *
+ *  Free all allocations done since arena_save(mark).
+ *
+ * - marks saved after this one are invalid after.
+ */
+void arena_restore(struct arena *arena, const struct arena_mark *mark);
+
+void *__arena_alloc_slow(struct arena *arena, size_t size, size_t align);
+
+/*
+ * arena_alloc_align
+ *
+ *  Allocate memory with a given alignment (power of 2).
+ *
+ * \return the memory or NULL if no memory
+ */
+static inline void *arena_alloc_align(struct arena *arena, size_t size,
+                                      size_t align)
+{
+        uintptr_t p = ((uintptr_t) arena->pos + align - 1)
+                & ~(uintptr_t) (align - 1);
+
+        if(p <= (uintptr_t) arena->end && size <= (uintptr_t) arena->end - p)
+        {
+                arena->pos = (char *) p + size;
+                return (void *) p;
+        }
+
+        return __arena_alloc_slow(arena, size, align);
+}
+
+/*
+ * arena_alloc
+ *
+ *  Allocate memory (aligned like malloc).
+ *
+ * \return the memory or NULL if no memory
+ */
+static inline void *arena_alloc(struct arena *arena, size_t size)
+{
+        return arena_alloc_align(arena, size, ARENA_ALIGN);
+}
+
+/*
+ * arena_zalloc
+ *
+ *  Allocate memory filled with zeros.
+ */
+void *arena_zalloc(struct arena *arena, size_t size);
+
+/*
+ * arena_strdup
+ *
+ *  Duplicate a string in an arena.
+ *
+ * \return the copy or NULL if no memory
+ */
+char *arena_strdup(struct arena *arena, const char *str);
+
+/*
+ * arena_strndup
+ *
+ *  Duplicate at most n chars of a string in an arena (the copy is
+ *  always null terminated).
+ *
+ * \return the copy or NULL if no memory
+ */
+char *arena_strndup(struct arena *arena, const char *str, size_t n);
+
+/*
+ * arena_vprintf
+ *
+ *  Format a string in an arena.
+ *
+ * - never call this function with a fmt given by user input.
+ *
+ * \return the string or NULL if error
+ */
+char *arena_vprintf(struct arena *arena, const char *fmt, va_list args)
+        __attribute__((format(printf, 2, 0)));
+
+/*
+ * arena_printf
+ *
+ *  Format a string in an arena (like asprintf).
+ *
+ * \return the string or NULL if error
+ */
+char *arena_printf(struct arena *arena, const char *fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+
+#endif
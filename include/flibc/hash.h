@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_HASH_H_
+#define _FLIBC_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "flibc/list.h"
+
+/*
+ * hash.h - intrusive hash table
+ *
+ * - like list_head, a struct hash_node is embedded in your structure;
+ * - the table stores a 64 bits key per node (an integer id or the hash of
+ *   a string computed with hash_str()): the table doesn't know your real
+ *   keys, so compare them in the body of hash_for_each_possible();
+ * - the table grows by itself (load factor 1). Nodes are moved to the new
+ *   buckets a few at a time by each hash_add() (and the old bucket of a
+ *   key by a lookup), so there isn't any latency spike when the table
+ *   grows. hash_del() never moves nodes;
+ * - the table isn't thread-safe, even lookup may move nodes.
+ *
+ * Example:
+ * --------
+ *
+ * struct user {
+ *      char name[32];
+ *      struct hash_node hnode;
+ * };
+ *
+ * hash_init(&table, 8);
+ *
+ * hash_add(&table, &user->hnode, hash_str(user->name));
+ *
+ * hash_for_each_possible(&table, user, hnode, hash_str("bob"))
+ * {
+ *      if(strcmp(user->name, "bob") == 0)
+ *              break;
+ * }
+ */
+
+/*
+ * Node to embed in structures stored in a hash table
+ */
+struct hash_node {
+        struct hlist_node node;
+        uint64_t key;
+};
+
+/*
+ * Hash table. Don't touch the members.
+ *
+ * While the table grows, old_buckets is the previous array of buckets
+ * and old_pos is the next old bucket to move.
+ */
+struct hash_table {
+        struct hlist_head *buckets;
+        struct hlist_head *old_buckets;
+        unsigned int bits;
+        unsigned int old_bits;
+        size_t old_pos;
+        size_t count;
+};
+
+/*
+ * Number of old buckets moved by each hash_add() while the table grows
+ */
+#define HASH_REHASH_STEP 4
+
+/*
+ * hash_64
+ *
+ *  Hash an integer into bits bits (multiplicative hashing).
+ *
+ * \param val The integer
+ * \param bits Number of bits of the result (1 to 64)
+ * \return hash of val
+ */
+static inline uint64_t hash_64(uint64_t val, unsigned int bits)
+{
+        return (val * 0x61c8864680b583ebULL) >> (64 - bits);
+}
+
+/*
+ * Mix two 64 bits integers (folded 128 bits multiplication)
+ */
+static inline uint64_t __hash_mix(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+        __uint128_t r = (__uint128_t)a * b;
+
+        return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+        uint64_t r = a * b;
+
+        return r ^ (r >> 32) ^ (a >> 29) * 0x9fb21c651e98df25ULL;
+#endif
+}
+
+/*
+ * hash_mem_seed
+ *
+ *  Hash a buffer with a seed. With a random seed kept secret (one per
+ *  table), which keys collide can't be guessed from outside, so keys
+ *  chosen by an attacker don't flood a table. It isn't a keyed hash
+ *  like SipHash though: don't use it where that is needed.
+ *
+ * \param data The buffer
+ * \param len Size of the buffer
+ * \param seed The seed
+ * \return a 64 bits hash
+ */
+static inline uint64_t hash_mem_seed(const void *data, size_t len,
+                                     uint64_t seed)
+{
+        const unsigned char *p = data;
+        uint64_t h = seed ^ len,
+                w;
+
+        while(len >= 8)
+        {
+                memcpy(&w, p, 8);
+                h = __hash_mix(h ^ w, 0xa0761d6478bd642fULL);
+                p += 8;
+                len -= 8;
+        }
+
+        w = 0;
+        memcpy(&w, p, len);
+        h = __hash_mix(h ^ w, 0xe7037ed1a0b428dbULL);
+
+        return __hash_mix(h, 0x8ebc6af09c88c6e3ULL);
+}
+
+/*
+ * hash_mem
+ *
+ *  Hash a buffer. Fast (8 bytes per multiplication) but not resistant
+ *  to hash flooding: don't use it with keys chosen by an attacker (see
+ *  hash_mem_seed()).
+ *
+ * \param data The buffer
+ * \param len Size of the buffer
+ * \return a 64 bits hash
+ */
+static inline uint64_t hash_mem(const void *data, size_t len)
+{
+        return hash_mem_seed(data, len, 0x243f6a8885a308d3ULL);
+}
+
+/*
+ * hash_str
+ *
+ *  Hash a string (see hash_mem()).
+ */
+static inline uint64_t hash_str(const char *str)
+{
+        return hash_mem(str, strlen(str));
+}
+
+/*
+ * hash_init
+ *
+ *  Init an empty hash table.
+ *
+ * \param table The table
+ * \param bits The table starts with 2^bits buckets
+ * \return 0 if success, -1 if allocation failed
+ */
+int hash_init(struct hash_table *table, unsigned int bits);
+
+/*
+ * hash_cleanup
+ *
+ *  Free buckets of the table (nodes aren't touched).
+ */
+void hash_cleanup(struct hash_table *table);
+
+/*
+ * hash_add
+ *
+ *  Add a node in the table. Several nodes can have the same key.
+ *
+ * - if the table can't grow (allocation failure), the node is still
+ *   added (chains are just longer).
+ *
+ * \param table The table
+ * \param node The node to add
+ * \param key The key of the node
+ */
+void hash_add(struct hash_table *table, struct hash_node *node, uint64_t key);
+
+/*
+ * hash_del
+ *
+ *  Remove a node from the table.
+ */
+void hash_del(struct hash_table *table, struct hash_node *node);
+
+/*
+ * hash_count
+ *
+ *  Number of nodes in the table.
+ */
+static inline size_t hash_count(const struct hash_table *table)
+{
+        return table->count;
+}
+
+/*
+ * Give the bucket of a key (move its old bucket first if the table grows)
+ */
+struct hlist_head *__hash_bucket(struct hash_table *table, uint64_t key);
+
+/*
+ * Total number of buckets (old and new ones) and bucket by index
+ * for hash_for_each()
+ */
+static inline size_t __hash_size(const struct hash_table *table)
+{
+        return ((size_t)1 << table->bits)
+                + (table->old_buckets != NULL ? (size_t)1 << table->old_bits
+                   : 0);
+}
+
+static inline struct hlist_head *__hash_index(const struct hash_table *table,
+                                              size_t bkt)
+{
+        size_t size = (size_t)1 << table->bits;
+
+        return bkt < size ? &table->buckets[bkt]
+                : &table->old_buckets[bkt - size];
+}
+
+/*
+ * The key of hash_for_each_possible{,_safe}() is evaluated once: the outer
+ * loop only binds it (a break in the body leaves both loops).
+ */
+#define __hash_concat(a, b) a##b
+#define __hash_var(name, line) __hash_concat(name, line)
+#define __hash_key __hash_var(__hash_key_, __LINE__)
+#define __hash_once __hash_var(__hash_once_, __LINE__)
+
+/*
+ * hash_for_each_possible - iterate over nodes of a key
+ * @table: the table.
+ * @obj: the type * to use as a loop cursor.
+ * @member: the name of the hash_node within the struct.
+ * @k: the key (evaluated once).
+ */
+#define hash_for_each_possible(table, obj, member, k)                   \
+        for(uint64_t __hash_key = (k), __hash_once = 1;                 \
+            __hash_once; __hash_once = 0)                               \
+                hlist_for_each_entry(obj, __hash_bucket(table, __hash_key), \
+                                     member.node)                       \
+                        if((obj)->member.key != __hash_key) {} else
+
+/*
+ * hash_for_each_possible_safe - iterate over nodes of a key safe against
+ *                               removal of the node (with hash_del())
+ * @table: the table.
+ * @obj: the type * to use as a loop cursor.
+ * @tmp: a struct hlist_node * to use as temporary storage.
+ * @member: the name of the hash_node within the struct.
+ * @k: the key (evaluated once).
+ */
+#define hash_for_each_possible_safe(table, obj, tmp, member, k)         \
+        for(uint64_t __hash_key = (k), __hash_once = 1;                 \
+            __hash_once; __hash_once = 0)                               \
+                hlist_for_each_entry_safe(obj, tmp,                     \
+                                          __hash_bucket(table,          \
+                                                        __hash_key),    \
+                                          member.node)                  \
+                        if((obj)->member.key != __hash_key) {} else
+
+/*
+ * hash_for_each - iterate over all nodes of the table
+ * @table: the table.
+ * @bkt: a size_t to use as bucket loop cursor.
+ * @obj: the type * to use as a loop cursor.
+ * @member: the name of the hash_node within the struct.
+ */
+#define hash_for_each(table, bkt, obj, member)                          \
+        for((bkt) = 0, obj = NULL;                                      \
+            obj == NULL && (bkt) < __hash_size(table); (bkt)++)         \
+                hlist_for_each_entry(obj, __hash_index(table, bkt),     \
+                                     member.node)
+
+/*
+ * hash_for_each_safe - iterate over all nodes of the table safe against
+ *                      removal of the node (with hash_del())
+ * @table: the table.
+ * @bkt: a size_t to use as bucket loop cursor.
+ * @tmp: a struct hlist_node * to use as temporary storage.
+ * @obj: the type * to use as a loop cursor.
+ * @member: the name of the hash_node within the struct.
+ */
+#define hash_for_each_safe(table, bkt, tmp, obj, member)                \
+        for((bkt) = 0, obj = NULL;                                      \
+            obj == NULL && (bkt) < __hash_size(table); (bkt)++)         \
+                hlist_for_each_entry_safe(obj, tmp,                     \
+                                          __hash_index(table, bkt),     \
+                                          member.node)
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_HEAP_H_
+#define _FLIBC_HEAP_H_
+
+#include <limits.h>
+
+#include "flibc/list.h"
+
+/*
+ * heap.h - intrusive d-ary min-heap (priority queue)
+ *
+ *  A struct heap_node is embedded in your structure and heap_entry()
+ *  gives the structure back. The heap is an array of pointers to the
+ *  nodes, and each node knows its index in the array: so heap_remove()
+ *  and heap_update() of any node are O(log n), without searching it.
+ *
+ * - the top is the smallest node for the less() function;
+ * - HEAP_ARITY children per node: a wider heap is less deep and its
+ *   children are in the same cache line, so sift down is faster than
+ *   with a binary heap;
+ * - heap_insert() is the only function which may allocate memory.
+ *
+ * Example:
+ * --------
+ *
+ * struct timer {
+ *      unsigned long expire;
+ *      struct heap_node node;
+ * };
+ *
+ * static int timer_less(const struct heap_node *a,
+ *                       const struct heap_node *b)
+ * {
+ *      return heap_entry(a, const struct timer, node)->expire
+ *              < heap_entry(b, const struct timer, node)->expire;
+ * }
+ *
+ * heap_init(&heap, timer_less);
+ * heap_insert(&heap, &timer->node);
+ *
+ * timer->expire = now + 10;
+ * heap_update(&heap, &timer->node);
+ *
+ * first = heap_entry(heap_top(&heap), struct timer, node);
+ */
+
+/* number of children of a node */
+#define HEAP_ARITY 4
+
+/* index of a node which isn't in a heap */
+#define HEAP_NODE_NONE UINT_MAX
+
+struct heap_node {
+        unsigned int index;
+};
+
+typedef int (*heap_less_func_t)(const struct heap_node *a,
+                                const struct heap_node *b);
+
+struct heap {
+        struct heap_node **nodes;
+        unsigned int count;
+        unsigned int size;
+        heap_less_func_t less;
+};
+
+#define heap_entry(ptr, type, member) container_of(ptr, type, member)
+
+/*
+ * heap_node_init
+ *
+ *  Init a node: heap_node_queued() is false until it's inserted.
+ */
+static inline void heap_node_init(struct heap_node *node)
+{
+        node->index = HEAP_NODE_NONE;
+}
+
+/*
+ * heap_node_queued
+ *
+ * \return 1 if the node is in a heap (initialized with
+ * heap_node_init()), 0 otherwise
+ */
+static inline int heap_node_queued(const struct heap_node *node)
+{
+        return node->index != HEAP_NODE_NONE;
+}
+
+/*
+ * heap_top
+ *
+ * \return the smallest node or NULL if the heap is empty
+ */
+static inline struct heap_node *heap_top(const struct heap *heap)
+{
+        return heap->count ? heap->nodes[0] : NULL;
+}
+
+static inline unsigned int heap_count(const struct heap *heap)
+{
+        return heap->count;
+}
+
+static inline int heap_empty(const struct heap *heap)
+{
+        return heap->count == 0;
+}
+
+/*
+ * heap_init
+ *
+ *  Init an empty heap (no memory is allocated).
+ *
+ * \param heap The heap
+ * \param less Returns non zero if a must be before b
+ */
+void heap_init(struct heap *heap, heap_less_func_t less);
+
+/*
+ * heap_cleanup
+ *
+ *  Free the array of the heap. Nodes aren't touched.
+ */
+void heap_cleanup(struct heap *heap);
+
+/*
+ * heap_reserve
+ *
+ *  Allocate room for count nodes, so next insertions don't allocate.
+ *
+ * \return 0 if success, -1 otherwise
+ */
+int heap_reserve(struct heap *heap, unsigned int count);
+
+/*
+ * heap_insert
+ *
+ *  Insert a node in the heap (it must not be in a heap yet).
+ *
+ * \return 0 if success, -1 if no memory
+ */
+int heap_insert(struct heap *heap, struct heap_node *node);
+
+/*
+ * heap_pop
+ *
+ *  Remove the smallest node from the heap.
+ *
+ * \return the node or NULL if the heap is empty
+ */
+struct heap_node *heap_pop(struct heap *heap);
+
+/*
+ * heap_remove
+ *
+ *  Remove a node from the heap, wherever it is.
+ */
+void heap_remove(struct heap *heap, struct heap_node *node);
+
+/*
+ * heap_decrease
+ *
+ *  Move a node whose key has decreased (decrease-key). Cheaper than
+ *  heap_update() when the key can only go down.
+ */
+void heap_decrease(struct heap *heap, struct heap_node *node);
+
+/*
+ * heap_update
+ *
+ *  Move a node whose key has changed, in either direction.
+ */
+void heap_update(struct heap *heap, struct heap_node *node);
+
+#endif
@@ -23,7 +23,7 @@
 /*!
  * \file lib/list.h Copied from the Linux kernel source tree
  *
- * \brief Implement doubly linked list (list_head)
+ * \brief Implement doubly linked list (list_head and hlist_head)
  *
  * \author Licensed under the GPL v2 as per the whole kernel source tree.
  * 
@@ -439,4 +439,257 @@ list_splice_init(struct list_head *list, struct list_head *head)
              &pos->member != (head);                                    \
              pos = n, n = list_entry(n->member.prev, typeof(*n), member))
 
+/**
+ * list_prefetch - prefetch memory for reading (never faults)
+ * @x:          the address to prefetch.
+ */
+#define list_prefetch(x) __builtin_prefetch(x)
+
+/* default number of entries prefetched ahead */
+#define LIST_PREFETCH_DISTANCE 8
+
+/**
+ * list_for_each_entry_prefetch - iterate over list of given type, prefetching the next entry
+ * @pos:        the type * to use as a loop cursor.
+ * @head:       the head for your list.
+ * @member:     the name of the list_struct within the struct.
+ *
+ * Same as list_for_each_entry(), but the next entry is prefetched
+ * before the body runs: its load overlaps with the work on the current
+ * entry. Useful on long lists out of the cache when the body does some
+ * work; for a body of a few instructions, use
+ * list_for_each_entry_prefetch_ahead().
+ */
+#define list_for_each_entry_prefetch(pos, head, member)                 \
+        for (pos = list_entry((head)->next, typeof(*pos), member);      \
+             list_prefetch(pos->member.next), &pos->member != (head);   \
+             pos = list_entry(pos->member.next, typeof(*pos), member))
+
+/* move the ahead cursor of list_for_each_entry_prefetch_ahead() */
+static inline struct list_head *
+__list_prefetch_ahead(struct list_head *ahead, const struct list_head *head,
+                      size_t offset)
+{
+        if (ahead != head) {
+                ahead = ahead->next;
+                /* the containing object, not only the list node */
+                list_prefetch((char *)ahead - offset);
+                list_prefetch(ahead);
+        }
+        return ahead;
+}
+
+static inline struct list_head *
+__list_prefetch_ahead_init(const struct list_head *head, size_t offset,
+                           unsigned int distance)
+{
+        struct list_head *ahead = head->next;
+
+        list_prefetch((char *)ahead - offset);
+        while (distance-- > 0 && ahead != head)
+                ahead = __list_prefetch_ahead(ahead, head, offset);
+        return ahead;
+}
+
+/**
+ * list_for_each_entry_prefetch_ahead - iterate over list of given type, prefetching entries a distance ahead
+ * @pos:        the type * to use as a loop cursor.
+ * @ahead:      a &struct list_head * to use as temporary storage.
+ * @head:       the head for your list.
+ * @member:     the name of the list_struct within the struct.
+ * @distance:   number of entries between @pos and @ahead.
+ *
+ * A second cursor runs @distance entries before @pos, and each object
+ * it reaches is prefetched: when @pos gets there, the object is
+ * (hopefully) in the cache. The longer the memory latency compared to
+ * the body, the larger @distance should be (LIST_PREFETCH_DISTANCE is
+ * a good start). The list must not be modified by the body.
+ */
+#define list_for_each_entry_prefetch_ahead(pos, ahead, head, member, distance) \
+        for (pos = list_entry((head)->next, typeof(*pos), member),      \
+                ahead = __list_prefetch_ahead_init((head),              \
+                        offsetof(typeof(*pos), member), (distance));    \
+             &pos->member != (head);                                    \
+             pos = list_entry(pos->member.next, typeof(*pos), member),  \
+                ahead = __list_prefetch_ahead(ahead, (head),            \
+                        offsetof(typeof(*pos), member)))
+
+/*!
+ * Double linked lists with a single pointer list head.
+ * Mostly useful for hash tables where the two pointer list head is
+ * too wasteful.
+ * You lose the ability to access the tail in O(1).
+ */
+
+struct hlist_head {
+	struct hlist_node *first;
+};
+
+struct hlist_node {
+	struct hlist_node *next, **pprev;
+};
+
+#define HLIST_HEAD_INIT { .first = NULL }
+#define HLIST_HEAD(name) struct hlist_head name = {  .first = NULL }
+#define INIT_HLIST_HEAD(ptr) ((ptr)->first = NULL)
+
+static inline void INIT_HLIST_NODE(struct hlist_node *h)
+{
+	h->next = NULL;
+	h->pprev = NULL;
+}
+
+/*!
+ * hlist_unhashed - tests whether a node is in a list
+ * @h: the node to test.
+ */
+static inline int hlist_unhashed(const struct hlist_node *h)
+{
+	return !h->pprev;
+}
+
+/*!
+ * hlist_empty - tests whether a list is empty
+ * @h: the list to test.
+ */
+static inline int hlist_empty(const struct hlist_head *h)
+{
+	return !h->first;
+}
+
+static inline void __hlist_del(struct hlist_node *n)
+{
+	struct hlist_node *next = n->next;
+	struct hlist_node **pprev = n->pprev;
+
+	*pprev = next;
+	if (next)
+		next->pprev = pprev;
+}
+
+/*!
+ * hlist_del - deletes entry from list.
+ * @n: the element to delete from the list.
+ * Note: hlist_unhashed on entry does not return true after this,
+ * the entry is in an undefined state.
+ */
+static inline void hlist_del(struct hlist_node *n)
+{
+	__hlist_del(n);
+	n->next = LIST_POISON1;
+	n->pprev = LIST_POISON2;
+}
+
+/*!
+ * hlist_del_init - deletes entry from list and reinitialize it.
+ * @n: the element to delete from the list.
+ */
+static inline void hlist_del_init(struct hlist_node *n)
+{
+	if (!hlist_unhashed(n)) {
+		__hlist_del(n);
+		INIT_HLIST_NODE(n);
+	}
+}
+
+/*!
+ * hlist_add_head - add a new entry at the beginning of the hlist
+ * @n: new entry to be added
+ * @h: hlist head to add it after
+ */
+static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
+{
+	struct hlist_node *first = h->first;
+
+	n->next = first;
+	if (first)
+		first->pprev = &n->next;
+	h->first = n;
+	n->pprev = &h->first;
+}
+
+/*!
+ * hlist_add_before - add a new entry before the one specified
+ * @n: new entry to be added
+ * @next: hlist node to add it before, which must be non-NULL
+ */
+static inline void
+hlist_add_before(struct hlist_node *n, struct hlist_node *next)
+{
+	n->pprev = next->pprev;
+	n->next = next;
+	next->pprev = &n->next;
+	*(n->pprev) = n;
+}
+
+/*!
+ * hlist_add_behind - add a new entry after the one specified
+ * @n: new entry to be added
+ * @prev: hlist node to add it after, which must be non-NULL
+ */
+static inline void
+hlist_add_behind(struct hlist_node *n, struct hlist_node *prev)
+{
+	n->next = prev->next;
+	prev->next = n;
+	n->pprev = &prev->next;
+
+	if (n->next)
+		n->next->pprev = &n->next;
+}
+
+/*!
+ * hlist_move_list - move an hlist
+ * @old: hlist_head for old list.
+ * @new: hlist_head for new list.
+ *
+ * Move a list from one list head to another. Fixup the pprev
+ * reference of the first entry if it exists.
+ */
+static inline void
+hlist_move_list(struct hlist_head *old, struct hlist_head *new)
+{
+	new->first = old->first;
+	if (new->first)
+		new->first->pprev = &new->first;
+	old->first = NULL;
+}
+
+#define hlist_entry(ptr, type, member) container_of(ptr,type,member)
+
+#define hlist_for_each(pos, head) \
+	for (pos = (head)->first; pos ; pos = pos->next)
+
+#define hlist_for_each_safe(pos, n, head) \
+	for (pos = (head)->first; pos && ({ n = pos->next; 1; }); \
+	     pos = n)
+
+#define hlist_entry_safe(ptr, type, member) \
+	({ typeof(ptr) ____ptr = (ptr); \
+	   ____ptr ? hlist_entry(____ptr, type, member) : NULL; \
+	})
+
+/*!
+ * hlist_for_each_entry - iterate over list of given type
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ */
+#define hlist_for_each_entry(pos, head, member)				\
+	for (pos = hlist_entry_safe((head)->first, typeof(*(pos)), member);\
+	     pos;							\
+	     pos = hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
+
+/*!
+ * hlist_for_each_entry_safe - iterate over list of given type safe against removal of list entry
+ * @pos:	the type * to use as a loop cursor.
+ * @n:		another &struct hlist_node to use as temporary storage
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ */
+#define hlist_for_each_entry_safe(pos, n, head, member) 		\
+	for (pos = hlist_entry_safe((head)->first, typeof(*pos), member);\
+	     pos && ({ n = pos->member.next; 1; });			\
+	     pos = hlist_entry_safe(n, typeof(*pos), member))
+
 #endif
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_LIST_SORT_H_
+#define _FLIBC_LIST_SORT_H_
+
+#include "flibc/list.h"
+
+/*
+ * Compare function of list_sort() and list_merge().
+ *
+ *  Return > 0 if a must be after b, <= 0 otherwise (a strcmp-like
+ *  function works).
+ */
+typedef int (*list_cmp_func_t)(void *priv, const struct list_head *a,
+                               const struct list_head *b);
+
+/*
+ * list_sort
+ *
+ *  Sort a list (merge sort like the Linux kernel one).
+ *
+ * - O(n log n) comparisons, no allocation, no recursion;
+ * - stable: equal items keep their order.
+ *
+ * \param priv Private data passed to cmp
+ * \param head The list to sort
+ * \param cmp The compare function
+ */
+void list_sort(void *priv, struct list_head *head, list_cmp_func_t cmp);
+
+/*
+ * list_merge
+ *
+ *  Merge a sorted list into another sorted list.
+ *
+ * - O(n + m) comparisons;
+ * - stable: on equal items, those of head stay first;
+ * - list is empty after.
+ *
+ * \param priv Private data passed to cmp
+ * \param head The sorted list where items are merged
+ * \param list The sorted list to merge into head
+ * \param cmp The compare function
+ */
+void list_merge(void *priv, struct list_head *head, struct list_head *list,
+                list_cmp_func_t cmp);
+
+#endif
@@ -29,8 +29,30 @@
  * - You can enable log_debug() by defining ENABLE_LOG_DEBUG macro.
  * - You can enable color logs by defining ENABLE_VT102_COLOR macro
  *   (before any flibc includes).
+ * - log_timestamp() gives a cheap, per-thread cached timestamp for
+ *   those who format their own log prefixes.
+ * - log_kv() and log_kv_to() write structured (key/value) messages in
+ *   logfmt or JSON lines. These lines are made to be parsed by programs,
+ *   so they are never colored: VT102 colors are only for the text
+ *   messages of log_info(), log_error(), ...
+ * - log module counts messages, bytes, drops and write latency
+ *   (see log_stats_snapshot()). Text messages (log_write(), log_info(), ...)
+ *   are only counted if you define ENABLE_LOG_STATS macro (before any
+ *   flibc includes), because they then go through log_stats_write()
+ *   instead of calling syslog() directly.
+ * - log_record() writes in a flight recorder (see log_ring_open()), a
+ *   memory-mapped ring which survives a crash of the program. If you define
+ *   ENABLE_LOG_RING macro, log_debug() is always enabled and goes to the
+ *   flight recorder instead of syslog.
+ * - log module has its own syslog client (see log_syslog_open()) which
+ *   doesn't take the global lock of syslog() for each message. If you define
+ *   ENABLE_LOG_SYSLOG macro, log_open(), log_write() and log_close() use it
+ *   (with the log_syslog_default client) instead of the syslog() functions.
  */
 
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <syslog.h>
 
 #include <flibc/vt102.h>
@@ -47,7 +69,11 @@
 #define log_error(fmt, ...)                                         \
         log_write(LOG_ERR, VT102_COLOR_RED(fmt), ##__VA_ARGS__)
 
-#if defined(ENABLE_LOG_DEBUG)
+#if defined(ENABLE_LOG_RING)
+#define log_debug(fmt, ...)                                         \
+        log_record(LOG_DEBUG, "in %s:%04d - " fmt,                  \
+                   __FUNCTION__, __LINE__, ##__VA_ARGS__)
+#elif defined(ENABLE_LOG_DEBUG)
 #define log_debug(fmt, ...)                                         \
         log_write(LOG_DEBUG, "in %s:%04d - " fmt,                   \
                   __FUNCTION__, __LINE__, ##__VA_ARGS__)
@@ -62,8 +88,14 @@
  *
  * (view syslog man page for more documentation)
  */
+#if defined(ENABLE_LOG_SYSLOG)
+#define log_open(ident, opt, facility)                                  \
+        log_syslog_open(&log_syslog_default, NULL, ident, opt, facility, \
+                        LOG_SYSLOG_RFC3164)
+#else
 #define log_open(ident, opt, facility) \
         openlog(ident, opt, facility)
+#endif
 
 /*
  * log_close - wrapper macro to closelog
@@ -72,8 +104,13 @@
  *
  * (view syslog man page for more documentation)
  */
+#if defined(ENABLE_LOG_SYSLOG)
+#define log_close() \
+        log_syslog_close(&log_syslog_default)
+#else
 #define log_close() \
         closelog()
+#endif
 
 /*
  * log_write - wrapper macro to syslog
@@ -82,7 +119,480 @@
  *
  * (view syslog man page for more documentation)
  */
+#if defined(ENABLE_LOG_SYSLOG)
+#define log_write(priority, fmt, ...) \
+        log_syslog_write(&log_syslog_default, priority, fmt, ##__VA_ARGS__)
+#elif defined(ENABLE_LOG_STATS)
+#define log_write(priority, fmt, ...) \
+        log_stats_write(priority, fmt, ##__VA_ARGS__)
+#else
 #define log_write(priority, fmt, ...) \
         syslog(priority, fmt, ##__VA_ARGS__)
+#endif
+
+/*
+ * Length of a timestamp string returned by log_timestamp()
+ * ("YYYY-MM-DDTHH:MM:SS.mmm", without the \0 caracter)
+ */
+#define LOG_TIMESTAMP_LEN 23
+
+/*
+ * log_timestamp
+ *
+ *  Give the current local time as "YYYY-MM-DDTHH:MM:SS.mmm".
+ *
+ * - the clock is read with CLOCK_REALTIME_COARSE (vDSO, no syscall) so
+ *   the precision is the one of the kernel tick (a few milliseconds);
+ * - the "YYYY-MM-DDTHH:MM:SS" part is rendered with localtime_r() once
+ *   per second, only the milliseconds digits are patched between;
+ * - the buffer is per-thread: no lock, but it is overwritten by the next
+ *   call from the same thread (copy it if you want to keep it).
+ *
+ * \return pointer to a per-thread string of LOG_TIMESTAMP_LEN caracters
+ */
+const char *log_timestamp(void);
+
+/*
+ * Type of the value of a structured log field
+ */
+enum log_kv_type {
+        LOG_KV_STR,
+        LOG_KV_INT,
+        LOG_KV_UINT,
+        LOG_KV_DOUBLE,
+        LOG_KV_BOOL,
+};
+
+/*
+ * A structured log field. Use KV_* macros to build them.
+ */
+struct log_kv {
+        const char *key;
+        enum log_kv_type type;
+        union {
+                const char *s;
+                long long i;
+                unsigned long long u;
+                double d;
+        } v;
+};
+
+#define KV_STR(k, val)                                                  \
+        ((struct log_kv){ .key = (k), .type = LOG_KV_STR, .v.s = (val) })
+#define KV_INT(k, val)                                                  \
+        ((struct log_kv){ .key = (k), .type = LOG_KV_INT,               \
+                          .v.i = (long long)(val) })
+#define KV_UINT(k, val)                                                 \
+        ((struct log_kv){ .key = (k), .type = LOG_KV_UINT,              \
+                          .v.u = (unsigned long long)(val) })
+#define KV_DOUBLE(k, val)                                               \
+        ((struct log_kv){ .key = (k), .type = LOG_KV_DOUBLE,            \
+                          .v.d = (double)(val) })
+#define KV_BOOL(k, val)                                                 \
+        ((struct log_kv){ .key = (k), .type = LOG_KV_BOOL,              \
+                          .v.i = !!(val) })
+
+/*
+ * Encoding of structured log lines
+ *
+ * - LOG_KV_LOGFMT: ts=... level=info msg="hello world" user=bob lat_us=12
+ * - LOG_KV_JSON: {"ts":"...","level":"info","msg":"hello world",...}
+ */
+enum log_kv_format {
+        LOG_KV_LOGFMT,
+        LOG_KV_JSON,
+};
+
+/*
+ * Max size of the pre-rendered static fields of a logger
+ * and max size of a structured log line
+ */
+#define LOG_KV_FIELDS_SIZE 256
+#define LOG_KV_LINE_SIZE 1024
+
+/*
+ * A structured logger. Don't touch the members, use log_kv_logger_init().
+ */
+struct log_kv_logger {
+        int fd;
+        enum log_kv_format format;
+        size_t fields_len;
+        char fields[LOG_KV_FIELDS_SIZE];
+};
+
+/*
+ * Default structured logger used by log_kv(): logfmt to syslog,
+ * without static fields.
+ */
+extern struct log_kv_logger log_kv_default;
+
+/*
+ * log_kv_logger_init
+ *
+ *  Setup a structured logger.
+ *
+ * - static fields (application name, host, version...) are rendered once
+ *   here and copied as is in each line;
+ * - if fd is -1, lines are sent to syslog (without "ts" field because
+ *   syslog already adds its own timestamp), otherwise one write() per line
+ *   is done on fd.
+ *
+ * \param logger The logger to setup
+ * \param fd File descriptor where lines are written or -1 for syslog
+ * \param format Encoding of the lines
+ * \param fields Static fields (can be NULL if count is 0)
+ * \param count Number of static fields
+ * \return 0 if success, -1 if static fields doesn't fit in the logger
+ */
+int log_kv_logger_init(struct log_kv_logger *logger, int fd,
+                       enum log_kv_format format,
+                       const struct log_kv *fields, size_t count);
+
+/*
+ * log_kv_write
+ *
+ *  Write a structured log line. Use log_kv() or log_kv_to() macros
+ *  instead of calling this function directly.
+ *
+ * - the message is always quoted, even in logfmt;
+ * - a line too long for LOG_KV_LINE_SIZE is cut (in the message or between
+ *   two fields) and a "truncated" field is added, so a JSON line stays valid.
+ *
+ * \param logger The logger
+ * \param priority syslog priority (LOG_INFO, LOG_ERR, ...)
+ * \param msg The message
+ * \param fields Fields of this line
+ * \param count Number of fields
+ * \return 0 if success, -1 if write failed
+ */
+int log_kv_write(struct log_kv_logger *logger, int priority, const char *msg,
+                 const struct log_kv *fields, size_t count);
+
+#define __LOG_KV_ARRAY(...)                                             \
+        ((const struct log_kv[]){ __VA_ARGS__ }),                       \
+        (sizeof((const struct log_kv[]){ __VA_ARGS__ })                 \
+         / sizeof(struct log_kv))
+
+/*
+ * log_kv_logger_setup - helper macro to log_kv_logger_init
+ *
+ *  log_kv_logger_setup(&logger, fd, LOG_KV_JSON,
+ *                      KV_STR("app", "foo"), KV_INT("pid", getpid()));
+ */
+#define log_kv_logger_setup(logger, fd, format, ...)                    \
+        log_kv_logger_init(logger, fd, format, __LOG_KV_ARRAY(__VA_ARGS__))
+
+/*
+ * log_kv - write a structured log line with the default logger
+ *
+ *  log_kv(LOG_INFO, "request done",
+ *         KV_STR("user", user), KV_INT("lat_us", latency));
+ */
+#define log_kv(priority, msg, ...)                                      \
+        log_kv_write(&log_kv_default, priority, msg,                    \
+                     __LOG_KV_ARRAY(__VA_ARGS__))
+
+/*
+ * log_kv_to - write a structured log line with a given logger
+ */
+#define log_kv_to(logger, priority, msg, ...)                           \
+        log_kv_write(logger, priority, msg, __LOG_KV_ARRAY(__VA_ARGS__))
+
+/*
+ * Number of syslog levels (LOG_EMERG to LOG_DEBUG) and number of
+ * buckets of the write latency histogram. Bucket i counts writes
+ * which took [2^i, 2^(i+1)[ nanoseconds (bucket 0 also counts 0 ns,
+ * last bucket also counts longer writes).
+ */
+#define LOG_STATS_LEVELS 8
+#define LOG_STATS_LATENCY_BUCKETS 40
+
+/*
+ * Counters of log module
+ */
+struct log_stats {
+        unsigned long long messages[LOG_STATS_LEVELS];
+        unsigned long long bytes[LOG_STATS_LEVELS];
+        unsigned long long drops;
+        unsigned long long latency[LOG_STATS_LATENCY_BUCKETS];
+};
+
+/*
+ * log_stats_record
+ *
+ *  Count a message written by a sink (log_kv_write(), log_stats_write()
+ *  and other log sinks already call it).
+ *
+ * - counters are per-thread and only touched with relaxed atomic
+ *   loads/stores by their thread: no lock and no shared cache line
+ *   on this path.
+ *
+ * \param priority syslog priority of the message
+ * \param bytes Size of the message written
+ * \param latency_ns Time spent in the sink to write the message
+ */
+void log_stats_record(int priority, size_t bytes,
+                      unsigned long long latency_ns);
+
+/*
+ * log_stats_drop
+ *
+ *  Count a message lost by a sink (write error, queue full...).
+ */
+void log_stats_drop(void);
+
+/*
+ * log_stats_snapshot
+ *
+ *  Sum the counters of all threads (even finished ones).
+ *
+ * \param stats Where counters are copied
+ */
+void log_stats_snapshot(struct log_stats *stats);
+
+/*
+ * log_stats_reset
+ *
+ *  Reset counters to zero (for next snapshots).
+ */
+void log_stats_reset(void);
+
+/*
+ * log_stats_latency_percentile
+ *
+ *  Give an approximation of a write latency percentile
+ *  (the upper bound of the histogram bucket where it is).
+ *
+ * \param stats Counters from log_stats_snapshot()
+ * \param percentile Between 0 and 100
+ * \return latency in nanoseconds, 0 if there isn't any write
+ */
+unsigned long long log_stats_latency_percentile(const struct log_stats *stats,
+                                                double percentile);
+
+/*
+ * log_stats_report_every
+ *
+ *  Write a "log stats" structured line (with log_kv()) every given
+ *  number of seconds. The line is written by the first message logged
+ *  after the period is elapsed, so nothing is written by an idle program.
+ *
+ * \param seconds The period, 0 to disable the report (default)
+ */
+void log_stats_report_every(unsigned int seconds);
+
+/*
+ * log_stats_write
+ *
+ *  Write message to the system logger and count it.
+ *  log_write() maps to it when ENABLE_LOG_STATS macro is defined.
+ */
+void log_stats_write(int priority, const char *fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+
+/*
+ * Size of a record in flight recorder (a longer message is truncated
+ * to LOG_RING_SLOT_SIZE - 24 caracters)
+ */
+#define LOG_RING_SLOT_SIZE 256
+
+/*
+ * A flight recorder. Don't touch the members.
+ */
+struct log_ring {
+        void *map;
+        size_t map_size;
+        uint64_t mask;
+};
+
+/*
+ * Default flight recorder used by log_record()
+ */
+extern struct log_ring *log_ring_default;
+
+/*
+ * log_ring_open
+ *
+ *  Open (or create) a flight recorder: a file mapped in memory and used as
+ *  a circular buffer of fixed size records.
+ *
+ * - writing a message costs an atomic increment and a memcpy, no syscall;
+ * - records are in the page cache, so they survive a crash of the program
+ *   (not a crash of the machine);
+ * - only a new or empty file is created and sized;
+ * - if the file is already a flight recorder of the same size, records
+ *   are kept and new ones are written after them, any other file is
+ *   left untouched and EINVAL is returned;
+ * - the number of records is rounded down to a power of 2.
+ *
+ * \param ring The flight recorder
+ * \param path File name
+ * \param size Size of the file (at least 4096)
+ * \return 0 if success, -1 otherwise (errno is set)
+ */
+int log_ring_open(struct log_ring *ring, const char *path, size_t size);
+
+/*
+ * log_ring_close
+ *
+ *  Unmap the flight recorder (records stay in the file).
+ */
+void log_ring_close(struct log_ring *ring);
+
+/*
+ * log_ring_write
+ *
+ *  Write a message in the flight recorder.
+ *
+ * \param ring The flight recorder
+ * \param priority syslog priority of the message
+ * \param msg The message (doesn't need to be null terminated)
+ * \param len Length of the message
+ */
+void log_ring_write(struct log_ring *ring, int priority,
+                    const char *msg, size_t len);
+
+/*
+ * log_ring_printf
+ *
+ *  Write a formatted message in the flight recorder (the message is
+ *  formatted directly in its record).
+ */
+void log_ring_printf(struct log_ring *ring, int priority,
+                     const char *fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+
+/*
+ * log_ring_dump
+ *
+ *  Write records of a flight recorder file in order, one per line
+ *  ("YYYY-MM-DDTHH:MM:SS.mmm level message"). The program which
+ *  writes in it can be still running or dead.
+ *
+ * \param path File name of the flight recorder
+ * \param fd File descriptor where lines are written
+ * \return number of records written or -1 if error
+ */
+int log_ring_dump(const char *path, int fd);
+
+/*
+ * Framing of the syslog client messages
+ *
+ * - LOG_SYSLOG_RFC3164: <PRI>Mmm dd hh:mm:ss ident[pid]: message
+ *   (same as syslog() of the libc);
+ * - LOG_SYSLOG_RFC5424: <PRI>1 YYYY-MM-DDTHH:MM:SS.mmm+hh:mm host ident
+ *   pid - - message
+ */
+enum log_syslog_format {
+        LOG_SYSLOG_RFC3164,
+        LOG_SYSLOG_RFC5424,
+};
+
+/*
+ * Default socket of the system logger, max size of a message,
+ * max number of messages queued by a thread before sending them,
+ * max time (in milliseconds) to wait for the system logger
+ * and max time (in milliseconds) a message stays queued
+ */
+#define LOG_SYSLOG_PATH "/dev/log"
+#define LOG_SYSLOG_MSG_SIZE 1024
+#define LOG_SYSLOG_BATCH 32
+#define LOG_SYSLOG_TIMEOUT 100
+#define LOG_SYSLOG_MAX_AGE 1000
+
+/*
+ * A syslog client. Don't touch the members.
+ */
+struct log_syslog {
+        char path[108];
+        char ident[64];
+        char hostname[64];
+        int option;
+        int facility;
+        enum log_syslog_format format;
+        int fd;
+        pthread_mutex_t lock;
+};
+
+/*
+ * Syslog client used by log_open(), log_write() and log_close()
+ * when ENABLE_LOG_SYSLOG macro is defined
+ */
+extern struct log_syslog log_syslog_default;
+
+/*
+ * log_syslog_open
+ *
+ *  Setup a syslog client. The connection to the socket is done
+ *  (and done again if needed) when messages are sent.
+ *
+ * \param client The client
+ * \param path Socket of the system logger, NULL for LOG_SYSLOG_PATH
+ * \param ident String prepended to messages (NULL for program name)
+ * \param option LOG_PID or 0
+ * \param facility Default facility (LOG_USER, LOG_DAEMON...)
+ * \param format Framing of the messages
+ * \return 0 if success, -1 if path is too long
+ */
+int log_syslog_open(struct log_syslog *client, const char *path,
+                    const char *ident, int option, int facility,
+                    enum log_syslog_format format);
+
+/*
+ * log_syslog_close
+ *
+ *  Send messages queued with this client (by any thread) and close the
+ *  connection.
+ *
+ * - other threads must not write with this client anymore.
+ */
+void log_syslog_close(struct log_syslog *client);
+
+/*
+ * log_syslog_write
+ *
+ *  Queue a message. Messages are formatted in a per-thread queue and sent
+ *  by batch (one sendmmsg() for LOG_SYSLOG_BATCH messages), so only one
+ *  lock is taken per batch.
+ *
+ * - the queue is sent when it is full, when a message of priority LOG_ERR
+ *   or more urgent is written, when log_syslog_flush() is called, when
+ *   the thread ends and at exit();
+ * - a queue is also sent by a background thread (started at the first
+ *   message) when its oldest message is LOG_SYSLOG_MAX_AGE milliseconds
+ *   old, so a lone message isn't kept forever;
+ * - messages are dropped (and counted by log_stats_drop()) if the system
+ *   logger doesn't read them fast enough: sending a batch never blocks the
+ *   caller more than LOG_SYSLOG_TIMEOUT milliseconds.
+ *
+ * \param client The client
+ * \param priority syslog priority (facility of client is used if not set)
+ * \param fmt Formated string
+ * \param ... The arguments
+ */
+void log_syslog_write(struct log_syslog *client, int priority,
+                      const char *fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+
+/*
+ * log_syslog_flush
+ *
+ *  Send messages queued by the calling thread.
+ *
+ * \return number of messages sent, -1 if some messages were dropped
+ */
+int log_syslog_flush(void);
+
+/*
+ * log_record - write in the default flight recorder (if any)
+ */
+#define log_record(priority, fmt, ...) do                               \
+        {                                                               \
+                if(log_ring_default != NULL)                            \
+                {                                                       \
+                        log_ring_printf(log_ring_default, priority,     \
+                                        fmt, ##__VA_ARGS__);            \
+                }                                                       \
+        } while(0)
 
 #endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_POOL_H_
+#define _FLIBC_POOL_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "flibc/list.h"
+
+/*
+ * pool.h - fixed-size object allocator (slab)
+ *
+ *  Objects of one size are carved from page-sized slabs. Each thread
+ *  keeps a small cache of free objects per pool, so pool_alloc() and
+ *  pool_free() are a few instructions without lock nor malloc in the
+ *  common case. The pool lock is taken only to move a batch of objects
+ *  between a thread cache and the pool, or to allocate a new slab.
+ *
+ * - memory of slabs is given back to the system only by pool_cleanup();
+ * - an object can be freed by another thread than the one which
+ *   allocated it;
+ * - at most POOL_MAX pools have thread caches at the same time, other
+ *   pools always take the lock;
+ * - in debug builds (-DDEBUG), free objects are filled with
+ *   POOL_POISON and checked on allocation: a write after free aborts.
+ *
+ * Example:
+ * --------
+ *
+ * struct pool pool;
+ *
+ * pool_init(&pool, sizeof(struct request), 0);
+ * req = pool_alloc(&pool);
+ * pool_free(&pool, req);
+ * pool_cleanup(&pool);
+ */
+
+/* number of pools with thread caches */
+#define POOL_MAX 64
+/* objects moved at once between a thread cache and its pool */
+#define POOL_CACHE_BATCH 32
+/* poison byte of free objects in debug builds */
+#define POOL_POISON 0x6b
+
+struct pool {
+        size_t size;
+        size_t align;
+        size_t slab_size;
+        /* index of thread caches, POOL_MAX if none */
+        unsigned int id;
+        unsigned long generation;
+
+        pthread_mutex_t lock;
+        /* free objects not in a thread cache */
+        void *free;
+        size_t free_count;
+        struct list_head slabs;
+        size_t slabs_count;
+};
+
+/*
+ * pool_init
+ *
+ *  Init a pool of objects.
+ *
+ * \param pool The pool
+ * \param size Size of objects
+ * \param align Alignment of objects (power of 2, 0 for the one of malloc)
+ * \return 0 if success, -1 otherwise
+ */
+int pool_init(struct pool *pool, size_t size, size_t align);
+
+/*
+ * pool_cleanup
+ *
+ *  Free all slabs of a pool: all objects allocated from the pool are
+ *  freed.
+ */
+void pool_cleanup(struct pool *pool);
+
+/*
+ * pool_alloc
+ *
+ *  Allocate an object (not zeroed).
+ *
+ * \param pool The pool
+ * \return the object or NULL if no memory
+ */
+void *pool_alloc(struct pool *pool);
+
+/*
+ * pool_zalloc
+ *
+ *  Allocate an object filled with zeros.
+ */
+void *pool_zalloc(struct pool *pool);
+
+/*
+ * pool_free
+ *
+ *  Give an object back to its pool (NULL is ignored).
+ */
+void pool_free(struct pool *pool, void *obj);
+
+#endif
@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_QUEUE_H_
+#define _FLIBC_QUEUE_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "flibc/list.h"
+
+/*
+ * queue.h - lock-free queues to pass items between threads
+ *
+ *  - struct mpsc_queue: unbounded intrusive queue, many producers and
+ *    ONE consumer (Dmitry Vyukov's algorithm). Like list_head, a struct
+ *    mpsc_node is embedded in your structure and mpsc_entry() gives the
+ *    structure back. Push is wait-free (one atomic exchange), pop never
+ *    blocks.
+ *  - struct spsc_ring: bounded ring of pointers, ONE producer and ONE
+ *    consumer. No atomic read-modify-write at all: each side only
+ *    stores its own index.
+ *
+ * Memory ordering:
+ * ----------------
+ *
+ *  Everything written to an item before it is pushed is visible to the
+ *  consumer after it popped it: the producer publishes the item with a
+ *  release store (or exchange) and the consumer reads it with an acquire
+ *  load. No other guarantee is given (there is no total order between
+ *  producers).
+ *
+ * Example:
+ * --------
+ *
+ * struct job {
+ *      int id;
+ *      struct mpsc_node node;
+ * };
+ *
+ * struct mpsc_queue queue;
+ * struct mpsc_node *node;
+ *
+ * mpsc_queue_init(&queue);
+ *
+ * // producers
+ * mpsc_push(&queue, &job->node);
+ *
+ * // consumer
+ * while((node = mpsc_pop(&queue)) != NULL)
+ * {
+ *      job = mpsc_entry(node, struct job, node);
+ * }
+ */
+
+/* avoid false sharing between producer and consumer data */
+#define QUEUE_CACHELINE_SIZE 64
+
+struct mpsc_node {
+        struct mpsc_node *_Atomic next;
+};
+
+struct mpsc_queue {
+        /* last pushed node, written by producers */
+        struct mpsc_node *_Atomic head
+                __attribute__((aligned(QUEUE_CACHELINE_SIZE)));
+        /* next node to pop, only used by the consumer */
+        struct mpsc_node *tail
+                __attribute__((aligned(QUEUE_CACHELINE_SIZE)));
+        struct mpsc_node stub;
+};
+
+#define mpsc_entry(ptr, type, member) container_of(ptr, type, member)
+
+/*
+ * mpsc_queue_init
+ *
+ *  Init an empty queue.
+ */
+static inline void mpsc_queue_init(struct mpsc_queue *queue)
+{
+        atomic_init(&queue->stub.next, NULL);
+        atomic_init(&queue->head, &queue->stub);
+        queue->tail = &queue->stub;
+}
+
+/*
+ * mpsc_push
+ *
+ *  Push a node at the end of the queue (any thread).
+ *
+ * - the exchange is the linearization point: it orders producers
+ *   between them. Until the release store of prev->next, the node is
+ *   pushed but not yet reachable by the consumer.
+ *
+ * \param queue The queue
+ * \param node The node to push
+ */
+static inline void mpsc_push(struct mpsc_queue *queue, struct mpsc_node *node)
+{
+        struct mpsc_node *prev;
+
+        atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+        prev = atomic_exchange_explicit(&queue->head, node,
+                                        memory_order_acq_rel);
+        atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+/*
+ * mpsc_pop
+ *
+ *  Pop the first node of the queue (consumer thread only).
+ *
+ * - NULL is returned if the queue is empty, but also if a producer is
+ *   between the exchange and the store of mpsc_push(): then the queue
+ *   isn't empty but the next node isn't linked yet. Just try again
+ *   later (this window is a few instructions long).
+ *
+ * \param queue The queue
+ * \return the node or NULL
+ */
+static inline struct mpsc_node *mpsc_pop(struct mpsc_queue *queue)
+{
+        struct mpsc_node *tail = queue->tail,
+                *next = atomic_load_explicit(&tail->next,
+                                             memory_order_acquire),
+                *head;
+
+        /* skip the stub */
+        if(tail == &queue->stub)
+        {
+                if(next == NULL)
+                {
+                        return NULL;
+                }
+
+                queue->tail = next;
+                tail = next;
+                next = atomic_load_explicit(&tail->next, memory_order_acquire);
+        }
+
+        if(next != NULL)
+        {
+                queue->tail = next;
+                return tail;
+        }
+
+        /* tail is the last node: a producer is pushing after it */
+        head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        if(tail != head)
+        {
+                return NULL;
+        }
+
+        /* push back the stub so tail can be popped */
+        mpsc_push(queue, &queue->stub);
+
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+        if(next != NULL)
+        {
+                queue->tail = next;
+                return tail;
+        }
+
+        return NULL;
+}
+
+/*
+ * mpsc_pop_batch
+ *
+ *  Pop up to count nodes (consumer thread only).
+ *
+ * \param queue The queue
+ * \param nodes Array where popped nodes are stored (in queue order)
+ * \param count Size of nodes array
+ * \return number of nodes popped
+ */
+static inline size_t mpsc_pop_batch(struct mpsc_queue *queue,
+                                    struct mpsc_node **nodes, size_t count)
+{
+        size_t n = 0;
+
+        while(n < count && (nodes[n] = mpsc_pop(queue)) != NULL)
+        {
+                ++n;
+        }
+
+        return n;
+}
+
+/*
+ * mpsc_empty
+ *
+ *  Tell if the queue is empty (consumer thread only).
+ *
+ * \return 1 if empty, 0 otherwise
+ */
+static inline int mpsc_empty(struct mpsc_queue *queue)
+{
+        return queue->tail == &queue->stub
+                && atomic_load_explicit(&queue->stub.next,
+                                        memory_order_acquire) == NULL
+                && atomic_load_explicit(&queue->head,
+                                        memory_order_acquire) == &queue->stub;
+}
+
+struct spsc_ring {
+        /* producer side */
+        _Atomic size_t head __attribute__((aligned(QUEUE_CACHELINE_SIZE)));
+        size_t tail_cache;
+        /* consumer side */
+        _Atomic size_t tail __attribute__((aligned(QUEUE_CACHELINE_SIZE)));
+        size_t head_cache;
+        /* read only */
+        void **slots __attribute__((aligned(QUEUE_CACHELINE_SIZE)));
+        size_t mask;
+};
+
+/*
+ * spsc_ring_init
+ *
+ *  Allocate a ring.
+ *
+ * \param ring The ring
+ * \param size Number of slots (rounded up to a power of 2)
+ * \return 0 if success, -1 otherwise
+ */
+int spsc_ring_init(struct spsc_ring *ring, size_t size);
+
+/*
+ * spsc_ring_cleanup
+ *
+ *  Free a ring (items left in the ring aren't freed).
+ */
+void spsc_ring_cleanup(struct spsc_ring *ring);
+
+/*
+ * spsc_ring_push
+ *
+ *  Push an item (producer thread only).
+ *
+ * - the slot is written before the release store of head, so the
+ *   consumer (acquire load of head) sees the item;
+ * - the acquire load of tail orders our write of a slot after the
+ *   consumer's read of it;
+ * - item mustn't be NULL (see spsc_ring_pop()).
+ *
+ * \param ring The ring
+ * \param item The item
+ * \return 0 if pushed, -1 if the ring is full
+ */
+static inline int spsc_ring_push(struct spsc_ring *ring, void *item)
+{
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+        if(head - ring->tail_cache > ring->mask)
+        {
+                ring->tail_cache = atomic_load_explicit(&ring->tail,
+                                                        memory_order_acquire);
+                if(head - ring->tail_cache > ring->mask)
+                {
+                        return -1;
+                }
+        }
+
+        ring->slots[head & ring->mask] = item;
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+        return 0;
+}
+
+/*
+ * spsc_ring_pop_batch
+ *
+ *  Pop up to count items (consumer thread only).
+ *
+ * \param ring The ring
+ * \param items Array where popped items are stored
+ * \param count Size of items array
+ * \return number of items popped
+ */
+static inline size_t spsc_ring_pop_batch(struct spsc_ring *ring,
+                                         void **items, size_t count)
+{
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed),
+                n = 0;
+
+        if(ring->head_cache - tail < count)
+        {
+                ring->head_cache = atomic_load_explicit(&ring->head,
+                                                        memory_order_acquire);
+        }
+
+        while(n < count && tail + n != ring->head_cache)
+        {
+                items[n] = ring->slots[(tail + n) & ring->mask];
+                ++n;
+        }
+
+        if(n > 0)
+        {
+                /* release: slots are read before the producer reuses them */
+                atomic_store_explicit(&ring->tail, tail + n,
+                                      memory_order_release);
+        }
+
+        return n;
+}
+
+/*
+ * spsc_ring_pop
+ *
+ *  Pop an item (consumer thread only).
+ *
+ * \param ring The ring
+ * \return the item or NULL if the ring is empty
+ */
+static inline void *spsc_ring_pop(struct spsc_ring *ring)
+{
+        void *item = NULL;
+
+        return spsc_ring_pop_batch(ring, &item, 1) == 1 ? item : NULL;
+}
+
+#endif
@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_RBTREE_H_
+#define _FLIBC_RBTREE_H_
+
+#include <stddef.h>
+
+#include "flibc/list.h"
+
+/*
+ * rbtree.h - intrusive red-black tree (same API as the Linux kernel one)
+ *
+ * - like list_head, a struct rb_node is embedded in your structure and
+ *   rb_entry() gives the structure back;
+ * - insert, erase, lower/upper bound are O(log n);
+ * - rb_root_cached also keeps the leftmost node, so rb_first_cached() is
+ *   O(1) (useful for timers: the first one to expire).
+ *
+ * Example:
+ * --------
+ *
+ * struct timer {
+ *      unsigned long expire;
+ *      struct rb_node node;
+ * };
+ *
+ * static int timer_less(const struct rb_node *a, const struct rb_node *b)
+ * {
+ *      return rb_entry(a, const struct timer, node)->expire
+ *              < rb_entry(b, const struct timer, node)->expire;
+ * }
+ *
+ * struct rb_root_cached timers = RB_ROOT_CACHED;
+ *
+ * rb_add_cached(&timer->node, &timers, timer_less);
+ * first = rb_entry(rb_first_cached(&timers), struct timer, node);
+ */
+
+struct rb_node {
+        unsigned long __rb_parent_color;
+        struct rb_node *rb_right;
+        struct rb_node *rb_left;
+} __attribute__((aligned(sizeof(long))));
+
+struct rb_root {
+        struct rb_node *rb_node;
+};
+
+struct rb_root_cached {
+        struct rb_root rb_root;
+        struct rb_node *rb_leftmost;
+};
+
+#define RB_ROOT (struct rb_root) { NULL, }
+#define RB_ROOT_CACHED (struct rb_root_cached) { { NULL, }, NULL }
+
+#define rb_parent(r) ((struct rb_node *)((r)->__rb_parent_color & ~3UL))
+
+#define rb_entry(ptr, type, member) container_of(ptr, type, member)
+
+#define rb_entry_safe(ptr, type, member)                                \
+        ({ typeof(ptr) ____ptr = (ptr);                                 \
+           ____ptr ? rb_entry(____ptr, type, member) : NULL;            \
+        })
+
+#define RB_EMPTY_ROOT(root) ((root)->rb_node == NULL)
+
+/* 'empty' nodes are nodes that are known not to be inserted in an rbtree */
+#define RB_EMPTY_NODE(node)                                             \
+        ((node)->__rb_parent_color == (unsigned long)(node))
+#define RB_CLEAR_NODE(node)                                             \
+        ((node)->__rb_parent_color = (unsigned long)(node))
+
+/*
+ * rb_link_node - link a new node at the place found by a search
+ * @node: the new node.
+ * @parent: the parent of the new node (NULL if tree is empty).
+ * @rb_link: the pointer of parent (or root) where node must be linked.
+ *
+ * You must call rb_insert_color() after to rebalance the tree.
+ */
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent,
+                                struct rb_node **rb_link)
+{
+        node->__rb_parent_color = (unsigned long)parent;
+        node->rb_left = node->rb_right = NULL;
+
+        *rb_link = node;
+}
+
+/*
+ * rb_insert_color
+ *
+ *  Rebalance the tree after rb_link_node().
+ */
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+
+/*
+ * rb_erase
+ *
+ *  Remove a node from the tree.
+ */
+void rb_erase(struct rb_node *node, struct rb_root *root);
+
+/*
+ * rb_replace_node
+ *
+ *  Replace a node by a new one at the same place (both must have
+ *  the same key, the tree isn't rebalanced).
+ */
+void rb_replace_node(struct rb_node *victim, struct rb_node *new,
+                     struct rb_root *root);
+
+/*
+ * In order iteration: first (smallest), last (biggest), next and
+ * previous nodes. They return NULL at the end.
+ */
+struct rb_node *rb_first(const struct rb_root *root);
+struct rb_node *rb_last(const struct rb_root *root);
+struct rb_node *rb_next(const struct rb_node *node);
+struct rb_node *rb_prev(const struct rb_node *node);
+
+/*
+ * Post order iteration: children before their parent, so nodes
+ * can be freed while iterating (see rbtree_postorder_for_each_entry_safe)
+ */
+struct rb_node *rb_first_postorder(const struct rb_root *root);
+struct rb_node *rb_next_postorder(const struct rb_node *node);
+
+/*
+ * Same functions for the cached tree (leftmost node is kept up to date)
+ */
+static inline void rb_insert_color_cached(struct rb_node *node,
+                                          struct rb_root_cached *root,
+                                          int leftmost)
+{
+        if(leftmost)
+        {
+                root->rb_leftmost = node;
+        }
+
+        rb_insert_color(node, &root->rb_root);
+}
+
+static inline void rb_erase_cached(struct rb_node *node,
+                                   struct rb_root_cached *root)
+{
+        if(root->rb_leftmost == node)
+        {
+                root->rb_leftmost = rb_next(node);
+        }
+
+        rb_erase(node, &root->rb_root);
+}
+
+static inline void rb_replace_node_cached(struct rb_node *victim,
+                                          struct rb_node *new,
+                                          struct rb_root_cached *root)
+{
+        if(root->rb_leftmost == victim)
+        {
+                root->rb_leftmost = new;
+        }
+
+        rb_replace_node(victim, new, &root->rb_root);
+}
+
+#define rb_first_cached(root) (root)->rb_leftmost
+
+/*
+ * rb_add
+ *
+ *  Insert a node in the tree with a less() function. Nodes which are
+ *  equal keep their insertion order.
+ *
+ * \param node The node to insert
+ * \param tree The tree
+ * \param less Return != 0 if a is before b
+ */
+static inline void rb_add(struct rb_node *node, struct rb_root *tree,
+                          int (*less)(const struct rb_node *a,
+                                      const struct rb_node *b))
+{
+        struct rb_node **link = &tree->rb_node;
+        struct rb_node *parent = NULL;
+
+        while(*link != NULL)
+        {
+                parent = *link;
+                if(less(node, parent))
+                {
+                        link = &parent->rb_left;
+                }
+                else
+                {
+                        link = &parent->rb_right;
+                }
+        }
+
+        rb_link_node(node, parent, link);
+        rb_insert_color(node, tree);
+}
+
+/*
+ * rb_add_cached
+ *
+ *  Same as rb_add() for the cached tree.
+ *
+ * \return node if it is the new leftmost node, NULL otherwise
+ */
+static inline struct rb_node *
+rb_add_cached(struct rb_node *node, struct rb_root_cached *tree,
+              int (*less)(const struct rb_node *a, const struct rb_node *b))
+{
+        struct rb_node **link = &tree->rb_root.rb_node;
+        struct rb_node *parent = NULL;
+        int leftmost = 1;
+
+        while(*link != NULL)
+        {
+                parent = *link;
+                if(less(node, parent))
+                {
+                        link = &parent->rb_left;
+                }
+                else
+                {
+                        link = &parent->rb_right;
+                        leftmost = 0;
+                }
+        }
+
+        rb_link_node(node, parent, link);
+        rb_insert_color_cached(node, tree, leftmost);
+
+        return leftmost ? node : NULL;
+}
+
+/*
+ * rb_find
+ *
+ *  Find a node equal to key.
+ *
+ * \param key The key
+ * \param tree The tree
+ * \param cmp Compare key to a node (<0, 0 or >0 like strcmp)
+ * \return a node or NULL if not found
+ */
+static inline struct rb_node *
+rb_find(const void *key, const struct rb_root *tree,
+        int (*cmp)(const void *key, const struct rb_node *node))
+{
+        struct rb_node *node = tree->rb_node;
+        int c;
+
+        while(node != NULL)
+        {
+                c = cmp(key, node);
+                if(c < 0)
+                {
+                        node = node->rb_left;
+                }
+                else if(c > 0)
+                {
+                        node = node->rb_right;
+                }
+                else
+                {
+                        return node;
+                }
+        }
+
+        return NULL;
+}
+
+/*
+ * rb_lower_bound
+ *
+ *  Find the first node which isn't before key (node >= key).
+ *
+ * \param key The key
+ * \param tree The tree
+ * \param cmp Compare key to a node (<0, 0 or >0 like strcmp)
+ * \return a node or NULL if all nodes are before key
+ */
+static inline struct rb_node *
+rb_lower_bound(const void *key, const struct rb_root *tree,
+               int (*cmp)(const void *key, const struct rb_node *node))
+{
+        struct rb_node *node = tree->rb_node,
+                *match = NULL;
+
+        while(node != NULL)
+        {
+                if(cmp(key, node) <= 0)
+                {
+                        match = node;
+                        node = node->rb_left;
+                }
+                else
+                {
+                        node = node->rb_right;
+                }
+        }
+
+        return match;
+}
+
+/*
+ * rb_upper_bound
+ *
+ *  Find the first node after key (node > key).
+ *
+ * \param key The key
+ * \param tree The tree
+ * \param cmp Compare key to a node (<0, 0 or >0 like strcmp)
+ * \return a node or NULL if no node is after key
+ */
+static inline struct rb_node *
+rb_upper_bound(const void *key, const struct rb_root *tree,
+               int (*cmp)(const void *key, const struct rb_node *node))
+{
+        struct rb_node *node = tree->rb_node,
+                *match = NULL;
+
+        while(node != NULL)
+        {
+                if(cmp(key, node) < 0)
+                {
+                        match = node;
+                        node = node->rb_left;
+                }
+                else
+                {
+                        node = node->rb_right;
+                }
+        }
+
+        return match;
+}
+
+/*
+ * rb_find_first
+ *
+ *  Find the first node equal to key (when several nodes are equal).
+ *
+ * \return a node or NULL if not found
+ */
+static inline struct rb_node *
+rb_find_first(const void *key, const struct rb_root *tree,
+              int (*cmp)(const void *key, const struct rb_node *node))
+{
+        struct rb_node *node = rb_lower_bound(key, tree, cmp);
+
+        return (node != NULL && cmp(key, node) == 0) ? node : NULL;
+}
+
+/*
+ * rb_for_each_entry - iterate over tree in order
+ * @pos:    the type * to use as a loop cursor.
+ * @root:   the struct rb_root of the tree.
+ * @member: the name of the rb_node within the struct.
+ */
+#define rb_for_each_entry(pos, root, member)                            \
+        for(pos = rb_entry_safe(rb_first(root), typeof(*pos), member);  \
+            pos != NULL;                                                \
+            pos = rb_entry_safe(rb_next(&(pos)->member),                \
+                                typeof(*pos), member))
+
+/*
+ * rb_for_each_entry_reverse - iterate over tree in reverse order
+ * @pos:    the type * to use as a loop cursor.
+ * @root:   the struct rb_root of the tree.
+ * @member: the name of the rb_node within the struct.
+ */
+#define rb_for_each_entry_reverse(pos, root, member)                    \
+        for(pos = rb_entry_safe(rb_last(root), typeof(*pos), member);   \
+            pos != NULL;                                                \
+            pos = rb_entry_safe(rb_prev(&(pos)->member),                \
+                                typeof(*pos), member))
+
+/*
+ * rbtree_postorder_for_each_entry_safe - iterate in post-order over tree
+ *                                        safe against removal of entry
+ * @pos:    the type * to use as a loop cursor.
+ * @n:      another type * to use as temporary storage.
+ * @root:   the struct rb_root of the tree.
+ * @member: the name of the rb_node within the struct.
+ *
+ * Nodes can be freed but not erased (with rb_erase()) in the loop:
+ * use it to free a whole tree.
+ */
+#define rbtree_postorder_for_each_entry_safe(pos, n, root, member)      \
+        for(pos = rb_entry_safe(rb_first_postorder(root),               \
+                                typeof(*pos), member);                  \
+            pos != NULL                                                 \
+                    && ({ n = rb_entry_safe(rb_next_postorder(&pos->member), \
+                                            typeof(*pos), member); 1; }); \
+            pos = n)
+
+#endif
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_RCU_H_
+#define _FLIBC_RCU_H_
+
+#include <stdatomic.h>
+
+#include "flibc/list.h"
+
+/*
+ * rcu.h - read-copy-update for read mostly data
+ *
+ *  Readers walk a shared list (or follow a shared pointer) without any
+ *  lock: rcu_read_lock() and rcu_read_unlock() only write a per-thread
+ *  counter (no atomic read-modify-write, no shared cache line), so
+ *  readers scale with cores. Updaters publish new data with
+ *  rcu_assign_pointer() or list_*_rcu() and free old data only when no
+ *  reader can still see it: either by waiting (synchronize_rcu()) or by
+ *  deferring the free (call_rcu()).
+ *
+ *  Reclamation is epoch based: a global epoch is incremented by each
+ *  update, readers record the epoch they started in, and an object
+ *  removed at epoch E is freed once no reader is in a critical section
+ *  started at or before E.
+ *
+ * - each thread using rcu_read_lock() must call rcu_register_thread()
+ *   first, and rcu_unregister_thread() before exit;
+ * - updaters must be serialized between them (a mutex), RCU only
+ *   protects readers from updaters;
+ * - never call synchronize_rcu() or rcu_barrier() in a read-side
+ *   critical section (deadlock).
+ *
+ * Example:
+ * --------
+ *
+ * // reader
+ * rcu_read_lock();
+ * list_for_each_entry_rcu(route, &routes, node)
+ * {
+ *      // your stuff //
+ * }
+ * rcu_read_unlock();
+ *
+ * // updater
+ * pthread_mutex_lock(&routes_lock);
+ * list_replace_rcu(&old->node, &new->node);
+ * pthread_mutex_unlock(&routes_lock);
+ * call_rcu(&old->rcu, route_free);
+ */
+
+struct rcu_reader {
+        /* epoch of the current critical section, 0 if none */
+        _Atomic unsigned long ctr;
+        unsigned int nesting;
+        struct list_head node;
+};
+
+struct rcu_head {
+        struct list_head node;
+        unsigned long epoch;
+        void (*func)(struct rcu_head *head);
+};
+
+/* call_rcu() tries to reclaim every RCU_DEFER_BATCH callbacks */
+#define RCU_DEFER_BATCH 64
+
+extern _Atomic unsigned long rcu_gp_epoch;
+extern __thread struct rcu_reader rcu_reader_self;
+extern int rcu_has_membarrier;
+
+/*
+ * rcu_register_thread
+ *
+ *  Register the calling thread as a reader.
+ */
+void rcu_register_thread(void);
+
+/*
+ * rcu_unregister_thread
+ *
+ *  Unregister the calling thread (not in a read-side critical section).
+ */
+void rcu_unregister_thread(void);
+
+/*
+ * rcu_read_lock
+ *
+ *  Enter a read-side critical section (can be nested).
+ *
+ * - the acquire load of the epoch pairs with the epoch increment of the
+ *   updater: a reader which sees the new epoch sees the update too;
+ * - the full fence orders the store of our epoch before the loads of
+ *   the critical section. It pairs with the fence of the updater before
+ *   it scans readers: either the updater sees us, or we see its update;
+ * - on Linux, the updater uses membarrier(2) to run this fence on all
+ *   reader cpus instead, so readers only need a compiler barrier.
+ */
+static inline void rcu_read_lock(void)
+{
+        if(rcu_reader_self.nesting++ == 0)
+        {
+                atomic_store_explicit(&rcu_reader_self.ctr,
+                                      atomic_load_explicit(&rcu_gp_epoch,
+                                                           memory_order_acquire),
+                                      memory_order_relaxed);
+                if(rcu_has_membarrier)
+                {
+                        atomic_signal_fence(memory_order_seq_cst);
+                }
+                else
+                {
+                        atomic_thread_fence(memory_order_seq_cst);
+                }
+        }
+}
+
+/*
+ * rcu_read_unlock
+ *
+ *  Leave a read-side critical section.
+ *
+ * - release: loads of the critical section are done before the updater
+ *   sees we left.
+ */
+static inline void rcu_read_unlock(void)
+{
+        if(--rcu_reader_self.nesting == 0)
+        {
+                atomic_store_explicit(&rcu_reader_self.ctr, 0,
+                                      memory_order_release);
+        }
+}
+
+/*
+ * synchronize_rcu
+ *
+ *  Wait until all read-side critical sections started before the call
+ *  are finished. Old data can be freed after.
+ */
+void synchronize_rcu(void);
+
+/*
+ * call_rcu
+ *
+ *  Call func(head) once all read-side critical sections started before
+ *  the call are finished (it doesn't wait).
+ *
+ * - func is called by a later call_rcu(), rcu_reclaim() or rcu_barrier()
+ *   in the thread which calls them.
+ *
+ * \param head The rcu_head embedded in the object to free
+ * \param func The function which frees the object
+ */
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head));
+
+/*
+ * rcu_reclaim
+ *
+ *  Call functions queued by call_rcu() which can be called now
+ *  (doesn't wait for readers).
+ *
+ * \return number of functions called
+ */
+unsigned int rcu_reclaim(void);
+
+/*
+ * rcu_barrier
+ *
+ *  Wait for readers and call all functions queued by call_rcu().
+ *
+ * \return number of functions called
+ */
+unsigned int rcu_barrier(void);
+
+/*
+ * rcu_assign_pointer
+ *
+ *  Publish a pointer: initialization of the pointed data is visible to
+ *  readers which load the pointer with rcu_dereference().
+ */
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/*
+ * rcu_dereference
+ *
+ *  Load a pointer published with rcu_assign_pointer() (in a read-side
+ *  critical section).
+ */
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+/*
+ * list_add_rcu - add a new entry to rcu-protected list
+ * @new: new entry to be added
+ * @head: list head to add it after
+ *
+ * The new entry is fully linked before readers can reach it.
+ */
+static inline void list_add_rcu(struct list_head *new, struct list_head *head)
+{
+        struct list_head *next = head->next;
+
+        new->next = next;
+        new->prev = head;
+        rcu_assign_pointer(head->next, new);
+        next->prev = new;
+}
+
+/*
+ * list_add_tail_rcu - add a new entry to rcu-protected list
+ * @new: new entry to be added
+ * @head: list head to add it before
+ */
+static inline void list_add_tail_rcu(struct list_head *new,
+                                     struct list_head *head)
+{
+        struct list_head *prev = head->prev;
+
+        new->next = head;
+        new->prev = prev;
+        rcu_assign_pointer(prev->next, new);
+        head->prev = new;
+}
+
+/*
+ * list_del_rcu - deletes entry from rcu-protected list
+ * @entry: the element to delete from the list.
+ *
+ * entry->next is kept: readers on the entry can continue their walk.
+ * Free it with call_rcu() or after synchronize_rcu().
+ */
+static inline void list_del_rcu(struct list_head *entry)
+{
+        entry->next->prev = entry->prev;
+        __atomic_store_n(&entry->prev->next, entry->next, __ATOMIC_RELAXED);
+        entry->prev = LIST_POISON2;
+}
+
+/*
+ * list_replace_rcu - replace old entry by new one in rcu-protected list
+ * @old: the element to be replaced
+ * @new: the new element to insert
+ */
+static inline void list_replace_rcu(struct list_head *old,
+                                    struct list_head *new)
+{
+        new->next = old->next;
+        new->prev = old->prev;
+        rcu_assign_pointer(new->prev->next, new);
+        new->next->prev = new;
+        old->prev = LIST_POISON2;
+}
+
+/*
+ * list_for_each_entry_rcu - iterate over rcu list of given type
+ * @pos:    the type * to use as a loop cursor.
+ * @head:   the head for your list.
+ * @member: the name of the list_head within the struct.
+ *
+ * Must be called in a read-side critical section.
+ */
+#define list_for_each_entry_rcu(pos, head, member)                      \
+        for(pos = list_entry(rcu_dereference((head)->next),             \
+                             typeof(*pos), member);                     \
+            &pos->member != (head);                                     \
+            pos = list_entry(rcu_dereference(pos->member.next),         \
+                             typeof(*pos), member))
+
+/*
+ * hlist_add_head_rcu - add a new entry at the beginning of a rcu hlist
+ * @n: the element to add to the hash list.
+ * @h: the list to add to.
+ */
+static inline void hlist_add_head_rcu(struct hlist_node *n,
+                                      struct hlist_head *h)
+{
+        struct hlist_node *first = h->first;
+
+        n->next = first;
+        n->pprev = &h->first;
+        rcu_assign_pointer(h->first, n);
+        if(first != NULL)
+        {
+                first->pprev = &n->next;
+        }
+}
+
+/*
+ * hlist_del_rcu - deletes entry from rcu hlist
+ * @n: the element to delete from the hash list.
+ *
+ * n->next is kept for readers on the entry.
+ */
+static inline void hlist_del_rcu(struct hlist_node *n)
+{
+        struct hlist_node *next = n->next;
+
+        __atomic_store_n(n->pprev, next, __ATOMIC_RELAXED);
+        if(next != NULL)
+        {
+                next->pprev = n->pprev;
+        }
+        n->pprev = LIST_POISON2;
+}
+
+/*
+ * hlist_for_each_entry_rcu - iterate over rcu hlist of given type
+ * @pos:    the type * to use as a loop cursor.
+ * @head:   the head for your list.
+ * @member: the name of the hlist_node within the struct.
+ */
+#define hlist_for_each_entry_rcu(pos, head, member)                     \
+        for(pos = hlist_entry_safe(rcu_dereference((head)->first),      \
+                                   typeof(*(pos)), member);             \
+            pos != NULL;                                                \
+            pos = hlist_entry_safe(rcu_dereference((pos)->member.next), \
+                                   typeof(*(pos)), member))
+
+#endif
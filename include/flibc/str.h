@@ -25,6 +25,11 @@
 #include <stdarg.h>
 
 #include "flibc/list.h"
+#include "flibc/vec.h"
+
+struct arena;
+struct pool;
+struct str_intern;
 
 /*
  * Structures used when deal with list of string.
@@ -37,8 +42,27 @@ struct str_list_item {
 struct str_list {
 	struct list_head head;
 	unsigned int count;
+        /* items allocated from this pool if not NULL (see pool.h) */
+        struct pool *pool;
+        /* or from this arena if not NULL (see arena.h) */
+        struct arena *arena;
+        /* or values interned in this table if not NULL (see str_intern.h) */
+        struct str_intern *intern;
 };
 
+/*
+ * Size of pool objects for a str_list whose strings up to max_len chars
+ * are stored in the item itself (see str_list_init_pool()).
+ */
+#define STR_LIST_POOL_SIZE(max_len)                             \
+        (sizeof(struct str_list_item) + (max_len) + 1)
+
+/*
+ * Contiguous array of strings (see vec.h): struct str_vec and
+ * str_vec_* functions.
+ */
+VEC_DEFINE(str_vec, const char *)
+
 /* 
  * str_copy (aka "safe strcpy") - wrapper function to strncpy
  *
@@ -57,6 +81,21 @@ struct str_list {
  */
 size_t str_copy(char *dst, size_t dst_size, const char *src);
 
+/*
+ * str_copy_utf8
+ *
+ *  Same as str_copy() but, on truncation, an UTF-8 sequence isn't cut:
+ *  the destination buffer holds whole characters only (see
+ *  str_utf8_truncate()).
+ *
+ * \param dst Destination buffer where source string will be copied
+ * \param dst_size Size of destination buffer
+ * \param src Source String (UTF-8)
+ * \return count of char copied (or should have been copied in case
+ *                               of truncation)
+ */
+size_t str_copy_utf8(char *dst, size_t dst_size, const char *src);
+
 /*
  * str_vprintf (aka "safe vsprintf") - wrapper function to vsnprintf
  *
@@ -194,6 +233,55 @@ int str_empty(const char *str);
 unsigned int str_split(const char *str, const char *sep,
 		       struct str_list *list);
 
+/*
+ * str_split_pool
+ *
+ *  Same as str_split() with items allocated from a pool
+ *  (see str_list_init_pool()).
+ *
+ * \param str Data string
+ * \param sep The word delimiter
+ * \param list Pointer to a list where str_split put struct str_list_item
+ *             items (initialized by str_split_pool)
+ * \param pool The pool
+ * \return count of words found and stored in list
+ */
+unsigned int str_split_pool(const char *str, const char *sep,
+                            struct str_list *list, struct pool *pool);
+
+/*
+ * str_split_arena
+ *
+ *  Same as str_split() with items allocated from an arena
+ *  (see str_list_init_arena()).
+ *
+ * \param str Data string
+ * \param sep The word delimiter
+ * \param list Pointer to a list where str_split put struct str_list_item
+ *             items (initialized by str_split_arena)
+ * \param arena The arena
+ * \return count of words found and stored in list
+ */
+unsigned int str_split_arena(const char *str, const char *sep,
+                             struct str_list *list, struct arena *arena);
+
+/*
+ * str_split_intern
+ *
+ *  Same as str_split() with strings interned
+ *  (see str_list_init_intern()).
+ *
+ * \param str Data string
+ * \param sep The word delimiter
+ * \param list Pointer to a list where str_split put struct str_list_item
+ *             items (initialized by str_split_intern)
+ * \param intern The intern table
+ * \return count of words found and stored in list
+ */
+unsigned int str_split_intern(const char *str, const char *sep,
+                              struct str_list *list,
+                              struct str_intern *intern);
+
 /*
  * str_ltrim
  *
@@ -274,6 +362,122 @@ static inline int str_endwith(const char *haystack, const char *word)
                        word_len) == 0;
 }
 
+/*
+ * Case functions
+ *
+ *  ASCII only and locale-free: only A-Z and a-z are folded, other bytes
+ *  (UTF-8 sequences included) are left as is. They use SSE2 on x86-64.
+ */
+
+/*
+ * str_tolower, str_toupper
+ *
+ *  Convert a string to lower (upper) case, in place.
+ *
+ * \param str The string
+ * \return str
+ */
+char *str_tolower(char *str);
+char *str_toupper(char *str);
+
+/*
+ * str_tolower_len, str_toupper_len
+ *
+ *  Convert len bytes to lower (upper) case (not null terminated).
+ *
+ * - dst can be src (in place).
+ *
+ * \param dst Destination buffer of len bytes at least
+ * \param src Source buffer
+ * \param len Count of bytes to convert
+ * \return void
+ */
+void str_tolower_len(char *dst, const char *src, size_t len);
+void str_toupper_len(char *dst, const char *src, size_t len);
+
+/*
+ * str_tolower_copy, str_toupper_copy
+ *
+ *  Same as str_copy() with the copy converted to lower (upper) case.
+ *
+ * \param dst Destination buffer where source string will be copied
+ * \param dst_size Size of destination buffer
+ * \param src Source String
+ * \return count of char copied (or should have been copied in case
+ *                               of truncation)
+ */
+size_t str_tolower_copy(char *dst, size_t dst_size, const char *src);
+size_t str_toupper_copy(char *dst, size_t dst_size, const char *src);
+
+/*
+ * str_casecmp
+ *
+ *  Compare two strings ignoring case, like strcasecmp() in the C locale.
+ *
+ * \param a A string
+ * \param b Another string
+ * \return < 0, 0 or > 0 like strcmp
+ */
+int str_casecmp(const char *a, const char *b);
+
+/*
+ * str_casecmp_len
+ *
+ *  Same as str_casecmp() on buffers (not null terminated): a buffer
+ *  which is the beginning of the other one is lower.
+ *
+ * Example:
+ *
+ *      // header name from a request, not null terminated
+ *      if(str_casecmp_len(name, name_len, "content-length", 14) == 0)
+ *
+ * \param a A buffer
+ * \param a_len Size of a
+ * \param b Another buffer
+ * \param b_len Size of b
+ * \return < 0, 0 or > 0 like strcmp
+ */
+int str_casecmp_len(const char *a, size_t a_len, const char *b, size_t b_len);
+
+/*
+ * str_casestartwith, str_caseendwith
+ *
+ *  Same as str_startwith() and str_endwith() ignoring case.
+ *
+ * \param haystack the base string
+ * \param word the string to seek at start (end) of haystack
+ * \return 1 if found, 0 otherwise
+ */
+int str_casestartwith(const char *haystack, const char *word);
+int str_caseendwith(const char *haystack, const char *word);
+
+/*
+ * str_casestr
+ *
+ *  Locate a string in another one ignoring case (like strcasestr()).
+ *
+ * \param haystack the base string
+ * \param needle the string to seek
+ * \return pointer to the first occurrence of needle in haystack,
+ *         haystack if needle is empty, NULL if not found
+ */
+const char *str_casestr(const char *haystack, const char *needle);
+
+/*
+ * str_casestr_len
+ *
+ *  Same as str_casestr() on buffers (not null terminated).
+ *
+ * \param haystack the base buffer
+ * \param haystack_len size of haystack
+ * \param needle the buffer to seek
+ * \param needle_len size of needle
+ * \return pointer to the first occurrence of needle in haystack,
+ *         haystack if needle_len is 0, NULL if not found
+ */
+const char *str_casestr_len(const char *haystack, size_t haystack_len,
+                            const char *needle, size_t needle_len);
+
 /*
  * str_replace
  *
@@ -356,6 +560,84 @@ long str_tol(const char *str, char **endptr, int base, long dfl);
  */
 long long str_toll(const char *str, char **endptr, int base, long long dfl);
 
+/*
+ * str_utf8_valid
+ *
+ *  Tell if a buffer is valid UTF-8: no overlong form, no surrogate, no
+ *  code point above U+10FFFF, no truncated sequence.
+ *
+ * - SSE4.1 or AVX2 versions are used if the CPU supports them (several
+ *   GB/s), str_utf8_valid_scalar() otherwise;
+ * - a null byte is a valid character (U+0000).
+ *
+ * \param str The buffer
+ * \param len Size of the buffer
+ * \return 1 if valid, 0 otherwise
+ */
+int str_utf8_valid(const char *str, size_t len);
+
+/*
+ * str_utf8_len
+ *
+ *  Count code points of an UTF-8 buffer (bytes which aren't
+ *  continuation bytes).
+ *
+ * - the result is meaningless if the buffer isn't valid UTF-8 (see
+ *   str_utf8_valid()).
+ *
+ * \param str The buffer
+ * \param len Size of the buffer
+ * \return count of code points
+ */
+size_t str_utf8_len(const char *str, size_t len);
+
+/*
+ * Portable versions of str_utf8_valid() and str_utf8_len(), always
+ * available (reference for tests and benchmarks).
+ */
+int str_utf8_valid_scalar(const char *str, size_t len);
+size_t str_utf8_len_scalar(const char *str, size_t len);
+
+/*
+ * Implementations of str_utf8_valid() and str_utf8_len()
+ */
+enum str_utf8_impl {
+        STR_UTF8_SCALAR,
+        STR_UTF8_SSE4,
+        STR_UTF8_AVX2,
+        STR_UTF8_IMPLS
+};
+
+/*
+ * For tests and benchmarks only: tell if an implementation can run on
+ * this CPU, call a given one (str_utf8_valid_scalar() or
+ * str_utf8_len_scalar() if it can't).
+ */
+int __str_utf8_impl_supported(enum str_utf8_impl impl);
+int __str_utf8_valid_impl(enum str_utf8_impl impl, const char *str,
+                          size_t len);
+size_t __str_utf8_len_impl(enum str_utf8_impl impl, const char *str,
+                           size_t len);
+
+/*
+ * str_utf8_truncate
+ *
+ *  Length to truncate an UTF-8 buffer to at most max bytes without
+ *  cutting a sequence.
+ *
+ * Example:
+ *
+ *      // "\xc3\xa9t\xc3\xa9" ("été") to 4 bytes: 3 ("ét")
+ *      len = str_utf8_truncate(s, strlen(s), 4);
+ *
+ * \param str The buffer (UTF-8)
+ * \param len Size of the buffer
+ * \param max Maximum length
+ * \return len if len <= max, otherwise a length <= max ending on a
+ *         character boundary (max if str isn't UTF-8 there)
+ */
+size_t str_utf8_truncate(const char *str, size_t len, size_t max);
+
 /*
  * str_list_init
  *
@@ -366,6 +648,61 @@ long long str_toll(const char *str, char **endptr, int base, long long dfl);
  */
 void str_list_init(struct str_list *list);
 
+/*
+ * str_list_init_pool
+ *
+ * Init a list of str whose items are allocated from a pool.
+ *
+ * - the pool must be used only by str_lists (it can be shared by
+ *   several lists);
+ * - a string is stored in its item if it fits in the pool object
+ *   (see STR_LIST_POOL_SIZE), without any malloc. Longer strings are
+ *   allocated with malloc;
+ * - the pool object size must be at least sizeof(struct str_list_item).
+ *
+ * Example:
+ *
+ *      pool_init(&pool, STR_LIST_POOL_SIZE(32), 0);
+ *      str_list_init_pool(&list, &pool);
+ *
+ * \param list The list which will be initialized
+ * \param pool The pool
+ * \return void
+ */
+void str_list_init_pool(struct str_list *list, struct pool *pool);
+
+/*
+ * str_list_init_arena
+ *
+ * Init a list of str whose items (and their string) are allocated
+ * from an arena.
+ *
+ * - str_list_remove() and str_list_cleanup() don't free memory: it is
+ *   freed by arena_reset() (so don't use the list after it).
+ *
+ * \param list The list which will be initialized
+ * \param arena The arena
+ * \return void
+ */
+void str_list_init_arena(struct str_list *list, struct arena *arena);
+
+/*
+ * str_list_init_intern
+ *
+ * Init a list of str whose strings are interned (see str_intern.h):
+ * a string repeated in the list, or in several lists sharing the
+ * table, is stored once.
+ *
+ * - items are allocated with malloc, strings belong to the table: they
+ *   stay until str_intern_cleanup() and must not be modified;
+ * - values of two items are equal if their pointers are.
+ *
+ * \param list The list which will be initialized
+ * \param intern The intern table
+ * \return void
+ */
+void str_list_init_intern(struct str_list *list, struct str_intern *intern);
+
 /*
  * str_list_cleanup
  *
@@ -423,6 +760,47 @@ unsigned int str_list_length(struct str_list *list);
 unsigned int str_list_toarray(struct str_list *list,
 			      const char **array, size_t size);
 
+/*
+ * str_lencmp
+ *
+ *  Compare two strings: the shortest first, then like strcmp.
+ *
+ * - "9" < "10" < "abc" (useful to sort numbers or names by length).
+ *
+ * \param a A string
+ * \param b Another string
+ * \return < 0, 0 or > 0 like strcmp
+ */
+int str_lencmp(const char *a, const char *b);
+
+/*
+ * str_list_sort
+ *
+ * Sort a list of str (stable merge sort, no allocation).
+ *
+ * \param list The list to sort
+ * \param cmp Compare function (strcmp, str_lencmp, strcasecmp...),
+ *            NULL for strcmp
+ * \return void
+ */
+void str_list_sort(struct str_list *list,
+                   int (*cmp)(const char *a, const char *b));
+
+/*
+ * str_list_tovec
+ *
+ * Append strings of a list to a vector of str.
+ *
+ * - strings aren't copied: they belong to the list, so don't use the
+ *   vector after str_list_cleanup();
+ * - on error, the vector is unchanged.
+ *
+ * \param list The list which contains str_list_item
+ * \param vec An initialized vector (see str_vec_init())
+ * \return 0 if strings were appended, -1 otherwise
+ */
+int str_list_tovec(struct str_list *list, struct str_vec *vec);
+
 /*
  * Walk over string list
  */
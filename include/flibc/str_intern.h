@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_STR_INTERN_H_
+#define _FLIBC_STR_INTERN_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "flibc/arena.h"
+
+/*
+ * str_intern.h - string interning
+ *
+ *  str_intern() returns one copy of each distinct string: interning a
+ *  string twice gives the same pointer, so interned strings are compared
+ *  by pointer (a == b) and a vocabulary repeated millions of times is
+ *  stored once.
+ *
+ * - strings are copied in an arena and stay until str_intern_cleanup():
+ *   pointers are stable, and strings must not be modified;
+ * - the index is an open-addressing hash table (linear probing) of
+ *   hash and pointer pairs, grown when half full;
+ * - strings are hashed with a random seed drawn for each table (see
+ *   hash_mem_seed()), so strings received from outside can't be chosen
+ *   to collide and make interning slow;
+ * - a table initialized with shards is thread-safe: strings are spread
+ *   over the shards by hash, each shard with its own lock, table and
+ *   arena, so threads seldom wait for each other.
+ *
+ * Example:
+ * --------
+ *
+ * str_intern_init(&names, 0);
+ *
+ * a = str_intern(&names, "status", 6);
+ * b = str_intern_cstr(&names, field);
+ * if(a == b)
+ *      // field is "status" //
+ *
+ * str_intern_cleanup(&names);
+ */
+
+/* first size of the hash table of a shard (power of 2) */
+#define STR_INTERN_MIN_SLOTS 64
+#define STR_INTERN_CACHELINE_SIZE 64
+
+struct str_intern_slot {
+        /* bits of the hash above the slot index, length (NULL str for an
+           empty slot) */
+        uint32_t tag;
+        uint32_t len;
+        const char *str;
+};
+
+struct str_intern_shard {
+        pthread_mutex_t lock;
+        struct str_intern_slot *slots;
+        size_t mask;
+        size_t count;
+        struct arena arena;
+} __attribute__((aligned(STR_INTERN_CACHELINE_SIZE)));
+
+struct str_intern {
+        struct str_intern_shard *shards;
+        uint64_t seed;
+        unsigned int shards_bits;
+        /* 0 if not thread-safe */
+        unsigned int locked;
+};
+
+/*
+ * str_intern_init
+ *
+ *  Init an empty table.
+ *
+ * \param table The table
+ * \param shards 0 for a table used by one thread only (no lock), or
+ *               the count of locked shards (rounded up to a power of 2,
+ *               1 to 256)
+ * \return 0 on success, -1 otherwise
+ */
+int str_intern_init(struct str_intern *table, unsigned int shards);
+
+/*
+ * str_intern_cleanup
+ *
+ *  Free the table and all the interned strings.
+ *
+ * \param table The table
+ * \return void
+ */
+void str_intern_cleanup(struct str_intern *table);
+
+/*
+ * str_intern
+ *
+ *  Intern a string.
+ *
+ * \param table The table
+ * \param str The string (doesn't need to be null terminated)
+ * \param len Length of str
+ * \return the interned copy of str (null terminated), NULL on error
+ */
+const char *str_intern(struct str_intern *table, const char *str, size_t len);
+
+/*
+ * str_intern_cstr
+ *
+ *  Intern a null terminated string.
+ */
+static inline const char *str_intern_cstr(struct str_intern *table,
+                                          const char *str)
+{
+        return str_intern(table, str, strlen(str));
+}
+
+/*
+ * str_intern_find
+ *
+ *  Find a string without interning it.
+ *
+ * \param table The table
+ * \param str The string
+ * \param len Length of str
+ * \return the interned copy of str, NULL if it isn't interned
+ */
+const char *str_intern_find(struct str_intern *table, const char *str,
+                            size_t len);
+
+/*
+ * str_intern_count
+ *
+ * \return the number of distinct strings interned
+ */
+size_t str_intern_count(struct str_intern *table);
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_STR_MULTI_H_
+#define _FLIBC_STR_MULTI_H_
+
+#include <stddef.h>
+
+#include "flibc/vec.h"
+
+/*
+ * str_multi.h - search and replace of many strings at once
+ *
+ *  Patterns are compiled once into an Aho-Corasick automaton, then each
+ *  input is scanned once whatever the number of patterns (one table
+ *  lookup per byte), instead of one scan per pattern with str_replace().
+ *
+ * - matches are leftmost-longest: the match starting first wins, and the
+ *   longest pattern among those starting there;
+ * - the transition table is dense, indexed by byte classes: bytes which
+ *   aren't in any pattern share one class, so the table stays small;
+ * - bytes which can't start a match are skipped quickly (with memchr()
+ *   if all the patterns start with the same byte);
+ * - str_multi_compile() must be called after the last str_multi_add().
+ *
+ * Example:
+ * --------
+ *
+ * str_multi_init(&multi);
+ * str_multi_add(&multi, "{{name}}", user->name);
+ * str_multi_add(&multi, "{{date}}", today);
+ * str_multi_compile(&multi);
+ *
+ * str_multi_replace(&multi, template, output, sizeof(output));
+ *
+ * str_multi_cleanup(&multi);
+ */
+
+struct str_multi_pattern {
+        char *pattern;
+        size_t len;
+        char *replacement;
+        size_t replacement_len;
+};
+
+VEC_DEFINE(str_multi_pattern_vec, struct str_multi_pattern)
+
+struct str_multi {
+        struct str_multi_pattern_vec patterns;
+        /* automaton, NULL until compiled */
+        unsigned int *transitions;
+        /* length of the longest pattern prefix of each state */
+        size_t *depth;
+        /* longest pattern ending at each state, STR_MULTI_NONE if none */
+        unsigned int *match;
+        unsigned int states;
+        unsigned int classes;
+        unsigned char byte_class[256];
+        /* bytes starting a pattern: their count, and one of them */
+        unsigned int start_bytes;
+        unsigned char start_byte;
+};
+
+/* no pattern */
+#define STR_MULTI_NONE ((unsigned int)-1)
+
+struct str_multi_match {
+        /* pattern (in order of str_multi_add()) */
+        unsigned int index;
+        size_t offset;
+        size_t len;
+};
+
+/*
+ * str_multi_init
+ *
+ *  Init a set of patterns, empty.
+ *
+ * \param multi The set of patterns
+ * \return void
+ */
+void str_multi_init(struct str_multi *multi);
+
+/*
+ * str_multi_cleanup
+ *
+ *  Free the patterns and the automaton.
+ *
+ * \param multi The set of patterns
+ * \return void
+ */
+void str_multi_cleanup(struct str_multi *multi);
+
+/*
+ * str_multi_add
+ *
+ *  Add a pattern and its replacement (both are copied).
+ *
+ * - if a pattern is added twice, the first one wins;
+ * - the automaton is freed: call str_multi_compile() again.
+ *
+ * \param multi The set of patterns
+ * \param pattern The string to seek (not empty)
+ * \param replacement The string which replaces pattern in
+ *                    str_multi_replace(), NULL for an empty one
+ * \return index of the pattern, -1 on error
+ */
+int str_multi_add(struct str_multi *multi, const char *pattern,
+                  const char *replacement);
+
+/*
+ * str_multi_compile
+ *
+ *  Build the automaton of the patterns added.
+ *
+ * \param multi The set of patterns
+ * \return 0 on success, -1 otherwise
+ */
+int str_multi_compile(struct str_multi *multi);
+
+/*
+ * str_multi_find
+ *
+ *  Find the leftmost-longest match of the patterns in a buffer.
+ *
+ * Example:
+ *
+ *      // all matches
+ *      for(pos = 0; str_multi_find(&multi, s + pos, len - pos, &match);
+ *          pos += match.offset + match.len)
+ *      {
+ *              // pattern match.index at s + pos + match.offset //
+ *      }
+ *
+ * \param multi The set of patterns (compiled)
+ * \param str The buffer
+ * \param len Size of the buffer
+ * \param match Where the match is stored (offset relative to str)
+ * \return 1 if found, 0 otherwise
+ */
+int str_multi_find(const struct str_multi *multi, const char *str,
+                   size_t len, struct str_multi_match *match);
+
+/*
+ * str_multi_replace
+ *
+ *  Replace all the patterns by their replacement in one pass (like
+ *  str_replace() with every pair at once).
+ *
+ * - replaced text isn't scanned again;
+ * - output is always null terminated, truncated on error.
+ *
+ * \param multi The set of patterns (compiled)
+ * \param haystack the base string
+ * \param output a buffer with a good size to store result
+ * \param output_size the size of buffer output
+ * \return 0 if the string has been replaced, -1 on truncation
+ */
+int str_multi_replace(const struct str_multi *multi, const char *haystack,
+                      char *output, size_t output_size);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_TIMER_H_
+#define _FLIBC_TIMER_H_
+
+#include <stdint.h>
+
+#include "flibc/list.h"
+
+/*
+ * timer.h - hierarchical timer wheel
+ *
+ *  Time is counted in ticks (the unit is yours: milliseconds, event loop
+ *  iterations...). The wheel has TIMER_WHEEL_LEVELS levels of
+ *  TIMER_WHEEL_SIZE slots: a slot of level 0 is one tick, a slot of
+ *  level 1 is TIMER_WHEEL_SIZE ticks, and so on. A timer is put in the
+ *  slot of the lowest level which covers its expiry; when time reaches
+ *  a slot of an upper level, its timers are cascaded to lower levels.
+ *
+ * - timer_add() and timer_cancel() are O(1), whatever the number of
+ *   timers;
+ * - timer_wheel_advance() runs expired timers in the order of their
+ *   slots (timers which expire at the same tick run in any order) and
+ *   skips ticks without timers;
+ * - a timer expiring after TIMER_WHEEL_RANGE ticks waits in the last
+ *   level and is cascaded again until it's in range;
+ * - a callback can add or cancel any timer, including itself;
+ * - no memory is allocated: struct timer is embedded in your structure
+ *   (see container_of()).
+ *
+ * Example:
+ * --------
+ *
+ * static void conn_timeout(struct timer *timer)
+ * {
+ *      struct conn *conn = container_of(timer, struct conn, timer);
+ *      ...
+ * }
+ *
+ * timer_wheel_init(&wheel, now_ms());
+ * timer_init(&conn->timer, conn_timeout);
+ * timer_add(&wheel, &conn->timer, now_ms() + 30000);
+ *
+ * for(;;)
+ * {
+ *      epoll_wait(fd, events, n, timer_wheel_timeout(&wheel, now_ms()));
+ *      timer_wheel_advance(&wheel, now_ms());
+ * }
+ */
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 5
+/* timers expiring later wait in the last level */
+#define TIMER_WHEEL_RANGE (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+struct timer;
+
+typedef void (*timer_func_t)(struct timer *timer);
+
+struct timer {
+        struct list_head node;
+        uint64_t expires;
+        timer_func_t func;
+};
+
+struct timer_wheel {
+        /* next tick to process */
+        uint64_t clock;
+        unsigned long count;
+        struct list_head slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+};
+
+/*
+ * timer_init
+ *
+ *  Init a timer (not pending).
+ *
+ * \param timer The timer
+ * \param func Called when the timer expires (it isn't pending anymore)
+ */
+static inline void timer_init(struct timer *timer, timer_func_t func)
+{
+        INIT_LIST_HEAD(&timer->node);
+        timer->expires = 0;
+        timer->func = func;
+}
+
+/*
+ * timer_pending
+ *
+ * \return 1 if the timer is added and hasn't expired, 0 otherwise
+ */
+static inline int timer_pending(const struct timer *timer)
+{
+        return !list_empty(&timer->node);
+}
+
+/*
+ * timer_wheel_init
+ *
+ *  Init an empty wheel.
+ *
+ * \param wheel The wheel
+ * \param now Current tick
+ */
+void timer_wheel_init(struct timer_wheel *wheel, uint64_t now);
+
+/*
+ * timer_add
+ *
+ *  Add a timer or change the expiry of a pending one.
+ *
+ * \param wheel The wheel
+ * \param timer The timer (initialized by timer_init())
+ * \param expires Tick of expiry: if it's already passed, the timer
+ *        expires at next timer_wheel_advance()
+ */
+void timer_add(struct timer_wheel *wheel, struct timer *timer,
+               uint64_t expires);
+
+/*
+ * timer_cancel
+ *
+ *  Remove a timer from its wheel (nothing is done if it isn't pending).
+ *
+ * \return 1 if the timer was pending, 0 otherwise
+ */
+int timer_cancel(struct timer_wheel *wheel, struct timer *timer);
+
+/*
+ * timer_wheel_advance
+ *
+ *  Run all timers which expire at or before a tick.
+ *
+ * \param wheel The wheel
+ * \param now Current tick
+ * \return number of timers run
+ */
+unsigned long timer_wheel_advance(struct timer_wheel *wheel, uint64_t now);
+
+/*
+ * timer_wheel_next
+ *
+ *  Find the next tick at which timer_wheel_advance() has work to do (a
+ *  timer to run or timers to cascade). It is never after the expiry of
+ *  the first timer, but may be before.
+ *
+ * \return the tick or UINT64_MAX if there is no timer
+ */
+uint64_t timer_wheel_next(const struct timer_wheel *wheel);
+
+/*
+ * timer_wheel_timeout
+ *
+ *  Timeout for poll() or epoll_wait() when ticks are milliseconds.
+ *
+ * \param wheel The wheel
+ * \param now Current tick
+ * \return ticks until timer_wheel_next() (0 if already passed), -1 if
+ *         there is no timer
+ */
+int timer_wheel_timeout(const struct timer_wheel *wheel, uint64_t now);
+
+#endif
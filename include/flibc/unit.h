@@ -20,12 +20,33 @@
 #ifndef _FLIBC_UNIT_H_
 #define _FLIBC_UNIT_H_
 
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#define BENCH_HAVE_PERF 1
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include <flibc/alloc.h>
 #include <flibc/vt102.h>
 
+/* defined only if libflibc_alloc is linked (see alloc.h) */
+#pragma weak alloc_tracking
+#pragma weak alloc_stats_get
+
 /*
  * unit.h - unit test framework
  *
@@ -58,6 +79,78 @@
  *
  *      return TEST_MODULE_RETURN;
  * }
+ *
+ * Timing:
+ * -------
+ *
+ *  The duration of each test is printed. Tests lasting more than
+ *  TEST_SLOW_MS milliseconds (environment variable, 1000 by default, 0
+ *  for none) are reported as slow, and TEST_MODULE_RETURN prints the
+ *  TEST_SLOWEST (5 by default) slowest tests.
+ *  TEST_ASSERT_FASTER_THAN(ns) fails if the test has lasted more than ns
+ *  nanoseconds so far (scaled by TEST_TIME_SCALE).
+ *
+ * Parallel runner:
+ * ----------------
+ *
+ *  If the TEST_JOBS environment variable is a number greater than 0,
+ *  each TEST_RUN() forks a child process to run the test and up to
+ *  TEST_JOBS tests run at the same time. A test which crashes or lasts
+ *  more than TEST_TIMEOUT seconds (environment variable, 60 by default,
+ *  0 for none) is reported as failed, the others still run. Results are
+ *  printed in the order tests finish; TEST_MODULE_RETURN waits for all
+ *  of them.
+ *
+ * - tests must not depend on what a previous test has done;
+ * - TEST_JOBS_DEFAULT can be defined (before including unit.h) to
+ *   enable the runner without environment variable.
+ *
+ * Allocations:
+ * ------------
+ *
+ *  When the test is linked with libflibc_alloc (see alloc.h),
+ *  TEST_ASSERT_NO_ALLOC(block) checks that a block of code doesn't
+ *  allocate memory and TEST_ASSERT_ALLOC_COUNT(n, block) that it
+ *  allocates exactly n times. Otherwise, the block runs without check
+ *  and a warning is printed. Benchmarks also print allocations per
+ *  iteration of their BENCH_LOOP.
+ *
+ * Benchmarks:
+ * -----------
+ *
+ *  A benchmark is defined like a test; only the BENCH_LOOP is timed. It
+ *  runs with a number of iterations calibrated so that a sample lasts
+ *  BENCH_SAMPLE_NS, once for warmup then BENCH_SAMPLES times. The
+ *  min, median and 99th percentile time per iteration are printed.
+ *
+ *  If the BENCH_JSON environment variable is set, results are also
+ *  appended to this file as one JSON object per line.
+ *
+ *  If the BENCH_PERF environment variable is set (Linux only), hardware
+ *  counters of the BENCH_LOOP are read with perf_event_open(): cycles,
+ *  instructions, IPC, branch misses, L1 data and last level cache
+ *  misses, page faults per iteration. Counters which aren't available
+ *  (virtual machine, perf_event_paranoid...) are not printed.
+ *
+ * BENCH_DEF(bench_foo)
+ * {
+ *      char buf[4096];
+ *
+ *      BENCH_SET_BYTES(sizeof(buf));
+ *      BENCH_LOOP
+ *      {
+ *              DO_NOT_OPTIMIZE(foo(buf, sizeof(buf)));
+ *      }
+ * }
+ *
+ * int main(void)
+ * {
+ *      BENCH_MODULE_INIT("foo");
+ *
+ *      BENCH_RUN(bench_foo);
+ *
+ *      return BENCH_MODULE_RETURN;
+ * }
  */
 
 /*
@@ -67,6 +160,9 @@ struct test_result {
         int ret;
 	int line;
 	char msg[256];
+        /* when the test started and its duration */
+        struct timespec start;
+        double ns;
 };
 
 /*
@@ -81,6 +177,429 @@ struct test_result {
 #define TEST_PRINT_OK(m, ...)                                   \
         printf(VT102_COLOR_GREEN(m "\n"), ##__VA_ARGS__)
 
+/*
+ * Parallel runner (see TEST_JOBS)
+ */
+#ifndef TEST_JOBS_DEFAULT
+#define TEST_JOBS_DEFAULT 0
+#endif
+
+#define TEST_TIMEOUT_DEFAULT 60
+#define TEST_MAX_JOBS 64
+/* tests lasting more than this are reported as slow (TEST_SLOW_MS) */
+#define TEST_SLOW_MS_DEFAULT 1000
+/* slowest tests printed at the end (TEST_SLOWEST) */
+#define TEST_SLOWEST_DEFAULT 5
+#define TEST_SLOWEST_MAX 32
+
+/* nanoseconds from start to end */
+static inline double test_clock_diff(const struct timespec *start,
+                                     const struct timespec *end)
+{
+        return (double) (end->tv_sec - start->tv_sec) * 1e9
+                + (double) (end->tv_nsec - start->tv_nsec);
+}
+
+/* nanoseconds since start */
+static inline double test_clock_diff_now(const struct timespec *start)
+{
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return test_clock_diff(start, &now);
+}
+
+struct test_timing {
+        const char *name;
+        double ns;
+};
+
+struct test_child {
+        pid_t pid;
+        int fd;
+        const char *name;
+        struct timespec start;
+        struct timespec deadline;
+        struct test_result tr;
+        size_t received;
+};
+
+struct test_runner {
+        /* 0 if tests run in the process */
+        unsigned int jobs;
+        /* seconds, 0 for none */
+        unsigned int timeout;
+        unsigned int running;
+        int ret;
+        struct test_child children[TEST_MAX_JOBS];
+        /* milliseconds, 0 for none */
+        unsigned int slow_ms;
+        unsigned int slow_count;
+        /* slowest tests, sorted */
+        unsigned int slowest_max;
+        unsigned int slowest_count;
+        struct test_timing slowest[TEST_SLOWEST_MAX];
+        unsigned int count;
+        double total_ns;
+};
+
+static inline unsigned int test_env_uint(const char *name,
+                                         unsigned int dfl)
+{
+        const char *value = getenv(name);
+        char *end = NULL;
+        unsigned long n;
+
+        if(value == NULL || *value == '\0')
+        {
+                return dfl;
+        }
+
+        n = strtoul(value, &end, 10);
+        if(*end != '\0' || n > 1000000)
+        {
+                return dfl;
+        }
+
+        return (unsigned int) n;
+}
+
+static inline void test_runner_init(struct test_runner *runner)
+{
+        memset(runner, 0, sizeof(*runner));
+        runner->jobs = test_env_uint("TEST_JOBS", TEST_JOBS_DEFAULT);
+        if(runner->jobs > TEST_MAX_JOBS)
+        {
+                runner->jobs = TEST_MAX_JOBS;
+        }
+        runner->timeout = test_env_uint("TEST_TIMEOUT", TEST_TIMEOUT_DEFAULT);
+        runner->slow_ms = test_env_uint("TEST_SLOW_MS", TEST_SLOW_MS_DEFAULT);
+        runner->slowest_max = test_env_uint("TEST_SLOWEST",
+                                            TEST_SLOWEST_DEFAULT);
+        if(runner->slowest_max > TEST_SLOWEST_MAX)
+        {
+                runner->slowest_max = TEST_SLOWEST_MAX;
+        }
+}
+
+/* human readable duration */
+static inline const char *test_duration_format(char *buf, size_t size,
+                                               double ns)
+{
+        if(ns < 1e6)
+        {
+                snprintf(buf, size, "%.0f us", ns / 1e3);
+        }
+        else if(ns < 1e9)
+        {
+                snprintf(buf, size, "%.2f ms", ns / 1e6);
+        }
+        else
+        {
+                snprintf(buf, size, "%.2f s", ns / 1e9);
+        }
+
+        return buf;
+}
+
+/* print the result of a test and keep its duration */
+static inline void test_runner_report(struct test_runner *runner,
+                                      const char *name,
+                                      const struct test_result *tr)
+{
+        char duration[32];
+        unsigned int i;
+
+        test_duration_format(duration, sizeof(duration), tr->ns);
+        if(tr->ret != 0 && tr->line == 0)
+        {
+                /* crashed or timed out child */
+                TEST_PRINT_ERROR("KO: %s: %s (%s)", name, tr->msg, duration);
+        }
+        else if(tr->ret != 0)
+        {
+                TEST_PRINT_ERROR("KO: %s (line:%d): %s (%s)",
+                                 name, tr->line, tr->msg, duration);
+        }
+        else
+        {
+                TEST_PRINT_OK("OK: %s (%s)", name, duration);
+        }
+
+        if(runner->slow_ms && tr->ns > (double) runner->slow_ms * 1e6)
+        {
+                TEST_PRINT_WARNING("SLOW: %s (%s, more than %u ms)",
+                                   name, duration, runner->slow_ms);
+                ++runner->slow_count;
+        }
+
+        ++runner->count;
+        runner->total_ns += tr->ns;
+
+        /* insertion in the slowest tests */
+        for(i = runner->slowest_count; i > 0; --i)
+        {
+                if(runner->slowest[i - 1].ns >= tr->ns)
+                {
+                        break;
+                }
+                if(i < runner->slowest_max)
+                {
+                        runner->slowest[i] = runner->slowest[i - 1];
+                }
+        }
+        if(i < runner->slowest_max)
+        {
+                runner->slowest[i].name = name;
+                runner->slowest[i].ns = tr->ns;
+                if(runner->slowest_count < runner->slowest_max)
+                {
+                        ++runner->slowest_count;
+                }
+        }
+}
+
+static inline void test_runner_summary(const struct test_runner *runner)
+{
+        char duration[32];
+        unsigned int i;
+
+        if(runner->slowest_count == 0)
+        {
+                return;
+        }
+
+        printf("%u tests in %s", runner->count,
+               test_duration_format(duration, sizeof(duration),
+                                    runner->total_ns));
+        if(runner->slow_count)
+        {
+                printf(", %u slow", runner->slow_count);
+        }
+        printf(", slowest:\n");
+
+        for(i = 0; i < runner->slowest_count; ++i)
+        {
+                printf("  %10s  %s\n",
+                       test_duration_format(duration, sizeof(duration),
+                                            runner->slowest[i].ns),
+                       runner->slowest[i].name);
+        }
+}
+
+/* print the result of a finished child and forget it */
+static inline void test_runner_reap(struct test_runner *runner,
+                                    unsigned int index, int timeout)
+{
+        struct test_child *child = &runner->children[index];
+        struct test_result *tr = &child->tr;
+        struct timespec end;
+        int status = 0;
+
+        if(timeout)
+        {
+                kill(child->pid, SIGKILL);
+        }
+
+        while(waitpid(child->pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        close(child->fd);
+
+        if(child->received != sizeof(*tr))
+        {
+                /* no result: duration seen from here */
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                memset(tr, 0, sizeof(*tr));
+                tr->ret = -1;
+                tr->ns = test_clock_diff(&child->start, &end);
+        }
+
+        /* failed even if a whole result was written before */
+        if(timeout)
+        {
+                tr->ret = -1;
+                tr->line = 0;
+                snprintf(tr->msg, sizeof(tr->msg), "timeout (%u s)",
+                         runner->timeout);
+        }
+        else if(WIFSIGNALED(status))
+        {
+                tr->ret = -1;
+                tr->line = 0;
+                snprintf(tr->msg, sizeof(tr->msg),
+                         "killed by signal %d (%s)",
+                         WTERMSIG(status), strsignal(WTERMSIG(status)));
+        }
+        else if(child->received != sizeof(*tr))
+        {
+                snprintf(tr->msg, sizeof(tr->msg),
+                         "exited with status %d without result",
+                         WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        }
+
+        test_runner_report(runner, child->name, tr);
+        runner->ret |= tr->ret;
+        fflush(stdout);
+
+        *child = runner->children[--runner->running];
+}
+
+/* wait until at least one child has finished */
+static inline void test_runner_wait(struct test_runner *runner)
+{
+        struct pollfd fds[TEST_MAX_JOBS];
+        struct test_child *child = NULL;
+        struct timespec now;
+        double remaining,
+                wait_ms;
+        unsigned int i,
+                reaped = 0;
+        ssize_t n;
+        int ret;
+
+        while(!reaped && runner->running)
+        {
+                clock_gettime(CLOCK_MONOTONIC, &now);
+
+                wait_ms = -1;
+                for(i = 0; i < runner->running; ++i)
+                {
+                        fds[i].fd = runner->children[i].fd;
+                        fds[i].events = POLLIN;
+                        fds[i].revents = 0;
+
+                        if(runner->timeout)
+                        {
+                                remaining = test_clock_diff(
+                                        &now,
+                                        &runner->children[i].deadline) / 1e6;
+                                if(remaining < 0)
+                                {
+                                        remaining = 0;
+                                }
+                                if(wait_ms < 0 || remaining < wait_ms)
+                                {
+                                        wait_ms = remaining;
+                                }
+                        }
+                }
+
+                ret = poll(fds, runner->running,
+                           wait_ms < 0 ? -1 : (int) wait_ms + 1);
+                if(ret < 0 && errno != EINTR)
+                {
+                        TEST_PRINT_RUNTIME_ERROR("poll: %s", strerror(errno));
+                        exit(EXIT_FAILURE);
+                }
+
+                clock_gettime(CLOCK_MONOTONIC, &now);
+
+                /* from the end: reaping moves the last child */
+                for(i = runner->running; i-- > 0;)
+                {
+                        child = &runner->children[i];
+
+                        if(fds[i].revents)
+                        {
+                                n = read(child->fd,
+                                         (char *) &child->tr + child->received,
+                                         sizeof(child->tr) - child->received);
+                                if(n > 0)
+                                {
+                                        child->received += (size_t) n;
+                                        if(child->received < sizeof(child->tr))
+                                        {
+                                                continue;
+                                        }
+                                }
+                                else if(n < 0 && errno == EINTR)
+                                {
+                                        continue;
+                                }
+
+                                test_runner_reap(runner, i, 0);
+                                ++reaped;
+                        }
+                        else if(runner->timeout
+                                && test_clock_diff(&now,
+                                                    &child->deadline) <= 0)
+                        {
+                                test_runner_reap(runner, i, 1);
+                                ++reaped;
+                        }
+                }
+        }
+}
+
+/* run a test in a child process */
+static inline void test_runner_fork(struct test_runner *runner,
+                                    const char *name,
+                                    void (*func)(struct test_result *))
+{
+        struct test_child *child = NULL;
+        struct test_result tr;
+        int fds[2];
+        pid_t pid;
+
+        while(runner->running >= runner->jobs)
+        {
+                test_runner_wait(runner);
+        }
+
+        /* else buffered output would be written by both processes */
+        fflush(stdout);
+        fflush(stderr);
+
+        if(pipe(fds) != 0 || (pid = fork()) < 0)
+        {
+                TEST_PRINT_RUNTIME_ERROR("fork: %s", strerror(errno));
+                exit(EXIT_FAILURE);
+        }
+
+        if(pid == 0)
+        {
+                close(fds[0]);
+                memset(&tr, 0, sizeof(tr));
+
+                clock_gettime(CLOCK_MONOTONIC, &tr.start);
+                func(&tr);
+                tr.ns = test_clock_diff_now(&tr.start);
+
+                fflush(stdout);
+                if(write(fds[1], &tr, sizeof(tr)) != (ssize_t) sizeof(tr))
+                {
+                        _exit(EXIT_FAILURE);
+                }
+                _exit(tr.ret ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+
+        close(fds[1]);
+
+        child = &runner->children[runner->running++];
+        child->pid = pid;
+        child->fd = fds[0];
+        child->name = name;
+        child->received = 0;
+        clock_gettime(CLOCK_MONOTONIC, &child->start);
+        child->deadline = child->start;
+        child->deadline.tv_sec += (time_t) runner->timeout;
+}
+
+/* wait for all tests and return the result of the module */
+static inline int test_runner_finish(struct test_runner *runner)
+{
+        while(runner->running)
+        {
+                test_runner_wait(runner);
+        }
+
+        test_runner_summary(runner);
+
+        return runner->ret;
+}
+
 /*
  * Run a test definition
  */
@@ -89,16 +608,16 @@ struct test_result {
 		struct test_result tr;                                  \
 		tr.ret = 0;                                             \
 									\
+                if(test_runner.jobs)                                    \
+                {                                                       \
+                        test_runner_fork(&test_runner, #func, func);    \
+                        break;                                          \
+                }                                                       \
+									\
+                clock_gettime(CLOCK_MONOTONIC, &tr.start);              \
 		func(&tr);                                              \
-		if(tr.ret != 0)                                         \
-		{							\
-			TEST_PRINT_ERROR("KO: %s (line:%d): %s",        \
-                                    #func, tr.line, tr.msg);            \
-		}							\
-		else							\
-		{							\
-			TEST_PRINT_OK("OK: %s", #func);                 \
-		}							\
+                tr.ns = test_clock_diff_now(&tr.start);                 \
+                test_runner_report(&test_runner, #func, &tr);           \
 		main_return |= tr.ret;                                  \
 	} while(0)
 
@@ -129,13 +648,610 @@ struct test_result {
 #define TEST_ASSERT(condition)                                  \
         TEST_RAW_ASSERT(condition, "Condition isn't TRUE")
 
+/*
+ * Time budget of a test: fails if the test has lasted more than ns
+ * nanoseconds so far. The budget is multiplied by the TEST_TIME_SCALE
+ * environment variable if set (for slow builds: valgrind, sanitizers).
+ */
+static inline double test_time_scale(void)
+{
+        const char *value = getenv("TEST_TIME_SCALE");
+        double scale = value ? strtod(value, NULL) : 1;
+
+        return scale > 0 ? scale : 1;
+}
+
+#define TEST_ASSERT_FASTER_THAN(ns) do                                  \
+	{								\
+                double __elapsed = test_clock_diff_now(&__tr->start),   \
+                        __budget = (double) (ns) * test_time_scale();   \
+                                                                        \
+                TEST_RAW_ASSERT(__elapsed <= __budget,                  \
+                                "%.0f ns, budget was %.0f ns",          \
+                                __elapsed, __budget);                   \
+	} while(0)
+
+/*
+ * Assertions on allocations of a block of code (see alloc.h)
+ */
+static inline int test_alloc_tracking(void)
+{
+        return alloc_tracking != NULL && alloc_tracking();
+}
+
+#define TEST_ASSERT_ALLOC_COUNT(count, ...) do                          \
+	{								\
+                struct alloc_stats __alloc_stats;                       \
+                                                                        \
+                if(!test_alloc_tracking())                              \
+                {                                                       \
+                        TEST_PRINT_WARNING("allocations aren't counted "\
+                                           "(line:%d)", __LINE__);      \
+                        __VA_ARGS__;                                    \
+                }                                                       \
+                else                                                    \
+                {                                                       \
+                        ALLOC_COUNT(&__alloc_stats, __VA_ARGS__);       \
+                        TEST_RAW_ASSERT(__alloc_stats.allocs            \
+                                        == (unsigned long) (count),     \
+                                        "%lu allocations (%zu bytes) "  \
+                                        "instead of %lu",               \
+                                        __alloc_stats.allocs,           \
+                                        __alloc_stats.bytes,            \
+                                        (unsigned long) (count));       \
+                }                                                       \
+	} while(0)
+
+#define TEST_ASSERT_NO_ALLOC(...)                                       \
+        TEST_ASSERT_ALLOC_COUNT(0, __VA_ARGS__)
+
 /*
  * Define a test module of unit tests
  */
 #define TEST_MODULE_INIT(name)                                  \
 	int main_return = 0;                                    \
+        struct test_runner test_runner;                         \
+                                                                \
+        test_runner_init(&test_runner);                         \
 	printf(VT102_COLOR_BLUE("@@ TEST " name " @@\n"))
 
-#define TEST_MODULE_RETURN main_return
+#define TEST_MODULE_RETURN                                      \
+        (main_return | test_runner_finish(&test_runner))
+
+/*
+ * Benchmarks
+ */
+
+/* number of timed samples */
+#ifndef BENCH_SAMPLES
+#define BENCH_SAMPLES 30
+#endif
+
+/* wanted duration of a sample */
+#ifndef BENCH_SAMPLE_NS
+#define BENCH_SAMPLE_NS 10000000.0
+#endif
+
+/* limit of iterations per sample */
+#define BENCH_MAX_ITERATIONS (1UL << 40)
+
+/*
+ * Hardware counters of benchmarks (see BENCH_PERF)
+ */
+enum {
+        BENCH_PERF_CYCLES,
+        BENCH_PERF_INSTRUCTIONS,
+        BENCH_PERF_BRANCH_MISSES,
+        BENCH_PERF_L1D_MISSES,
+        BENCH_PERF_LLC_MISSES,
+        BENCH_PERF_PAGE_FAULTS,
+        BENCH_PERF_COUNTERS
+};
+
+struct bench_perf {
+        /* group leader, -1 if counters are disabled */
+        int leader;
+        int fds[BENCH_PERF_COUNTERS];
+        /* position of a counter in a group read, -1 if not opened */
+        int index[BENCH_PERF_COUNTERS];
+        unsigned int count;
+        /* sum of counters while enabled */
+        double totals[BENCH_PERF_COUNTERS];
+        /* if 0, counters aren't enabled by BENCH_LOOP */
+        int active;
+};
+
+static const char *const bench_perf_names[BENCH_PERF_COUNTERS] = {
+        "cycles",
+        "instructions",
+        "branch-misses",
+        "L1d-misses",
+        "LLC-misses",
+        "page-faults",
+};
+
+#ifdef BENCH_HAVE_PERF
+
+static inline int bench_perf_event_open(unsigned int counter, int group)
+{
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.disabled = group < 0;
+        /* user space only: allowed with perf_event_paranoid <= 2 */
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP
+                | PERF_FORMAT_TOTAL_TIME_ENABLED
+                | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        switch(counter)
+        {
+        case BENCH_PERF_CYCLES:
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+        case BENCH_PERF_INSTRUCTIONS:
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+        case BENCH_PERF_BRANCH_MISSES:
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+        case BENCH_PERF_L1D_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D
+                        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+        case BENCH_PERF_LLC_MISSES:
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+        default:
+                attr.type = PERF_TYPE_SOFTWARE;
+                attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+                break;
+        }
+
+        return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static inline void bench_perf_open(struct bench_perf *perf)
+{
+        static int warned = 0;
+        const char *env = getenv("BENCH_PERF");
+        unsigned int i;
+        int fd;
+
+        memset(perf, 0, sizeof(*perf));
+        perf->leader = -1;
+        for(i = 0; i < BENCH_PERF_COUNTERS; ++i)
+        {
+                perf->fds[i] = -1;
+                perf->index[i] = -1;
+        }
+
+        if(env == NULL || *env == '\0' || strcmp(env, "0") == 0)
+        {
+                return;
+        }
+
+        for(i = 0; i < BENCH_PERF_COUNTERS; ++i)
+        {
+                fd = bench_perf_event_open(i, perf->leader);
+                if(fd < 0)
+                {
+                        continue;
+                }
+
+                if(perf->leader < 0)
+                {
+                        perf->leader = fd;
+                }
+                perf->fds[i] = fd;
+                perf->index[i] = (int) perf->count++;
+        }
+
+        if(!warned && perf->fds[BENCH_PERF_CYCLES] < 0)
+        {
+                warned = 1;
+                TEST_PRINT_WARNING("hardware counters unavailable (%s), "
+                                   "see /proc/sys/kernel/perf_event_paranoid",
+                                   strerror(errno));
+        }
+}
+
+static inline void bench_perf_close(struct bench_perf *perf)
+{
+        unsigned int i;
+
+        for(i = 0; i < BENCH_PERF_COUNTERS; ++i)
+        {
+                if(perf->fds[i] >= 0)
+                {
+                        close(perf->fds[i]);
+                }
+        }
+        perf->leader = -1;
+}
+
+static inline void bench_perf_start(struct bench_perf *perf)
+{
+        if(perf->active && perf->leader >= 0)
+        {
+                ioctl(perf->leader, PERF_EVENT_IOC_RESET,
+                      PERF_IOC_FLAG_GROUP);
+                ioctl(perf->leader, PERF_EVENT_IOC_ENABLE,
+                      PERF_IOC_FLAG_GROUP);
+        }
+}
+
+static inline void bench_perf_stop(struct bench_perf *perf)
+{
+        /* nr, time enabled, time running, values */
+        uint64_t values[3 + BENCH_PERF_COUNTERS];
+        double scale;
+        unsigned int i;
+
+        if(!perf->active || perf->leader < 0)
+        {
+                return;
+        }
+
+        ioctl(perf->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        if(read(perf->leader, values, sizeof(values)) < 0
+           || values[0] != perf->count || values[2] == 0)
+        {
+                return;
+        }
+
+        /* counters were multiplexed with other events */
+        scale = (double) values[1] / (double) values[2];
+        for(i = 0; i < BENCH_PERF_COUNTERS; ++i)
+        {
+                if(perf->index[i] >= 0)
+                {
+                        perf->totals[i] += (double) values[3 + perf->index[i]]
+                                * scale;
+                }
+        }
+}
+
+#else
+
+static inline void bench_perf_open(struct bench_perf *perf)
+{
+        memset(perf, 0, sizeof(*perf));
+        perf->leader = -1;
+}
+
+static inline void bench_perf_close(struct bench_perf *perf)
+{
+        (void) perf;
+}
+
+static inline void bench_perf_start(struct bench_perf *perf)
+{
+        (void) perf;
+}
+
+static inline void bench_perf_stop(struct bench_perf *perf)
+{
+        (void) perf;
+}
+
+#endif
+
+struct bench_state {
+        const char *module;
+        const char *name;
+        /* iterations of BENCH_LOOP */
+        unsigned long iterations;
+        /* bytes processed by an iteration (0 if unknown) */
+        size_t bytes;
+        int started;
+        struct timespec start;
+        /* duration of the last BENCH_LOOP */
+        double elapsed;
+        /* allocations of BENCH_LOOP (if counted) */
+        struct alloc_stats allocs_start;
+        unsigned long allocs;
+        /* hardware counters of BENCH_LOOP */
+        struct bench_perf perf;
+        /* ns per iteration of each sample */
+        double samples[BENCH_SAMPLES];
+};
+
+/*
+ * Prevent the compiler to remove a computation whose result is unused
+ */
+#define DO_NOT_OPTIMIZE(value)                                  \
+        __asm__ __volatile__("" : : "r,m"(value) : "memory")
+
+/*
+ * Force the compiler to write and read again values from memory
+ */
+#define BENCH_CLOBBER() __asm__ __volatile__("" : : : "memory")
+
+/*
+ * Set the number of bytes processed by an iteration (for bytes/s)
+ */
+#define BENCH_SET_BYTES(n) (__bs->bytes = (size_t) (n))
+
+/*
+ * Define a benchmark function
+ */
+#define BENCH_DEF(name)                                         \
+	static void name(struct bench_state* __bs)
+
+/*
+ * The timed loop of a benchmark
+ */
+#define BENCH_LOOP                                                      \
+        for(unsigned long __bench_i = bench_state_start(__bs);          \
+            __bench_i-- > 0 || bench_state_stop(__bs);)
+
+static inline unsigned long bench_state_start(struct bench_state *bs)
+{
+        bs->started = 1;
+        if(test_alloc_tracking())
+        {
+                alloc_stats_get(&bs->allocs_start);
+        }
+        bench_perf_start(&bs->perf);
+        clock_gettime(CLOCK_MONOTONIC, &bs->start);
+
+        return bs->iterations;
+}
+
+static inline int bench_state_stop(struct bench_state *bs)
+{
+        struct timespec end;
+        struct alloc_stats allocs;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        bench_perf_stop(&bs->perf);
+        bs->elapsed = test_clock_diff(&bs->start, &end);
+
+        if(test_alloc_tracking())
+        {
+                alloc_stats_get(&allocs);
+                alloc_stats_sub(&allocs, &bs->allocs_start);
+                bs->allocs += allocs.allocs;
+        }
+
+        return 0;
+}
+
+static inline int bench_double_cmp(const void *a, const void *b)
+{
+        double x = *(const double *) a,
+                y = *(const double *) b;
+
+        return (x > y) - (x < y);
+}
+
+/* time of one call of the benchmark, -1 if BENCH_LOOP wasn't run */
+static inline double bench_sample(struct bench_state *bs,
+                                  void (*func)(struct bench_state *))
+{
+        bs->started = 0;
+        bs->elapsed = 0;
+        func(bs);
+
+        return bs->started ? bs->elapsed : -1;
+}
+
+static inline double bench_allocs_per_op(const struct bench_state *bs)
+{
+        return (double) bs->allocs
+                / ((double) bs->iterations * BENCH_SAMPLES);
+}
+
+/* counter per iteration, -1 if not available */
+static inline double bench_perf_per_op(const struct bench_state *bs,
+                                       unsigned int counter)
+{
+        if(bs->perf.index[counter] < 0)
+        {
+                return -1;
+        }
+
+        return bs->perf.totals[counter]
+                / ((double) bs->iterations * BENCH_SAMPLES);
+}
+
+static inline void bench_perf_report(const struct bench_state *bs)
+{
+        double cycles = bench_perf_per_op(bs, BENCH_PERF_CYCLES),
+                instructions = bench_perf_per_op(bs, BENCH_PERF_INSTRUCTIONS),
+                value;
+        unsigned int i,
+                printed = 0;
+
+        for(i = 0; i < BENCH_PERF_COUNTERS; ++i)
+        {
+                value = bench_perf_per_op(bs, i);
+                if(value < 0)
+                {
+                        continue;
+                }
+
+                printf("%s%.2f %s/op", printed++ ? ", " : "    ", value,
+                       bench_perf_names[i]);
+                if(i == BENCH_PERF_INSTRUCTIONS && cycles > 0)
+                {
+                        printf(", IPC %.2f", instructions / cycles);
+                }
+        }
+
+        if(printed)
+        {
+                printf("\n");
+        }
+}
+
+static inline void bench_report_json(const struct bench_state *bs,
+                                     double min, double median, double p99)
+{
+        const char *path = getenv("BENCH_JSON");
+        FILE *file = NULL;
+        unsigned int i;
+
+        if(path == NULL || *path == '\0')
+        {
+                return;
+        }
+
+        file = fopen(path, "a");
+        if(file == NULL)
+        {
+                TEST_PRINT_RUNTIME_ERROR("Unable to open %s", path);
+                return;
+        }
+
+        fprintf(file, "{\"module\":\"%s\",\"name\":\"%s\","
+                "\"iterations\":%lu,\"bytes\":%zu,"
+                "\"min_ns\":%.3f,\"median_ns\":%.3f,\"p99_ns\":%.3f,",
+                bs->module, bs->name, bs->iterations, bs->bytes,
+                min, median, p99);
+        if(test_alloc_tracking())
+        {
+                fprintf(file, "\"allocs_per_op\":%.3f,",
+                        bench_allocs_per_op(bs));
+        }
+        for(i = 0; i < BENCH_PERF_COUNTERS; ++i)
+        {
+                if(bench_perf_per_op(bs, i) >= 0)
+                {
+                        fprintf(file, "\"%s_per_op\":%.3f,",
+                                bench_perf_names[i], bench_perf_per_op(bs, i));
+                }
+        }
+        fprintf(file, "\"samples_ns\":[");
+        for(i = 0; i < BENCH_SAMPLES; ++i)
+        {
+                fprintf(file, "%s%.3f", i ? "," : "", bs->samples[i]);
+        }
+        fprintf(file, "]}\n");
+
+        fclose(file);
+}
+
+/*
+ * Calibrate, warm up, sample and report a benchmark
+ */
+static inline int bench_run(struct bench_state *bs,
+                            void (*func)(struct bench_state *))
+{
+        double elapsed,
+                min,
+                median,
+                p99;
+        unsigned int i;
+
+        /* calibration: until a sample lasts at least half of the
+         * wanted duration */
+        bs->iterations = 1;
+        for(;;)
+        {
+                elapsed = bench_sample(bs, func);
+                if(elapsed < 0)
+                {
+                        TEST_PRINT_ERROR("KO: %s: no BENCH_LOOP", bs->name);
+                        return -1;
+                }
+
+                if(elapsed >= BENCH_SAMPLE_NS / 2
+                   || bs->iterations >= BENCH_MAX_ITERATIONS)
+                {
+                        break;
+                }
+
+                if(elapsed < BENCH_SAMPLE_NS / 100)
+                {
+                        bs->iterations *= 10;
+                }
+                else
+                {
+                        bs->iterations = (unsigned long)
+                                ((double) bs->iterations * BENCH_SAMPLE_NS
+                                 / elapsed);
+                }
+        }
+        bs->iterations = (unsigned long)
+                ((double) bs->iterations * BENCH_SAMPLE_NS / elapsed) + 1;
+
+        /* warmup */
+        bench_sample(bs, func);
+
+        bs->allocs = 0;
+        bench_perf_open(&bs->perf);
+        bs->perf.active = 1;
+        for(i = 0; i < BENCH_SAMPLES; ++i)
+        {
+                bs->samples[i] = bench_sample(bs, func)
+                        / (double) bs->iterations;
+        }
+        bs->perf.active = 0;
+        bench_perf_close(&bs->perf);
+
+        /* report on sorted copy, samples are kept in order */
+        {
+                double sorted[BENCH_SAMPLES];
+
+                memcpy(sorted, bs->samples, sizeof(sorted));
+                qsort(sorted, BENCH_SAMPLES, sizeof(*sorted),
+                      bench_double_cmp);
+
+                min = sorted[0];
+                median = BENCH_SAMPLES % 2
+                        ? sorted[BENCH_SAMPLES / 2]
+                        : (sorted[BENCH_SAMPLES / 2 - 1]
+                           + sorted[BENCH_SAMPLES / 2]) / 2;
+                p99 = sorted[(BENCH_SAMPLES * 99 + 99) / 100 - 1];
+        }
+
+        printf("%-32s %10.2f %10.2f %10.2f ns/op",
+               bs->name, min, median, p99);
+        if(bs->bytes)
+        {
+                printf(" %10.2f MB/s", (double) bs->bytes * 1e3 / median);
+        }
+        if(test_alloc_tracking())
+        {
+                printf(" %8.2f allocs/op", bench_allocs_per_op(bs));
+        }
+        printf("\n");
+        bench_perf_report(bs);
+
+        bench_report_json(bs, min, median, p99);
+
+        return 0;
+}
+
+/*
+ * Run a benchmark definition
+ */
+#define BENCH_RUN(func) do                                              \
+	{								\
+		struct bench_state bs;                                  \
+                                                                        \
+                memset(&bs, 0, sizeof(bs));                             \
+                bs.module = bench_module;                               \
+                bs.name = #func;                                        \
+		main_return |= bench_run(&bs, func);                    \
+	} while(0)
+
+/*
+ * Define a module of benchmarks
+ */
+#define BENCH_MODULE_INIT(name)                                         \
+	int main_return = 0;                                            \
+        const char *bench_module = name;                                \
+	printf(VT102_COLOR_BLUE("@@ BENCH " name " @@\n"));            \
+        printf("%-32s %10s %10s %10s\n", "", "min", "median", "p99")
+
+#define BENCH_MODULE_RETURN main_return
 
 #endif
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIBC_VEC_H_
+#define _FLIBC_VEC_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * vec.h - type-safe growable array
+ *
+ *  Elements are stored in one contiguous buffer: iterating is a linear
+ *  scan (no pointer to follow and no cache miss per element like with
+ *  list_head). Use it when you mostly append and iterate.
+ *
+ * - VEC_DEFINE(name, type) defines struct name and name_* functions;
+ * - functions which can allocate return 0 on success, -1 otherwise
+ *   (the vector is unchanged on error);
+ * - pointers to elements are invalidated by functions which can
+ *   allocate (reserve, push, insert, append) or shrink.
+ *
+ * Example:
+ * --------
+ *
+ * VEC_DEFINE(int_vec, int)
+ *
+ * struct int_vec v;
+ * int *pos;
+ *
+ * int_vec_init(&v);
+ * int_vec_push(&v, 42);
+ * vec_for_each(pos, &v)
+ * {
+ *      // your stuff //
+ * }
+ * int_vec_cleanup(&v);
+ */
+
+/* first allocation size (in elements) */
+#define VEC_MIN_CAPACITY 8
+
+/*
+ * vec_len
+ *
+ *  Return the number of elements of a vector.
+ */
+#define vec_len(v) ((v)->len)
+
+/*
+ * vec_at
+ *
+ *  Access to an element (no bound check).
+ */
+#define vec_at(v, i) ((v)->data[i])
+
+/*
+ * vec_for_each - iterate over a vector
+ * @pos: the type * to use as a loop cursor.
+ * @v:   the vector.
+ */
+#define vec_for_each(pos, v)                                            \
+        for(pos = (v)->data; pos != NULL && pos < (v)->data + (v)->len; ++pos)
+
+/*
+ * VEC_DEFINE
+ *
+ *  Define a vector of type elements:
+ *
+ *  struct name { type *data; size_t len; size_t cap; };
+ *
+ *  void name_init(struct name *v);
+ *  void name_cleanup(struct name *v);
+ *  void name_clear(struct name *v);
+ *  int name_reserve(struct name *v, size_t cap);
+ *  int name_shrink(struct name *v);
+ *  int name_push(struct name *v, type value);
+ *  int name_pop(struct name *v, type *value);
+ *  int name_insert(struct name *v, size_t pos, type value);
+ *  int name_remove(struct name *v, size_t pos, type *value);
+ *  int name_append(struct name *v, const type *values, size_t count);
+ *  void name_sort(struct name *v, cmp);
+ *  type *name_bsearch(const struct name *v, const type *key, cmp);
+ *
+ * - cmp is a qsort() compare function which receives pointers to
+ *   elements (type *);
+ * - name_sort isn't stable (qsort);
+ * - name_pop and name_remove accept a NULL value.
+ */
+#define VEC_DEFINE(name, type)                                          \
+                                                                        \
+struct name {                                                           \
+        type *data;                                                     \
+        size_t len;                                                     \
+        size_t cap;                                                     \
+};                                                                      \
+                                                                        \
+static inline void name##_init(struct name *v)                         \
+{                                                                       \
+        v->data = NULL;                                                 \
+        v->len = 0;                                                     \
+        v->cap = 0;                                                     \
+}                                                                       \
+                                                                        \
+static inline void name##_cleanup(struct name *v)                      \
+{                                                                       \
+        free(v->data);                                                  \
+        name##_init(v);                                                 \
+}                                                                       \
+                                                                        \
+static inline void name##_clear(struct name *v)                        \
+{                                                                       \
+        v->len = 0;                                                     \
+}                                                                       \
+                                                                        \
+static inline int __##name##_realloc(struct name *v, size_t cap)        \
+{                                                                       \
+        type *data;                                                     \
+                                                                        \
+        if(cap > SIZE_MAX / sizeof(type))                               \
+        {                                                               \
+                return -1;                                              \
+        }                                                               \
+                                                                        \
+        data = realloc(v->data, cap * sizeof(type));                    \
+        if(data == NULL)                                                \
+        {                                                               \
+                return -1;                                              \
+        }                                                               \
+                                                                        \
+        v->data = data;                                                 \
+        v->cap = cap;                                                   \
+                                                                        \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+static inline int name##_reserve(struct name *v, size_t cap)           \
+{                                                                       \
+        size_t new_cap;                                                 \
+                                                                        \
+        if(cap <= v->cap)                                               \
+        {                                                               \
+                return 0;                                               \
+        }                                                               \
+                                                                        \
+        /* grow geometrically so push is amortized O(1) */              \
+        new_cap = v->cap < VEC_MIN_CAPACITY ? VEC_MIN_CAPACITY : v->cap; \
+        while(new_cap < cap)                                            \
+        {                                                               \
+                new_cap = new_cap > SIZE_MAX / 2 ? cap : new_cap * 2;   \
+        }                                                               \
+                                                                        \
+        return __##name##_realloc(v, new_cap);                          \
+}                                                                       \
+                                                                        \
+static inline int name##_shrink(struct name *v)                        \
+{                                                                       \
+        if(v->len == v->cap)                                            \
+        {                                                               \
+                return 0;                                               \
+        }                                                               \
+                                                                        \
+        if(v->len == 0)                                                 \
+        {                                                               \
+                name##_cleanup(v);                                      \
+                return 0;                                               \
+        }                                                               \
+                                                                        \
+        return __##name##_realloc(v, v->len);                           \
+}                                                                       \
+                                                                        \
+static inline int name##_push(struct name *v, type value)              \
+{                                                                       \
+        if(v->len == v->cap && name##_reserve(v, v->len + 1) != 0)      \
+        {                                                               \
+                return -1;                                              \
+        }                                                               \
+                                                                        \
+        v->data[v->len++] = value;                                      \
+                                                                        \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+static inline int name##_pop(struct name *v, type *value)              \
+{                                                                       \
+        if(v->len == 0)                                                 \
+        {                                                               \
+                return -1;                                              \
+        }                                                               \
+                                                                        \
+        --v->len;                                                       \
+        if(value != NULL)                                               \
+        {                                                               \
+                *value = v->data[v->len];                               \
+        }                                                               \
+                                                                        \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+static inline int name##_insert(struct name *v, size_t pos, type value) \
+{                                                                       \
+        if(pos > v->len                                                 \
+           || (v->len == v->cap && name##_reserve(v, v->len + 1) != 0)) \
+        {                                                               \
+                return -1;                                              \
+        }                                                               \
+                                                                        \
+        memmove(v->data + pos + 1, v->data + pos,                       \
+                (v->len - pos) * sizeof(type));                         \
+        v->data[pos] = value;                                           \
+        ++v->len;                                                       \
+                                                                        \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+static inline int name##_remove(struct name *v, size_t pos, type *value) \
+{                                                                       \
+        if(pos >= v->len)                                               \
+        {                                                               \
+                return -1;                                              \
+        }                                                               \
+                                                                        \
+        if(value != NULL)                                               \
+        {                                                               \
+                *value = v->data[pos];                                  \
+        }                                                               \
+                                                                        \
+        --v->len;                                                       \
+        memmove(v->data + pos, v->data + pos + 1,                       \
+                (v->len - pos) * sizeof(type));                         \
+                                                                        \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+static inline int name##_append(struct name *v, const type *values,    \
+                                size_t count)                           \
+{                                                                       \
+        if(count == 0)                                                  \
+        {                                                               \
+                return 0;                                               \
+        }                                                               \
+                                                                        \
+        if(count > SIZE_MAX - v->len                                    \
+           || name##_reserve(v, v->len + count) != 0)                   \
+        {                                                               \
+                return -1;                                              \
+        }                                                               \
+                                                                        \
+        memcpy(v->data + v->len, values, count * sizeof(type));         \
+        v->len += count;                                                \
+                                                                        \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+static inline void name##_sort(struct name *v,                         \
+                               int (*cmp)(const void *, const void *))  \
+{                                                                       \
+        if(v->len > 1)                                                  \
+        {                                                               \
+                qsort(v->data, v->len, sizeof(type), cmp);              \
+        }                                                               \
+}                                                                       \
+                                                                        \
+static inline type *name##_bsearch(const struct name *v, const type *key, \
+                                   int (*cmp)(const void *, const void *)) \
+{                                                                       \
+        if(v->len == 0)                                                 \
+        {                                                               \
+                return NULL;                                            \
+        }                                                               \
+                                                                        \
+        return bsearch(key, v->data, v->len, sizeof(type), cmp);        \
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * libflibc_alloc: malloc() and friends counting their calls then
+ * calling the functions of the GNU C library, which are all exported
+ * with a __libc_ prefix. Calls of the C library itself (strdup(),
+ * fopen()...) go through the replaced functions too.
+ */
+
+#include "flibc/alloc.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* no lazy allocation of thread local storage: it would call malloc() */
+static __thread struct alloc_stats alloc_stats
+        __attribute__((tls_model("initial-exec")));
+
+#ifdef HAVE___LIBC_MALLOC
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+extern void __libc_free(void *ptr);
+
+static inline void alloc_count(void *ptr, size_t size)
+{
+        if(ptr != NULL)
+        {
+                ++alloc_stats.allocs;
+                alloc_stats.bytes += size;
+        }
+}
+
+void *malloc(size_t size)
+{
+        void *ptr = __libc_malloc(size);
+
+        alloc_count(ptr, size);
+
+        return ptr;
+}
+
+void *calloc(size_t count, size_t size)
+{
+        void *ptr = __libc_calloc(count, size);
+
+        /* no overflow if ptr isn't NULL */
+        alloc_count(ptr, count * size);
+
+        return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+        void *new_ptr = NULL;
+
+        if(ptr != NULL && size == 0)
+        {
+                ++alloc_stats.frees;
+        }
+
+        new_ptr = __libc_realloc(ptr, size);
+        alloc_count(new_ptr, size);
+
+        return new_ptr;
+}
+
+void free(void *ptr)
+{
+        if(ptr != NULL)
+        {
+                ++alloc_stats.frees;
+        }
+
+        __libc_free(ptr);
+}
+
+void *memalign(size_t align, size_t size)
+{
+        void *ptr = __libc_memalign(align, size);
+
+        alloc_count(ptr, size);
+
+        return ptr;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+        return memalign(align, size);
+}
+
+int posix_memalign(void **ptr, size_t align, size_t size)
+{
+        void *new_ptr = NULL;
+
+        if(align < sizeof(void *) || (align & (align - 1)) != 0)
+        {
+                return EINVAL;
+        }
+
+        new_ptr = memalign(align, size);
+        if(new_ptr == NULL)
+        {
+                return ENOMEM;
+        }
+
+        *ptr = new_ptr;
+
+        return 0;
+}
+
+int alloc_tracking(void)
+{
+        return 1;
+}
+
+#else
+
+int alloc_tracking(void)
+{
+        return 0;
+}
+
+#endif
+
+void alloc_stats_get(struct alloc_stats *stats)
+{
+        *stats = alloc_stats;
+}
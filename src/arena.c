@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct arena_chunk {
+        struct arena_chunk *prev;
+        /* size of the chunk (with this header) */
+        size_t size;
+        int mmapped;
+};
+
+/* data of chunks starts after the header, aligned on ARENA_ALIGN */
+#define ARENA_CHUNK_HEADER                                              \
+        ((sizeof(struct arena_chunk) + ARENA_ALIGN - 1)                 \
+         & ~(size_t) (ARENA_ALIGN - 1))
+
+static size_t arena_round_up(size_t value, size_t align)
+{
+        return (value + align - 1) & ~(align - 1);
+}
+
+static struct arena_chunk *arena_chunk_new(struct arena *arena,
+                                           size_t min_size)
+{
+        struct arena_chunk *chunk = NULL;
+        size_t size = arena->chunk_size;
+        void *mem = NULL;
+
+        if(min_size > size - ARENA_CHUNK_HEADER)
+        {
+                /* a big allocation gets its own chunk */
+                if(min_size > SIZE_MAX / 2)
+                {
+                        return NULL;
+                }
+                size = arena_round_up(ARENA_CHUNK_HEADER + min_size, 4096);
+        }
+
+        if(arena->flags & ARENA_HUGEPAGE)
+        {
+                size = arena_round_up(size, ARENA_HUGEPAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+                /* reserved huge pages */
+                mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if(mem != MAP_FAILED)
+                {
+                        chunk = mem;
+                        chunk->mmapped = 1;
+                        goto ex_on_alloc;
+                }
+#endif
+
+                /* transparent huge pages */
+                if(posix_memalign(&mem, ARENA_HUGEPAGE_SIZE, size) != 0)
+                {
+                        return NULL;
+                }
+#ifdef MADV_HUGEPAGE
+                madvise(mem, size, MADV_HUGEPAGE);
+#endif
+        }
+        else
+        {
+                mem = malloc(size);
+                if(mem == NULL)
+                {
+                        return NULL;
+                }
+        }
+
+        chunk = mem;
+        chunk->mmapped = 0;
+
+ex_on_alloc:
+        chunk->size = size;
+        chunk->prev = NULL;
+
+        return chunk;
+}
+
+static void arena_chunk_free(struct arena_chunk *chunk)
+{
+        if(chunk->mmapped)
+        {
+                munmap(chunk, chunk->size);
+        }
+        else
+        {
+                free(chunk);
+        }
+}
+
+/* keep chunks of the default size for reuse, free the others */
+static void arena_chunk_release(struct arena *arena,
+                                struct arena_chunk *chunk)
+{
+        if(chunk->size == arena->chunk_size)
+        {
+                chunk->prev = arena->spare;
+                arena->spare = chunk;
+        }
+        else
+        {
+                arena_chunk_free(chunk);
+        }
+}
+
+static void arena_chunk_use(struct arena *arena, struct arena_chunk *chunk)
+{
+        arena->chunk = chunk;
+        arena->pos = (char *) chunk + ARENA_CHUNK_HEADER;
+        arena->end = (char *) chunk + chunk->size;
+}
+
+int arena_init(struct arena *arena, size_t chunk_size, int flags)
+{
+        struct arena_chunk *chunk = NULL;
+
+        if(chunk_size == 0)
+        {
+                chunk_size = ARENA_CHUNK_SIZE;
+        }
+
+        if(chunk_size < 2 * ARENA_CHUNK_HEADER || chunk_size > SIZE_MAX / 2)
+        {
+                return -1;
+        }
+
+        if(flags & ARENA_HUGEPAGE)
+        {
+                chunk_size = arena_round_up(chunk_size, ARENA_HUGEPAGE_SIZE);
+        }
+
+        arena->chunk_size = chunk_size;
+        arena->flags = flags;
+        arena->spare = NULL;
+
+        chunk = arena_chunk_new(arena, 0);
+        if(chunk == NULL)
+        {
+                return -1;
+        }
+
+        arena_chunk_use(arena, chunk);
+
+        return 0;
+}
+
+void arena_cleanup(struct arena *arena)
+{
+        struct arena_chunk *chunk = NULL;
+
+        while((chunk = arena->chunk) != NULL)
+        {
+                arena->chunk = chunk->prev;
+                arena_chunk_free(chunk);
+        }
+
+        while((chunk = arena->spare) != NULL)
+        {
+                arena->spare = chunk->prev;
+                arena_chunk_free(chunk);
+        }
+
+        arena->pos = NULL;
+        arena->end = NULL;
+}
+
+void arena_reset(struct arena *arena)
+{
+        struct arena_chunk *chunk = arena->chunk;
+
+        /* keep the first chunk */
+        while(chunk->prev != NULL)
+        {
+                arena->chunk = chunk->prev;
+                arena_chunk_release(arena, chunk);
+                chunk = arena->chunk;
+        }
+
+        arena_chunk_use(arena, chunk);
+}
+
+void arena_restore(struct arena *arena, const struct arena_mark *mark)
+{
+        struct arena_chunk *chunk = NULL;
+
+        while(arena->chunk != mark->chunk)
+        {
+                chunk = arena->chunk;
+                arena->chunk = chunk->prev;
+                arena_chunk_release(arena, chunk);
+        }
+
+        arena->pos = mark->pos;
+        arena->end = (char *) arena->chunk + arena->chunk->size;
+}
+
+void *__arena_alloc_slow(struct arena *arena, size_t size, size_t align)
+{
+        struct arena_chunk *chunk = arena->spare;
+        size_t min_size;
+
+        if(size > SIZE_MAX / 2 || align > ARENA_HUGEPAGE_SIZE)
+        {
+                return NULL;
+        }
+
+        /* data of a chunk is aligned on ARENA_ALIGN */
+        min_size = size + (align > ARENA_ALIGN ? align : 0);
+
+        if(chunk != NULL && min_size <= chunk->size - ARENA_CHUNK_HEADER)
+        {
+                arena->spare = chunk->prev;
+        }
+        else
+        {
+                chunk = arena_chunk_new(arena, min_size);
+                if(chunk == NULL)
+                {
+                        return NULL;
+                }
+        }
+
+        chunk->prev = arena->chunk;
+        arena_chunk_use(arena, chunk);
+
+        return arena_alloc_align(arena, size, align);
+}
+
+void *arena_zalloc(struct arena *arena, size_t size)
+{
+        void *mem = arena_alloc(arena, size);
+
+        if(mem != NULL)
+        {
+                memset(mem, 0, size);
+        }
+
+        return mem;
+}
+
+static char *arena_memdup_str(struct arena *arena, const char *str,
+                              size_t len)
+{
+        char *copy = arena_alloc_align(arena, len + 1, 1);
+
+        if(copy != NULL)
+        {
+                memcpy(copy, str, len);
+                copy[len] = '\0';
+        }
+
+        return copy;
+}
+
+char *arena_strndup(struct arena *arena, const char *str, size_t n)
+{
+        return arena_memdup_str(arena, str, strnlen(str, n));
+}
+
+char *arena_strdup(struct arena *arena, const char *str)
+{
+        return arena_memdup_str(arena, str, strlen(str));
+}
+
+char *arena_vprintf(struct arena *arena, const char *fmt, va_list args)
+{
+        size_t avail = (size_t) (arena->end - arena->pos);
+        char *str = arena->pos;
+        va_list copy;
+        int len;
+
+        /* try to format in place first */
+        va_copy(copy, args);
+        len = vsnprintf(str, avail, fmt, copy);
+        va_end(copy);
+
+        if(len < 0)
+        {
+                return NULL;
+        }
+
+        if((size_t) len < avail)
+        {
+                arena->pos += len + 1;
+                return str;
+        }
+
+        str = arena_alloc_align(arena, (size_t) len + 1, 1);
+        if(str != NULL)
+        {
+                vsnprintf(str, (size_t) len + 1, fmt, args);
+        }
+
+        return str;
+}
+
+char *arena_printf(struct arena *arena, const char *fmt, ...)
+{
+        va_list args;
+        char *str;
+
+        va_start(args, fmt);
+        str = arena_vprintf(arena, fmt, args);
+        va_end(args);
+
+        return str;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/hash.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+int hash_init(struct hash_table *table, unsigned int bits)
+{
+        if(bits == 0)
+        {
+                bits = 1;
+        }
+
+        table->buckets = calloc((size_t)1 << bits, sizeof(*table->buckets));
+        if(table->buckets == NULL)
+        {
+                return -1;
+        }
+
+        table->old_buckets = NULL;
+        table->bits = bits;
+        table->old_bits = 0;
+        table->old_pos = 0;
+        table->count = 0;
+
+        return 0;
+}
+
+void hash_cleanup(struct hash_table *table)
+{
+        free(table->buckets);
+        free(table->old_buckets);
+
+        table->buckets = NULL;
+        table->old_buckets = NULL;
+        table->count = 0;
+}
+
+static inline struct hlist_head *hash_head(struct hash_table *table,
+                                           uint64_t key)
+{
+        return &table->buckets[hash_64(key, table->bits)];
+}
+
+/*
+ * Move nodes of an old bucket in the new buckets
+ */
+static void hash_move(struct hash_table *table, struct hlist_head *old)
+{
+        struct hlist_node *pos = NULL,
+                *n = NULL;
+        struct hash_node *node = NULL;
+
+        hlist_for_each_safe(pos, n, old)
+        {
+                node = hlist_entry(pos, struct hash_node, node);
+                __hlist_del(pos);
+                hlist_add_head(pos, hash_head(table, node->key));
+        }
+}
+
+static void hash_rehash(struct hash_table *table, size_t steps)
+{
+        size_t old_size = (size_t)1 << table->old_bits;
+
+        while(steps-- > 0 && table->old_pos < old_size)
+        {
+                hash_move(table, &table->old_buckets[table->old_pos++]);
+        }
+
+        if(table->old_pos == old_size)
+        {
+                free(table->old_buckets);
+                table->old_buckets = NULL;
+        }
+}
+
+/*
+ * Only start to grow: nodes are moved later by hash_rehash()
+ */
+static void hash_grow(struct hash_table *table)
+{
+        struct hlist_head *buckets = NULL;
+
+        buckets = calloc((size_t)2 << table->bits, sizeof(*buckets));
+        if(buckets == NULL)
+        {
+                return;
+        }
+
+        table->old_buckets = table->buckets;
+        table->old_bits = table->bits;
+        table->old_pos = 0;
+
+        table->buckets = buckets;
+        ++table->bits;
+}
+
+void hash_add(struct hash_table *table, struct hash_node *node, uint64_t key)
+{
+        /* all nodes are moved before the table is full again */
+        if(table->old_buckets != NULL)
+        {
+                hash_rehash(table, HASH_REHASH_STEP);
+        }
+        else if(table->count >= (size_t)1 << table->bits
+                && table->bits < sizeof(size_t) * 8 - 1)
+        {
+                hash_grow(table);
+        }
+
+        node->key = key;
+        hlist_add_head(&node->node, hash_head(table, key));
+        ++table->count;
+}
+
+void hash_del(struct hash_table *table, struct hash_node *node)
+{
+        /* don't move nodes here: it is used while iterating the table */
+        hlist_del_init(&node->node);
+        --table->count;
+}
+
+struct hlist_head *__hash_bucket(struct hash_table *table, uint64_t key)
+{
+        size_t idx;
+
+        if(table->old_buckets != NULL)
+        {
+                idx = (size_t)hash_64(key, table->old_bits);
+                if(idx >= table->old_pos)
+                {
+                        hash_move(table, &table->old_buckets[idx]);
+                }
+        }
+
+        return hash_head(table, key);
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/heap.h"
+
+#include <stdlib.h>
+
+/* initial size of the array */
+#define HEAP_MIN_SIZE 16
+
+static inline void heap_set(struct heap *heap, unsigned int index,
+                            struct heap_node *node)
+{
+        heap->nodes[index] = node;
+        node->index = index;
+}
+
+static void heap_sift_up(struct heap *heap, unsigned int index)
+{
+        struct heap_node *node = heap->nodes[index];
+        unsigned int parent;
+
+        while(index > 0)
+        {
+                parent = (index - 1) / HEAP_ARITY;
+                if(!heap->less(node, heap->nodes[parent]))
+                {
+                        break;
+                }
+
+                heap_set(heap, index, heap->nodes[parent]);
+                index = parent;
+        }
+
+        heap_set(heap, index, node);
+}
+
+static void heap_sift_down(struct heap *heap, unsigned int index)
+{
+        struct heap_node *node = heap->nodes[index];
+        unsigned int child,
+                last,
+                best;
+
+        for(;;)
+        {
+                child = index * HEAP_ARITY + 1;
+                if(child >= heap->count)
+                {
+                        break;
+                }
+
+                last = heap->count - child > HEAP_ARITY
+                        ? child + HEAP_ARITY : heap->count;
+
+                /* smallest child */
+                best = child;
+                for(++child; child < last; ++child)
+                {
+                        if(heap->less(heap->nodes[child], heap->nodes[best]))
+                        {
+                                best = child;
+                        }
+                }
+
+                if(!heap->less(heap->nodes[best], node))
+                {
+                        break;
+                }
+
+                heap_set(heap, index, heap->nodes[best]);
+                index = best;
+        }
+
+        heap_set(heap, index, node);
+}
+
+void heap_init(struct heap *heap, heap_less_func_t less)
+{
+        heap->nodes = NULL;
+        heap->count = 0;
+        heap->size = 0;
+        heap->less = less;
+}
+
+void heap_cleanup(struct heap *heap)
+{
+        free(heap->nodes);
+        heap->nodes = NULL;
+        heap->count = 0;
+        heap->size = 0;
+}
+
+int heap_reserve(struct heap *heap, unsigned int count)
+{
+        struct heap_node **nodes = NULL;
+
+        if(count <= heap->size)
+        {
+                return 0;
+        }
+
+        /* the last index must not overflow when computing children */
+        if(count > (HEAP_NODE_NONE - 1) / HEAP_ARITY)
+        {
+                return -1;
+        }
+
+        nodes = realloc(heap->nodes, count * sizeof(*nodes));
+        if(nodes == NULL)
+        {
+                return -1;
+        }
+
+        heap->nodes = nodes;
+        heap->size = count;
+
+        return 0;
+}
+
+int heap_insert(struct heap *heap, struct heap_node *node)
+{
+        unsigned int size;
+
+        if(heap->count == heap->size)
+        {
+                size = heap->size ? heap->size * 2 : HEAP_MIN_SIZE;
+                if(size < heap->size || heap_reserve(heap, size) != 0)
+                {
+                        return -1;
+                }
+        }
+
+        heap->nodes[heap->count] = node;
+        heap_sift_up(heap, heap->count++);
+
+        return 0;
+}
+
+struct heap_node *heap_pop(struct heap *heap)
+{
+        struct heap_node *top = heap_top(heap);
+
+        if(top != NULL)
+        {
+                heap_remove(heap, top);
+        }
+
+        return top;
+}
+
+void heap_remove(struct heap *heap, struct heap_node *node)
+{
+        unsigned int index = node->index;
+        struct heap_node *last = heap->nodes[--heap->count];
+
+        node->index = HEAP_NODE_NONE;
+        if(index == heap->count)
+        {
+                return;
+        }
+
+        /* the last node takes the place of the removed one */
+        heap_set(heap, index, last);
+        heap_update(heap, last);
+}
+
+void heap_decrease(struct heap *heap, struct heap_node *node)
+{
+        heap_sift_up(heap, node->index);
+}
+
+void heap_update(struct heap *heap, struct heap_node *node)
+{
+        unsigned int index = node->index;
+
+        if(index > 0
+           && heap->less(node, heap->nodes[(index - 1) / HEAP_ARITY]))
+        {
+                heap_sift_up(heap, index);
+        }
+        else
+        {
+                heap_sift_down(heap, index);
+        }
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/list_sort.h"
+
+#include <stddef.h>
+
+/*
+ * Merge two null-terminated singly linked lists (prev links are
+ * ignored). On equal items, a is first.
+ */
+static struct list_head *merge(void *priv, list_cmp_func_t cmp,
+                               struct list_head *a, struct list_head *b)
+{
+        struct list_head *head = NULL,
+                **tail = &head;
+
+        for(;;)
+        {
+                if(cmp(priv, a, b) <= 0)
+                {
+                        *tail = a;
+                        tail = &a->next;
+                        a = a->next;
+                        if(a == NULL)
+                        {
+                                *tail = b;
+                                break;
+                        }
+                }
+                else
+                {
+                        *tail = b;
+                        tail = &b->next;
+                        b = b->next;
+                        if(b == NULL)
+                        {
+                                *tail = a;
+                                break;
+                        }
+                }
+        }
+
+        return head;
+}
+
+/*
+ * Last merge: also restore prev links and make the list circular
+ * again with head.
+ */
+static void merge_final(void *priv, list_cmp_func_t cmp,
+                        struct list_head *head,
+                        struct list_head *a, struct list_head *b)
+{
+        struct list_head *tail = head;
+
+        for(;;)
+        {
+                if(cmp(priv, a, b) <= 0)
+                {
+                        tail->next = a;
+                        a->prev = tail;
+                        tail = a;
+                        a = a->next;
+                        if(a == NULL)
+                        {
+                                break;
+                        }
+                }
+                else
+                {
+                        tail->next = b;
+                        b->prev = tail;
+                        tail = b;
+                        b = b->next;
+                        if(b == NULL)
+                        {
+                                b = a;
+                                break;
+                        }
+                }
+        }
+
+        /* link the remaining items */
+        tail->next = b;
+        do
+        {
+                b->prev = tail;
+                tail = b;
+                b = b->next;
+        } while(b != NULL);
+
+        tail->next = head;
+        head->prev = tail;
+}
+
+/*
+ * Bottom-up merge sort: items are added one by one to a stack of
+ * pending sorted sublists (linked by their prev pointer), whose sizes
+ * are powers of 2. Two sublists of the same size are merged when a
+ * third one of this size is about to be made (so merges stay balanced,
+ * 2:1 at worst, and the pending sublists fit in cache). The bits of
+ * count tell which sublists to merge.
+ */
+void list_sort(void *priv, struct list_head *head, list_cmp_func_t cmp)
+{
+        struct list_head *list = head->next,
+                *pending = NULL;
+        size_t count = 0;
+
+        /* zero or one item */
+        if(list == head->prev)
+        {
+                return;
+        }
+
+        /* null terminate the list */
+        head->prev->next = NULL;
+
+        do
+        {
+                size_t bits;
+                struct list_head **tail = &pending;
+
+                /* find the least significant clear bit of count */
+                for(bits = count; bits & 1; bits >>= 1)
+                {
+                        tail = &(*tail)->prev;
+                }
+
+                /* merge the two sublists of this size, if any */
+                if(bits != 0)
+                {
+                        struct list_head *a = *tail,
+                                *b = a->prev;
+
+                        a = merge(priv, cmp, b, a);
+                        a->prev = b->prev;
+                        *tail = a;
+                }
+
+                /* push the next item as a sublist of size 1 */
+                list->prev = pending;
+                pending = list;
+                list = list->next;
+                pending->next = NULL;
+                ++count;
+        } while(list != NULL);
+
+        /* merge all pending sublists, the most recent first */
+        list = pending;
+        pending = pending->prev;
+        for(;;)
+        {
+                struct list_head *next = pending->prev;
+
+                if(next == NULL)
+                {
+                        break;
+                }
+
+                list = merge(priv, cmp, pending, list);
+                pending = next;
+        }
+
+        merge_final(priv, cmp, head, pending, list);
+}
+
+void list_merge(void *priv, struct list_head *head, struct list_head *list,
+                list_cmp_func_t cmp)
+{
+        struct list_head *pos = head->next,
+                *node = NULL,
+                *next = NULL;
+
+        list_for_each_safe(node, next, list)
+        {
+                /* items of head equal to node stay before it */
+                while(pos != head && cmp(priv, pos, node) <= 0)
+                {
+                        pos = pos->next;
+                }
+
+                /* insert node before pos */
+                list_add_tail(node, pos);
+        }
+
+        INIT_LIST_HEAD(list);
+}
@@ -0,0 +1,1751 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for sendmmsg() and program_invocation_short_name */
+#define _GNU_SOURCE
+
+#include "flibc/log.h"
+#include "flibc/io.h"
+#include "flibc/list.h"
+#include "flibc/math.h"
+#include "flibc/str.h"
+#include "flibc/flibc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#if defined(CLOCK_REALTIME_COARSE)
+ #define LOG_CLOCK CLOCK_REALTIME_COARSE
+#else
+ #define LOG_CLOCK CLOCK_REALTIME
+#endif
+
+static unsigned long long log_clock_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (unsigned long long)ts.tv_sec * 1000000000ULL
+                + (unsigned long long)ts.tv_nsec;
+}
+
+/*
+ * Per-thread timestamp cache. sec is the second already rendered
+ * in buf (-1 means nothing rendered yet). bsd ("Mmm dd hh:mm:ss") and
+ * tz ("+hh:mm") are rendered at the same time for the syslog client.
+ */
+struct log_timestamp_cache {
+        time_t sec;
+        char buf[LOG_TIMESTAMP_LEN + 1];
+        char bsd[16];
+        char tz[7];
+};
+
+static __thread struct log_timestamp_cache log_ts_cache = { -1, "", "", "" };
+
+static void log_timestamp_render(struct log_timestamp_cache *cache,
+                                 time_t sec)
+{
+        static const char *months[] = {
+                "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+        };
+        struct tm tm;
+        unsigned long off;
+
+        memset(&tm, 0, sizeof(tm));
+        if(localtime_r(&sec, &tm) == NULL
+           || strftime(cache->buf, sizeof(cache->buf),
+                       "%Y-%m-%dT%H:%M:%S", &tm) == 0)
+        {
+                memset(cache->buf, '0', LOG_TIMESTAMP_LEN - 4);
+        }
+
+        cache->buf[LOG_TIMESTAMP_LEN - 4] = '.';
+        cache->buf[LOG_TIMESTAMP_LEN] = '\0';
+
+        /* month names of RFC 3164 doesn't depend on locale */
+        snprintf(cache->bsd, sizeof(cache->bsd), "%s %2d %02d:%02d:%02d",
+                 months[(unsigned int)tm.tm_mon % 12], tm.tm_mday,
+                 tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+        off = (unsigned long)(tm.tm_gmtoff < 0 ? -tm.tm_gmtoff
+                              : tm.tm_gmtoff) / 60;
+        snprintf(cache->tz, sizeof(cache->tz), "%c%02lu:%02lu",
+                 tm.tm_gmtoff < 0 ? '-' : '+', off / 60 % 100, off % 60);
+
+        cache->sec = sec;
+}
+
+static struct log_timestamp_cache *log_timestamp_update(void)
+{
+        struct log_timestamp_cache *cache = &log_ts_cache;
+        struct timespec ts;
+        unsigned int ms;
+
+        if(clock_gettime(LOG_CLOCK, &ts) != 0)
+        {
+                ts.tv_sec = time(NULL);
+                ts.tv_nsec = 0;
+        }
+
+        if(ts.tv_sec != cache->sec)
+        {
+                log_timestamp_render(cache, ts.tv_sec);
+        }
+
+        ms = (unsigned int)(ts.tv_nsec / 1000000);
+        cache->buf[LOG_TIMESTAMP_LEN - 3] = (char)('0' + ms / 100);
+        cache->buf[LOG_TIMESTAMP_LEN - 2] = (char)('0' + ms / 10 % 10);
+        cache->buf[LOG_TIMESTAMP_LEN - 1] = (char)('0' + ms % 10);
+
+        return cache;
+}
+
+const char *log_timestamp(void)
+{
+        return log_timestamp_update()->buf;
+}
+
+/*
+ * Structured logging
+ */
+struct log_kv_logger log_kv_default = { -1, LOG_KV_LOGFMT, 0, "" };
+
+static const char *log_level_names[] = {
+        "emerg", "alert", "crit", "err",
+        "warning", "notice", "info", "debug",
+};
+
+/*
+ * Room kept at end of a line for the closing caracters and
+ * the "truncated" field
+ */
+#define LOG_KV_TAIL_SIZE 32
+
+/*
+ * Output buffer of the structured formatter. end is the
+ * limit for the content, not the end of the memory.
+ */
+struct log_kv_buf {
+        char *p;
+        char *end;
+};
+
+static int log_kv_put(struct log_kv_buf *buf, const char *s, size_t len)
+{
+        if(len > (size_t)(buf->end - buf->p))
+        {
+                return -1;
+        }
+
+        memcpy(buf->p, s, len);
+        buf->p += len;
+
+        return 0;
+}
+
+static int log_kv_putc(struct log_kv_buf *buf, char c)
+{
+        if(buf->p == buf->end)
+        {
+                return -1;
+        }
+
+        *buf->p++ = c;
+
+        return 0;
+}
+
+/*
+ * Put as much as possible of s, without cutting an UTF-8 sequence
+ */
+static int log_kv_put_partial(struct log_kv_buf *buf, const char *s,
+                              size_t len)
+{
+        size_t room = (size_t)(buf->end - buf->p);
+
+        if(len <= room)
+        {
+                return log_kv_put(buf, s, len);
+        }
+
+        log_kv_put(buf, s, str_utf8_truncate(s, len, room));
+
+        return -1;
+}
+
+static int log_kv_puts(struct log_kv_buf *buf, const char *s)
+{
+        return log_kv_put(buf, s, strlen(s));
+}
+
+static int log_kv_put_uint(struct log_kv_buf *buf, unsigned long long u)
+{
+        char tmp[24];
+        char *p = tmp + sizeof(tmp);
+
+        do
+        {
+                *--p = (char)('0' + u % 10);
+                u /= 10;
+        }
+        while(u != 0);
+
+        return log_kv_put(buf, p, (size_t)(tmp + sizeof(tmp) - p));
+}
+
+static int log_kv_put_int(struct log_kv_buf *buf, long long i)
+{
+        if(i < 0)
+        {
+                if(log_kv_putc(buf, '-') != 0)
+                {
+                        return -1;
+                }
+
+                return log_kv_put_uint(buf, 0ULL - (unsigned long long)i);
+        }
+
+        return log_kv_put_uint(buf, (unsigned long long)i);
+}
+
+/*
+ * logfmt values are quoted only when needed
+ */
+static int log_kv_needs_quote(const char *s)
+{
+        if(*s == '\0')
+        {
+                return 1;
+        }
+
+        for(; *s != '\0'; ++s)
+        {
+                if((unsigned char)*s <= ' ' || *s == '=' || *s == '"'
+                   || *s == '\\' || *s == 0x7f)
+                {
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+/*
+ * Put an escaped string (without quotes). Stop at the first
+ * caracter which doesn't fit (never in the middle of an escape sequence).
+ */
+static int log_kv_put_escaped(struct log_kv_buf *buf, const char *s)
+{
+        static const char hex[] = "0123456789abcdef";
+        const char *run = s;
+        char esc[6];
+        size_t esc_len;
+
+        for(; *s != '\0'; ++s)
+        {
+                unsigned char c = (unsigned char)*s;
+
+                if(c >= 0x20 && c != '"' && c != '\\')
+                {
+                        continue;
+                }
+
+                if(log_kv_put_partial(buf, run, (size_t)(s - run)) != 0)
+                {
+                        return -1;
+                }
+
+                esc[0] = '\\';
+                esc_len = 2;
+                switch(c)
+                {
+                case '"': esc[1] = '"'; break;
+                case '\\': esc[1] = '\\'; break;
+                case '\n': esc[1] = 'n'; break;
+                case '\r': esc[1] = 'r'; break;
+                case '\t': esc[1] = 't'; break;
+                default:
+                        esc[1] = 'u';
+                        esc[2] = '0';
+                        esc[3] = '0';
+                        esc[4] = hex[c >> 4];
+                        esc[5] = hex[c & 0xf];
+                        esc_len = 6;
+                        break;
+                }
+
+                if(log_kv_put(buf, esc, esc_len) != 0)
+                {
+                        return -1;
+                }
+
+                run = s + 1;
+        }
+
+        return log_kv_put_partial(buf, run, (size_t)(s - run));
+}
+
+static int log_kv_put_string(struct log_kv_buf *buf,
+                             enum log_kv_format format, const char *s)
+{
+        if(s == NULL)
+        {
+                return log_kv_puts(buf, format == LOG_KV_JSON ? "null" : "");
+        }
+
+        if(format == LOG_KV_LOGFMT && !log_kv_needs_quote(s))
+        {
+                return log_kv_puts(buf, s);
+        }
+
+        if(log_kv_putc(buf, '"') != 0
+           || log_kv_put_escaped(buf, s) != 0)
+        {
+                return -1;
+        }
+
+        return log_kv_putc(buf, '"');
+}
+
+static int log_kv_put_double(struct log_kv_buf *buf,
+                             enum log_kv_format format, double d)
+{
+        char tmp[32];
+        int len;
+
+        if(format == LOG_KV_JSON && !isfinite(d))
+        {
+                return log_kv_puts(buf, "null");
+        }
+
+        len = snprintf(tmp, sizeof(tmp), "%.15g", d);
+        if(len < 0 || (size_t)len >= sizeof(tmp))
+        {
+                return -1;
+        }
+
+        return log_kv_put(buf, tmp, (size_t)len);
+}
+
+/*
+ * Put the separator and the key of a field (quoted and escaped like
+ * a string value)
+ */
+static int log_kv_put_key(struct log_kv_buf *buf,
+                          enum log_kv_format format, const char *key)
+{
+        if(log_kv_putc(buf, format == LOG_KV_JSON ? ',' : ' ') != 0
+           || log_kv_put_string(buf, format, key) != 0)
+        {
+                return -1;
+        }
+
+        return log_kv_putc(buf, format == LOG_KV_JSON ? ':' : '=');
+}
+
+static int log_kv_put_field(struct log_kv_buf *buf,
+                            enum log_kv_format format,
+                            const struct log_kv *kv)
+{
+        if(log_kv_put_key(buf, format, kv->key) != 0)
+        {
+                return -1;
+        }
+
+        switch(kv->type)
+        {
+        case LOG_KV_STR:
+                return log_kv_put_string(buf, format, kv->v.s);
+        case LOG_KV_INT:
+                return log_kv_put_int(buf, kv->v.i);
+        case LOG_KV_UINT:
+                return log_kv_put_uint(buf, kv->v.u);
+        case LOG_KV_DOUBLE:
+                return log_kv_put_double(buf, format, kv->v.d);
+        case LOG_KV_BOOL:
+                return log_kv_puts(buf, kv->v.i ? "true" : "false");
+        default:
+                return -1;
+        }
+}
+
+int log_kv_logger_init(struct log_kv_logger *logger, int fd,
+                       enum log_kv_format format,
+                       const struct log_kv *fields, size_t count)
+{
+        struct log_kv_buf buf;
+        size_t i;
+
+        logger->fd = fd;
+        logger->format = format;
+        logger->fields_len = 0;
+        logger->fields[0] = '\0';
+
+        buf.p = logger->fields;
+        buf.end = logger->fields + sizeof(logger->fields) - 1;
+
+        for(i = 0; i < count; ++i)
+        {
+                if(log_kv_put_field(&buf, format, &fields[i]) != 0)
+                {
+                        return -1;
+                }
+        }
+
+        *buf.p = '\0';
+        logger->fields_len = (size_t)(buf.p - logger->fields);
+
+        return 0;
+}
+
+int log_kv_write(struct log_kv_logger *logger, int priority, const char *msg,
+                 const struct log_kv *fields, size_t count)
+{
+        char line[LOG_KV_LINE_SIZE];
+        struct log_kv_buf buf;
+        enum log_kv_format format = logger->format;
+        int truncated = 0;
+        char *mark = NULL;
+        unsigned long long start;
+        size_t i;
+
+        buf.p = line;
+        buf.end = line + sizeof(line) - LOG_KV_TAIL_SIZE;
+
+        /* the head of the line always fits: ts and level are short */
+        if(format == LOG_KV_JSON)
+        {
+                log_kv_putc(&buf, '{');
+        }
+
+        if(logger->fd >= 0)
+        {
+                log_kv_puts(&buf, format == LOG_KV_JSON ? "\"ts\":\"" : "ts=");
+                log_kv_put(&buf, log_timestamp(), LOG_TIMESTAMP_LEN);
+                log_kv_puts(&buf, format == LOG_KV_JSON ? "\"," : " ");
+        }
+
+        log_kv_puts(&buf, format == LOG_KV_JSON ? "\"level\":\"" : "level=");
+        log_kv_puts(&buf, log_level_names[LOG_PRI(priority)]);
+        log_kv_puts(&buf, format == LOG_KV_JSON ? "\"" : "");
+
+        /*
+         * The message is always quoted and cut if too long: its closing
+         * quote is kept out of the room given to it.
+         */
+        --buf.end;
+        if(log_kv_put_key(&buf, format, "msg") != 0
+           || log_kv_putc(&buf, '"') != 0
+           || log_kv_put_escaped(&buf, msg != NULL ? msg : "") != 0)
+        {
+                truncated = 1;
+        }
+        ++buf.end;
+        log_kv_putc(&buf, '"');
+
+        /* static fields then fields of the line */
+        if(!truncated
+           && log_kv_put(&buf, logger->fields, logger->fields_len) != 0)
+        {
+                truncated = 1;
+        }
+
+        for(i = 0; i < count && !truncated; ++i)
+        {
+                mark = buf.p;
+                if(log_kv_put_field(&buf, format, &fields[i]) != 0)
+                {
+                        buf.p = mark;
+                        truncated = 1;
+                }
+        }
+
+        /* now use the tail */
+        buf.end = line + sizeof(line);
+
+        if(truncated)
+        {
+                log_kv_puts(&buf, format == LOG_KV_JSON
+                            ? ",\"truncated\":true" : " truncated=true");
+        }
+
+        if(format == LOG_KV_JSON)
+        {
+                log_kv_putc(&buf, '}');
+        }
+
+        if(logger->fd < 0)
+        {
+                *buf.p = '\0';
+                start = log_clock_ns();
+                syslog(priority, "%s", line);
+                log_stats_record(priority, (size_t)(buf.p - line),
+                                 log_clock_ns() - start);
+                return 0;
+        }
+
+        log_kv_putc(&buf, '\n');
+
+        start = log_clock_ns();
+        if(io_write(logger->fd, line, (size_t)(buf.p - line))
+           != buf.p - line)
+        {
+                log_stats_drop();
+                return -1;
+        }
+        log_stats_record(priority, (size_t)(buf.p - line),
+                         log_clock_ns() - start);
+
+        return 0;
+}
+
+/*
+ * Counters
+ *
+ * Each thread has its own counters block, registered in log_stats_threads
+ * at its first message. Only the owner thread writes in it, so relaxed
+ * load + store is enough (no read-modify-write, no lock). Snapshots read
+ * the blocks under log_stats_lock, which only protects the registry.
+ * When a thread ends, its counters are added to log_stats_retired.
+ */
+struct log_stats_thread {
+        struct list_head node;
+        _Atomic unsigned long long messages[LOG_STATS_LEVELS];
+        _Atomic unsigned long long bytes[LOG_STATS_LEVELS];
+        _Atomic unsigned long long drops;
+        _Atomic unsigned long long latency[LOG_STATS_LATENCY_BUCKETS];
+};
+
+static pthread_mutex_t log_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static LIST_HEAD(log_stats_threads);
+static struct log_stats log_stats_retired;
+static struct log_stats log_stats_base;
+
+static pthread_once_t log_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_stats_key;
+static __thread struct log_stats_thread *log_stats_self;
+
+static _Atomic unsigned int log_stats_report_period;
+static _Atomic unsigned long long log_stats_report_next;
+static __thread int log_stats_reporting;
+
+static inline void log_stats_inc(_Atomic unsigned long long *counter,
+                                 unsigned long long value)
+{
+        atomic_store_explicit(counter,
+                              atomic_load_explicit(counter,
+                                                   memory_order_relaxed)
+                              + value,
+                              memory_order_relaxed);
+}
+
+static inline unsigned long long
+log_stats_get(_Atomic unsigned long long *counter)
+{
+        return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void log_stats_add(struct log_stats *stats,
+                          struct log_stats_thread *self)
+{
+        unsigned int i;
+
+        for(i = 0; i < LOG_STATS_LEVELS; ++i)
+        {
+                stats->messages[i] += log_stats_get(&self->messages[i]);
+                stats->bytes[i] += log_stats_get(&self->bytes[i]);
+        }
+
+        stats->drops += log_stats_get(&self->drops);
+
+        for(i = 0; i < LOG_STATS_LATENCY_BUCKETS; ++i)
+        {
+                stats->latency[i] += log_stats_get(&self->latency[i]);
+        }
+}
+
+static void log_stats_thread_exit(void *arg)
+{
+        struct log_stats_thread *self = arg;
+
+        pthread_mutex_lock(&log_stats_lock);
+        log_stats_add(&log_stats_retired, self);
+        list_del(&self->node);
+        pthread_mutex_unlock(&log_stats_lock);
+
+        free(self);
+}
+
+static void log_stats_init(void)
+{
+        pthread_key_create(&log_stats_key, log_stats_thread_exit);
+}
+
+static struct log_stats_thread *log_stats_thread_get(void)
+{
+        struct log_stats_thread *self = log_stats_self;
+
+        if(self != NULL)
+        {
+                return self;
+        }
+
+        pthread_once(&log_stats_once, log_stats_init);
+
+        self = calloc(1, sizeof(*self));
+        if(self == NULL)
+        {
+                return NULL;
+        }
+
+        pthread_mutex_lock(&log_stats_lock);
+        list_add_tail(&self->node, &log_stats_threads);
+        pthread_mutex_unlock(&log_stats_lock);
+
+        pthread_setspecific(log_stats_key, self);
+        log_stats_self = self;
+
+        return self;
+}
+
+static unsigned int log_stats_bucket(unsigned long long ns)
+{
+        unsigned int bucket;
+
+        if(ns < 2)
+        {
+                return 0;
+        }
+
+        bucket = 63 - (unsigned int)__builtin_clzll(ns);
+        if(bucket >= LOG_STATS_LATENCY_BUCKETS)
+        {
+                bucket = LOG_STATS_LATENCY_BUCKETS - 1;
+        }
+
+        return bucket;
+}
+
+static void log_stats_report(void)
+{
+        struct log_stats stats;
+        unsigned long long messages = 0,
+                bytes = 0;
+        unsigned int i;
+
+        log_stats_snapshot(&stats);
+
+        for(i = 0; i < LOG_STATS_LEVELS; ++i)
+        {
+                messages += stats.messages[i];
+                bytes += stats.bytes[i];
+        }
+
+        log_kv(LOG_INFO, "log stats",
+               KV_UINT("messages", messages),
+               KV_UINT("bytes", bytes),
+               KV_UINT("drops", stats.drops),
+               KV_UINT("p50_ns", log_stats_latency_percentile(&stats, 50)),
+               KV_UINT("p99_ns", log_stats_latency_percentile(&stats, 99)),
+               KV_UINT("max_ns", log_stats_latency_percentile(&stats, 100)));
+}
+
+/*
+ * Only one thread wins the compare and swap and writes the report
+ */
+static void log_stats_report_check(unsigned long long now_ns)
+{
+        unsigned int period = atomic_load_explicit(&log_stats_report_period,
+                                                   memory_order_relaxed);
+        unsigned long long next;
+
+        if(period == 0 || log_stats_reporting)
+        {
+                return;
+        }
+
+        next = atomic_load_explicit(&log_stats_report_next,
+                                    memory_order_relaxed);
+        if(now_ns < next
+           || !atomic_compare_exchange_strong(&log_stats_report_next, &next,
+                                              now_ns + period * 1000000000ULL))
+        {
+                return;
+        }
+
+        log_stats_reporting = 1;
+        log_stats_report();
+        log_stats_reporting = 0;
+}
+
+void log_stats_record(int priority, size_t bytes,
+                      unsigned long long latency_ns)
+{
+        struct log_stats_thread *self = log_stats_thread_get();
+        unsigned int level = (unsigned int)LOG_PRI(priority);
+
+        if(self == NULL)
+        {
+                return;
+        }
+
+        log_stats_inc(&self->messages[level], 1);
+        log_stats_inc(&self->bytes[level], bytes);
+        log_stats_inc(&self->latency[log_stats_bucket(latency_ns)], 1);
+
+        if(atomic_load_explicit(&log_stats_report_period,
+                                memory_order_relaxed) != 0)
+        {
+                log_stats_report_check(log_clock_ns());
+        }
+}
+
+void log_stats_drop(void)
+{
+        struct log_stats_thread *self = log_stats_thread_get();
+
+        if(self != NULL)
+        {
+                log_stats_inc(&self->drops, 1);
+        }
+}
+
+/*
+ * Sum of all counters since start (without log_stats_base),
+ * log_stats_lock must be held
+ */
+static void log_stats_sum(struct log_stats *stats)
+{
+        struct log_stats_thread *self = NULL;
+
+        *stats = log_stats_retired;
+
+        list_for_each_entry(self, &log_stats_threads, node)
+        {
+                log_stats_add(stats, self);
+        }
+}
+
+void log_stats_snapshot(struct log_stats *stats)
+{
+        unsigned int i;
+
+        pthread_mutex_lock(&log_stats_lock);
+
+        log_stats_sum(stats);
+
+        for(i = 0; i < LOG_STATS_LEVELS; ++i)
+        {
+                stats->messages[i] -= log_stats_base.messages[i];
+                stats->bytes[i] -= log_stats_base.bytes[i];
+        }
+
+        stats->drops -= log_stats_base.drops;
+
+        for(i = 0; i < LOG_STATS_LATENCY_BUCKETS; ++i)
+        {
+                stats->latency[i] -= log_stats_base.latency[i];
+        }
+
+        pthread_mutex_unlock(&log_stats_lock);
+}
+
+void log_stats_reset(void)
+{
+        pthread_mutex_lock(&log_stats_lock);
+        log_stats_sum(&log_stats_base);
+        pthread_mutex_unlock(&log_stats_lock);
+}
+
+unsigned long long log_stats_latency_percentile(const struct log_stats *stats,
+                                                double percentile)
+{
+        unsigned long long total = 0,
+                count = 0;
+        double rank;
+        unsigned int i;
+
+        for(i = 0; i < LOG_STATS_LATENCY_BUCKETS; ++i)
+        {
+                total += stats->latency[i];
+        }
+
+        if(total == 0)
+        {
+                return 0;
+        }
+
+        rank = (double)total * percentile / 100.0;
+
+        for(i = 0; i < LOG_STATS_LATENCY_BUCKETS; ++i)
+        {
+                count += stats->latency[i];
+                if(stats->latency[i] != 0 && (double)count >= rank)
+                {
+                        break;
+                }
+        }
+
+        if(i == LOG_STATS_LATENCY_BUCKETS)
+        {
+                i = LOG_STATS_LATENCY_BUCKETS - 1;
+        }
+
+        return (2ULL << i) - 1;
+}
+
+void log_stats_report_every(unsigned int seconds)
+{
+        atomic_store(&log_stats_report_next, log_clock_ns()
+                     + seconds * 1000000000ULL);
+        atomic_store(&log_stats_report_period, seconds);
+}
+
+void log_stats_write(int priority, const char *fmt, ...)
+{
+        char msg[LOG_KV_LINE_SIZE];
+        unsigned long long start;
+        va_list args;
+        int len;
+
+        va_start(args, fmt);
+        len = vsnprintf(msg, sizeof(msg), fmt, args);
+        va_end(args);
+
+        if(len < 0)
+        {
+                log_stats_drop();
+                return;
+        }
+
+        start = log_clock_ns();
+        syslog(priority, "%s", msg);
+        log_stats_record(priority, min((size_t)len, sizeof(msg) - 1),
+                         log_clock_ns() - start);
+}
+
+/*
+ * Flight recorder
+ *
+ * File layout: a header then a power of 2 number of slots, all of
+ * LOG_RING_SLOT_SIZE bytes. A writer takes a sequence number from
+ * header->seq (the only atomic read-modify-write), clears the seq of the
+ * slot, fills it and then publishes seq + 1 with a release store. So a
+ * reader (even after a crash) ignores slots which were being written.
+ */
+#define LOG_RING_MAGIC 0x474e5246 /* "FRNG" */
+#define LOG_RING_VERSION 1
+
+struct log_ring_header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slot_size;
+        uint32_t reserved;
+        uint64_t slots;
+        _Atomic uint64_t seq;
+};
+
+struct log_ring_slot {
+        _Atomic uint64_t seq;
+        uint64_t time_ns;
+        uint16_t len;
+        uint8_t priority;
+        uint8_t reserved[5];
+        char data[LOG_RING_SLOT_SIZE - 24];
+};
+
+_Static_assert(sizeof(struct log_ring_slot) == LOG_RING_SLOT_SIZE,
+               "bad flight recorder slot size");
+_Static_assert(sizeof(struct log_ring_header) <= LOG_RING_SLOT_SIZE,
+               "bad flight recorder header size");
+
+struct log_ring *log_ring_default = NULL;
+
+static inline struct log_ring_slot *log_ring_slots(void *map)
+{
+        return (struct log_ring_slot *)((char *)map + LOG_RING_SLOT_SIZE);
+}
+
+int log_ring_open(struct log_ring *ring, const char *path, size_t size)
+{
+        struct log_ring_header *header = NULL;
+        struct stat st;
+        uint64_t slots;
+        size_t map_size;
+        void *map = NULL;
+        int created,
+                fd;
+
+        if(size < 4096)
+        {
+                errno = EINVAL;
+                return -1;
+        }
+
+        slots = size / LOG_RING_SLOT_SIZE - 1;
+        slots = 1ULL << (63 - __builtin_clzll(slots));
+        map_size = (size_t)(slots + 1) * LOG_RING_SLOT_SIZE;
+
+        fd = open(path, O_CREAT | O_RDWR,
+                  S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if(fd < 0)
+        {
+                return -1;
+        }
+
+        if(fstat(fd, &st) != 0)
+        {
+                close(fd);
+                return -1;
+        }
+
+        /* only a new (empty) file is sized, others are never truncated */
+        created = st.st_size == 0;
+        if(created)
+        {
+                if(ftruncate(fd, (off_t)map_size) != 0)
+                {
+                        close(fd);
+                        return -1;
+                }
+        }
+        else if((size_t)st.st_size != map_size)
+        {
+                close(fd);
+                errno = EINVAL;
+                return -1;
+        }
+
+        map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(map == MAP_FAILED)
+        {
+                return -1;
+        }
+
+        header = map;
+        if(created)
+        {
+                header->version = LOG_RING_VERSION;
+                header->slot_size = LOG_RING_SLOT_SIZE;
+                header->slots = slots;
+                atomic_store(&header->seq, 0);
+                header->magic = LOG_RING_MAGIC;
+        }
+        else if(header->magic != LOG_RING_MAGIC
+                || header->version != LOG_RING_VERSION
+                || header->slot_size != LOG_RING_SLOT_SIZE
+                || header->slots != slots)
+        {
+                /* not a flight recorder of this size: left untouched */
+                munmap(map, map_size);
+                errno = EINVAL;
+                return -1;
+        }
+
+        ring->map = map;
+        ring->map_size = map_size;
+        ring->mask = slots - 1;
+
+        return 0;
+}
+
+void log_ring_close(struct log_ring *ring)
+{
+        if(ring->map != NULL)
+        {
+                munmap(ring->map, ring->map_size);
+                ring->map = NULL;
+        }
+}
+
+static struct log_ring_slot *log_ring_begin(struct log_ring *ring,
+                                            int priority, uint64_t *seq)
+{
+        struct log_ring_header *header = ring->map;
+        struct log_ring_slot *slot = NULL;
+        struct timespec ts;
+
+        *seq = atomic_fetch_add_explicit(&header->seq, 1,
+                                         memory_order_relaxed);
+        slot = log_ring_slots(ring->map) + (*seq & ring->mask);
+
+        /* slot is invalid until log_ring_commit() */
+        atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        clock_gettime(LOG_CLOCK, &ts);
+        slot->time_ns = (uint64_t)ts.tv_sec * 1000000000ULL
+                + (uint64_t)ts.tv_nsec;
+        slot->priority = (uint8_t)LOG_PRI(priority);
+
+        return slot;
+}
+
+static void log_ring_commit(struct log_ring_slot *slot, uint64_t seq,
+                            size_t len)
+{
+        slot->len = (uint16_t)len;
+        atomic_store_explicit(&slot->seq, seq + 1, memory_order_release);
+}
+
+void log_ring_write(struct log_ring *ring, int priority,
+                    const char *msg, size_t len)
+{
+        struct log_ring_slot *slot = NULL;
+        uint64_t seq;
+
+        slot = log_ring_begin(ring, priority, &seq);
+
+        len = min(len, sizeof(slot->data));
+        memcpy(slot->data, msg, len);
+
+        log_ring_commit(slot, seq, len);
+}
+
+void log_ring_printf(struct log_ring *ring, int priority,
+                     const char *fmt, ...)
+{
+        struct log_ring_slot *slot = NULL;
+        uint64_t seq;
+        va_list args;
+        int ret;
+
+        slot = log_ring_begin(ring, priority, &seq);
+
+        va_start(args, fmt);
+        ret = vsnprintf(slot->data, sizeof(slot->data), fmt, args);
+        va_end(args);
+
+        if(ret < 0)
+        {
+                ret = 0;
+        }
+
+        /* vsnprintf() wrote a \0 in place of the last caracter */
+        log_ring_commit(slot, seq, min((size_t)ret, sizeof(slot->data) - 1));
+}
+
+struct log_ring_entry {
+        uint64_t seq;
+        uint64_t index;
+};
+
+static int log_ring_entry_cmp(const void *a, const void *b)
+{
+        const struct log_ring_entry *ea = a,
+                *eb = b;
+
+        return (ea->seq > eb->seq) - (ea->seq < eb->seq);
+}
+
+static int log_ring_dump_slot(const struct log_ring_slot *slot, int fd)
+{
+        char line[LOG_RING_SLOT_SIZE + 64];
+        struct tm tm;
+        time_t sec = (time_t)(slot->time_ns / 1000000000ULL);
+        size_t len = 0,
+                data_len = min((size_t)slot->len, sizeof(slot->data));
+
+        if(localtime_r(&sec, &tm) != NULL)
+        {
+                len = strftime(line, sizeof(line), "%Y-%m-%dT%H:%M:%S", &tm);
+        }
+
+        len += (size_t)snprintf(line + len, sizeof(line) - len, ".%03u %s ",
+                                (unsigned int)(slot->time_ns
+                                               / 1000000 % 1000),
+                                log_level_names[slot->priority & 0x7]);
+        memcpy(line + len, slot->data, data_len);
+        len += data_len;
+        line[len++] = '\n';
+
+        return io_write(fd, line, len) == (ssize_t)len ? 0 : -1;
+}
+
+int log_ring_dump(const char *path, int fd)
+{
+        const struct log_ring_header *header = NULL;
+        struct log_ring_slot *slots = NULL;
+        struct log_ring_slot copy;
+        struct log_ring_entry *entries = NULL;
+        struct stat st;
+        uint64_t i,
+                count = 0;
+        void *map = NULL;
+        int ret = -1,
+                map_fd;
+
+        map_fd = open(path, O_RDONLY);
+        if(map_fd < 0)
+        {
+                return -1;
+        }
+
+        if(fstat(map_fd, &st) != 0
+           || (size_t)st.st_size < 2 * LOG_RING_SLOT_SIZE)
+        {
+                close(map_fd);
+                return -1;
+        }
+
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED,
+                   map_fd, 0);
+        close(map_fd);
+        if(map == MAP_FAILED)
+        {
+                return -1;
+        }
+
+        header = map;
+        if(header->magic != LOG_RING_MAGIC
+           || header->version != LOG_RING_VERSION
+           || header->slot_size != LOG_RING_SLOT_SIZE
+           || header->slots == 0
+           || header->slots > (uint64_t)st.st_size / LOG_RING_SLOT_SIZE - 1)
+        {
+                errno = EINVAL;
+                goto ex_on_map;
+        }
+
+        entries = malloc(sizeof(*entries) * header->slots);
+        if(entries == NULL)
+        {
+                goto ex_on_map;
+        }
+
+        slots = log_ring_slots(map);
+        for(i = 0; i < header->slots; ++i)
+        {
+                entries[count].seq = atomic_load_explicit(&slots[i].seq,
+                                                          memory_order_acquire);
+                entries[count].index = i;
+                if(entries[count].seq != 0)
+                {
+                        ++count;
+                }
+        }
+
+        qsort(entries, count, sizeof(*entries), log_ring_entry_cmp);
+
+        ret = 0;
+        for(i = 0; i < count; ++i)
+        {
+                struct log_ring_slot *slot = &slots[entries[i].index];
+
+                /* skip records overwritten while we are reading them */
+                memcpy(&copy, slot, sizeof(copy));
+                atomic_thread_fence(memory_order_acquire);
+                if(atomic_load_explicit(&slot->seq, memory_order_relaxed)
+                   != entries[i].seq)
+                {
+                        continue;
+                }
+
+                if(log_ring_dump_slot(&copy, fd) != 0)
+                {
+                        ret = -1;
+                        break;
+                }
+
+                ++ret;
+        }
+
+        free(entries);
+
+ex_on_map:
+        munmap(map, (size_t)st.st_size);
+
+        return ret;
+}
+
+/*
+ * Syslog client
+ *
+ * Each thread formats its messages in its own batch (allocated at its
+ * first message, sent and freed when it ends). client->lock is only taken
+ * to send a whole batch and to (re)connect the socket.
+ *
+ * Batches are registered in log_syslog_batches (under log_syslog_lock)
+ * so that a flusher thread sends the messages which wait for too long
+ * and an atexit() handler sends the ones left at exit. batch->lock is
+ * only contended when one of them sends the batch of another thread.
+ */
+struct log_syslog log_syslog_default = {
+        LOG_SYSLOG_PATH, "", "", 0, LOG_USER, LOG_SYSLOG_RFC3164, -1,
+        PTHREAD_MUTEX_INITIALIZER
+};
+
+struct log_syslog_batch {
+        struct list_head node;
+        pthread_mutex_t lock;
+        struct log_syslog *client;
+        unsigned long long first_ns;
+        unsigned int count;
+        int priority[LOG_SYSLOG_BATCH];
+        size_t len[LOG_SYSLOG_BATCH];
+        char msg[LOG_SYSLOG_BATCH][LOG_SYSLOG_MSG_SIZE];
+};
+
+static pthread_mutex_t log_syslog_lock = PTHREAD_MUTEX_INITIALIZER;
+static LIST_HEAD(log_syslog_batches);
+static _Atomic int log_syslog_flusher_started;
+
+static pthread_once_t log_syslog_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_syslog_key;
+static __thread struct log_syslog_batch *log_syslog_self;
+static __thread pid_t log_syslog_pid;
+
+static int log_syslog_batch_flush(struct log_syslog_batch *batch);
+
+static void log_syslog_thread_exit(void *arg)
+{
+        struct log_syslog_batch *batch = arg;
+
+        /* the flusher can't see the batch anymore once it is unlinked */
+        pthread_mutex_lock(&log_syslog_lock);
+        list_del(&batch->node);
+        pthread_mutex_unlock(&log_syslog_lock);
+
+        log_syslog_batch_flush(batch);
+
+        pthread_mutex_destroy(&batch->lock);
+        free(batch);
+}
+
+/*
+ * Send the batches of all threads: lock order is log_syslog_lock then
+ * batch->lock. If max_age isn't 0, only batches whose oldest message
+ * is at least that old are sent.
+ */
+static void log_syslog_flush_all(unsigned long long max_age)
+{
+        struct log_syslog_batch *batch = NULL;
+        unsigned long long now = log_clock_ns();
+
+        pthread_mutex_lock(&log_syslog_lock);
+        list_for_each_entry(batch, &log_syslog_batches, node)
+        {
+                pthread_mutex_lock(&batch->lock);
+                if(batch->count != 0 && now - batch->first_ns >= max_age)
+                {
+                        log_syslog_batch_flush(batch);
+                }
+                pthread_mutex_unlock(&batch->lock);
+        }
+        pthread_mutex_unlock(&log_syslog_lock);
+}
+
+/*
+ * Checking every half of LOG_SYSLOG_MAX_AGE for messages older than that
+ * sends a message at most LOG_SYSLOG_MAX_AGE after it was queued.
+ */
+static void *log_syslog_flusher(void *arg)
+{
+        struct timespec period = {
+                LOG_SYSLOG_MAX_AGE / 2 / 1000,
+                LOG_SYSLOG_MAX_AGE / 2 % 1000 * 1000000L
+        };
+
+        (void)arg;
+
+        for(;;)
+        {
+                nanosleep(&period, NULL);
+                log_syslog_flush_all(LOG_SYSLOG_MAX_AGE / 2 * 1000000ULL);
+        }
+
+        return NULL;
+}
+
+/*
+ * Started at the first message queued (again in the child of a fork()),
+ * with all signals blocked so that they are still delivered to the
+ * threads of the program.
+ */
+static void log_syslog_flusher_start(void)
+{
+        pthread_attr_t attr;
+        pthread_t thread;
+        sigset_t all,
+                old;
+
+        pthread_mutex_lock(&log_syslog_lock);
+        if(!atomic_load(&log_syslog_flusher_started))
+        {
+                sigfillset(&all);
+                pthread_sigmask(SIG_SETMASK, &all, &old);
+
+                pthread_attr_init(&attr);
+                pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+                if(pthread_create(&thread, &attr, log_syslog_flusher,
+                                  NULL) == 0)
+                {
+                        atomic_store(&log_syslog_flusher_started, 1);
+                }
+                pthread_attr_destroy(&attr);
+
+                pthread_sigmask(SIG_SETMASK, &old, NULL);
+        }
+        pthread_mutex_unlock(&log_syslog_lock);
+}
+
+static void log_syslog_atexit(void)
+{
+        log_syslog_flush_all(0);
+}
+
+/*
+ * log_syslog_lock is held across fork(): the flusher (and the exit
+ * handler) only send batches under it, so none of them is sending, with
+ * a client->lock held, when the process is copied.
+ */
+static void log_syslog_atfork_prepare(void)
+{
+        pthread_mutex_lock(&log_syslog_lock);
+}
+
+static void log_syslog_atfork_parent(void)
+{
+        pthread_mutex_unlock(&log_syslog_lock);
+}
+
+/*
+ * The child of a fork() has only the thread which called fork(): the
+ * batches of the other threads (and the flusher) are gone, and so are
+ * the locks they held: the one of the batch left, and the ones of the
+ * clients it may use, are reset.
+ */
+static void log_syslog_atfork_child(void)
+{
+        struct log_syslog_batch *batch = log_syslog_self;
+
+        log_syslog_pid = 0;
+
+        pthread_mutex_unlock(&log_syslog_lock);
+        INIT_LIST_HEAD(&log_syslog_batches);
+        atomic_store(&log_syslog_flusher_started, 0);
+
+        pthread_mutex_init(&log_syslog_default.lock, NULL);
+
+        if(batch != NULL)
+        {
+                pthread_mutex_init(&batch->lock, NULL);
+                if(batch->client != NULL)
+                {
+                        pthread_mutex_init(&batch->client->lock, NULL);
+                }
+                list_add_tail(&batch->node, &log_syslog_batches);
+        }
+}
+
+static void log_syslog_init(void)
+{
+        pthread_key_create(&log_syslog_key, log_syslog_thread_exit);
+        pthread_atfork(log_syslog_atfork_prepare, log_syslog_atfork_parent,
+                       log_syslog_atfork_child);
+        atexit(log_syslog_atexit);
+}
+
+static struct log_syslog_batch *log_syslog_batch_get(void)
+{
+        struct log_syslog_batch *batch = log_syslog_self;
+
+        if(batch != NULL)
+        {
+                return batch;
+        }
+
+        pthread_once(&log_syslog_once, log_syslog_init);
+
+        batch = malloc(sizeof(*batch));
+        if(batch == NULL)
+        {
+                return NULL;
+        }
+
+        pthread_mutex_init(&batch->lock, NULL);
+        batch->client = NULL;
+        batch->count = 0;
+
+        pthread_mutex_lock(&log_syslog_lock);
+        list_add_tail(&batch->node, &log_syslog_batches);
+        pthread_mutex_unlock(&log_syslog_lock);
+
+        pthread_setspecific(log_syslog_key, batch);
+        log_syslog_self = batch;
+
+        return batch;
+}
+
+int log_syslog_open(struct log_syslog *client, const char *path,
+                    const char *ident, int option, int facility,
+                    enum log_syslog_format format)
+{
+        if(path == NULL)
+        {
+                path = LOG_SYSLOG_PATH;
+        }
+
+        if(strlen(path) >= sizeof(client->path))
+        {
+                errno = ENAMETOOLONG;
+                return -1;
+        }
+
+        strcpy(client->path, path);
+        snprintf(client->ident, sizeof(client->ident), "%s",
+                 ident != NULL ? ident : program_invocation_short_name);
+
+        if(gethostname(client->hostname, sizeof(client->hostname)) != 0
+           || client->hostname[0] == '\0')
+        {
+                strcpy(client->hostname, "-");
+        }
+        client->hostname[sizeof(client->hostname) - 1] = '\0';
+
+        client->option = option;
+        client->facility = facility;
+        client->format = format;
+        client->fd = -1;
+        pthread_mutex_init(&client->lock, NULL);
+
+        return 0;
+}
+
+void log_syslog_close(struct log_syslog *client)
+{
+        struct log_syslog_batch *batch = NULL;
+
+        /*
+         * Messages already queued by any thread are sent now: the
+         * flusher and the exit handler must not use the client later.
+         */
+        pthread_mutex_lock(&log_syslog_lock);
+        list_for_each_entry(batch, &log_syslog_batches, node)
+        {
+                pthread_mutex_lock(&batch->lock);
+                if(batch->client == client)
+                {
+                        log_syslog_batch_flush(batch);
+                        batch->client = NULL;
+                }
+                pthread_mutex_unlock(&batch->lock);
+        }
+        pthread_mutex_unlock(&log_syslog_lock);
+
+        pthread_mutex_lock(&client->lock);
+        if(client->fd >= 0)
+        {
+                close(client->fd);
+                client->fd = -1;
+        }
+        pthread_mutex_unlock(&client->lock);
+}
+
+/*
+ * client->lock must be held
+ */
+static int log_syslog_connect(struct log_syslog *client)
+{
+        struct sockaddr_un addr;
+        struct timeval timeout;
+        int fd;
+
+        fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if(fd < 0)
+        {
+                return -1;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, client->path, sizeof(client->path));
+
+        timeout.tv_sec = LOG_SYSLOG_TIMEOUT / 1000;
+        timeout.tv_usec = LOG_SYSLOG_TIMEOUT % 1000 * 1000;
+
+        if(setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO,
+                      &timeout, sizeof(timeout)) != 0
+           || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+                close(fd);
+                return -1;
+        }
+
+        client->fd = fd;
+
+        return 0;
+}
+
+static size_t log_syslog_header(struct log_syslog *client, int priority,
+                                char *buf, size_t size)
+{
+        struct log_timestamp_cache *cache = log_timestamp_update();
+        const char *ident = client->ident;
+        char pid[16] = "";
+        int len;
+
+        if(ident[0] == '\0')
+        {
+                ident = program_invocation_short_name;
+        }
+
+        if(client->option & LOG_PID)
+        {
+                if(log_syslog_pid == 0)
+                {
+                        log_syslog_pid = getpid();
+                }
+
+                snprintf(pid, sizeof(pid), "%d", (int)log_syslog_pid);
+        }
+
+        if(client->format == LOG_SYSLOG_RFC5424)
+        {
+                len = snprintf(buf, size, "<%d>1 %s%s %s %s %s - - ",
+                               priority, cache->buf, cache->tz,
+                               client->hostname, ident[0] ? ident : "-",
+                               pid[0] ? pid : "-");
+        }
+        else
+        {
+                len = snprintf(buf, size, "<%d>%s %s%s%s%s: ",
+                               priority, cache->bsd, ident,
+                               pid[0] ? "[" : "", pid, pid[0] ? "]" : "");
+        }
+
+        if(len < 0)
+        {
+                return 0;
+        }
+
+        return min((size_t)len, size - 1);
+}
+
+void log_syslog_write(struct log_syslog *client, int priority,
+                      const char *fmt, ...)
+{
+        struct log_syslog_batch *batch = log_syslog_batch_get();
+        char *msg = NULL;
+        size_t len;
+        va_list args;
+        int ret;
+
+        if(batch == NULL)
+        {
+                log_stats_drop();
+                return;
+        }
+
+        if(!atomic_load_explicit(&log_syslog_flusher_started,
+                                 memory_order_relaxed))
+        {
+                log_syslog_flusher_start();
+        }
+
+        pthread_mutex_lock(&batch->lock);
+
+        if(batch->count != 0 && batch->client != client)
+        {
+                log_syslog_batch_flush(batch);
+        }
+
+        if(batch->count == 0)
+        {
+                batch->first_ns = log_clock_ns();
+        }
+
+        if((priority & LOG_FACMASK) == 0)
+        {
+                priority |= client->facility;
+        }
+
+        batch->client = client;
+        msg = batch->msg[batch->count];
+
+        len = log_syslog_header(client, priority, msg, LOG_SYSLOG_MSG_SIZE);
+
+        va_start(args, fmt);
+        ret = vsnprintf(msg + len, LOG_SYSLOG_MSG_SIZE - len, fmt, args);
+        va_end(args);
+
+        if(ret > 0)
+        {
+                len += min((size_t)ret, LOG_SYSLOG_MSG_SIZE - len - 1);
+        }
+
+        batch->priority[batch->count] = priority;
+        batch->len[batch->count] = len;
+        ++batch->count;
+
+        if(batch->count == LOG_SYSLOG_BATCH || LOG_PRI(priority) <= LOG_ERR)
+        {
+                log_syslog_batch_flush(batch);
+        }
+
+        pthread_mutex_unlock(&batch->lock);
+}
+
+/*
+ * The socket must be connected again if the system logger was restarted
+ */
+static int log_syslog_reconnectable(int err)
+{
+        return (err == ECONNREFUSED || err == ENOTCONN || err == EBADF
+                || err == ENOENT || err == EPIPE);
+}
+
+/*
+ * batch->lock must be held (or the batch unreachable by other threads)
+ */
+static int log_syslog_batch_flush(struct log_syslog_batch *batch)
+{
+        struct log_syslog *client = NULL;
+        struct mmsghdr msgs[LOG_SYSLOG_BATCH];
+        struct iovec iov[LOG_SYSLOG_BATCH];
+        unsigned long long start,
+                latency;
+        unsigned int i,
+                next = 0,
+                sent = 0,
+                count;
+        int retried = 0,
+                ret;
+
+        if(batch->count == 0)
+        {
+                return 0;
+        }
+
+        client = batch->client;
+        count = batch->count;
+        batch->count = 0;
+
+        memset(msgs, 0, sizeof(msgs[0]) * count);
+        for(i = 0; i < count; ++i)
+        {
+                iov[i].iov_base = batch->msg[i];
+                iov[i].iov_len = batch->len[i];
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        start = log_clock_ns();
+
+        pthread_mutex_lock(&client->lock);
+        while(next < count)
+        {
+                if(client->fd < 0 && log_syslog_connect(client) != 0)
+                {
+                        break;
+                }
+
+                ret = sendmmsg(client->fd, msgs + next, count - next, 0);
+                if(ret > 0)
+                {
+                        /* sent messages are marked with msg_len != 0 */
+                        next += (unsigned int)ret;
+                        continue;
+                }
+
+                if(errno == EINTR)
+                {
+                        continue;
+                }
+
+                if(!retried && log_syslog_reconnectable(errno))
+                {
+                        close(client->fd);
+                        client->fd = -1;
+                        retried = 1;
+                        continue;
+                }
+
+                if(errno == EAGAIN || errno == EWOULDBLOCK
+                   || log_syslog_reconnectable(errno))
+                {
+                        /* system logger is too slow (timeout) or gone */
+                        break;
+                }
+
+                /* this message can't be sent (too long...) */
+                ++next;
+        }
+        pthread_mutex_unlock(&client->lock);
+
+        for(i = 0; i < count; ++i)
+        {
+                sent += (msgs[i].msg_len != 0);
+        }
+
+        latency = (log_clock_ns() - start) / (sent != 0 ? sent : 1);
+
+        for(i = 0; i < count; ++i)
+        {
+                if(msgs[i].msg_len != 0)
+                {
+                        log_stats_record(batch->priority[i], batch->len[i],
+                                         latency);
+                }
+                else
+                {
+                        log_stats_drop();
+                }
+        }
+
+        return sent == count ? (int)sent : -1;
+}
+
+int log_syslog_flush(void)
+{
+        struct log_syslog_batch *batch = log_syslog_self;
+        int ret;
+
+        if(batch == NULL)
+        {
+                return 0;
+        }
+
+        pthread_mutex_lock(&batch->lock);
+        ret = log_syslog_batch_flush(batch);
+        pthread_mutex_unlock(&batch->lock);
+
+        return ret;
+}
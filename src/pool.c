@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/pool.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* a slab must hold at least this number of objects */
+#define POOL_SLAB_MIN_OBJECTS 8
+
+struct pool_slab {
+        struct list_head node;
+};
+
+struct pool_cache {
+        void *free;
+        unsigned int count;
+        unsigned long generation;
+};
+
+/* pools with thread caches, by id */
+static pthread_mutex_t pool_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pool *pool_registry[POOL_MAX];
+static unsigned long pool_generation;
+
+static __thread struct pool_cache pool_caches[POOL_MAX];
+static __thread int pool_caches_used;
+static pthread_key_t pool_caches_key;
+static pthread_once_t pool_caches_once = PTHREAD_ONCE_INIT;
+
+/* free objects are linked by their first word */
+#define pool_obj_next(obj) (*(void **) (obj))
+
+static size_t pool_round_up(size_t value, size_t align)
+{
+        return (value + align - 1) & ~(align - 1);
+}
+
+static void pool_poison(struct pool *pool, void *obj)
+{
+#ifdef DEBUG
+        memset(obj, POOL_POISON, pool->size);
+#else
+        (void) pool;
+        (void) obj;
+#endif
+}
+
+static void pool_check_poison(struct pool *pool, void *obj)
+{
+#ifdef DEBUG
+        const unsigned char *p = obj;
+        size_t i;
+
+        for(i = sizeof(void *); i < pool->size; ++i)
+        {
+                if(p[i] != POOL_POISON)
+                {
+                        fprintf(stderr,
+                                "pool: object %p modified after free "
+                                "(offset %zu)\n", obj, i);
+                        abort();
+                }
+        }
+#else
+        (void) pool;
+        (void) obj;
+#endif
+}
+
+/* add a slab to the free list of the pool (pool locked) */
+static int pool_grow(struct pool *pool)
+{
+        struct pool_slab *slab = NULL;
+        size_t offset;
+        void *mem = NULL;
+        char *obj = NULL;
+
+        if(posix_memalign(&mem, pool->slab_size > pool->align ?
+                          pool->slab_size : pool->align,
+                          pool->slab_size) != 0)
+        {
+                return -1;
+        }
+
+        slab = mem;
+        list_add(&slab->node, &pool->slabs);
+        ++pool->slabs_count;
+
+        for(offset = pool_round_up(sizeof(*slab), pool->align);
+            offset + pool->size <= pool->slab_size;
+            offset += pool->size)
+        {
+                obj = (char *) mem + offset;
+
+                pool_poison(pool, obj);
+                pool_obj_next(obj) = pool->free;
+                pool->free = obj;
+                ++pool->free_count;
+        }
+
+        return 0;
+}
+
+/* give count objects of a linked list back to the pool */
+static void pool_put_list(struct pool *pool, void *first, void *last,
+                          size_t count)
+{
+        pthread_mutex_lock(&pool->lock);
+        pool_obj_next(last) = pool->free;
+        pool->free = first;
+        pool->free_count += count;
+        pthread_mutex_unlock(&pool->lock);
+}
+
+/* flush thread caches at thread exit */
+static void pool_caches_destructor(void *arg)
+{
+        struct pool_cache *cache = NULL;
+        struct pool *pool = NULL;
+        void *last = NULL;
+        unsigned int id;
+
+        (void) arg;
+
+        pthread_mutex_lock(&pool_registry_lock);
+        for(id = 0; id < POOL_MAX; ++id)
+        {
+                cache = &pool_caches[id];
+                pool = pool_registry[id];
+
+                if(cache->count == 0 || pool == NULL
+                   || pool->generation != cache->generation)
+                {
+                        continue;
+                }
+
+                for(last = cache->free; pool_obj_next(last) != NULL;
+                    last = pool_obj_next(last))
+                        ;
+
+                pool_put_list(pool, cache->free, last, cache->count);
+                cache->free = NULL;
+                cache->count = 0;
+        }
+        pthread_mutex_unlock(&pool_registry_lock);
+}
+
+static void pool_caches_key_create(void)
+{
+        pthread_key_create(&pool_caches_key, pool_caches_destructor);
+}
+
+static struct pool_cache *pool_cache_get(struct pool *pool)
+{
+        struct pool_cache *cache = &pool_caches[pool->id];
+
+        /* objects of an old pool with the same id are forgotten */
+        if(cache->generation != pool->generation)
+        {
+                cache->free = NULL;
+                cache->count = 0;
+                cache->generation = pool->generation;
+
+                if(!pool_caches_used)
+                {
+                        pthread_once(&pool_caches_once,
+                                     pool_caches_key_create);
+                        pthread_setspecific(pool_caches_key, pool_caches);
+                        pool_caches_used = 1;
+                }
+        }
+
+        return cache;
+}
+
+/* move a batch of objects from the pool to the cache */
+static int pool_cache_refill(struct pool *pool, struct pool_cache *cache)
+{
+        void *obj = NULL;
+
+        pthread_mutex_lock(&pool->lock);
+
+        if(pool->free_count == 0 && pool_grow(pool) != 0)
+        {
+                pthread_mutex_unlock(&pool->lock);
+                return -1;
+        }
+
+        while(cache->count < POOL_CACHE_BATCH && pool->free != NULL)
+        {
+                obj = pool->free;
+                pool->free = pool_obj_next(obj);
+                --pool->free_count;
+
+                pool_obj_next(obj) = cache->free;
+                cache->free = obj;
+                ++cache->count;
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+
+        return 0;
+}
+
+/* move a batch of objects from the cache to the pool */
+static void pool_cache_drain(struct pool *pool, struct pool_cache *cache)
+{
+        void *first = cache->free,
+                *last = first;
+        unsigned int i;
+
+        for(i = 1; i < POOL_CACHE_BATCH; ++i)
+        {
+                last = pool_obj_next(last);
+        }
+
+        cache->free = pool_obj_next(last);
+        cache->count -= POOL_CACHE_BATCH;
+
+        pool_put_list(pool, first, last, POOL_CACHE_BATCH);
+}
+
+int pool_init(struct pool *pool, size_t size, size_t align)
+{
+        long page_size = sysconf(_SC_PAGESIZE);
+        unsigned int id;
+
+        if(align == 0)
+        {
+                align = __alignof__(max_align_t);
+        }
+
+        if((align & (align - 1)) != 0
+           || size > SIZE_MAX / 2 / POOL_SLAB_MIN_OBJECTS)
+        {
+                return -1;
+        }
+
+        if(size < sizeof(void *))
+        {
+                size = sizeof(void *);
+        }
+
+        pool->align = align < sizeof(void *) ? sizeof(void *) : align;
+        pool->size = pool_round_up(size, pool->align);
+
+        pool->slab_size = page_size > 0 ? (size_t) page_size : 4096;
+        while(pool_round_up(sizeof(struct pool_slab), pool->align)
+              + POOL_SLAB_MIN_OBJECTS * pool->size > pool->slab_size)
+        {
+                pool->slab_size *= 2;
+        }
+
+        if(pthread_mutex_init(&pool->lock, NULL) != 0)
+        {
+                return -1;
+        }
+
+        pool->free = NULL;
+        pool->free_count = 0;
+        INIT_LIST_HEAD(&pool->slabs);
+        pool->slabs_count = 0;
+
+        pthread_mutex_lock(&pool_registry_lock);
+
+        pool->generation = ++pool_generation;
+        pool->id = POOL_MAX;
+        for(id = 0; id < POOL_MAX; ++id)
+        {
+                if(pool_registry[id] == NULL)
+                {
+                        pool_registry[id] = pool;
+                        pool->id = id;
+                        break;
+                }
+        }
+
+        pthread_mutex_unlock(&pool_registry_lock);
+
+        return 0;
+}
+
+void pool_cleanup(struct pool *pool)
+{
+        struct pool_slab *slab = NULL,
+                *tmp = NULL;
+
+        pthread_mutex_lock(&pool_registry_lock);
+        if(pool->id < POOL_MAX)
+        {
+                pool_registry[pool->id] = NULL;
+        }
+        pthread_mutex_unlock(&pool_registry_lock);
+
+        list_for_each_entry_safe(slab, tmp, &pool->slabs, node)
+        {
+                list_del(&slab->node);
+                free(slab);
+        }
+
+        pool->free = NULL;
+        pool->free_count = 0;
+        pool->slabs_count = 0;
+        pthread_mutex_destroy(&pool->lock);
+}
+
+void *pool_alloc(struct pool *pool)
+{
+        struct pool_cache *cache = NULL;
+        void *obj = NULL;
+
+        if(pool->id == POOL_MAX)
+        {
+                pthread_mutex_lock(&pool->lock);
+                if(pool->free != NULL || pool_grow(pool) == 0)
+                {
+                        obj = pool->free;
+                        pool->free = pool_obj_next(obj);
+                        --pool->free_count;
+                }
+                pthread_mutex_unlock(&pool->lock);
+        }
+        else
+        {
+                cache = pool_cache_get(pool);
+                if(cache->free == NULL && pool_cache_refill(pool, cache) != 0)
+                {
+                        return NULL;
+                }
+
+                obj = cache->free;
+                cache->free = pool_obj_next(obj);
+                --cache->count;
+        }
+
+        if(obj != NULL)
+        {
+                pool_check_poison(pool, obj);
+        }
+
+        return obj;
+}
+
+void *pool_zalloc(struct pool *pool)
+{
+        void *obj = pool_alloc(pool);
+
+        if(obj != NULL)
+        {
+                memset(obj, 0, pool->size);
+        }
+
+        return obj;
+}
+
+void pool_free(struct pool *pool, void *obj)
+{
+        struct pool_cache *cache = NULL;
+
+        if(obj == NULL)
+        {
+                return;
+        }
+
+        pool_poison(pool, obj);
+
+        if(pool->id == POOL_MAX)
+        {
+                pool_put_list(pool, obj, obj, 1);
+                return;
+        }
+
+        cache = pool_cache_get(pool);
+        pool_obj_next(obj) = cache->free;
+        cache->free = obj;
+        ++cache->count;
+
+        if(cache->count >= 2 * POOL_CACHE_BATCH)
+        {
+                pool_cache_drain(pool, cache);
+        }
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/queue.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+int spsc_ring_init(struct spsc_ring *ring, size_t size)
+{
+        size_t slots = 2;
+
+        while(slots < size)
+        {
+                if(slots > SIZE_MAX / 2 / sizeof(void *))
+                {
+                        return -1;
+                }
+                slots *= 2;
+        }
+
+        ring->slots = calloc(slots, sizeof(void *));
+        if(ring->slots == NULL)
+        {
+                return -1;
+        }
+
+        ring->mask = slots - 1;
+        ring->tail_cache = 0;
+        ring->head_cache = 0;
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+
+        return 0;
+}
+
+void spsc_ring_cleanup(struct spsc_ring *ring)
+{
+        free(ring->slots);
+        ring->slots = NULL;
+        ring->mask = 0;
+}
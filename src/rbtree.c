@@ -0,0 +1,478 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/rbtree.h"
+
+#include <stddef.h>
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+#define rb_color(r) ((r)->__rb_parent_color & 1)
+#define rb_is_red(r) (!rb_color(r))
+#define rb_is_black(r) rb_color(r)
+
+/* a NULL node is a black leaf */
+#define rb_node_is_black(r) ((r) == NULL || rb_is_black(r))
+
+static inline void rb_set_red(struct rb_node *node)
+{
+        node->__rb_parent_color &= ~1UL;
+}
+
+static inline void rb_set_black(struct rb_node *node)
+{
+        node->__rb_parent_color |= 1UL;
+}
+
+static inline void rb_set_parent(struct rb_node *node, struct rb_node *parent)
+{
+        node->__rb_parent_color = (node->__rb_parent_color & 3UL)
+                | (unsigned long)parent;
+}
+
+static inline void rb_set_color(struct rb_node *node, unsigned long color)
+{
+        node->__rb_parent_color = (node->__rb_parent_color & ~1UL) | color;
+}
+
+/* make parent (or root) point to new instead of old */
+static inline void rb_change_child(struct rb_node *old, struct rb_node *new,
+                                   struct rb_node *parent,
+                                   struct rb_root *root)
+{
+        if(parent == NULL)
+        {
+                root->rb_node = new;
+        }
+        else if(parent->rb_left == old)
+        {
+                parent->rb_left = new;
+        }
+        else
+        {
+                parent->rb_right = new;
+        }
+}
+
+static void rb_rotate_left(struct rb_node *node, struct rb_root *root)
+{
+        struct rb_node *right = node->rb_right;
+        struct rb_node *parent = rb_parent(node);
+
+        node->rb_right = right->rb_left;
+        if(right->rb_left != NULL)
+        {
+                rb_set_parent(right->rb_left, node);
+        }
+
+        right->rb_left = node;
+        rb_set_parent(right, parent);
+        rb_change_child(node, right, parent, root);
+        rb_set_parent(node, right);
+}
+
+static void rb_rotate_right(struct rb_node *node, struct rb_root *root)
+{
+        struct rb_node *left = node->rb_left;
+        struct rb_node *parent = rb_parent(node);
+
+        node->rb_left = left->rb_right;
+        if(left->rb_right != NULL)
+        {
+                rb_set_parent(left->rb_right, node);
+        }
+
+        left->rb_right = node;
+        rb_set_parent(left, parent);
+        rb_change_child(node, left, parent, root);
+        rb_set_parent(node, left);
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+        struct rb_node *parent,
+                *gparent,
+                *uncle,
+                *tmp;
+
+        /* the new node is red (see rb_link_node()) */
+        while((parent = rb_parent(node)) != NULL && rb_is_red(parent))
+        {
+                /* a red node isn't the root so gparent exists */
+                gparent = rb_parent(parent);
+
+                if(parent == gparent->rb_left)
+                {
+                        uncle = gparent->rb_right;
+                        if(uncle != NULL && rb_is_red(uncle))
+                        {
+                                /* recolor and go up */
+                                rb_set_black(uncle);
+                                rb_set_black(parent);
+                                rb_set_red(gparent);
+                                node = gparent;
+                                continue;
+                        }
+
+                        if(parent->rb_right == node)
+                        {
+                                rb_rotate_left(parent, root);
+                                tmp = parent;
+                                parent = node;
+                                node = tmp;
+                        }
+
+                        rb_set_black(parent);
+                        rb_set_red(gparent);
+                        rb_rotate_right(gparent, root);
+                }
+                else
+                {
+                        uncle = gparent->rb_left;
+                        if(uncle != NULL && rb_is_red(uncle))
+                        {
+                                rb_set_black(uncle);
+                                rb_set_black(parent);
+                                rb_set_red(gparent);
+                                node = gparent;
+                                continue;
+                        }
+
+                        if(parent->rb_left == node)
+                        {
+                                rb_rotate_right(parent, root);
+                                tmp = parent;
+                                parent = node;
+                                node = tmp;
+                        }
+
+                        rb_set_black(parent);
+                        rb_set_red(gparent);
+                        rb_rotate_left(gparent, root);
+                }
+        }
+
+        rb_set_black(root->rb_node);
+}
+
+static void rb_erase_color(struct rb_node *node, struct rb_node *parent,
+                           struct rb_root *root)
+{
+        struct rb_node *sibling;
+
+        /* node (maybe NULL) has one black less than its sibling */
+        while(rb_node_is_black(node) && node != root->rb_node)
+        {
+                if(parent->rb_left == node)
+                {
+                        sibling = parent->rb_right;
+                        if(rb_is_red(sibling))
+                        {
+                                rb_set_black(sibling);
+                                rb_set_red(parent);
+                                rb_rotate_left(parent, root);
+                                sibling = parent->rb_right;
+                        }
+
+                        if(rb_node_is_black(sibling->rb_left)
+                           && rb_node_is_black(sibling->rb_right))
+                        {
+                                rb_set_red(sibling);
+                                node = parent;
+                                parent = rb_parent(node);
+                                continue;
+                        }
+
+                        if(rb_node_is_black(sibling->rb_right))
+                        {
+                                rb_set_black(sibling->rb_left);
+                                rb_set_red(sibling);
+                                rb_rotate_right(sibling, root);
+                                sibling = parent->rb_right;
+                        }
+
+                        rb_set_color(sibling, rb_color(parent));
+                        rb_set_black(parent);
+                        rb_set_black(sibling->rb_right);
+                        rb_rotate_left(parent, root);
+                }
+                else
+                {
+                        sibling = parent->rb_left;
+                        if(rb_is_red(sibling))
+                        {
+                                rb_set_black(sibling);
+                                rb_set_red(parent);
+                                rb_rotate_right(parent, root);
+                                sibling = parent->rb_left;
+                        }
+
+                        if(rb_node_is_black(sibling->rb_left)
+                           && rb_node_is_black(sibling->rb_right))
+                        {
+                                rb_set_red(sibling);
+                                node = parent;
+                                parent = rb_parent(node);
+                                continue;
+                        }
+
+                        if(rb_node_is_black(sibling->rb_left))
+                        {
+                                rb_set_black(sibling->rb_right);
+                                rb_set_red(sibling);
+                                rb_rotate_left(sibling, root);
+                                sibling = parent->rb_left;
+                        }
+
+                        rb_set_color(sibling, rb_color(parent));
+                        rb_set_black(parent);
+                        rb_set_black(sibling->rb_left);
+                        rb_rotate_right(parent, root);
+                }
+
+                node = root->rb_node;
+                break;
+        }
+
+        if(node != NULL)
+        {
+                rb_set_black(node);
+        }
+}
+
+void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+        struct rb_node *child,
+                *parent,
+                *successor;
+        unsigned long color;
+
+        if(node->rb_left == NULL || node->rb_right == NULL)
+        {
+                child = node->rb_left != NULL ? node->rb_left : node->rb_right;
+                parent = rb_parent(node);
+                color = rb_color(node);
+
+                if(child != NULL)
+                {
+                        rb_set_parent(child, parent);
+                }
+                rb_change_child(node, child, parent, root);
+        }
+        else
+        {
+                /* two children: the successor takes the place of node */
+                successor = node->rb_right;
+                while(successor->rb_left != NULL)
+                {
+                        successor = successor->rb_left;
+                }
+
+                rb_change_child(node, successor, rb_parent(node), root);
+
+                child = successor->rb_right;
+                parent = rb_parent(successor);
+                color = rb_color(successor);
+
+                if(parent == node)
+                {
+                        parent = successor;
+                }
+                else
+                {
+                        if(child != NULL)
+                        {
+                                rb_set_parent(child, parent);
+                        }
+                        parent->rb_left = child;
+
+                        successor->rb_right = node->rb_right;
+                        rb_set_parent(node->rb_right, successor);
+                }
+
+                successor->__rb_parent_color = node->__rb_parent_color;
+                successor->rb_left = node->rb_left;
+                rb_set_parent(node->rb_left, successor);
+        }
+
+        if(color == RB_BLACK)
+        {
+                rb_erase_color(child, parent, root);
+        }
+}
+
+void rb_replace_node(struct rb_node *victim, struct rb_node *new,
+                     struct rb_root *root)
+{
+        *new = *victim;
+
+        if(victim->rb_left != NULL)
+        {
+                rb_set_parent(victim->rb_left, new);
+        }
+        if(victim->rb_right != NULL)
+        {
+                rb_set_parent(victim->rb_right, new);
+        }
+
+        rb_change_child(victim, new, rb_parent(victim), root);
+}
+
+struct rb_node *rb_first(const struct rb_root *root)
+{
+        struct rb_node *node = root->rb_node;
+
+        if(node == NULL)
+        {
+                return NULL;
+        }
+
+        while(node->rb_left != NULL)
+        {
+                node = node->rb_left;
+        }
+
+        return node;
+}
+
+struct rb_node *rb_last(const struct rb_root *root)
+{
+        struct rb_node *node = root->rb_node;
+
+        if(node == NULL)
+        {
+                return NULL;
+        }
+
+        while(node->rb_right != NULL)
+        {
+                node = node->rb_right;
+        }
+
+        return node;
+}
+
+struct rb_node *rb_next(const struct rb_node *node)
+{
+        struct rb_node *parent;
+
+        if(RB_EMPTY_NODE(node))
+        {
+                return NULL;
+        }
+
+        /* leftmost node of the right subtree */
+        if(node->rb_right != NULL)
+        {
+                node = node->rb_right;
+                while(node->rb_left != NULL)
+                {
+                        node = node->rb_left;
+                }
+
+                return (struct rb_node *) node;
+        }
+
+        /* first ancestor we are on the left of */
+        while((parent = rb_parent(node)) != NULL && node == parent->rb_right)
+        {
+                node = parent;
+        }
+
+        return parent;
+}
+
+struct rb_node *rb_prev(const struct rb_node *node)
+{
+        struct rb_node *parent;
+
+        if(RB_EMPTY_NODE(node))
+        {
+                return NULL;
+        }
+
+        if(node->rb_left != NULL)
+        {
+                node = node->rb_left;
+                while(node->rb_right != NULL)
+                {
+                        node = node->rb_right;
+                }
+
+                return (struct rb_node *) node;
+        }
+
+        while((parent = rb_parent(node)) != NULL && node == parent->rb_left)
+        {
+                node = parent;
+        }
+
+        return parent;
+}
+
+static struct rb_node *rb_left_deepest_node(const struct rb_node *node)
+{
+        for(;;)
+        {
+                if(node->rb_left != NULL)
+                {
+                        node = node->rb_left;
+                }
+                else if(node->rb_right != NULL)
+                {
+                        node = node->rb_right;
+                }
+                else
+                {
+                        return (struct rb_node *) node;
+                }
+        }
+}
+
+struct rb_node *rb_first_postorder(const struct rb_root *root)
+{
+        if(root->rb_node == NULL)
+        {
+                return NULL;
+        }
+
+        return rb_left_deepest_node(root->rb_node);
+}
+
+struct rb_node *rb_next_postorder(const struct rb_node *node)
+{
+        const struct rb_node *parent;
+
+        if(node == NULL)
+        {
+                return NULL;
+        }
+
+        parent = rb_parent(node);
+
+        /* we were the left child: go to the deepest node of the right */
+        if(parent != NULL && node == parent->rb_left
+           && parent->rb_right != NULL)
+        {
+                return rb_left_deepest_node(parent->rb_right);
+        }
+
+        return (struct rb_node *) parent;
+}
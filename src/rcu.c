@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/rcu.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef HAVE_LINUX_MEMBARRIER_H
+ #include <linux/membarrier.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#endif
+
+/* 0 means "not in a critical section" so epochs start at 1 */
+_Atomic unsigned long rcu_gp_epoch = 1;
+__thread struct rcu_reader rcu_reader_self;
+int rcu_has_membarrier = 0;
+
+static pthread_once_t rcu_membarrier_once = PTHREAD_ONCE_INIT;
+
+/* registered readers */
+static pthread_mutex_t rcu_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static LIST_HEAD(rcu_registry);
+
+/* callbacks of call_rcu(), sorted by epoch */
+static pthread_mutex_t rcu_defer_lock = PTHREAD_MUTEX_INITIALIZER;
+static LIST_HEAD(rcu_defer_list);
+static unsigned int rcu_defer_count;
+
+static void rcu_membarrier_init(void)
+{
+#ifdef HAVE_LINUX_MEMBARRIER_H
+        long cmds = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+
+        if(cmds > 0
+           && (cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+           && syscall(__NR_membarrier,
+                      MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0)
+        {
+                rcu_has_membarrier = 1;
+        }
+#endif
+}
+
+/* full fence on the calling thread and on all running reader threads */
+static void rcu_fence_readers(void)
+{
+#ifdef HAVE_LINUX_MEMBARRIER_H
+        if(rcu_has_membarrier
+           && syscall(__NR_membarrier,
+                      MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0) == 0)
+        {
+                return;
+        }
+#endif
+        atomic_thread_fence(memory_order_seq_cst);
+}
+
+void rcu_register_thread(void)
+{
+        /* before any reader of this thread reads rcu_has_membarrier */
+        pthread_once(&rcu_membarrier_once, rcu_membarrier_init);
+
+        atomic_store_explicit(&rcu_reader_self.ctr, 0, memory_order_relaxed);
+        rcu_reader_self.nesting = 0;
+
+        pthread_mutex_lock(&rcu_registry_lock);
+        list_add(&rcu_reader_self.node, &rcu_registry);
+        pthread_mutex_unlock(&rcu_registry_lock);
+}
+
+void rcu_unregister_thread(void)
+{
+        pthread_mutex_lock(&rcu_registry_lock);
+        list_del(&rcu_reader_self.node);
+        pthread_mutex_unlock(&rcu_registry_lock);
+}
+
+/* smallest epoch of readers in a critical section (~0 if none) */
+static unsigned long rcu_readers_epoch(void)
+{
+        struct rcu_reader *reader = NULL;
+        unsigned long epoch = ~0UL,
+                ctr;
+
+        /* pairs with the fence of rcu_read_lock() */
+        rcu_fence_readers();
+
+        pthread_mutex_lock(&rcu_registry_lock);
+        list_for_each_entry(reader, &rcu_registry, node)
+        {
+                ctr = atomic_load_explicit(&reader->ctr, memory_order_acquire);
+                if(ctr != 0 && ctr < epoch)
+                {
+                        epoch = ctr;
+                }
+        }
+        pthread_mutex_unlock(&rcu_registry_lock);
+
+        return epoch;
+}
+
+void synchronize_rcu(void)
+{
+        struct rcu_reader *reader = NULL;
+        unsigned long epoch;
+        unsigned long ctr;
+
+        /* readers which start after this see the update */
+        epoch = atomic_fetch_add_explicit(&rcu_gp_epoch, 1,
+                                          memory_order_acq_rel) + 1;
+
+        rcu_fence_readers();
+
+        pthread_mutex_lock(&rcu_registry_lock);
+        list_for_each_entry(reader, &rcu_registry, node)
+        {
+                for(;;)
+                {
+                        ctr = atomic_load_explicit(&reader->ctr,
+                                                   memory_order_acquire);
+                        if(ctr == 0 || ctr >= epoch)
+                        {
+                                break;
+                        }
+
+                        sched_yield();
+                }
+        }
+        pthread_mutex_unlock(&rcu_registry_lock);
+}
+
+/* call functions of a list of rcu_head */
+static unsigned int rcu_call(struct list_head *list)
+{
+        struct rcu_head *head = NULL,
+                *tmp = NULL;
+        unsigned int count = 0;
+
+        list_for_each_entry_safe(head, tmp, list, node)
+        {
+                list_del(&head->node);
+                head->func(head);
+                ++count;
+        }
+
+        return count;
+}
+
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head))
+{
+        int reclaim;
+
+        head->func = func;
+
+        pthread_mutex_lock(&rcu_defer_lock);
+
+        /*
+         * readers which can see the object have an epoch <= the current
+         * one. Increment it so we can tell them from new readers.
+         */
+        head->epoch = atomic_fetch_add_explicit(&rcu_gp_epoch, 1,
+                                                memory_order_acq_rel);
+        list_add_tail(&head->node, &rcu_defer_list);
+        reclaim = (++rcu_defer_count % RCU_DEFER_BATCH == 0);
+
+        pthread_mutex_unlock(&rcu_defer_lock);
+
+        if(reclaim)
+        {
+                rcu_reclaim();
+        }
+}
+
+unsigned int rcu_reclaim(void)
+{
+        LIST_HEAD(ready);
+        struct rcu_head *head = NULL,
+                *tmp = NULL;
+        unsigned long epoch;
+
+        epoch = rcu_readers_epoch();
+
+        pthread_mutex_lock(&rcu_defer_lock);
+        list_for_each_entry_safe(head, tmp, &rcu_defer_list, node)
+        {
+                if(head->epoch >= epoch)
+                {
+                        break;
+                }
+
+                list_move_tail(&head->node, &ready);
+                --rcu_defer_count;
+        }
+        pthread_mutex_unlock(&rcu_defer_lock);
+
+        return rcu_call(&ready);
+}
+
+unsigned int rcu_barrier(void)
+{
+        LIST_HEAD(ready);
+
+        pthread_mutex_lock(&rcu_defer_lock);
+        list_splice_init(&rcu_defer_list, &ready);
+        rcu_defer_count = 0;
+        pthread_mutex_unlock(&rcu_defer_lock);
+
+        synchronize_rcu();
+
+        return rcu_call(&ready);
+}
@@ -18,6 +18,10 @@
  */
 
 #include "flibc/str.h"
+#include "flibc/arena.h"
+#include "flibc/list_sort.h"
+#include "flibc/pool.h"
+#include "flibc/str_intern.h"
 
 #include <errno.h>
 #include <stdlib.h>
@@ -106,49 +110,70 @@ int str_empty(const char *str)
         return (str[0] == '\0');
 }
 
-unsigned int str_split(const char *str, const char *sep,
-		       struct str_list *list)
+static int str_list_add_len(struct str_list *list, const char *str,
+                            size_t len);
+
+/* add words of str to list */
+static unsigned int str_split_append(const char *str, const char *sep,
+                                     struct str_list *list)
 {
-	char *strrw = NULL,
-		*strrw_p = NULL,
-		*sep_in_str = NULL;
+	const char *sep_in_str = NULL;
 	size_t len_sep = strlen(sep);
 
-        str_list_init(list);
-
-	strrw = strdup(str);
-	if(strrw == NULL)
-	{
-		return 0;
-	}
-
-	strrw_p = strrw;
-	while((sep_in_str = strstr(strrw_p, sep)) != NULL)
+	while((sep_in_str = strstr(str, sep)) != NULL)
 	{
-		*sep_in_str = '\0';
-
-		if(str_list_add(list, strrw_p) != 0)
+		if(str_list_add_len(list, str, (size_t) (sep_in_str - str)) != 0)
 		{
 			str_list_cleanup(list);
-			goto ex_on_populate;
+			return 0;
 		}
 
-		strrw_p = sep_in_str + len_sep;
+		str = sep_in_str + len_sep;
 	}
 
 	/* copy the last argument */
-	if(str_list_add(list, strrw_p) != 0)
+	if(str_list_add(list, str) != 0)
 	{
 		str_list_cleanup(list);
-		goto ex_on_populate;
+		return 0;
 	}
 
-ex_on_populate:
-	free(strrw);
-
 	return str_list_length(list);
 }
 
+unsigned int str_split(const char *str, const char *sep,
+		       struct str_list *list)
+{
+        str_list_init(list);
+
+        return str_split_append(str, sep, list);
+}
+
+unsigned int str_split_pool(const char *str, const char *sep,
+                            struct str_list *list, struct pool *pool)
+{
+        str_list_init_pool(list, pool);
+
+        return str_split_append(str, sep, list);
+}
+
+unsigned int str_split_arena(const char *str, const char *sep,
+                             struct str_list *list, struct arena *arena)
+{
+        str_list_init_arena(list, arena);
+
+        return str_split_append(str, sep, list);
+}
+
+unsigned int str_split_intern(const char *str, const char *sep,
+                              struct str_list *list,
+                              struct str_intern *intern)
+{
+        str_list_init_intern(list, intern);
+
+        return str_split_append(str, sep, list);
+}
+
 const char* str_ltrim(const char *str, const char *trimchr)
 {
         while(*str != '\0')
@@ -255,22 +280,137 @@ void str_list_init(struct str_list *list)
 {
         INIT_LIST_HEAD(&list->head);
 	list->count = 0;
+        list->pool = NULL;
+        list->arena = NULL;
+        list->intern = NULL;
 }
 
-int str_list_add(struct str_list *list, const char *str)
+void str_list_init_pool(struct str_list *list, struct pool *pool)
+{
+        str_list_init(list);
+        list->pool = pool;
+}
+
+void str_list_init_arena(struct str_list *list, struct arena *arena)
+{
+        str_list_init(list);
+        list->arena = arena;
+}
+
+void str_list_init_intern(struct str_list *list, struct str_intern *intern)
+{
+        str_list_init(list);
+        list->intern = intern;
+}
+
+/* value stored right after the item, in its block (malloc, pool or arena) */
+#define str_list_item_inline(item) ((char *) ((item) + 1))
+
+static struct str_list_item *str_list_item_new(struct str_list *list,
+                                               const char *str, size_t len)
 {
 	struct str_list_item *item;
+        const char *interned;
 
-	item = calloc(1, sizeof(*item));
-	if(item == NULL)
-	{
-		return -1;
-	}
+        if(list->intern != NULL)
+        {
+                interned = str_intern(list->intern, str, len);
+                if(interned == NULL
+                   || (item = malloc(sizeof(*item))) == NULL)
+                {
+                        return NULL;
+                }
 
-	item->value = strdup(str);
-	if(item->value == NULL)
+                /* shared and never written */
+                item->value = (char *) interned;
+
+                return item;
+        }
+        else if(list->arena != NULL)
+        {
+                item = arena_alloc(list->arena, sizeof(*item) + len + 1);
+                if(item == NULL)
+                {
+                        return NULL;
+                }
+
+                item->value = str_list_item_inline(item);
+        }
+        else if(list->pool != NULL)
+        {
+                item = pool_alloc(list->pool);
+                if(item == NULL)
+                {
+                        return NULL;
+                }
+
+                if(len < list->pool->size - sizeof(*item))
+                {
+                        item->value = str_list_item_inline(item);
+                }
+                else if((item->value = malloc(len + 1)) == NULL)
+                {
+                        pool_free(list->pool, item);
+                        return NULL;
+                }
+        }
+        else
+        {
+                /* one allocation for the item and its value */
+                item = malloc(sizeof(*item) + len + 1);
+                if(item == NULL)
+                {
+                        return NULL;
+                }
+
+                item->value = str_list_item_inline(item);
+        }
+
+        memcpy(item->value, str, len);
+        item->value[len] = '\0';
+
+        return item;
+}
+
+static void str_list_item_free(struct str_list *list,
+                               struct str_list_item *item)
+{
+        if(list->arena != NULL)
+        {
+                /* freed by arena_reset() */
+                return;
+        }
+
+        if(list->intern != NULL)
+        {
+                /* the value belongs to the intern table */
+                free(item);
+                return;
+        }
+
+        if(item->value != str_list_item_inline(item))
+        {
+                free(item->value);
+        }
+
+        if(list->pool != NULL)
+        {
+                pool_free(list->pool, item);
+        }
+        else
+        {
+                free(item);
+        }
+}
+
+static int str_list_add_len(struct str_list *list, const char *str,
+                            size_t len)
+{
+	struct str_list_item *item;
+
+	item = str_list_item_new(list, str, len);
+	if(item == NULL)
 	{
-		free(item);
 		return -1;
 	}
 
@@ -280,6 +420,11 @@ int str_list_add(struct str_list *list, const char *str)
 	return 0;
 }
 
+int str_list_add(struct str_list *list, const char *str)
+{
+        return str_list_add_len(list, str, strlen(str));
+}
+
 int str_list_remove(struct str_list *list, const char *str)
 {
         struct str_list_item *item = NULL,
@@ -290,9 +435,8 @@ int str_list_remove(struct str_list *list, const char *str)
         {
 		if(strcmp(item->value, str) == 0)
 		{
-			free(item->value);
-			free(item);
 			list_del(&(item->node));
+			str_list_item_free(list, item);
 			++found;
 			--list->count;
 		}
@@ -313,9 +457,8 @@ void str_list_cleanup(struct str_list *list)
 
         list_for_each_entry_safe(item, item_safe, &list->head, node)
         {
-                free(item->value);
-                free(item);
                 list_del(&(item->node));
+                str_list_item_free(list, item);
         }
 
 	list->count = 0;
@@ -341,3 +484,56 @@ unsigned int str_list_toarray(struct str_list *list,
 
 	return count;
 }
+
+int str_list_tovec(struct str_list *list, struct str_vec *vec)
+{
+        struct str_list_item *item = NULL;
+
+        if(str_vec_reserve(vec, vec->len + list->count) != 0)
+        {
+                return -1;
+        }
+
+        list_for_each_entry(item, &list->head, node)
+        {
+                vec->data[vec->len++] = item->value;
+        }
+
+        return 0;
+}
+
+int str_lencmp(const char *a, const char *b)
+{
+        size_t a_len = strlen(a),
+                b_len = strlen(b);
+
+        if(a_len != b_len)
+        {
+                return a_len < b_len ? -1 : 1;
+        }
+
+        return memcmp(a, b, a_len);
+}
+
+struct str_list_sort_priv {
+        int (*cmp)(const char *a, const char *b);
+};
+
+static int str_list_sort_cmp(void *priv, const struct list_head *a,
+                             const struct list_head *b)
+{
+        struct str_list_sort_priv *sort = priv;
+
+        return sort->cmp(list_entry(a, const struct str_list_item, node)->value,
+                         list_entry(b, const struct str_list_item, node)->value);
+}
+
+void str_list_sort(struct str_list *list,
+                   int (*cmp)(const char *a, const char *b))
+{
+        struct str_list_sort_priv sort;
+
+        sort.cmp = (cmp != NULL ? cmp : strcmp);
+
+        list_sort(&sort, &list->head, str_list_sort_cmp);
+}
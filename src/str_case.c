@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ASCII case folding, case-insensitive compare and search.
+ *
+ *  Locale-free: only A-Z and a-z are folded, other bytes (UTF-8
+ *  included) are compared as is. SSE2 (always there on x86-64) folds 16
+ *  bytes at once: bytes in the range are found with two signed compares
+ *  (bytes >= 0x80 are negative, so never in the range) and get 0x20
+ *  flipped.
+ */
+
+#include "flibc/str.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static inline unsigned char str_case_lower(unsigned char c)
+{
+        return (unsigned char)(c - 'A') < 26 ? (unsigned char)(c | 0x20) : c;
+}
+
+#ifdef __SSE2__
+
+/* flip 0x20 of bytes from first to last */
+static inline __m128i str_case_flip(__m128i input, char first, char last)
+{
+        __m128i in_range = _mm_and_si128(
+                _mm_cmpgt_epi8(input, _mm_set1_epi8((char)(first - 1))),
+                _mm_cmplt_epi8(input, _mm_set1_epi8((char)(last + 1))));
+
+        return _mm_xor_si128(input,
+                             _mm_and_si128(in_range, _mm_set1_epi8(0x20)));
+}
+
+static inline __m128i str_case_lower16(__m128i input)
+{
+        return str_case_flip(input, 'A', 'Z');
+}
+
+#endif
+
+/*
+ * Copy len bytes from src to dst, flipping the case of the letters from
+ * first to last ('A'-'Z' or 'a'-'z').
+ */
+static void str_case_convert(char *dst, const char *src, size_t len,
+                             char first, char last)
+{
+        size_t i = 0;
+
+#ifdef __SSE2__
+        for(; i + 16 <= len; i += 16)
+        {
+                __m128i input = _mm_loadu_si128((const __m128i *)(src + i));
+
+                _mm_storeu_si128((__m128i *)(dst + i),
+                                 str_case_flip(input, first, last));
+        }
+#endif
+
+        for(; i < len; ++i)
+        {
+                dst[i] = (char)(src[i] >= first && src[i] <= last ?
+                                src[i] ^ 0x20 : src[i]);
+        }
+}
+
+void str_tolower_len(char *dst, const char *src, size_t len)
+{
+        str_case_convert(dst, src, len, 'A', 'Z');
+}
+
+void str_toupper_len(char *dst, const char *src, size_t len)
+{
+        str_case_convert(dst, src, len, 'a', 'z');
+}
+
+char *str_tolower(char *str)
+{
+        str_tolower_len(str, str, strlen(str));
+
+        return str;
+}
+
+char *str_toupper(char *str)
+{
+        str_toupper_len(str, str, strlen(str));
+
+        return str;
+}
+
+/*
+ * str_copy() with a conversion
+ */
+static size_t str_case_copy(char *dst, size_t dst_size, const char *src,
+                            void (*convert)(char *, const char *, size_t))
+{
+        size_t src_len = strlen(src),
+                n = src_len < dst_size ? src_len : dst_size - 1;
+
+        convert(dst, src, n);
+        dst[n] = '\0';
+
+        return src_len;
+}
+
+size_t str_tolower_copy(char *dst, size_t dst_size, const char *src)
+{
+        return str_case_copy(dst, dst_size, src, str_tolower_len);
+}
+
+size_t str_toupper_copy(char *dst, size_t dst_size, const char *src)
+{
+        return str_case_copy(dst, dst_size, src, str_toupper_len);
+}
+
+/*
+ * Index of the first byte differing between a and b (case folded) in
+ * the first len bytes, len if none.
+ */
+static size_t str_case_mismatch(const char *a, const char *b, size_t len)
+{
+        size_t i = 0;
+
+#ifdef __SSE2__
+        for(; i + 16 <= len; i += 16)
+        {
+                __m128i va = _mm_loadu_si128((const __m128i *)(a + i)),
+                        vb = _mm_loadu_si128((const __m128i *)(b + i));
+                unsigned int equal = (unsigned int)_mm_movemask_epi8(
+                        _mm_cmpeq_epi8(str_case_lower16(va),
+                                       str_case_lower16(vb)));
+
+                if(equal != 0xffff)
+                {
+                        return i + (size_t)__builtin_ctz(~equal);
+                }
+        }
+#endif
+
+        for(; i < len; ++i)
+        {
+                if(str_case_lower((unsigned char)a[i])
+                   != str_case_lower((unsigned char)b[i]))
+                {
+                        break;
+                }
+        }
+
+        return i;
+}
+
+int str_casecmp_len(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+        size_t len = a_len < b_len ? a_len : b_len,
+                i = str_case_mismatch(a, b, len);
+
+        if(i < len)
+        {
+                return str_case_lower((unsigned char)a[i])
+                        - str_case_lower((unsigned char)b[i]);
+        }
+
+        return (a_len > b_len) - (a_len < b_len);
+}
+
+int str_casecmp(const char *a, const char *b)
+{
+        return str_casecmp_len(a, strlen(a), b, strlen(b));
+}
+
+int str_casestartwith(const char *haystack, const char *word)
+{
+        size_t word_len = strlen(word);
+
+        return strnlen(haystack, word_len) == word_len
+                && str_case_mismatch(haystack, word, word_len) == word_len;
+}
+
+int str_caseendwith(const char *haystack, const char *word)
+{
+        size_t word_len = strlen(word),
+                haystack_len = strlen(haystack);
+
+        return word_len <= haystack_len
+                && str_case_mismatch(haystack + haystack_len - word_len,
+                                     word, word_len) == word_len;
+}
+
+const char *str_casestr_len(const char *haystack, size_t haystack_len,
+                            const char *needle, size_t needle_len)
+{
+        unsigned char first,
+                last;
+        size_t i = 0;
+
+        if(needle_len == 0)
+        {
+                return haystack;
+        }
+        if(needle_len > haystack_len)
+        {
+                return NULL;
+        }
+
+        first = str_case_lower((unsigned char)needle[0]);
+        last = str_case_lower((unsigned char)needle[needle_len - 1]);
+
+#ifdef __SSE2__
+        /*
+         * Candidates are positions where the first and last bytes of the
+         * needle match, 16 at once (W. Mula's "SIMD-friendly algorithms
+         * for substring searching").
+         */
+        {
+                const __m128i vfirst = _mm_set1_epi8((char)first),
+                        vlast = _mm_set1_epi8((char)last);
+
+                for(; i + needle_len - 1 + 16 <= haystack_len; i += 16)
+                {
+                        __m128i block_first = _mm_loadu_si128(
+                                (const __m128i *)(haystack + i)),
+                                block_last = _mm_loadu_si128(
+                                (const __m128i *)(haystack + i
+                                                  + needle_len - 1));
+                        unsigned int mask = (unsigned int)_mm_movemask_epi8(
+                                _mm_and_si128(
+                                        _mm_cmpeq_epi8(
+                                                str_case_lower16(block_first),
+                                                vfirst),
+                                        _mm_cmpeq_epi8(
+                                                str_case_lower16(block_last),
+                                                vlast)));
+
+                        while(mask != 0)
+                        {
+                                size_t pos = i + (size_t)__builtin_ctz(mask);
+
+                                if(str_case_mismatch(haystack + pos, needle,
+                                                     needle_len)
+                                   == needle_len)
+                                {
+                                        return haystack + pos;
+                                }
+                                mask &= mask - 1;
+                        }
+                }
+        }
+#endif
+
+        for(; i + needle_len <= haystack_len; ++i)
+        {
+                if(str_case_lower((unsigned char)haystack[i]) == first
+                   && str_case_mismatch(haystack + i, needle, needle_len)
+                   == needle_len)
+                {
+                        return haystack + i;
+                }
+        }
+
+        return NULL;
+}
+
+const char *str_casestr(const char *haystack, const char *needle)
+{
+        return str_casestr_len(haystack, strlen(haystack),
+                               needle, strlen(needle));
+}
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/str_intern.h"
+#include "flibc/hash.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <sys/random.h>
+
+#define STR_INTERN_MAX_SHARDS_BITS 8
+
+/*
+ * Random seed of a table: from the kernel, or from the clock and the
+ * address of the table if it can't give one now.
+ */
+static uint64_t str_intern_seed(const struct str_intern *table)
+{
+        struct timespec ts;
+        uint64_t seed;
+
+        if(getrandom(&seed, sizeof(seed), GRND_NONBLOCK)
+           == (ssize_t)sizeof(seed))
+        {
+                return seed;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        seed = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+
+        return hash_mem_seed(&table, sizeof(table), seed);
+}
+
+static int str_intern_shard_init(struct str_intern_shard *shard)
+{
+        shard->slots = calloc(STR_INTERN_MIN_SLOTS, sizeof(*shard->slots));
+        if(shard->slots == NULL)
+        {
+                return -1;
+        }
+        shard->mask = STR_INTERN_MIN_SLOTS - 1;
+        shard->count = 0;
+
+        if(arena_init(&shard->arena, 0, 0) != 0)
+        {
+                free(shard->slots);
+                return -1;
+        }
+
+        if(pthread_mutex_init(&shard->lock, NULL) != 0)
+        {
+                arena_cleanup(&shard->arena);
+                free(shard->slots);
+                return -1;
+        }
+
+        return 0;
+}
+
+static void str_intern_shard_cleanup(struct str_intern_shard *shard)
+{
+        pthread_mutex_destroy(&shard->lock);
+        arena_cleanup(&shard->arena);
+        free(shard->slots);
+}
+
+int str_intern_init(struct str_intern *table, unsigned int shards)
+{
+        unsigned int count,
+                i;
+        void *mem;
+
+        table->seed = str_intern_seed(table);
+        table->locked = shards > 0;
+        table->shards_bits = 0;
+        while(table->shards_bits < STR_INTERN_MAX_SHARDS_BITS
+              && (1U << table->shards_bits) < shards)
+        {
+                ++table->shards_bits;
+        }
+        count = 1U << table->shards_bits;
+
+        if(posix_memalign(&mem, STR_INTERN_CACHELINE_SIZE,
+                          count * sizeof(*table->shards)) != 0)
+        {
+                return -1;
+        }
+        table->shards = mem;
+
+        for(i = 0; i < count; ++i)
+        {
+                if(str_intern_shard_init(&table->shards[i]) != 0)
+                {
+                        while(i-- > 0)
+                        {
+                                str_intern_shard_cleanup(&table->shards[i]);
+                        }
+                        free(table->shards);
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+void str_intern_cleanup(struct str_intern *table)
+{
+        unsigned int i;
+
+        for(i = 0; i < 1U << table->shards_bits; ++i)
+        {
+                str_intern_shard_cleanup(&table->shards[i]);
+        }
+        free(table->shards);
+        table->shards = NULL;
+}
+
+/*
+ * Tag kept in a slot to skip most string compares: the 32 bits of the
+ * hash right above the slot index (the top ones choose the shard, so
+ * they are the same for all the strings of a shard).
+ */
+static inline uint32_t str_intern_tag(uint64_t hash, size_t mask)
+{
+        return (uint32_t)(hash >> __builtin_ctzll((unsigned long long)mask
+                                                  + 1));
+}
+
+/*
+ * Slot of str in a shard: the one holding it, or the empty one where it
+ * goes. The low bits of the hash give the first slot.
+ */
+static struct str_intern_slot *str_intern_lookup(struct str_intern_slot *slots,
+                                                 size_t mask, uint64_t hash,
+                                                 const char *str, size_t len)
+{
+        struct str_intern_slot *slot;
+        uint32_t tag = str_intern_tag(hash, mask);
+        size_t i = (size_t)hash & mask;
+
+        for(;; i = (i + 1) & mask)
+        {
+                slot = &slots[i];
+                if(slot->str == NULL
+                   || (slot->tag == tag && slot->len == len
+                       && memcmp(slot->str, str, len) == 0))
+                {
+                        return slot;
+                }
+        }
+}
+
+static int str_intern_grow(struct str_intern_shard *shard, uint64_t seed)
+{
+        struct str_intern_slot *slots,
+                *slot,
+                *dst;
+        size_t mask = shard->mask * 2 + 1,
+                i;
+        uint64_t hash;
+
+        slots = calloc(mask + 1, sizeof(*slots));
+        if(slots == NULL)
+        {
+                return -1;
+        }
+
+        /* only the tag is kept: hash strings again */
+        for(i = 0; i <= shard->mask; ++i)
+        {
+                slot = &shard->slots[i];
+                if(slot->str != NULL)
+                {
+                        hash = hash_mem_seed(slot->str, slot->len, seed);
+                        dst = str_intern_lookup(slots, mask, hash,
+                                                slot->str, slot->len);
+                        *dst = *slot;
+                        dst->tag = str_intern_tag(hash, mask);
+                }
+        }
+
+        free(shard->slots);
+        shard->slots = slots;
+        shard->mask = mask;
+
+        return 0;
+}
+
+static struct str_intern_shard *str_intern_shard(struct str_intern *table,
+                                                 uint64_t hash)
+{
+        /* high bits, the low ones index the slots */
+        return &table->shards[table->shards_bits ?
+                              hash >> (64 - table->shards_bits) : 0];
+}
+
+const char *str_intern(struct str_intern *table, const char *str, size_t len)
+{
+        uint64_t hash = hash_mem_seed(str, len, table->seed);
+        struct str_intern_shard *shard = str_intern_shard(table, hash);
+        struct str_intern_slot *slot;
+        const char *interned = NULL;
+        char *copy;
+
+        if(len > UINT32_MAX)
+        {
+                return NULL;
+        }
+
+        if(table->locked)
+        {
+                pthread_mutex_lock(&shard->lock);
+        }
+
+        slot = str_intern_lookup(shard->slots, shard->mask, hash, str, len);
+        if(slot->str != NULL)
+        {
+                interned = slot->str;
+                goto out;
+        }
+
+        /* at most half full */
+        if((shard->count + 1) * 2 > shard->mask + 1)
+        {
+                if(str_intern_grow(shard, table->seed) != 0)
+                {
+                        goto out;
+                }
+                slot = str_intern_lookup(shard->slots, shard->mask, hash,
+                                         str, len);
+        }
+
+        /* not arena_strndup(): str may hold null bytes */
+        copy = arena_alloc_align(&shard->arena, len + 1, 1);
+        if(copy != NULL)
+        {
+                memcpy(copy, str, len);
+                copy[len] = '\0';
+
+                slot->tag = str_intern_tag(hash, shard->mask);
+                slot->len = (uint32_t)len;
+                slot->str = interned = copy;
+                ++shard->count;
+        }
+
+out:
+        if(table->locked)
+        {
+                pthread_mutex_unlock(&shard->lock);
+        }
+
+        return interned;
+}
+
+const char *str_intern_find(struct str_intern *table, const char *str,
+                            size_t len)
+{
+        uint64_t hash = hash_mem_seed(str, len, table->seed);
+        struct str_intern_shard *shard = str_intern_shard(table, hash);
+        const char *found;
+
+        if(table->locked)
+        {
+                pthread_mutex_lock(&shard->lock);
+        }
+
+        found = str_intern_lookup(shard->slots, shard->mask, hash, str,
+                                  len)->str;
+
+        if(table->locked)
+        {
+                pthread_mutex_unlock(&shard->lock);
+        }
+
+        return found;
+}
+
+size_t str_intern_count(struct str_intern *table)
+{
+        size_t count = 0;
+        unsigned int i;
+
+        for(i = 0; i < 1U << table->shards_bits; ++i)
+        {
+                if(table->locked)
+                {
+                        pthread_mutex_lock(&table->shards[i].lock);
+                }
+                count += table->shards[i].count;
+                if(table->locked)
+                {
+                        pthread_mutex_unlock(&table->shards[i].lock);
+                }
+        }
+
+        return count;
+}
@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/str_multi.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void str_multi_init(struct str_multi *multi)
+{
+        memset(multi, 0, sizeof(*multi));
+        str_multi_pattern_vec_init(&multi->patterns);
+}
+
+static void str_multi_free_automaton(struct str_multi *multi)
+{
+        free(multi->transitions);
+        free(multi->depth);
+        free(multi->match);
+        multi->transitions = NULL;
+        multi->depth = NULL;
+        multi->match = NULL;
+        multi->states = 0;
+}
+
+void str_multi_cleanup(struct str_multi *multi)
+{
+        struct str_multi_pattern *pattern;
+
+        str_multi_free_automaton(multi);
+
+        vec_for_each(pattern, &multi->patterns)
+        {
+                free(pattern->pattern);
+                free(pattern->replacement);
+        }
+        str_multi_pattern_vec_cleanup(&multi->patterns);
+}
+
+int str_multi_add(struct str_multi *multi, const char *pattern,
+                  const char *replacement)
+{
+        struct str_multi_pattern item;
+
+        if(pattern[0] == '\0' || vec_len(&multi->patterns) >= STR_MULTI_NONE)
+        {
+                return -1;
+        }
+
+        item.len = strlen(pattern);
+        item.pattern = strdup(pattern);
+        item.replacement_len = replacement ? strlen(replacement) : 0;
+        item.replacement = strdup(replacement ? replacement : "");
+        if(item.pattern == NULL || item.replacement == NULL
+           || str_multi_pattern_vec_push(&multi->patterns, item) != 0)
+        {
+                free(item.pattern);
+                free(item.replacement);
+                return -1;
+        }
+
+        str_multi_free_automaton(multi);
+
+        return (int)vec_len(&multi->patterns) - 1;
+}
+
+/*
+ * Bytes of the patterns get a class each, other bytes are class 0.
+ */
+static void str_multi_build_classes(struct str_multi *multi)
+{
+        const struct str_multi_pattern *pattern;
+        unsigned char used[256];
+        size_t i;
+
+        memset(used, 0, sizeof(used));
+        vec_for_each(pattern, &multi->patterns)
+        {
+                for(i = 0; i < pattern->len; ++i)
+                {
+                        used[(unsigned char)pattern->pattern[i]] = 1;
+                }
+        }
+
+        multi->classes = 1;
+        for(i = 0; i < 256; ++i)
+        {
+                multi->byte_class[i] = used[i] ?
+                        (unsigned char)multi->classes++ : 0;
+        }
+}
+
+int str_multi_compile(struct str_multi *multi)
+{
+        const struct str_multi_pattern *pattern;
+        unsigned int *fail = NULL,
+                *queue = NULL,
+                *row,
+                head = 0,
+                tail = 0,
+                max_states = 1,
+                state,
+                next,
+                c;
+        size_t i;
+
+        str_multi_free_automaton(multi);
+        str_multi_build_classes(multi);
+
+        vec_for_each(pattern, &multi->patterns)
+        {
+                if(pattern->len >= STR_MULTI_NONE - max_states)
+                {
+                        return -1;
+                }
+                max_states += (unsigned int)pattern->len;
+        }
+
+        /* 0 is the root, and "no edge" while building the trie */
+        multi->transitions = calloc((size_t)max_states * multi->classes,
+                                    sizeof(*multi->transitions));
+        multi->depth = calloc(max_states, sizeof(*multi->depth));
+        multi->match = malloc(max_states * sizeof(*multi->match));
+        fail = calloc(max_states, sizeof(*fail));
+        queue = malloc(max_states * sizeof(*queue));
+        if(multi->transitions == NULL || multi->depth == NULL
+           || multi->match == NULL || fail == NULL || queue == NULL)
+        {
+                goto error;
+        }
+        for(state = 0; state < max_states; ++state)
+        {
+                multi->match[state] = STR_MULTI_NONE;
+        }
+
+        /* trie */
+        multi->states = 1;
+        vec_for_each(pattern, &multi->patterns)
+        {
+                state = 0;
+                for(i = 0; i < pattern->len; ++i)
+                {
+                        row = multi->transitions + (size_t)state
+                                * multi->classes;
+                        c = multi->byte_class[(unsigned char)
+                                              pattern->pattern[i]];
+                        if(row[c] == 0)
+                        {
+                                row[c] = multi->states;
+                                multi->depth[multi->states] = i + 1;
+                                ++multi->states;
+                        }
+                        state = row[c];
+                }
+                if(multi->match[state] == STR_MULTI_NONE)
+                {
+                        multi->match[state] =
+                                (unsigned int)(pattern
+                                               - multi->patterns.data);
+                }
+        }
+
+        multi->start_bytes = 0;
+        for(i = 0; i < 256; ++i)
+        {
+                if(multi->transitions[multi->byte_class[i]] != 0)
+                {
+                        multi->start_byte = (unsigned char)i;
+                        ++multi->start_bytes;
+                }
+        }
+
+        /*
+         * Breadth first: the failure state of a state (its longest
+         * proper suffix in the trie) is less deep, so its transitions
+         * are complete when we take them for missing edges.
+         */
+        row = multi->transitions;
+        for(c = 0; c < multi->classes; ++c)
+        {
+                if(row[c] != 0)
+                {
+                        queue[tail++] = row[c];
+                }
+        }
+
+        while(head < tail)
+        {
+                state = queue[head++];
+                row = multi->transitions + (size_t)state * multi->classes;
+
+                /* longest pattern which is a suffix of this state */
+                if(multi->match[state] == STR_MULTI_NONE)
+                {
+                        multi->match[state] = multi->match[fail[state]];
+                }
+
+                for(c = 0; c < multi->classes; ++c)
+                {
+                        next = multi->transitions[(size_t)fail[state]
+                                                  * multi->classes + c];
+                        if(row[c] != 0)
+                        {
+                                fail[row[c]] = next;
+                                queue[tail++] = row[c];
+                        }
+                        else
+                        {
+                                row[c] = next;
+                        }
+                }
+        }
+
+        free(fail);
+        free(queue);
+
+        return 0;
+
+error:
+        free(fail);
+        free(queue);
+        str_multi_free_automaton(multi);
+
+        return -1;
+}
+
+/*
+ * Skip bytes which don't start a pattern (the root stays the root): one
+ * independent lookup per byte, or memchr() if all the patterns start
+ * with the same byte.
+ */
+static size_t str_multi_skip(const struct str_multi *multi, const char *str,
+                             size_t len, size_t i)
+{
+        const char *p;
+
+        if(multi->start_bytes == 1)
+        {
+                p = memchr(str + i, multi->start_byte, len - i);
+                return p ? (size_t)(p - str) : len;
+        }
+
+        while(i < len
+              && multi->transitions[multi->byte_class[(unsigned char)str[i]]]
+              == 0)
+        {
+                ++i;
+        }
+
+        return i;
+}
+
+int str_multi_find(const struct str_multi *multi, const char *str,
+                   size_t len, struct str_multi_match *match)
+{
+        const struct str_multi_pattern *pattern;
+        unsigned int state = 0,
+                found = 0;
+        size_t i,
+                start;
+
+        if(multi->transitions == NULL)
+        {
+                return 0;
+        }
+
+        for(i = 0; i < len; ++i)
+        {
+                if(state == 0 && !found)
+                {
+                        i = str_multi_skip(multi, str, len, i);
+                        if(i == len)
+                        {
+                                break;
+                        }
+                }
+
+                state = multi->transitions[(size_t)state * multi->classes
+                                           + multi->byte_class[
+                                                   (unsigned char)str[i]]];
+
+                /* no match can start at or before the one found anymore */
+                if(found && i + 1 - multi->depth[state] > match->offset)
+                {
+                        break;
+                }
+
+                if(multi->match[state] == STR_MULTI_NONE)
+                {
+                        continue;
+                }
+
+                pattern = &vec_at(&multi->patterns, multi->match[state]);
+                start = i + 1 - pattern->len;
+                if(!found || start < match->offset
+                   || (start == match->offset && pattern->len > match->len))
+                {
+                        match->index = multi->match[state];
+                        match->offset = start;
+                        match->len = pattern->len;
+                        found = 1;
+                }
+        }
+
+        return (int)found;
+}
+
+/*
+ * Append n bytes to output, as much as possible on truncation
+ */
+static int str_multi_put(char *output, size_t output_size, size_t *used,
+                         const char *s, size_t n)
+{
+        size_t room = output_size - 1 - *used;
+
+        if(n > room)
+        {
+                memcpy(output + *used, s, room);
+                *used += room;
+                return -1;
+        }
+
+        memcpy(output + *used, s, n);
+        *used += n;
+
+        return 0;
+}
+
+int str_multi_replace(const struct str_multi *multi, const char *haystack,
+                      char *output, size_t output_size)
+{
+        const struct str_multi_pattern *pattern;
+        struct str_multi_match match;
+        size_t len = strlen(haystack),
+                pos = 0,
+                used = 0;
+        int ret = 0;
+
+        while(ret == 0 && str_multi_find(multi, haystack + pos, len - pos,
+                                         &match))
+        {
+                pattern = &vec_at(&multi->patterns, match.index);
+                ret = str_multi_put(output, output_size, &used,
+                                    haystack + pos, match.offset);
+                if(ret == 0)
+                {
+                        ret = str_multi_put(output, output_size, &used,
+                                            pattern->replacement,
+                                            pattern->replacement_len);
+                }
+                pos += match.offset + match.len;
+        }
+
+        if(ret == 0)
+        {
+                ret = str_multi_put(output, output_size, &used,
+                                    haystack + pos, len - pos);
+        }
+        output[used] = '\0';
+
+        return ret;
+}
@@ -0,0 +1,543 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * UTF-8 validation and code point counting.
+ *
+ *  The x86 versions (SSE4.1 and AVX2, chosen at the first call) use the
+ *  lookup algorithm of simdjson (J. Keiser, D. Lemire, "Validating UTF-8
+ *  in less than one instruction per byte"): each byte is classified with
+ *  the high nibble of the previous byte, its low nibble and the high
+ *  nibble of the byte itself, three table lookups whose results are
+ *  ANDed: any bit left is an error.
+ */
+
+#include "flibc/str.h"
+
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define STR_UTF8_X86 1
+#include <immintrin.h>
+#endif
+
+int str_utf8_valid_scalar(const char *str, size_t len)
+{
+        const unsigned char *s = (const unsigned char *)str,
+                *end = s + len;
+        uint64_t word;
+
+        while(s < end)
+        {
+                /* ASCII: 8 bytes at once */
+                if((size_t)(end - s) >= sizeof(word))
+                {
+                        memcpy(&word, s, sizeof(word));
+                        if((word & 0x8080808080808080ULL) == 0)
+                        {
+                                s += sizeof(word);
+                                continue;
+                        }
+                }
+
+                if(s[0] < 0x80)
+                {
+                        ++s;
+                }
+                else if(s[0] < 0xc2)
+                {
+                        /* continuation or overlong 2 bytes sequence */
+                        return 0;
+                }
+                else if(s[0] < 0xe0)
+                {
+                        if(end - s < 2 || (s[1] & 0xc0) != 0x80)
+                        {
+                                return 0;
+                        }
+                        s += 2;
+                }
+                else if(s[0] < 0xf0)
+                {
+                        if(end - s < 3
+                           || (s[1] & 0xc0) != 0x80
+                           || (s[2] & 0xc0) != 0x80
+                           /* overlong */
+                           || (s[0] == 0xe0 && s[1] < 0xa0)
+                           /* surrogate */
+                           || (s[0] == 0xed && s[1] >= 0xa0))
+                        {
+                                return 0;
+                        }
+                        s += 3;
+                }
+                else if(s[0] < 0xf5)
+                {
+                        if(end - s < 4
+                           || (s[1] & 0xc0) != 0x80
+                           || (s[2] & 0xc0) != 0x80
+                           || (s[3] & 0xc0) != 0x80
+                           /* overlong */
+                           || (s[0] == 0xf0 && s[1] < 0x90)
+                           /* above U+10FFFF */
+                           || (s[0] == 0xf4 && s[1] >= 0x90))
+                        {
+                                return 0;
+                        }
+                        s += 4;
+                }
+                else
+                {
+                        return 0;
+                }
+        }
+
+        return 1;
+}
+
+size_t str_utf8_len_scalar(const char *str, size_t len)
+{
+        size_t count = 0,
+                i;
+
+        /* every byte but continuation bytes (10xxxxxx) */
+        for(i = 0; i < len; ++i)
+        {
+                count += ((unsigned char)str[i] & 0xc0) != 0x80;
+        }
+
+        return count;
+}
+
+#ifdef STR_UTF8_X86
+
+/* errors found by the lookups (see simdjson's utf8_lookup4) */
+#define TOO_SHORT       (1 << 0) /* 11______ 0_______, 11______ 11______ */
+#define TOO_LONG        (1 << 1) /* 0_______ 10______ */
+#define OVERLONG_3      (1 << 2) /* 11100000 100_____ */
+#define TOO_LARGE       (1 << 3) /* 11110100 1001____, 11110101+ */
+#define SURROGATE       (1 << 4) /* 11101101 101_____ */
+#define OVERLONG_2      (1 << 5) /* 1100000_ 10______ */
+#define TOO_LARGE_1000  (1 << 6) /* 11110101+ 1000____ */
+#define OVERLONG_4      (1 << 6) /* 11110000 1000____ */
+#define TWO_CONTS       (1 << 7) /* 10______ 10______ */
+#define CARRY           (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+/* indexed by the high nibble of the previous byte */
+static const unsigned char utf8_byte_1_high[16] = {
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+};
+
+/* indexed by the low nibble of the previous byte */
+static const unsigned char utf8_byte_1_low[16] = {
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000
+};
+
+/* indexed by the high nibble of the byte */
+static const unsigned char utf8_byte_2_high[16] = {
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000
+        | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+};
+
+/*
+ * A block ending with these bytes has an incomplete sequence at its end
+ * if a byte is greater (the last one is a 2, 3 or 4 bytes lead, the one
+ * before a 3 or 4 bytes lead, the one before a 4 bytes lead).
+ */
+static const unsigned char utf8_max_value[32] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf
+};
+
+/*
+ * Errors of a 16 bytes block, prev_input being the block before.
+ */
+__attribute__((target("sse4.1")))
+static inline __m128i utf8_check_sse4(__m128i input, __m128i prev_input)
+{
+        const __m128i low_nibble = _mm_set1_epi8(0x0f);
+        __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15),
+                prev2 = _mm_alignr_epi8(input, prev_input, 14),
+                prev3 = _mm_alignr_epi8(input, prev_input, 13),
+                byte_1_high,
+                byte_1_low,
+                byte_2_high,
+                special_cases,
+                must23;
+
+        byte_1_high = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *)utf8_byte_1_high),
+                _mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble));
+        byte_1_low = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *)utf8_byte_1_low),
+                _mm_and_si128(prev1, low_nibble));
+        byte_2_high = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *)utf8_byte_2_high),
+                _mm_and_si128(_mm_srli_epi16(input, 4), low_nibble));
+        special_cases = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low),
+                                      byte_2_high);
+
+        /*
+         * Third and fourth bytes of 3 and 4 bytes sequences must be
+         * continuations: TWO_CONTS is expected there, and only there.
+         */
+        must23 = _mm_or_si128(
+                _mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80)),
+                _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80)));
+        must23 = _mm_and_si128(must23, _mm_set1_epi8((char)0x80));
+
+        return _mm_xor_si128(must23, special_cases);
+}
+
+__attribute__((target("sse4.1")))
+static int utf8_valid_sse4(const char *str, size_t len)
+{
+        const __m128i max_value =
+                _mm_loadu_si128((const __m128i *)(utf8_max_value + 16));
+        __m128i error = _mm_setzero_si128(),
+                prev_input = _mm_setzero_si128(),
+                prev_incomplete = _mm_setzero_si128(),
+                input;
+        char tail[16];
+        size_t i;
+
+        for(i = 0; i < len; i += 16)
+        {
+                if(len - i >= 16)
+                {
+                        input = _mm_loadu_si128((const __m128i *)(str + i));
+                }
+                else
+                {
+                        /* the tail, padded with ASCII */
+                        memset(tail, 0, sizeof(tail));
+                        memcpy(tail, str + i, len - i);
+                        input = _mm_loadu_si128((const __m128i *)tail);
+                }
+
+                if(_mm_movemask_epi8(input) == 0)
+                {
+                        error = _mm_or_si128(error, prev_incomplete);
+                }
+                else
+                {
+                        error = _mm_or_si128(error,
+                                             utf8_check_sse4(input,
+                                                             prev_input));
+                        prev_incomplete = _mm_subs_epu8(input, max_value);
+                }
+                prev_input = input;
+        }
+        error = _mm_or_si128(error, prev_incomplete);
+
+        return _mm_testz_si128(error, error);
+}
+
+__attribute__((target("sse4.1,popcnt")))
+static size_t utf8_len_sse4(const char *str, size_t len)
+{
+        /* continuation bytes are -128..-65 */
+        const __m128i last_cont = _mm_set1_epi8(-65);
+        size_t count = 0,
+                i;
+
+        for(i = 0; i + 16 <= len; i += 16)
+        {
+                __m128i input = _mm_loadu_si128((const __m128i *)(str + i));
+
+                count += (size_t)__builtin_popcount(
+                        (unsigned int)_mm_movemask_epi8(
+                                _mm_cmpgt_epi8(input, last_cont)));
+        }
+
+        return count + str_utf8_len_scalar(str + i, len - i);
+}
+
+/*
+ * Same as utf8_check_sse4() with 32 bytes blocks.
+ */
+__attribute__((target("avx2")))
+static inline __m256i utf8_check_avx2(__m256i input, __m256i prev_input)
+{
+        const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+        /* prev_input high lane and input low lane */
+        __m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21),
+                prev1 = _mm256_alignr_epi8(input, shifted, 15),
+                prev2 = _mm256_alignr_epi8(input, shifted, 14),
+                prev3 = _mm256_alignr_epi8(input, shifted, 13),
+                byte_1_high,
+                byte_1_low,
+                byte_2_high,
+                special_cases,
+                must23;
+
+        byte_1_high = _mm256_shuffle_epi8(
+                _mm256_broadcastsi128_si256(
+                        _mm_loadu_si128((const __m128i *)utf8_byte_1_high)),
+                _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble));
+        byte_1_low = _mm256_shuffle_epi8(
+                _mm256_broadcastsi128_si256(
+                        _mm_loadu_si128((const __m128i *)utf8_byte_1_low)),
+                _mm256_and_si256(prev1, low_nibble));
+        byte_2_high = _mm256_shuffle_epi8(
+                _mm256_broadcastsi128_si256(
+                        _mm_loadu_si128((const __m128i *)utf8_byte_2_high)),
+                _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble));
+        special_cases = _mm256_and_si256(
+                _mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+        must23 = _mm256_or_si256(
+                _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80)),
+                _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80)));
+        must23 = _mm256_and_si256(must23, _mm256_set1_epi8((char)0x80));
+
+        return _mm256_xor_si256(must23, special_cases);
+}
+
+__attribute__((target("avx2")))
+static int utf8_valid_avx2(const char *str, size_t len)
+{
+        const __m256i max_value =
+                _mm256_loadu_si256((const __m256i *)utf8_max_value);
+        __m256i error = _mm256_setzero_si256(),
+                prev_input = _mm256_setzero_si256(),
+                prev_incomplete = _mm256_setzero_si256(),
+                input;
+        char tail[32];
+        size_t i;
+
+        for(i = 0; i < len; i += 32)
+        {
+                if(len - i >= 32)
+                {
+                        input = _mm256_loadu_si256((const __m256i *)(str + i));
+                }
+                else
+                {
+                        memset(tail, 0, sizeof(tail));
+                        memcpy(tail, str + i, len - i);
+                        input = _mm256_loadu_si256((const __m256i *)tail);
+                }
+
+                if(_mm256_movemask_epi8(input) == 0)
+                {
+                        error = _mm256_or_si256(error, prev_incomplete);
+                }
+                else
+                {
+                        error = _mm256_or_si256(error,
+                                                utf8_check_avx2(input,
+                                                                prev_input));
+                        prev_incomplete = _mm256_subs_epu8(input, max_value);
+                }
+                prev_input = input;
+        }
+        error = _mm256_or_si256(error, prev_incomplete);
+
+        return _mm256_testz_si256(error, error);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t utf8_len_avx2(const char *str, size_t len)
+{
+        const __m256i last_cont = _mm256_set1_epi8(-65);
+        size_t count = 0,
+                i;
+
+        for(i = 0; i + 32 <= len; i += 32)
+        {
+                __m256i input = _mm256_loadu_si256((const __m256i *)(str + i));
+
+                count += (size_t)__builtin_popcount(
+                        (unsigned int)_mm256_movemask_epi8(
+                                _mm256_cmpgt_epi8(input, last_cont)));
+        }
+
+        return count + str_utf8_len_scalar(str + i, len - i);
+}
+
+#endif
+
+/*
+ * All implementations, by enum str_utf8_impl
+ */
+struct utf8_impl {
+        int (*valid)(const char *, size_t);
+        size_t (*len)(const char *, size_t);
+};
+
+static const struct utf8_impl utf8_impls[STR_UTF8_IMPLS] = {
+        [STR_UTF8_SCALAR] = { str_utf8_valid_scalar, str_utf8_len_scalar },
+#ifdef STR_UTF8_X86
+        [STR_UTF8_SSE4] = { utf8_valid_sse4, utf8_len_sse4 },
+        [STR_UTF8_AVX2] = { utf8_valid_avx2, utf8_len_avx2 },
+#endif
+};
+
+int __str_utf8_impl_supported(enum str_utf8_impl impl)
+{
+        switch(impl)
+        {
+        case STR_UTF8_SCALAR:
+                return 1;
+#ifdef STR_UTF8_X86
+        case STR_UTF8_SSE4:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("sse4.1")
+                        && __builtin_cpu_supports("popcnt");
+        case STR_UTF8_AVX2:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2")
+                        && __builtin_cpu_supports("popcnt");
+#endif
+        default:
+                return 0;
+        }
+}
+
+int __str_utf8_valid_impl(enum str_utf8_impl impl, const char *str,
+                          size_t len)
+{
+        if(!__str_utf8_impl_supported(impl))
+        {
+                impl = STR_UTF8_SCALAR;
+        }
+
+        return utf8_impls[impl].valid(str, len);
+}
+
+size_t __str_utf8_len_impl(enum str_utf8_impl impl, const char *str,
+                           size_t len)
+{
+        if(!__str_utf8_impl_supported(impl))
+        {
+                impl = STR_UTF8_SCALAR;
+        }
+
+        return utf8_impls[impl].len(str, len);
+}
+
+/*
+ * Implementations chosen at the first call.
+ */
+static int utf8_valid_resolve(const char *str, size_t len);
+static size_t utf8_len_resolve(const char *str, size_t len);
+
+static int (*utf8_valid_impl)(const char *, size_t) = utf8_valid_resolve;
+static size_t (*utf8_len_impl)(const char *, size_t) = utf8_len_resolve;
+
+static void utf8_resolve(void)
+{
+        int impl = STR_UTF8_IMPLS - 1;
+
+        /* the fastest one supported by the CPU */
+        while(impl > STR_UTF8_SCALAR
+              && !__str_utf8_impl_supported((enum str_utf8_impl)impl))
+        {
+                --impl;
+        }
+
+        /* threads may race here: they store the same values */
+        __atomic_store_n(&utf8_valid_impl, utf8_impls[impl].valid,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&utf8_len_impl, utf8_impls[impl].len,
+                         __ATOMIC_RELAXED);
+}
+
+static int utf8_valid_resolve(const char *str, size_t len)
+{
+        utf8_resolve();
+
+        return str_utf8_valid(str, len);
+}
+
+static size_t utf8_len_resolve(const char *str, size_t len)
+{
+        utf8_resolve();
+
+        return str_utf8_len(str, len);
+}
+
+int str_utf8_valid(const char *str, size_t len)
+{
+        return __atomic_load_n(&utf8_valid_impl, __ATOMIC_RELAXED)(str, len);
+}
+
+size_t str_utf8_len(const char *str, size_t len)
+{
+        return __atomic_load_n(&utf8_len_impl, __ATOMIC_RELAXED)(str, len);
+}
+
+size_t str_utf8_truncate(const char *str, size_t len, size_t max)
+{
+        size_t n = max;
+
+        if(len <= max)
+        {
+                return len;
+        }
+
+        /* back to the lead byte of the cut sequence (4 bytes at most) */
+        while(n > 0 && max - n < 3 && ((unsigned char)str[n] & 0xc0) == 0x80)
+        {
+                --n;
+        }
+
+        return ((unsigned char)str[n] & 0xc0) == 0x80 ? max : n;
+}
+
+size_t str_copy_utf8(char *dst, size_t dst_size, const char *src)
+{
+        size_t src_len = strlen(src),
+                n = str_utf8_truncate(src, src_len, dst_size - 1);
+
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+
+        return src_len;
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flibc/timer.h"
+
+#include <limits.h>
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+
+/* slot of a tick in a level */
+#define timer_wheel_index(tick, level) \
+        ((unsigned int) ((tick) >> ((level) * TIMER_WHEEL_BITS)) \
+         & TIMER_WHEEL_MASK)
+
+static void timer_wheel_insert(struct timer_wheel *wheel,
+                               struct timer *timer)
+{
+        uint64_t expires = timer->expires,
+                delta;
+        unsigned int level;
+
+        if(expires < wheel->clock)
+        {
+                /* already expired: run at next tick */
+                expires = wheel->clock;
+        }
+
+        delta = expires - wheel->clock;
+        if(delta >= TIMER_WHEEL_RANGE)
+        {
+                delta = TIMER_WHEEL_RANGE - 1;
+                expires = wheel->clock + delta;
+        }
+
+        for(level = 0; level < TIMER_WHEEL_LEVELS - 1; ++level)
+        {
+                if(delta < 1ULL << ((level + 1) * TIMER_WHEEL_BITS))
+                {
+                        break;
+                }
+        }
+
+        list_add_tail(&timer->node,
+                      &wheel->slots[level][timer_wheel_index(expires,
+                                                             level)]);
+}
+
+/* move timers of a slot to lower levels */
+static void timer_wheel_cascade(struct timer_wheel *wheel,
+                                unsigned int level, unsigned int index)
+{
+        struct timer *timer = NULL,
+                *next = NULL;
+        LIST_HEAD(list);
+
+        list_splice_init(&wheel->slots[level][index], &list);
+        list_for_each_entry_safe(timer, next, &list, node)
+        {
+                timer_wheel_insert(wheel, timer);
+        }
+}
+
+void timer_wheel_init(struct timer_wheel *wheel, uint64_t now)
+{
+        unsigned int level,
+                i;
+
+        wheel->clock = now;
+        wheel->count = 0;
+        for(level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+        {
+                for(i = 0; i < TIMER_WHEEL_SIZE; ++i)
+                {
+                        INIT_LIST_HEAD(&wheel->slots[level][i]);
+                }
+        }
+}
+
+void timer_add(struct timer_wheel *wheel, struct timer *timer,
+               uint64_t expires)
+{
+        if(timer_pending(timer))
+        {
+                list_del(&timer->node);
+        }
+        else
+        {
+                ++wheel->count;
+        }
+
+        timer->expires = expires;
+        timer_wheel_insert(wheel, timer);
+}
+
+int timer_cancel(struct timer_wheel *wheel, struct timer *timer)
+{
+        if(!timer_pending(timer))
+        {
+                return 0;
+        }
+
+        list_del_init(&timer->node);
+        --wheel->count;
+
+        return 1;
+}
+
+unsigned long timer_wheel_advance(struct timer_wheel *wheel, uint64_t now)
+{
+        struct timer *timer = NULL;
+        unsigned long count = 0;
+        unsigned int level,
+                index;
+        uint64_t next;
+        LIST_HEAD(list);
+
+        while(wheel->clock <= now)
+        {
+                next = timer_wheel_next(wheel);
+                if(next > now)
+                {
+                        wheel->clock = now + 1;
+                        break;
+                }
+                wheel->clock = next;
+
+                index = timer_wheel_index(wheel->clock, 0);
+                if(index == 0)
+                {
+                        for(level = 1; level < TIMER_WHEEL_LEVELS; ++level)
+                        {
+                                index = timer_wheel_index(wheel->clock,
+                                                          level);
+                                timer_wheel_cascade(wheel, level, index);
+                                if(index != 0)
+                                {
+                                        break;
+                                }
+                        }
+                        index = 0;
+                }
+
+                /* timers added by callbacks must not go in this slot */
+                list_splice_init(&wheel->slots[0][index], &list);
+                ++wheel->clock;
+
+                while(!list_empty(&list))
+                {
+                        timer = list_first_entry(&list, struct timer, node);
+                        list_del_init(&timer->node);
+                        --wheel->count;
+                        ++count;
+
+                        timer->func(timer);
+                }
+        }
+
+        return count;
+}
+
+uint64_t timer_wheel_next(const struct timer_wheel *wheel)
+{
+        uint64_t next = UINT64_MAX,
+                tick,
+                step;
+        unsigned int level,
+                i;
+
+        if(wheel->count == 0)
+        {
+                return next;
+        }
+
+        /* level 0: a slot is the tick itself */
+        for(i = 0; i < TIMER_WHEEL_SIZE; ++i)
+        {
+                tick = wheel->clock + i;
+                if(!list_empty(&wheel->slots[0][timer_wheel_index(tick, 0)]))
+                {
+                        next = tick;
+                        break;
+                }
+        }
+
+        /* upper levels: the first cascade of a non empty slot */
+        for(level = 1; level < TIMER_WHEEL_LEVELS; ++level)
+        {
+                step = 1ULL << (level * TIMER_WHEEL_BITS);
+                tick = (wheel->clock + step - 1) & ~(step - 1);
+
+                for(i = 0; i < TIMER_WHEEL_SIZE && tick < next;
+                    ++i, tick += step)
+                {
+                        if(!list_empty(&wheel->slots[level]
+                                       [timer_wheel_index(tick, level)]))
+                        {
+                                next = tick;
+                                break;
+                        }
+                }
+        }
+
+        return next;
+}
+
+int timer_wheel_timeout(const struct timer_wheel *wheel, uint64_t now)
+{
+        uint64_t next = timer_wheel_next(wheel);
+
+        if(next == UINT64_MAX)
+        {
+                return -1;
+        }
+
+        if(next <= now)
+        {
+                return 0;
+        }
+
+        return next - now > INT_MAX ? INT_MAX : (int) (next - now);
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/alloc.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+TEST_DEF(test_alloc_count)
+{
+        struct alloc_stats stats;
+        void *p = NULL;
+        char *s = NULL;
+
+        TEST_ASSERT(alloc_tracking());
+
+        ALLOC_COUNT(&stats, {
+                p = malloc(100);
+                DO_NOT_OPTIMIZE(p);
+                free(p);
+        });
+        TEST_ASSERT(stats.allocs == 1);
+        TEST_ASSERT(stats.frees == 1);
+        TEST_ASSERT(stats.bytes == 100);
+
+        ALLOC_COUNT(&stats, {
+                p = calloc(10, 8);
+                DO_NOT_OPTIMIZE(p);
+                p = realloc(p, 200);
+                DO_NOT_OPTIMIZE(p);
+                free(p);
+        });
+        TEST_ASSERT(stats.allocs == 2);
+        TEST_ASSERT(stats.frees == 1);
+        TEST_ASSERT(stats.bytes == 280);
+
+        /* allocations of the C library itself */
+        ALLOC_COUNT(&stats, {
+                s = strdup("hello");
+                DO_NOT_OPTIMIZE(s);
+                free(s);
+        });
+        TEST_ASSERT(stats.allocs == 1);
+        TEST_ASSERT(stats.bytes == 6);
+
+        ALLOC_COUNT(&stats, {
+                TEST_ASSERT(posix_memalign(&p, 64, 128) == 0);
+                TEST_ASSERT((size_t) p % 64 == 0);
+                free(p);
+        });
+        TEST_ASSERT(stats.allocs == 1);
+        TEST_ASSERT(stats.frees == 1);
+
+        /* free(NULL) isn't counted */
+        ALLOC_COUNT(&stats, {
+                free(NULL);
+        });
+        TEST_ASSERT(stats.frees == 0);
+}
+
+static void *alloc_thread(void *arg)
+{
+        void *p = NULL;
+        unsigned int i;
+
+        for(i = 0; i < 100; ++i)
+        {
+                p = malloc(16);
+                DO_NOT_OPTIMIZE(p);
+                free(p);
+        }
+
+        return arg;
+}
+
+TEST_DEF(test_alloc_threads)
+{
+        struct alloc_stats stats;
+        pthread_t thread;
+
+        /* thread creation allocates its stack in this thread */
+        TEST_ASSERT(pthread_create(&thread, NULL, alloc_thread, NULL) == 0);
+
+        ALLOC_COUNT(&stats, {
+                pthread_join(thread, NULL);
+        });
+        TEST_ASSERT(stats.allocs == 0);
+}
+
+/* assertions which must fail */
+TEST_DEF(test_alloc_assert_fail_no_alloc)
+{
+        void *p = NULL;
+
+        TEST_ASSERT_NO_ALLOC({
+                p = malloc(1);
+                DO_NOT_OPTIMIZE(p);
+        });
+        free(p);
+}
+
+TEST_DEF(test_alloc_assert_fail_count)
+{
+        TEST_ASSERT_ALLOC_COUNT(2, {
+                free(strdup("x"));
+        });
+}
+
+TEST_DEF(test_alloc_assert)
+{
+        struct test_result tr;
+        char buf[16];
+        void *p = NULL;
+
+        TEST_ASSERT_NO_ALLOC({
+                memset(buf, 0, sizeof(buf));
+                free(NULL);
+        });
+
+        TEST_ASSERT_ALLOC_COUNT(1, {
+                p = malloc(32);
+                DO_NOT_OPTIMIZE(p);
+        });
+        free(p);
+
+        tr.ret = 0;
+        test_alloc_assert_fail_no_alloc(&tr);
+        TEST_ASSERT(tr.ret != 0);
+
+        tr.ret = 0;
+        test_alloc_assert_fail_count(&tr);
+        TEST_ASSERT(tr.ret != 0);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/alloc");
+
+        TEST_RUN(test_alloc_count);
+        TEST_RUN(test_alloc_threads);
+        TEST_RUN(test_alloc_assert);
+
+        return TEST_MODULE_RETURN;
+}
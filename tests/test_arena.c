@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/arena.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <stdint.h>
+#include <string.h>
+
+TEST_DEF(test_arena)
+{
+        struct arena arena;
+        char *p = NULL,
+                *q = NULL;
+        unsigned int i;
+
+        TEST_ASSERT(arena_init(&arena, 1, 0) == -1);
+        TEST_ASSERT(arena_init(&arena, 4096, 0) == 0);
+
+        p = arena_alloc(&arena, 3);
+        q = arena_alloc(&arena, 10);
+        TEST_ASSERT(p != NULL && q != NULL);
+        TEST_ASSERT((uintptr_t) p % ARENA_ALIGN == 0);
+        TEST_ASSERT((uintptr_t) q % ARENA_ALIGN == 0);
+        TEST_ASSERT(q >= p + 3);
+
+        p = arena_alloc_align(&arena, 1, 1);
+        q = arena_alloc_align(&arena, 8, 256);
+        TEST_ASSERT((uintptr_t) q % 256 == 0);
+
+        p = arena_zalloc(&arena, 100);
+        TEST_ASSERT(p != NULL);
+        for(i = 0; i < 100; ++i)
+        {
+                TEST_ASSERT(p[i] == 0);
+        }
+
+        /* many chunks and a big allocation */
+        for(i = 0; i < 1000; ++i)
+        {
+                p = arena_alloc(&arena, 100);
+                TEST_ASSERT(p != NULL);
+                memset(p, 'x', 100);
+        }
+        p = arena_alloc(&arena, 100000);
+        TEST_ASSERT(p != NULL);
+        memset(p, 'y', 100000);
+
+        arena_reset(&arena);
+        TEST_ASSERT(arena.chunk != NULL);
+        TEST_ASSERT(arena.spare != NULL);
+
+        /* chunks are reused */
+        for(i = 0; i < 1000; ++i)
+        {
+                TEST_ASSERT(arena_alloc(&arena, 100) != NULL);
+        }
+
+        arena_cleanup(&arena);
+}
+
+TEST_DEF(test_arena_str)
+{
+        struct arena arena;
+        char *s = NULL;
+
+        TEST_ASSERT(arena_init(&arena, 256, 0) == 0);
+
+        s = arena_strdup(&arena, "hello");
+        TEST_ASSERT(s != NULL && strcmp(s, "hello") == 0);
+
+        s = arena_strndup(&arena, "hello world", 5);
+        TEST_ASSERT(s != NULL && strcmp(s, "hello") == 0);
+
+        s = arena_strndup(&arena, "hi", 5);
+        TEST_ASSERT(s != NULL && strcmp(s, "hi") == 0);
+
+        s = arena_printf(&arena, "%s=%d", "answer", 42);
+        TEST_ASSERT(s != NULL && strcmp(s, "answer=42") == 0);
+
+        /* doesn't fit in the current chunk */
+        s = arena_printf(&arena, "%0300d", 7);
+        TEST_ASSERT(s != NULL && strlen(s) == 300 && s[299] == '7');
+
+        s = arena_printf(&arena, "%s", "");
+        TEST_ASSERT(s != NULL && s[0] == '\0');
+
+        arena_cleanup(&arena);
+}
+
+TEST_DEF(test_arena_mark)
+{
+        struct arena arena;
+        struct arena_mark mark;
+        char *before = NULL,
+                *p = NULL;
+        unsigned int i;
+
+        TEST_ASSERT(arena_init(&arena, 1024, 0) == 0);
+
+        before = arena_strdup(&arena, "keep me");
+        arena_save(&arena, &mark);
+
+        p = arena_alloc(&arena, 16);
+        for(i = 0; i < 100; ++i)
+        {
+                TEST_ASSERT(arena_alloc(&arena, 64) != NULL);
+        }
+
+        arena_restore(&arena, &mark);
+        TEST_ASSERT(strcmp(before, "keep me") == 0);
+
+        /* same memory is given again */
+        TEST_ASSERT(arena_alloc(&arena, 16) == p);
+
+        arena_cleanup(&arena);
+}
+
+TEST_DEF(test_arena_hugepage)
+{
+        struct arena arena;
+        char *p = NULL;
+
+        /* huge pages may not be available: memory is still usable */
+        TEST_ASSERT(arena_init(&arena, 0, ARENA_HUGEPAGE) == 0);
+        TEST_ASSERT(arena.chunk_size % ARENA_HUGEPAGE_SIZE == 0);
+
+        p = arena_alloc(&arena, ARENA_HUGEPAGE_SIZE / 2);
+        TEST_ASSERT(p != NULL);
+        memset(p, 0, ARENA_HUGEPAGE_SIZE / 2);
+
+        p = arena_alloc(&arena, ARENA_HUGEPAGE_SIZE);
+        TEST_ASSERT(p != NULL);
+        memset(p, 0, ARENA_HUGEPAGE_SIZE);
+
+        arena_reset(&arena);
+        arena_cleanup(&arena);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/arena");
+
+        TEST_RUN(test_arena);
+        TEST_RUN(test_arena_str);
+        TEST_RUN(test_arena_mark);
+        TEST_RUN(test_arena_hugepage);
+
+        return TEST_MODULE_RETURN;
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/unit.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#ifndef TEST_BENCHCMP
+#define TEST_BENCHCMP "../tools/flibc-benchcmp"
+#endif
+
+#define TEST_BENCHCMP_BASELINE "/tmp/test_benchcmp_baseline.json"
+#define TEST_BENCHCMP_CURRENT "/tmp/test_benchcmp_current.json"
+
+/*
+ * Write a BENCH_JSON file: one line per run of a benchmark, runs
+ * separated by '|' and samples by ','
+ */
+static int test_benchcmp_write(const char *path, const char *name,
+                               const char *runs)
+{
+        FILE *file = NULL;
+        const char *end = NULL;
+
+        file = fopen(path, "w");
+        if(file == NULL)
+        {
+                return -1;
+        }
+
+        /* lines which aren't results are skipped */
+        fprintf(file, "{\"module\":\"benchcmp\",\"version\":1}\n");
+
+        for(; *runs != '\0'; runs = *end ? end + 1 : end)
+        {
+                end = strchr(runs, '|');
+                if(end == NULL)
+                {
+                        end = runs + strlen(runs);
+                }
+
+                /* the median of the run only matters without samples */
+                fprintf(file, "{\"module\":\"benchcmp\",\"name\":\"%s\","
+                        "\"iterations\":1000,\"median_ns\":%.*s,"
+                        "\"samples_ns\":[%.*s]}\n", name,
+                        (int)strcspn(runs, ",|"), runs,
+                        (int)(end - runs), runs);
+        }
+
+        return fclose(file);
+}
+
+/*
+ * Run flibc-benchcmp on the baseline and the current file, output in
+ * buf: return its exit status
+ */
+static int test_benchcmp_run(const char *baseline, const char *current,
+                             char *buf, size_t size)
+{
+        char cmd[512];
+        FILE *out = NULL;
+        size_t len;
+        int status;
+
+        snprintf(cmd, sizeof(cmd), "%s %s %s 2>&1",
+                 TEST_BENCHCMP, baseline, current);
+
+        out = popen(cmd, "r");
+        if(out == NULL)
+        {
+                return -1;
+        }
+
+        len = fread(buf, 1, size - 1, out);
+        buf[len] = '\0';
+
+        status = pclose(out);
+
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* verdict column of the line of the benchmark */
+static const char *test_benchcmp_verdict(char *buf, const char *name)
+{
+        char *line = strstr(buf, name),
+                *end = NULL;
+
+        if(line == NULL)
+        {
+                return NULL;
+        }
+
+        end = strchr(line, '\n');
+        if(end != NULL)
+        {
+                *end = '\0';
+        }
+
+        /* "p  verdict": two spaces before the (maybe empty) verdict */
+        end = strstr(line, "  ");
+        while(end != NULL && strstr(end + 1, "  ") != NULL)
+        {
+                end = strstr(end + 1, "  ");
+        }
+
+        return end != NULL ? end + 2 : NULL;
+}
+
+TEST_DEF(test_benchcmp_identical)
+{
+        char buf[4096];
+
+        /* runs are merged whatever their order: 10 samples, median 107 */
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_BASELINE, "same",
+                                        "102,100,101,103,104|"
+                                        "112,110,111,113,114") == 0);
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_CURRENT, "same",
+                                        "112,110,111,113,114|"
+                                        "102,100,101,103,104") == 0);
+
+        TEST_ASSERT(test_benchcmp_run(TEST_BENCHCMP_BASELINE,
+                                      TEST_BENCHCMP_CURRENT,
+                                      buf, sizeof(buf)) == 0);
+        TEST_ASSERT(strstr(buf, "benchcmp same") != NULL);
+        TEST_ASSERT(strstr(buf, "107.00       107.00") != NULL);
+        TEST_ASSERT(strcmp(test_benchcmp_verdict(buf, "benchcmp same"),
+                           "") == 0);
+
+        /* only ties: no difference at all */
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_BASELINE, "ties",
+                                        "100,100,100,100,100,100") == 0);
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_CURRENT, "ties",
+                                        "100,100,100,100,100,100") == 0);
+        TEST_ASSERT(test_benchcmp_run(TEST_BENCHCMP_BASELINE,
+                                      TEST_BENCHCMP_CURRENT,
+                                      buf, sizeof(buf)) == 0);
+        TEST_ASSERT(strstr(buf, " 1.0000  ") != NULL);
+        TEST_ASSERT(strcmp(test_benchcmp_verdict(buf, "benchcmp ties"),
+                           "") == 0);
+}
+
+TEST_DEF(test_benchcmp_slower)
+{
+        char buf[4096];
+
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_BASELINE, "change",
+                                        "100,99,101,100,102,98,100,101,"
+                                        "99,100") == 0);
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_CURRENT, "change",
+                                        "110,109,111,110,112,108,110,111,"
+                                        "109,110") == 0);
+
+        /* 10% slower */
+        TEST_ASSERT(test_benchcmp_run(TEST_BENCHCMP_BASELINE,
+                                      TEST_BENCHCMP_CURRENT,
+                                      buf, sizeof(buf)) == 1);
+        TEST_ASSERT(strstr(buf, "+10.0%") != NULL);
+        TEST_ASSERT(strcmp(test_benchcmp_verdict(buf, "benchcmp change"),
+                           "SLOWER") == 0);
+
+        /* the other way: faster isn't an error */
+        TEST_ASSERT(test_benchcmp_run(TEST_BENCHCMP_CURRENT,
+                                      TEST_BENCHCMP_BASELINE,
+                                      buf, sizeof(buf)) == 0);
+        TEST_ASSERT(strcmp(test_benchcmp_verdict(buf, "benchcmp change"),
+                           "faster") == 0);
+}
+
+TEST_DEF(test_benchcmp_few_samples)
+{
+        char buf[4096];
+
+        /* medians compared with their MAD: 1 here */
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_BASELINE, "few",
+                                        "100,99,101") == 0);
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_CURRENT, "few",
+                                        "110,109,111") == 0);
+        TEST_ASSERT(test_benchcmp_run(TEST_BENCHCMP_BASELINE,
+                                      TEST_BENCHCMP_CURRENT,
+                                      buf, sizeof(buf)) == 1);
+        TEST_ASSERT(strstr(buf, "nan") != NULL);
+        TEST_ASSERT(strcmp(test_benchcmp_verdict(buf, "benchcmp few"),
+                           "SLOWER") == 0);
+
+        /* too noisy to tell */
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_CURRENT, "few",
+                                        "110,80,140") == 0);
+        TEST_ASSERT(test_benchcmp_run(TEST_BENCHCMP_BASELINE,
+                                      TEST_BENCHCMP_CURRENT,
+                                      buf, sizeof(buf)) == 0);
+        TEST_ASSERT(strcmp(test_benchcmp_verdict(buf, "benchcmp few"),
+                           "") == 0);
+}
+
+TEST_DEF(test_benchcmp_errors)
+{
+        char buf[4096];
+
+        TEST_ASSERT(test_benchcmp_write(TEST_BENCHCMP_CURRENT, "missing",
+                                        "100,99,101") == 0);
+        unlink(TEST_BENCHCMP_BASELINE);
+
+        TEST_ASSERT(test_benchcmp_run(TEST_BENCHCMP_BASELINE,
+                                      TEST_BENCHCMP_CURRENT,
+                                      buf, sizeof(buf)) == 2);
+        TEST_ASSERT(strstr(buf, "No such file or directory") != NULL);
+
+        TEST_ASSERT(test_benchcmp_run(TEST_BENCHCMP_CURRENT, "",
+                                      buf, sizeof(buf)) == 2);
+        TEST_ASSERT(strstr(buf, "usage:") != NULL);
+
+        unlink(TEST_BENCHCMP_CURRENT);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/benchcmp");
+
+        TEST_RUN(test_benchcmp_identical);
+        TEST_RUN(test_benchcmp_slower);
+        TEST_RUN(test_benchcmp_few_samples);
+        TEST_RUN(test_benchcmp_errors);
+
+        return TEST_MODULE_RETURN;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/hash.h>
+#include <flibc/flibc.h>
+#include <flibc/list.h>
+#include <flibc/unit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct item {
+        unsigned int id;
+        char name[16];
+        struct hash_node hnode;
+};
+
+TEST_DEF(test_hlist)
+{
+        HLIST_HEAD(head);
+        struct item items[3],
+                *item = NULL;
+        struct hlist_node *tmp = NULL;
+        unsigned int i,
+                sum = 0;
+
+        TEST_ASSERT(hlist_empty(&head));
+
+        for(i = 0; i < ARRAY_SIZE(items); ++i)
+        {
+                items[i].id = i + 1;
+                INIT_HLIST_NODE(&items[i].hnode.node);
+                TEST_ASSERT(hlist_unhashed(&items[i].hnode.node));
+        }
+
+        hlist_add_head(&items[0].hnode.node, &head);
+        hlist_add_behind(&items[2].hnode.node, &items[0].hnode.node);
+        hlist_add_before(&items[1].hnode.node, &items[2].hnode.node);
+
+        /* order is 1, 2, 3 */
+        i = 1;
+        hlist_for_each_entry(item, &head, hnode.node)
+        {
+                TEST_ASSERT(item->id == i);
+                ++i;
+        }
+        TEST_ASSERT(i == 4);
+
+        hlist_for_each_entry_safe(item, tmp, &head, hnode.node)
+        {
+                sum += item->id;
+                hlist_del_init(&item->hnode.node);
+        }
+        TEST_ASSERT(sum == 6);
+        TEST_ASSERT(hlist_empty(&head));
+}
+
+TEST_DEF(test_hash_functions)
+{
+        char buf[32] = "hello world, hello world !";
+
+        TEST_ASSERT(hash_str("foo") == hash_str("foo"));
+        TEST_ASSERT(hash_str("foo") != hash_str("bar"));
+        TEST_ASSERT(hash_str("") != hash_str("a"));
+        TEST_ASSERT(hash_mem("ab", 2) != hash_mem("ba", 2));
+
+        /* only len bytes are hashed */
+        TEST_ASSERT(hash_mem(buf, 5) == hash_str("hello"));
+        TEST_ASSERT(hash_mem(buf, 12) == hash_mem("hello world,", 12));
+        TEST_ASSERT(hash_mem(buf, 12) != hash_mem(buf, 13));
+
+        /* the seed changes the hash */
+        TEST_ASSERT(hash_mem_seed(buf, 5, 1) == hash_mem_seed("hello", 5, 1));
+        TEST_ASSERT(hash_mem_seed(buf, 5, 1) != hash_mem_seed(buf, 5, 2));
+
+        TEST_ASSERT(hash_64(1, 8) < 256);
+        TEST_ASSERT(hash_64(1, 8) != hash_64(2, 8));
+}
+
+TEST_DEF(test_hash_table)
+{
+        struct hash_table table;
+        struct item *items = NULL,
+                *item = NULL;
+        struct hlist_node *tmp = NULL;
+        unsigned int i,
+                found,
+                count = 10000;
+        size_t bkt;
+
+        TEST_ASSERT(hash_init(&table, 2) == 0);
+
+        items = calloc(count, sizeof(*items));
+        TEST_ASSERT(items != NULL);
+
+        for(i = 0; i < count; ++i)
+        {
+                items[i].id = i;
+                hash_add(&table, &items[i].hnode, i);
+        }
+        TEST_ASSERT(hash_count(&table) == count);
+        TEST_ASSERT(table.bits > 2);
+
+        /* lookup each id */
+        for(i = 0; i < count; ++i)
+        {
+                found = 0;
+                hash_for_each_possible(&table, item, hnode, i)
+                {
+                        TEST_ASSERT(item->id == i);
+                        ++found;
+                }
+                TEST_ASSERT(found == 1);
+        }
+
+        /* walk the whole table (may still be growing) */
+        found = 0;
+        hash_for_each(&table, bkt, item, hnode)
+        {
+                ++found;
+        }
+        TEST_ASSERT(found == count);
+
+        /* break stops the walk */
+        found = 0;
+        hash_for_each(&table, bkt, item, hnode)
+        {
+                ++found;
+                break;
+        }
+        TEST_ASSERT(found == 1 && item != NULL);
+
+        /* remove odd ids */
+        hash_for_each_safe(&table, bkt, tmp, item, hnode)
+        {
+                if(item->id % 2)
+                {
+                        hash_del(&table, &item->hnode);
+                }
+        }
+        TEST_ASSERT(hash_count(&table) == count / 2);
+
+        for(i = 0; i < count; ++i)
+        {
+                found = 0;
+                hash_for_each_possible(&table, item, hnode, i)
+                {
+                        ++found;
+                }
+                TEST_ASSERT(found == (i % 2 ? 0U : 1U));
+        }
+
+        hash_cleanup(&table);
+        free(items);
+}
+
+TEST_DEF(test_hash_table_str)
+{
+        struct hash_table table;
+        struct item items[64],
+                same,
+                *item = NULL;
+        struct hlist_node *tmp = NULL;
+        char name[16];
+        unsigned int i,
+                evals,
+                found;
+
+        TEST_ASSERT(hash_init(&table, 0) == 0);
+
+        for(i = 0; i < ARRAY_SIZE(items); ++i)
+        {
+                snprintf(items[i].name, sizeof(items[i].name), "user%u", i);
+                items[i].id = i;
+                hash_add(&table, &items[i].hnode, hash_str(items[i].name));
+        }
+
+        /* same key for two nodes */
+        snprintf(same.name, sizeof(same.name), "user7");
+        same.id = 1000;
+        hash_add(&table, &same.hnode, hash_str(same.name));
+
+        found = 0;
+        hash_for_each_possible(&table, item, hnode, hash_str("user7"))
+        {
+                TEST_ASSERT(strcmp(item->name, "user7") == 0);
+                TEST_ASSERT(item->id == 7 || item->id == 1000);
+                ++found;
+        }
+        TEST_ASSERT(found == 2);
+
+        /* the key is evaluated once, break leaves the loop */
+        found = 0;
+        evals = 0;
+        hash_for_each_possible(&table, item, hnode,
+                               (++evals, hash_str("user7")))
+        {
+                ++found;
+                break;
+        }
+        TEST_ASSERT(found == 1 && evals == 1);
+
+        evals = 0;
+        hash_for_each_possible_safe(&table, item, tmp, hnode,
+                                    (++evals, hash_str("user7")))
+        {
+                ++found;
+        }
+        TEST_ASSERT(found == 3 && evals == 1);
+
+        for(i = 0; i < ARRAY_SIZE(items); ++i)
+        {
+                snprintf(name, sizeof(name), "user%u", i);
+
+                hash_for_each_possible_safe(&table, item, tmp, hnode,
+                                            hash_str(name))
+                {
+                        if(strcmp(item->name, name) == 0)
+                        {
+                                hash_del(&table, &item->hnode);
+                        }
+                }
+        }
+        TEST_ASSERT(hash_count(&table) == 0);
+
+        found = 0;
+        hash_for_each_possible(&table, item, hnode, hash_str("nobody"))
+        {
+                ++found;
+        }
+        TEST_ASSERT(found == 0);
+
+        hash_cleanup(&table);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/hash");
+
+        TEST_RUN(test_hlist);
+        TEST_RUN(test_hash_functions);
+        TEST_RUN(test_hash_table);
+        TEST_RUN(test_hash_table_str);
+
+        return TEST_MODULE_RETURN;
+}
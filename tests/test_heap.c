@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/heap.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <stdlib.h>
+
+#define ITEMS_COUNT 10000
+
+struct item {
+        unsigned int key;
+        struct heap_node node;
+};
+
+static int item_less(const struct heap_node *a, const struct heap_node *b)
+{
+        return heap_entry(a, const struct item, node)->key
+                < heap_entry(b, const struct item, node)->key;
+}
+
+/* check indexes and heap order */
+static int heap_check(const struct heap *heap)
+{
+        unsigned int i;
+
+        for(i = 0; i < heap->count; ++i)
+        {
+                if(heap->nodes[i]->index != i)
+                {
+                        return 0;
+                }
+
+                if(i > 0 && heap->less(heap->nodes[i],
+                                       heap->nodes[(i - 1) / HEAP_ARITY]))
+                {
+                        return 0;
+                }
+        }
+
+        return 1;
+}
+
+/* pop everything: keys must come in order */
+static int heap_drain(struct heap *heap)
+{
+        struct heap_node *node = NULL;
+        unsigned int last = 0;
+        int ok = 1;
+
+        while((node = heap_pop(heap)) != NULL)
+        {
+                if(heap_node_queued(node)
+                   || heap_entry(node, struct item, node)->key < last)
+                {
+                        ok = 0;
+                }
+                last = heap_entry(node, struct item, node)->key;
+        }
+
+        return ok;
+}
+
+TEST_DEF(test_heap)
+{
+        struct heap heap;
+        struct item *items = NULL;
+        unsigned int i;
+
+        heap_init(&heap, item_less);
+        TEST_ASSERT(heap_empty(&heap));
+        TEST_ASSERT(heap_top(&heap) == NULL);
+        TEST_ASSERT(heap_pop(&heap) == NULL);
+
+        items = calloc(ITEMS_COUNT, sizeof(*items));
+        TEST_ASSERT(items != NULL);
+
+        srand(42);
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                items[i].key = (unsigned int) rand() % 1000;
+                heap_node_init(&items[i].node);
+                TEST_ASSERT(!heap_node_queued(&items[i].node));
+                TEST_ASSERT(heap_insert(&heap, &items[i].node) == 0);
+                TEST_ASSERT(heap_node_queued(&items[i].node));
+        }
+        TEST_ASSERT(heap_count(&heap) == ITEMS_COUNT);
+        TEST_ASSERT(heap_check(&heap));
+
+        TEST_ASSERT(heap_drain(&heap));
+        TEST_ASSERT(heap_empty(&heap));
+
+        heap_cleanup(&heap);
+        free(items);
+}
+
+TEST_DEF(test_heap_update)
+{
+        struct heap heap;
+        struct item *items = NULL;
+        unsigned int i;
+
+        heap_init(&heap, item_less);
+        TEST_ASSERT(heap_reserve(&heap, ITEMS_COUNT) == 0);
+
+        items = calloc(ITEMS_COUNT, sizeof(*items));
+        TEST_ASSERT(items != NULL);
+
+        srand(7);
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                items[i].key = (unsigned int) rand() % 100000;
+                heap_node_init(&items[i].node);
+                TEST_ASSERT(heap_insert(&heap, &items[i].node) == 0);
+        }
+
+        /* decrease-key */
+        for(i = 0; i < ITEMS_COUNT; i += 3)
+        {
+                items[i].key /= 2;
+                heap_decrease(&heap, &items[i].node);
+        }
+        TEST_ASSERT(heap_check(&heap));
+
+        /* keys changed in both directions */
+        for(i = 1; i < ITEMS_COUNT; i += 3)
+        {
+                items[i].key = (unsigned int) rand() % 100000;
+                heap_update(&heap, &items[i].node);
+        }
+        TEST_ASSERT(heap_check(&heap));
+
+        /* removal from anywhere */
+        for(i = 2; i < ITEMS_COUNT; i += 3)
+        {
+                heap_remove(&heap, &items[i].node);
+                TEST_ASSERT(!heap_node_queued(&items[i].node));
+        }
+        TEST_ASSERT(heap_check(&heap));
+        TEST_ASSERT(heap_count(&heap) == ITEMS_COUNT - ITEMS_COUNT / 3);
+
+        /* smallest key is on top */
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                if(heap_node_queued(&items[i].node))
+                {
+                        TEST_ASSERT(items[i].key >= heap_entry(heap_top(&heap),
+                                                               struct item,
+                                                               node)->key);
+                }
+        }
+
+        TEST_ASSERT(heap_drain(&heap));
+
+        heap_cleanup(&heap);
+        free(items);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/heap");
+
+        TEST_RUN(test_heap);
+        TEST_RUN(test_heap_update);
+
+        return TEST_MODULE_RETURN;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/list.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#define ITEMS_COUNT 100
+
+struct item {
+        unsigned int id;
+        struct list_head list;
+};
+
+TEST_DEF(test_list_for_each_entry_prefetch)
+{
+        struct item items[ITEMS_COUNT],
+                *item = NULL;
+        unsigned int i;
+        LIST_HEAD(list);
+
+        i = 0;
+        list_for_each_entry_prefetch(item, &list, list)
+        {
+                ++i;
+        }
+        TEST_ASSERT(i == 0);
+
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                items[i].id = i;
+                list_add_tail(&items[i].list, &list);
+        }
+
+        i = 0;
+        list_for_each_entry_prefetch(item, &list, list)
+        {
+                TEST_ASSERT(item->id == i);
+                ++i;
+        }
+        TEST_ASSERT(i == ITEMS_COUNT);
+}
+
+TEST_DEF(test_list_for_each_entry_prefetch_ahead)
+{
+        static const unsigned int distances[] = {
+                0, 1, LIST_PREFETCH_DISTANCE, ITEMS_COUNT, ITEMS_COUNT * 2
+        };
+        struct item items[ITEMS_COUNT],
+                *item = NULL;
+        struct list_head *ahead = NULL;
+        unsigned int i,
+                d;
+        LIST_HEAD(list);
+
+        i = 0;
+        list_for_each_entry_prefetch_ahead(item, ahead, &list, list, 4)
+        {
+                ++i;
+        }
+        TEST_ASSERT(i == 0);
+
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                items[i].id = i;
+                list_add_tail(&items[i].list, &list);
+        }
+
+        for(d = 0; d < ARRAY_SIZE(distances); ++d)
+        {
+                i = 0;
+                list_for_each_entry_prefetch_ahead(item, ahead, &list, list,
+                                                   distances[d])
+                {
+                        TEST_ASSERT(item->id == i);
+                        ++i;
+                }
+                TEST_ASSERT(i == ITEMS_COUNT);
+                TEST_ASSERT(ahead == &list);
+        }
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/list");
+
+        TEST_RUN(test_list_for_each_entry_prefetch);
+        TEST_RUN(test_list_for_each_entry_prefetch_ahead);
+
+        return TEST_MODULE_RETURN;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/list_sort.h>
+#include <flibc/flibc.h>
+#include <flibc/list.h>
+#include <flibc/unit.h>
+
+#include <stdlib.h>
+
+#define ITEMS_COUNT 10000
+
+struct item {
+        int key;
+        unsigned int id;
+        struct list_head node;
+};
+
+static unsigned int cmp_calls;
+
+static int item_cmp(void *priv, const struct list_head *a,
+                    const struct list_head *b)
+{
+        int ka = list_entry(a, const struct item, node)->key,
+                kb = list_entry(b, const struct item, node)->key;
+
+        UNUSED(priv);
+        ++cmp_calls;
+
+        return (ka > kb) - (ka < kb);
+}
+
+/* check order, stability and links in both directions */
+static int list_check(struct list_head *head, unsigned int count)
+{
+        struct list_head *pos = NULL;
+        struct item *prev = NULL,
+                *item = NULL;
+        unsigned int n = 0;
+
+        list_for_each(pos, head)
+        {
+                if(pos->next->prev != pos || pos->prev->next != pos)
+                {
+                        return 0;
+                }
+
+                item = list_entry(pos, struct item, node);
+                if(prev != NULL
+                   && (prev->key > item->key
+                       || (prev->key == item->key && prev->id > item->id)))
+                {
+                        return 0;
+                }
+
+                prev = item;
+                ++n;
+        }
+
+        return n == count && head->next->prev == head;
+}
+
+TEST_DEF(test_list_sort)
+{
+        LIST_HEAD(head);
+        struct item *items = NULL;
+        unsigned int i,
+                log2n = 0;
+
+        /* empty and one item lists */
+        list_sort(NULL, &head, item_cmp);
+        TEST_ASSERT(list_empty(&head));
+
+        items = calloc(ITEMS_COUNT, sizeof(*items));
+        TEST_ASSERT(items != NULL);
+
+        items[0].key = 1;
+        list_add_tail(&items[0].node, &head);
+        list_sort(NULL, &head, item_cmp);
+        TEST_ASSERT(list_check(&head, 1));
+
+        /* random keys with many duplicates */
+        INIT_LIST_HEAD(&head);
+        srand(42);
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                items[i].key = rand() % 100;
+                items[i].id = i;
+                list_add_tail(&items[i].node, &head);
+        }
+
+        cmp_calls = 0;
+        list_sort(NULL, &head, item_cmp);
+        TEST_ASSERT(list_check(&head, ITEMS_COUNT));
+
+        /* n log n */
+        for(i = ITEMS_COUNT; i > 1; i /= 2)
+        {
+                ++log2n;
+        }
+        TEST_ASSERT(cmp_calls <= ITEMS_COUNT * (log2n + 1));
+
+        /* already sorted and reversed lists */
+        list_sort(NULL, &head, item_cmp);
+        TEST_ASSERT(list_check(&head, ITEMS_COUNT));
+
+        INIT_LIST_HEAD(&head);
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                items[i].key = (int) (ITEMS_COUNT - i);
+                list_add_tail(&items[i].node, &head);
+        }
+        list_sort(NULL, &head, item_cmp);
+        TEST_ASSERT(list_check(&head, ITEMS_COUNT));
+        TEST_ASSERT(list_entry(head.next, struct item, node)->key == 1);
+
+        free(items);
+}
+
+TEST_DEF(test_list_merge)
+{
+        LIST_HEAD(head);
+        LIST_HEAD(list);
+        struct item items[10];
+        static const int keys[] = { 1, 3, 3, 7, 9, 0, 3, 4, 10, 11 };
+        unsigned int i;
+
+        /* two sorted lists: 1 3 3 7 9 and 0 3 4 10 11 */
+        for(i = 0; i < ARRAY_SIZE(items); ++i)
+        {
+                items[i].key = keys[i];
+                items[i].id = i;
+                list_add_tail(&items[i].node, i < 5 ? &head : &list);
+        }
+
+        list_merge(NULL, &head, &list, item_cmp);
+        TEST_ASSERT(list_empty(&list));
+        /* ids of the equal items (3) are in order: head items first */
+        TEST_ASSERT(list_check(&head, ARRAY_SIZE(items)));
+
+        /* merge into an empty list */
+        list_merge(NULL, &list, &head, item_cmp);
+        TEST_ASSERT(list_empty(&head));
+        TEST_ASSERT(list_check(&list, ARRAY_SIZE(items)));
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/list_sort");
+
+        TEST_RUN(test_list_sort);
+        TEST_RUN(test_list_merge);
+
+        return TEST_MODULE_RETURN;
+}
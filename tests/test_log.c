@@ -19,10 +19,27 @@
 
 #define ENABLE_VT102_COLOR 1
 #define ENABLE_LOG_DEBUG 1
+#define ENABLE_LOG_STATS 1
+#define ENABLE_LOG_RING 1
 #include <flibc/log.h>
 #include <flibc/flibc.h>
+#include <flibc/str.h>
 #include <flibc/unit.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
 TEST_DEF(test_log)
 {
 	/* only test if there macro issues */
@@ -40,11 +57,823 @@ TEST_DEF(test_log)
         TEST_ASSERT(1);
 }
 
+TEST_DEF(test_log_timestamp)
+{
+        const char *ts = NULL;
+        char expect[32];
+        char first[LOG_TIMESTAMP_LEN + 1];
+        struct tm tm;
+        time_t now;
+        int i;
+
+        /* the second may change between time() and log_timestamp() */
+        for(i = 0; i < 3; ++i)
+        {
+                now = time(NULL);
+                ts = log_timestamp();
+
+                TEST_ASSERT(localtime_r(&now, &tm) != NULL);
+                strftime(expect, sizeof(expect), "%Y-%m-%dT%H:%M:%S", &tm);
+
+                if(strncmp(ts, expect, strlen(expect)) == 0)
+                {
+                        break;
+                }
+        }
+
+        TEST_ASSERT(i < 3);
+        TEST_ASSERT(strlen(ts) == LOG_TIMESTAMP_LEN);
+        TEST_ASSERT(ts[LOG_TIMESTAMP_LEN - 4] == '.');
+        for(i = LOG_TIMESTAMP_LEN - 3; i < LOG_TIMESTAMP_LEN; ++i)
+        {
+                TEST_ASSERT(ts[i] >= '0' && ts[i] <= '9');
+        }
+
+        /* cached buffer is reused and never goes backward */
+        memcpy(first, ts, sizeof(first));
+        TEST_ASSERT(log_timestamp() == ts);
+        TEST_ASSERT(strcmp(log_timestamp(), first) >= 0);
+}
+
+/*
+ * Read a structured line written in a pipe and skip its timestamp
+ */
+static const char *test_log_kv_read(int fd, char *buf, size_t size,
+                                    const char *ts_prefix)
+{
+        ssize_t ret;
+        size_t prefix_len = strlen(ts_prefix);
+
+        ret = read(fd, buf, size - 1);
+        if(ret <= 0)
+        {
+                return "";
+        }
+        buf[ret] = '\0';
+
+        if(strncmp(buf, ts_prefix, prefix_len) != 0
+           || strlen(buf) < prefix_len + LOG_TIMESTAMP_LEN)
+        {
+                return "";
+        }
+
+        return buf + prefix_len + LOG_TIMESTAMP_LEN;
+}
+
+TEST_DEF(test_log_kv_logfmt)
+{
+        struct log_kv_logger logger;
+        char buf[LOG_KV_LINE_SIZE + 1];
+        char long_msg[2 * LOG_KV_LINE_SIZE];
+        const char *line = NULL;
+        int fds[2];
+
+        TEST_ASSERT(pipe(fds) == 0);
+
+        TEST_ASSERT(log_kv_logger_setup(&logger, fds[1], LOG_KV_LOGFMT,
+                                        KV_STR("app", "test"),
+                                        KV_INT("v", 3)) == 0);
+
+        TEST_ASSERT(log_kv_to(&logger, LOG_INFO, "request done",
+                              KV_STR("user", "bob"),
+                              KV_INT("lat_us", -12),
+                              KV_UINT("bytes", 4096),
+                              KV_BOOL("cached", 1),
+                              KV_STR("path", "/a b"),
+                              KV_STR("empty", "")) == 0);
+        line = test_log_kv_read(fds[0], buf, sizeof(buf), "ts=");
+        TEST_ASSERT(strcmp(line,
+                           " level=info msg=\"request done\" app=test v=3"
+                           " user=bob lat_us=-12 bytes=4096 cached=true"
+                           " path=\"/a b\" empty=\"\"\n") == 0);
+
+        /* no field and escaping */
+        TEST_ASSERT(log_kv_to(&logger, LOG_ERR, "say \"hi\"\n") == 0);
+        line = test_log_kv_read(fds[0], buf, sizeof(buf), "ts=");
+        TEST_ASSERT(strcmp(line, " level=err msg=\"say \\\"hi\\\"\\n\""
+                           " app=test v=3\n") == 0);
+
+        /* truncation keeps the end of line */
+        memset(long_msg, 'x', sizeof(long_msg) - 1);
+        long_msg[sizeof(long_msg) - 1] = '\0';
+        TEST_ASSERT(log_kv_to(&logger, LOG_DEBUG, long_msg,
+                              KV_INT("lost", 1)) == 0);
+        line = test_log_kv_read(fds[0], buf, sizeof(buf), "ts=");
+        TEST_ASSERT(strlen(buf) <= LOG_KV_LINE_SIZE);
+        TEST_ASSERT(str_endwith(line, "xx\" truncated=true\n"));
+
+        close(fds[0]);
+        close(fds[1]);
+}
+
+#define TEST_LOG_KV_STATIC "0123456789abcdef0123456789abcdef0123456789abcdef"
+
+TEST_DEF(test_log_kv_exact_fit)
+{
+        struct log_kv_logger logger;
+        char buf[2 * LOG_KV_LINE_SIZE];
+        char msg[LOG_KV_LINE_SIZE];
+        const char *line = NULL;
+        size_t len;
+        int fds[2];
+
+        TEST_ASSERT(pipe(fds) == 0);
+
+        /* static fields longer than the tail kept for the closing */
+        TEST_ASSERT(log_kv_logger_setup(&logger, fds[1], LOG_KV_LOGFMT,
+                                        KV_STR("app", TEST_LOG_KV_STATIC),
+                                        KV_INT("v", 3)) == 0);
+
+        /*
+         * Messages around the size of the line: one of them fills the
+         * content area exactly, its closing quote must not push the
+         * fields out of the line.
+         */
+        for(len = LOG_KV_LINE_SIZE - 150; len < sizeof(msg); ++len)
+        {
+                memset(msg, 'x', len);
+                msg[len] = '\0';
+
+                TEST_ASSERT(log_kv_to(&logger, LOG_INFO, msg,
+                                      KV_INT("n", 1)) == 0);
+                line = test_log_kv_read(fds[0], buf, sizeof(buf), "ts=");
+                TEST_ASSERT(strlen(buf) <= LOG_KV_LINE_SIZE);
+                TEST_ASSERT(strstr(line, "x\" ") != NULL);
+                TEST_ASSERT(str_endwith(line, "\" app=" TEST_LOG_KV_STATIC
+                                        " v=3 n=1\n")
+                            || str_endwith(line, " truncated=true\n"));
+        }
+
+        close(fds[0]);
+        close(fds[1]);
+}
+
+#undef TEST_LOG_KV_STATIC
+
+TEST_DEF(test_log_kv_json)
+{
+        struct log_kv_logger logger;
+        char buf[LOG_KV_LINE_SIZE + 1];
+        const char *line = NULL;
+        int fds[2];
+
+        TEST_ASSERT(pipe(fds) == 0);
+
+        TEST_ASSERT(log_kv_logger_setup(&logger, fds[1], LOG_KV_JSON,
+                                        KV_STR("app", "test")) == 0);
+
+        TEST_ASSERT(log_kv_to(&logger, LOG_WARNING, "tab\there",
+                              KV_INT("min", LLONG_MIN),
+                              KV_DOUBLE("ratio", 0.5),
+                              KV_STR("ctl", "\001"),
+                              KV_STR("null", NULL),
+                              KV_BOOL("ok", 0)) == 0);
+        line = test_log_kv_read(fds[0], buf, sizeof(buf), "{\"ts\":\"");
+        TEST_ASSERT(strcmp(line,
+                           "\",\"level\":\"warning\",\"msg\":\"tab\\there\","
+                           "\"app\":\"test\",\"min\":-9223372036854775808,"
+                           "\"ratio\":0.5,\"ctl\":\"\\u0001\",\"null\":null,"
+                           "\"ok\":false}\n") == 0);
+
+        /* keys are escaped like values */
+        TEST_ASSERT(log_kv_to(&logger, LOG_INFO, "k",
+                              KV_INT("a\"b\\c", 1)) == 0);
+        line = test_log_kv_read(fds[0], buf, sizeof(buf), "{\"ts\":\"");
+        TEST_ASSERT(str_endwith(line,
+                                ",\"app\":\"test\",\"a\\\"b\\\\c\":1}\n"));
+
+        close(fds[0]);
+        close(fds[1]);
+}
+
+TEST_DEF(test_log_kv_fields_too_big)
+{
+        struct log_kv_logger logger;
+        char big[LOG_KV_FIELDS_SIZE];
+
+        /* static fields which don't fit */
+        memset(big, 'a', sizeof(big) - 1);
+        big[sizeof(big) - 1] = '\0';
+        TEST_ASSERT(log_kv_logger_setup(&logger, -1, LOG_KV_JSON,
+                                        KV_STR("big", big)) == -1);
+}
+
+TEST_DEF(test_log_kv_syslog)
+{
+        /* only test if there macro issues */
+        log_open("flibc_test_log", LOG_PID, LOG_USER);
+
+        TEST_ASSERT(log_kv(LOG_INFO, "structured", KV_STR("k", "v")) == 0);
+        TEST_ASSERT(log_kv(LOG_INFO, "no fields") == 0);
+
+        log_close();
+}
+
+static void *test_log_stats_thread(void *arg)
+{
+        struct log_kv_logger *logger = arg;
+        int i;
+
+        for(i = 0; i < 100; ++i)
+        {
+                log_kv_to(logger, LOG_DEBUG, "thread", KV_INT("i", i));
+        }
+
+        return NULL;
+}
+
+TEST_DEF(test_log_stats)
+{
+        struct log_kv_logger logger;
+        struct log_stats stats;
+        pthread_t threads[4];
+        char buf[65536];
+        unsigned long long latencies = 0;
+        unsigned int i;
+        int fds[2];
+
+        TEST_ASSERT(pipe(fds) == 0);
+        TEST_ASSERT(log_kv_logger_setup(&logger, fds[1], LOG_KV_LOGFMT) == 0);
+
+        log_stats_reset();
+        log_stats_snapshot(&stats);
+        TEST_ASSERT(stats.messages[LOG_INFO] == 0);
+        TEST_ASSERT(stats.drops == 0);
+        TEST_ASSERT(log_stats_latency_percentile(&stats, 99) == 0);
+
+        /* messages and bytes per level */
+        TEST_ASSERT(log_kv_to(&logger, LOG_INFO, "one") == 0);
+        TEST_ASSERT(log_kv_to(&logger, LOG_INFO, "two") == 0);
+        TEST_ASSERT(log_kv_to(&logger, LOG_ERR, "three") == 0);
+
+        log_stats_snapshot(&stats);
+        TEST_ASSERT(stats.messages[LOG_INFO] == 2);
+        TEST_ASSERT(stats.messages[LOG_ERR] == 1);
+        TEST_ASSERT(stats.bytes[LOG_INFO]
+                    == (unsigned long long)read(fds[0], buf, sizeof(buf))
+                    - stats.bytes[LOG_ERR]);
+        for(i = 0; i < LOG_STATS_LATENCY_BUCKETS; ++i)
+        {
+                latencies += stats.latency[i];
+        }
+        TEST_ASSERT(latencies == 3);
+        TEST_ASSERT(log_stats_latency_percentile(&stats, 50)
+                    <= log_stats_latency_percentile(&stats, 100));
+
+        /* text messages with ENABLE_LOG_STATS */
+        log_open("flibc_test_log", LOG_PID, LOG_USER);
+        log_notice("counted %d", 1);
+        log_close();
+
+        log_stats_snapshot(&stats);
+        TEST_ASSERT(stats.messages[LOG_NOTICE] == 1);
+        TEST_ASSERT(stats.bytes[LOG_NOTICE]
+                    == strlen(VT102_COLOR_PURPLE("counted 1")));
+
+        /* counters of finished threads are kept */
+        for(i = 0; i < ARRAY_SIZE(threads); ++i)
+        {
+                TEST_ASSERT(pthread_create(&threads[i], NULL,
+                                           test_log_stats_thread,
+                                           &logger) == 0);
+        }
+        for(i = 0; i < ARRAY_SIZE(threads); ++i)
+        {
+                pthread_join(threads[i], NULL);
+        }
+
+        log_stats_snapshot(&stats);
+        TEST_ASSERT(stats.messages[LOG_DEBUG] == 400);
+
+        /* drops */
+        close(fds[0]);
+        close(fds[1]);
+        TEST_ASSERT(log_kv_to(&logger, LOG_INFO, "lost") == -1);
+
+        log_stats_snapshot(&stats);
+        TEST_ASSERT(stats.drops == 1);
+        TEST_ASSERT(stats.messages[LOG_INFO] == 2);
+
+        log_stats_reset();
+        log_stats_snapshot(&stats);
+        TEST_ASSERT(stats.messages[LOG_DEBUG] == 0);
+        TEST_ASSERT(stats.drops == 0);
+}
+
+TEST_DEF(test_log_stats_report)
+{
+        struct log_kv_logger saved = log_kv_default;
+        char buf[LOG_KV_LINE_SIZE + 1];
+        ssize_t ret;
+        int fds[2];
+
+        TEST_ASSERT(pipe(fds) == 0);
+        TEST_ASSERT(log_kv_logger_setup(&log_kv_default, fds[1],
+                                        LOG_KV_LOGFMT) == 0);
+
+        /* report is written by the first message after the period */
+        log_stats_report_every(1);
+        sleep(1);
+        TEST_ASSERT(log_kv(LOG_INFO, "trigger") == 0);
+        log_stats_report_every(0);
+
+        ret = read(fds[0], buf, sizeof(buf) - 1);
+        log_kv_default = saved;
+        close(fds[0]);
+        close(fds[1]);
+
+        TEST_ASSERT(ret > 0);
+        buf[ret] = '\0';
+        TEST_ASSERT(strstr(buf, "msg=\"trigger\"") != NULL);
+        TEST_ASSERT(strstr(buf, "msg=\"log stats\"") != NULL);
+        TEST_ASSERT(strstr(buf, " drops=") != NULL);
+}
+
+/*
+ * Dump a flight recorder in a buffer
+ */
+static int test_log_ring_dump(const char *path, char *buf, size_t size)
+{
+        ssize_t len;
+        int fds[2],
+                ret;
+
+        if(pipe(fds) != 0)
+        {
+                return -1;
+        }
+
+        ret = log_ring_dump(path, fds[1]);
+        close(fds[1]);
+
+        len = read(fds[0], buf, size - 1);
+        close(fds[0]);
+
+        buf[len > 0 ? len : 0] = '\0';
+
+        return ret;
+}
+
+TEST_DEF(test_log_ring)
+{
+        struct log_ring ring;
+        struct str_list lines;
+        struct str_list_item *item = NULL;
+        char buf[8192];
+        char long_msg[LOG_RING_SLOT_SIZE * 2];
+        char expect[32];
+        struct stat st;
+        size_t size;
+        int fd,
+                i;
+
+        unlink("/tmp/test_log_ring");
+
+        TEST_ASSERT(log_ring_open(&ring, "/tmp/test_log_ring", 1024) == -1);
+        TEST_ASSERT(log_ring_dump("/tmp/test_log_ring", 1) == -1);
+
+        /* 4096 bytes: a header and 15 slots, rounded to 8 slots */
+        TEST_ASSERT(log_ring_open(&ring, "/tmp/test_log_ring", 4096) == 0);
+        TEST_ASSERT(test_log_ring_dump("/tmp/test_log_ring",
+                                       buf, sizeof(buf)) == 0);
+
+        for(i = 0; i < 20; ++i)
+        {
+                log_ring_printf(&ring, LOG_INFO, "msg %d", i);
+        }
+
+        TEST_ASSERT(test_log_ring_dump("/tmp/test_log_ring",
+                                       buf, sizeof(buf)) == 8);
+
+        /* only the last 8 messages, in order */
+        str_rtrim(buf, "\n");
+        TEST_ASSERT(str_split(buf, "\n", &lines) == 8);
+        i = 12;
+        str_list_for_each_entry(&lines, item)
+        {
+                snprintf(expect, sizeof(expect), " info msg %d", i);
+                TEST_ASSERT(strlen(item->value) > LOG_TIMESTAMP_LEN);
+                TEST_ASSERT(strcmp(item->value + LOG_TIMESTAMP_LEN,
+                                   expect) == 0);
+                ++i;
+        }
+        str_list_cleanup(&lines);
+
+        /* long message is truncated */
+        memset(long_msg, 'x', sizeof(long_msg));
+        log_ring_write(&ring, LOG_ERR, long_msg, sizeof(long_msg));
+        log_ring_close(&ring);
+
+        /* records are kept when the file is opened again */
+        TEST_ASSERT(log_ring_open(&ring, "/tmp/test_log_ring", 4096) == 0);
+        log_ring_write(&ring, LOG_WARNING, "last", 4);
+        log_ring_close(&ring);
+
+        TEST_ASSERT(test_log_ring_dump("/tmp/test_log_ring",
+                                       buf, sizeof(buf)) == 8);
+        TEST_ASSERT(str_endwith(buf, " warning last\n"));
+        TEST_ASSERT(strstr(buf, " err xxx") != NULL);
+        TEST_ASSERT(strstr(buf, "x\n") - strstr(buf, " err x")
+                    == (ptrdiff_t)(LOG_RING_SLOT_SIZE - 24 + 4));
+
+        /* another size is refused, the file is kept */
+        TEST_ASSERT(stat("/tmp/test_log_ring", &st) == 0);
+        size = (size_t)st.st_size;
+
+        errno = 0;
+        TEST_ASSERT(log_ring_open(&ring, "/tmp/test_log_ring", 8192) == -1);
+        TEST_ASSERT(errno == EINVAL);
+        TEST_ASSERT(stat("/tmp/test_log_ring", &st) == 0
+                    && (size_t)st.st_size == size);
+        TEST_ASSERT(test_log_ring_dump("/tmp/test_log_ring",
+                                       buf, sizeof(buf)) == 8);
+
+        /* so is a file of the right size which isn't a flight recorder */
+        fd = open("/tmp/test_log_ring", O_WRONLY | O_TRUNC);
+        TEST_ASSERT(fd >= 0);
+        memset(buf, 'a', size);
+        TEST_ASSERT(write(fd, buf, size) == (ssize_t)size);
+        close(fd);
+
+        errno = 0;
+        TEST_ASSERT(log_ring_open(&ring, "/tmp/test_log_ring", 4096) == -1);
+        TEST_ASSERT(errno == EINVAL);
+        fd = open("/tmp/test_log_ring", O_RDONLY);
+        TEST_ASSERT(fd >= 0);
+        TEST_ASSERT(read(fd, buf, sizeof(buf)) == (ssize_t)size);
+        close(fd);
+        TEST_ASSERT(buf[0] == 'a' && buf[size - 1] == 'a');
+
+        /* an empty file is made a flight recorder */
+        fd = open("/tmp/test_log_ring", O_WRONLY | O_TRUNC);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+        TEST_ASSERT(log_ring_open(&ring, "/tmp/test_log_ring", 8192) == 0);
+        log_ring_close(&ring);
+        TEST_ASSERT(test_log_ring_dump("/tmp/test_log_ring",
+                                       buf, sizeof(buf)) == 0);
+
+        unlink("/tmp/test_log_ring");
+}
+
+TEST_DEF(test_log_ring_crash)
+{
+        struct log_ring ring;
+        char buf[8192];
+        pid_t pid;
+        int status;
+
+        unlink("/tmp/test_log_ring_crash");
+
+        pid = fork();
+        TEST_ASSERT(pid >= 0);
+
+        if(pid == 0)
+        {
+                if(log_ring_open(&ring, "/tmp/test_log_ring_crash",
+                                 65536) != 0)
+                {
+                        _exit(1);
+                }
+
+                log_ring_default = &ring;
+                log_record(LOG_NOTICE, "starting");
+                log_debug("before crash %d", 42);
+
+                abort();
+        }
+
+        TEST_ASSERT(waitpid(pid, &status, 0) == pid);
+        TEST_ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+        TEST_ASSERT(test_log_ring_dump("/tmp/test_log_ring_crash",
+                                       buf, sizeof(buf)) == 2);
+        TEST_ASSERT(strstr(buf, " notice starting\n") != NULL);
+        TEST_ASSERT(strstr(buf, " debug in ") != NULL);
+        TEST_ASSERT(str_endwith(buf, " - before crash 42\n"));
+
+        unlink("/tmp/test_log_ring_crash");
+}
+
+#define TEST_LOG_SYSLOG_PATH "/tmp/test_log_syslog.sock"
+
+/*
+ * Stand-in for the system logger: a local datagram socket
+ */
+static int test_log_syslog_server(void)
+{
+        struct sockaddr_un addr;
+        int fd;
+
+        unlink(TEST_LOG_SYSLOG_PATH);
+
+        fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if(fd < 0)
+        {
+                return -1;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        str_copy(addr.sun_path, sizeof(addr.sun_path), TEST_LOG_SYSLOG_PATH);
+
+        if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+                close(fd);
+                return -1;
+        }
+
+        return fd;
+}
+
+static ssize_t test_log_syslog_recv(int fd, char *buf, size_t size)
+{
+        ssize_t ret;
+
+        ret = recv(fd, buf, size - 1, MSG_DONTWAIT);
+        buf[ret > 0 ? ret : 0] = '\0';
+
+        return ret;
+}
+
+static void *test_log_syslog_reader(void *arg)
+{
+        char buf[LOG_SYSLOG_MSG_SIZE];
+        intptr_t count = 0;
+
+        while(count < LOG_SYSLOG_BATCH
+              && recv(*(int *)arg, buf, sizeof(buf), 0) > 0)
+        {
+                ++count;
+        }
+
+        return (void *)count;
+}
+
+static void *test_log_syslog_thread(void *arg)
+{
+        log_syslog_write(arg, LOG_INFO, "from thread");
+
+        /* not flushed: sent when the thread ends */
+        return NULL;
+}
+
+TEST_DEF(test_log_syslog)
+{
+        struct log_syslog client;
+        struct log_stats stats;
+        pthread_t thread;
+        void *received = NULL;
+        char buf[LOG_SYSLOG_MSG_SIZE + 1];
+        char expect[64];
+        char long_msg[2 * LOG_SYSLOG_MSG_SIZE];
+        pid_t pid;
+        int server,
+                status,
+                i;
+
+        server = test_log_syslog_server();
+        TEST_ASSERT(server >= 0);
+
+        TEST_ASSERT(log_syslog_open(&client, TEST_LOG_SYSLOG_PATH,
+                                    "flibc_test", LOG_PID, LOG_USER,
+                                    LOG_SYSLOG_RFC3164) == 0);
+
+        /* messages are queued... */
+        for(i = 0; i < 3; ++i)
+        {
+                log_syslog_write(&client, LOG_INFO, "hello %d", i);
+        }
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) == -1);
+
+        /* ...and sent by batch */
+        TEST_ASSERT(log_syslog_flush() == 3);
+        for(i = 0; i < 3; ++i)
+        {
+                TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) > 0);
+                /* <14>Mmm dd hh:mm:ss flibc_test[pid]: hello i */
+                TEST_ASSERT(str_startwith(buf, "<14>"));
+                TEST_ASSERT(strlen(buf) > 20 && buf[7] == ' '
+                            && buf[13] == ':' && buf[16] == ':'
+                            && buf[19] == ' ');
+                snprintf(expect, sizeof(expect), " flibc_test[%d]: hello %d",
+                         (int)getpid(), i);
+                TEST_ASSERT(strcmp(buf + 19, expect) == 0);
+        }
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) == -1);
+
+        /* errors are sent at once, with their facility */
+        log_syslog_write(&client, LOG_DAEMON | LOG_ERR, "failure");
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) > 0);
+        TEST_ASSERT(str_startwith(buf, "<27>"));
+        TEST_ASSERT(str_endwith(buf, ": failure"));
+
+        /* long messages are truncated */
+        memset(long_msg, 'x', sizeof(long_msg) - 1);
+        long_msg[sizeof(long_msg) - 1] = '\0';
+        log_syslog_write(&client, LOG_INFO, "%s", long_msg);
+        TEST_ASSERT(log_syslog_flush() == 1);
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf))
+                    == LOG_SYSLOG_MSG_SIZE - 1);
+
+        /* a full batch is sent (read by a thread: the socket queue
+           may be shorter than a batch) */
+        TEST_ASSERT(pthread_create(&thread, NULL, test_log_syslog_reader,
+                                   &server) == 0);
+        for(i = 0; i < LOG_SYSLOG_BATCH; ++i)
+        {
+                log_syslog_write(&client, LOG_DEBUG, "batch %d", i);
+        }
+        pthread_join(thread, &received);
+        TEST_ASSERT((intptr_t)received == LOG_SYSLOG_BATCH);
+        TEST_ASSERT(log_syslog_flush() == 0);
+
+        /* queue of a thread is sent when it ends */
+        TEST_ASSERT(pthread_create(&thread, NULL, test_log_syslog_thread,
+                                   &client) == 0);
+        pthread_join(thread, NULL);
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) > 0);
+        TEST_ASSERT(str_endwith(buf, ": from thread"));
+
+        /* a lone message is sent when it gets too old */
+        log_syslog_write(&client, LOG_INFO, "lone");
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) == -1);
+        for(i = 0; i < 2 * LOG_SYSLOG_MAX_AGE / 10
+                && test_log_syslog_recv(server, buf, sizeof(buf)) <= 0; ++i)
+        {
+                usleep(10000);
+        }
+        TEST_ASSERT(str_endwith(buf, ": lone"));
+        TEST_ASSERT(log_syslog_flush() == 0);
+
+        /* messages left are sent at exit */
+        pid = fork();
+        TEST_ASSERT(pid >= 0);
+        if(pid == 0)
+        {
+                log_syslog_write(&client, LOG_INFO, "at exit");
+                exit(0);
+        }
+        TEST_ASSERT(waitpid(pid, &status, 0) == pid);
+        TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) > 0);
+        TEST_ASSERT(str_endwith(buf, ": at exit"));
+
+        /* system logger is gone: messages are dropped */
+        close(server);
+        unlink(TEST_LOG_SYSLOG_PATH);
+
+        log_stats_reset();
+        log_syslog_write(&client, LOG_INFO, "lost");
+        TEST_ASSERT(log_syslog_flush() == -1);
+        log_stats_snapshot(&stats);
+        TEST_ASSERT(stats.drops == 1);
+
+        /* system logger is back: client connects again */
+        server = test_log_syslog_server();
+        TEST_ASSERT(server >= 0);
+
+        log_syslog_write(&client, LOG_INFO, "back");
+        TEST_ASSERT(log_syslog_flush() == 1);
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) > 0);
+        TEST_ASSERT(str_endwith(buf, ": back"));
+
+        log_stats_snapshot(&stats);
+        TEST_ASSERT(stats.messages[LOG_INFO] == 1);
+
+        log_syslog_close(&client);
+        close(server);
+        unlink(TEST_LOG_SYSLOG_PATH);
+}
+
+struct test_log_syslog_closed {
+        struct log_syslog *client;
+        pthread_barrier_t queued;
+        pthread_barrier_t closed;
+};
+
+static void *test_log_syslog_queue_thread(void *arg)
+{
+        struct test_log_syslog_closed *closed = arg;
+
+        log_syslog_write(closed->client, LOG_INFO, "queued by a thread");
+
+        /* still queued (not sent by the end of the thread) while the
+           client is closed */
+        pthread_barrier_wait(&closed->queued);
+        pthread_barrier_wait(&closed->closed);
+
+        return NULL;
+}
+
+TEST_DEF(test_log_syslog_close)
+{
+        struct test_log_syslog_closed closed;
+        struct log_syslog *client = NULL;
+        pthread_t thread;
+        char buf[LOG_SYSLOG_MSG_SIZE + 1];
+        int server;
+
+        server = test_log_syslog_server();
+        TEST_ASSERT(server >= 0);
+
+        /* freed once closed: nothing may use it later */
+        client = malloc(sizeof(*client));
+        TEST_ASSERT(client != NULL);
+        TEST_ASSERT(log_syslog_open(client, TEST_LOG_SYSLOG_PATH,
+                                    "flibc_test", 0, LOG_USER,
+                                    LOG_SYSLOG_RFC3164) == 0);
+
+        closed.client = client;
+        pthread_barrier_init(&closed.queued, NULL, 2);
+        pthread_barrier_init(&closed.closed, NULL, 2);
+        TEST_ASSERT(pthread_create(&thread, NULL,
+                                   test_log_syslog_queue_thread,
+                                   &closed) == 0);
+
+        /* messages queued by other threads are sent by close */
+        pthread_barrier_wait(&closed.queued);
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) == -1);
+        log_syslog_close(client);
+        free(client);
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) > 0);
+        TEST_ASSERT(str_endwith(buf, ": queued by a thread"));
+
+        /* and not again when the thread ends */
+        pthread_barrier_wait(&closed.closed);
+        pthread_join(thread, NULL);
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) == -1);
+
+        pthread_barrier_destroy(&closed.queued);
+        pthread_barrier_destroy(&closed.closed);
+        close(server);
+        unlink(TEST_LOG_SYSLOG_PATH);
+}
+
+TEST_DEF(test_log_syslog_rfc5424)
+{
+        struct log_syslog client;
+        char buf[LOG_SYSLOG_MSG_SIZE + 1];
+        char expect[64];
+        char long_path[sizeof(client.path) + 1];
+        const char *p = NULL;
+        int server;
+
+        server = test_log_syslog_server();
+        TEST_ASSERT(server >= 0);
+
+        TEST_ASSERT(log_syslog_open(&client, TEST_LOG_SYSLOG_PATH,
+                                    "flibc_test", LOG_PID, LOG_LOCAL0,
+                                    LOG_SYSLOG_RFC5424) == 0);
+
+        log_syslog_write(&client, LOG_NOTICE, "hello %s", "world");
+        log_syslog_close(&client);
+
+        /* <133>1 YYYY-MM-DDTHH:MM:SS.mmm+hh:mm host flibc_test pid - - msg */
+        TEST_ASSERT(test_log_syslog_recv(server, buf, sizeof(buf)) > 0);
+        TEST_ASSERT(str_startwith(buf, "<133>1 "));
+        p = buf + strlen("<133>1 ");
+        TEST_ASSERT(strlen(p) > LOG_TIMESTAMP_LEN + 6);
+        TEST_ASSERT(p[4] == '-' && p[10] == 'T' && p[19] == '.');
+        TEST_ASSERT((p[LOG_TIMESTAMP_LEN] == '+'
+                     || p[LOG_TIMESTAMP_LEN] == '-')
+                    && p[LOG_TIMESTAMP_LEN + 3] == ':'
+                    && p[LOG_TIMESTAMP_LEN + 6] == ' ');
+        snprintf(expect, sizeof(expect), " flibc_test %d - - hello world",
+                 (int)getpid());
+        TEST_ASSERT(str_endwith(buf, expect));
+
+        close(server);
+        unlink(TEST_LOG_SYSLOG_PATH);
+
+        TEST_ASSERT(log_syslog_open(&client, NULL, NULL, 0, LOG_USER,
+                                    LOG_SYSLOG_RFC3164) == 0);
+        TEST_ASSERT(strcmp(client.path, LOG_SYSLOG_PATH) == 0);
+
+        memset(long_path, 'a', sizeof(long_path) - 1);
+        long_path[sizeof(long_path) - 1] = '\0';
+        TEST_ASSERT(log_syslog_open(&client, long_path, NULL, 0,
+                                    LOG_USER, LOG_SYSLOG_RFC3164) == -1);
+}
+
 int main(void)
 {
         TEST_MODULE_INIT("flibc/log");
 
         TEST_RUN(test_log);
+        TEST_RUN(test_log_timestamp);
+        TEST_RUN(test_log_kv_logfmt);
+        TEST_RUN(test_log_kv_exact_fit);
+        TEST_RUN(test_log_kv_json);
+        TEST_RUN(test_log_kv_fields_too_big);
+        TEST_RUN(test_log_kv_syslog);
+        TEST_RUN(test_log_stats);
+        TEST_RUN(test_log_stats_report);
+        TEST_RUN(test_log_ring);
+        TEST_RUN(test_log_ring_crash);
+        TEST_RUN(test_log_syslog);
+        TEST_RUN(test_log_syslog_close);
+        TEST_RUN(test_log_syslog_rfc5424);
 
         return TEST_MODULE_RETURN;
 }
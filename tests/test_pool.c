@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/pool.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OBJECTS_COUNT 10000
+#define THREADS_COUNT 4
+
+struct object {
+        unsigned int id;
+        char data[20];
+};
+
+TEST_DEF(test_pool)
+{
+        struct pool pool;
+        struct object **objects = NULL;
+        unsigned int i;
+
+        TEST_ASSERT(pool_init(&pool, sizeof(struct object), 3) == -1);
+        TEST_ASSERT(pool_init(&pool, sizeof(struct object), 0) == 0);
+        TEST_ASSERT(pool.size >= sizeof(struct object));
+        TEST_ASSERT(pool.size % __alignof__(max_align_t) == 0);
+
+        objects = calloc(OBJECTS_COUNT, sizeof(*objects));
+        TEST_ASSERT(objects != NULL);
+
+        for(i = 0; i < OBJECTS_COUNT; ++i)
+        {
+                objects[i] = pool_alloc(&pool);
+                TEST_ASSERT(objects[i] != NULL);
+                TEST_ASSERT((uintptr_t) objects[i] % __alignof__(max_align_t) == 0);
+
+                objects[i]->id = i;
+                memset(objects[i]->data, (int) (i & 0xff),
+                       sizeof(objects[i]->data));
+        }
+
+        /* objects don't overlap */
+        for(i = 0; i < OBJECTS_COUNT; ++i)
+        {
+                TEST_ASSERT(objects[i]->id == i);
+                TEST_ASSERT(objects[i]->data[19] == (char) (i & 0xff));
+        }
+        TEST_ASSERT(pool.slabs_count > 1);
+
+        for(i = 0; i < OBJECTS_COUNT; ++i)
+        {
+                pool_free(&pool, objects[i]);
+        }
+        pool_free(&pool, NULL);
+
+        /* freed objects are reused: no new slab */
+        i = (unsigned int) pool.slabs_count;
+        objects[0] = pool_zalloc(&pool);
+        TEST_ASSERT(objects[0] != NULL);
+        TEST_ASSERT(objects[0]->id == 0 && objects[0]->data[0] == 0);
+        TEST_ASSERT(pool.slabs_count == i);
+        pool_free(&pool, objects[0]);
+
+        pool_cleanup(&pool);
+
+        /* big aligned objects */
+        TEST_ASSERT(pool_init(&pool, 3000, 64) == 0);
+        for(i = 0; i < 100; ++i)
+        {
+                objects[i] = pool_alloc(&pool);
+                TEST_ASSERT(objects[i] != NULL);
+                TEST_ASSERT((uintptr_t) objects[i] % 64 == 0);
+                memset(objects[i], 0, 3000);
+        }
+        pool_cleanup(&pool);
+
+        free(objects);
+}
+
+TEST_DEF(test_pool_no_cache)
+{
+        struct pool pools[POOL_MAX + 1];
+        void *obj = NULL;
+        unsigned int i;
+
+        for(i = 0; i < ARRAY_SIZE(pools); ++i)
+        {
+                TEST_ASSERT(pool_init(&pools[i], 16, 0) == 0);
+        }
+
+        /* no more thread cache: the pool still works */
+        TEST_ASSERT(pools[POOL_MAX].id == POOL_MAX);
+        obj = pool_alloc(&pools[POOL_MAX]);
+        TEST_ASSERT(obj != NULL);
+        pool_free(&pools[POOL_MAX], obj);
+        TEST_ASSERT(pool_alloc(&pools[POOL_MAX]) == obj);
+
+        for(i = 0; i < ARRAY_SIZE(pools); ++i)
+        {
+                pool_cleanup(&pools[i]);
+        }
+
+        /* ids are reused */
+        TEST_ASSERT(pool_init(&pools[0], 16, 0) == 0);
+        TEST_ASSERT(pools[0].id < POOL_MAX);
+        obj = pool_alloc(&pools[0]);
+        TEST_ASSERT(obj != NULL);
+        pool_free(&pools[0], obj);
+        pool_cleanup(&pools[0]);
+}
+
+struct worker {
+        struct pool *pool;
+        struct object **objects;
+        unsigned int count;
+};
+
+static void *worker_alloc(void *arg)
+{
+        struct worker *worker = arg;
+        unsigned int i;
+
+        for(i = 0; i < worker->count; ++i)
+        {
+                worker->objects[i] = pool_alloc(worker->pool);
+                if(worker->objects[i] != NULL)
+                {
+                        worker->objects[i]->id = i;
+                }
+        }
+
+        return NULL;
+}
+
+static void *worker_free(void *arg)
+{
+        struct worker *worker = arg;
+        unsigned int i;
+
+        for(i = 0; i < worker->count; ++i)
+        {
+                pool_free(worker->pool, worker->objects[i]);
+        }
+
+        return NULL;
+}
+
+TEST_DEF(test_pool_threads)
+{
+        struct pool pool;
+        struct worker workers[THREADS_COUNT];
+        pthread_t threads[THREADS_COUNT];
+        struct object **first = NULL;
+        unsigned int i,
+                j;
+        size_t total;
+
+        TEST_ASSERT(pool_init(&pool, sizeof(struct object), 0) == 0);
+
+        for(i = 0; i < THREADS_COUNT; ++i)
+        {
+                workers[i].pool = &pool;
+                workers[i].count = OBJECTS_COUNT;
+                workers[i].objects = calloc(OBJECTS_COUNT,
+                                            sizeof(struct object *));
+                TEST_ASSERT(workers[i].objects != NULL);
+                TEST_ASSERT(pthread_create(&threads[i], NULL, worker_alloc,
+                                           &workers[i]) == 0);
+        }
+
+        for(i = 0; i < THREADS_COUNT; ++i)
+        {
+                pthread_join(threads[i], NULL);
+                for(j = 0; j < OBJECTS_COUNT; ++j)
+                {
+                        TEST_ASSERT(workers[i].objects[j] != NULL);
+                        TEST_ASSERT(workers[i].objects[j]->id == j);
+                }
+        }
+
+        /* objects are freed by other threads than their allocator */
+        first = workers[0].objects;
+        for(i = 0; i < THREADS_COUNT - 1; ++i)
+        {
+                workers[i].objects = workers[i + 1].objects;
+        }
+        workers[THREADS_COUNT - 1].objects = first;
+        for(i = 0; i < THREADS_COUNT; ++i)
+        {
+                TEST_ASSERT(pthread_create(&threads[i], NULL, worker_free,
+                                           &workers[i]) == 0);
+        }
+        for(i = 0; i < THREADS_COUNT; ++i)
+        {
+                pthread_join(threads[i], NULL);
+        }
+
+        /* caches of exited threads went back to the pool */
+        total = pool.slabs_count
+                * ((pool.slab_size - pool.size) / pool.size);
+        TEST_ASSERT(pool.free_count >= THREADS_COUNT * OBJECTS_COUNT);
+        TEST_ASSERT(pool.free_count <= total + pool.slabs_count);
+
+        for(i = 0; i < THREADS_COUNT; ++i)
+        {
+                free(workers[i].objects);
+        }
+
+        pool_cleanup(&pool);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/pool");
+
+        TEST_RUN(test_pool);
+        TEST_RUN(test_pool_no_cache);
+        TEST_RUN(test_pool_threads);
+
+        return TEST_MODULE_RETURN;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/queue.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define PRODUCERS_COUNT 4
+#define ITEMS_PER_PRODUCER 100000
+#define RING_ITEMS 1000000
+
+struct item {
+        unsigned int producer;
+        unsigned int seq;
+        struct mpsc_node node;
+};
+
+struct producer {
+        struct mpsc_queue *queue;
+        struct item *items;
+        unsigned int id;
+};
+
+static void *producer_run(void *arg)
+{
+        struct producer *producer = arg;
+        unsigned int i;
+
+        for(i = 0; i < ITEMS_PER_PRODUCER; ++i)
+        {
+                producer->items[i].producer = producer->id;
+                producer->items[i].seq = i;
+                mpsc_push(producer->queue, &producer->items[i].node);
+        }
+
+        return NULL;
+}
+
+static void *ring_producer_run(void *arg)
+{
+        struct spsc_ring *ring = arg;
+        uintptr_t i;
+
+        for(i = 1; i <= RING_ITEMS; ++i)
+        {
+                while(spsc_ring_push(ring, (void *) i) != 0)
+                {
+                        sched_yield();
+                }
+        }
+
+        return NULL;
+}
+
+TEST_DEF(test_mpsc)
+{
+        struct mpsc_queue queue;
+        struct item items[3];
+        struct mpsc_node *nodes[4];
+        unsigned int i;
+
+        mpsc_queue_init(&queue);
+        TEST_ASSERT(mpsc_empty(&queue));
+        TEST_ASSERT(mpsc_pop(&queue) == NULL);
+
+        for(i = 0; i < ARRAY_SIZE(items); ++i)
+        {
+                items[i].seq = i;
+                mpsc_push(&queue, &items[i].node);
+        }
+        TEST_ASSERT(!mpsc_empty(&queue));
+
+        for(i = 0; i < ARRAY_SIZE(items); ++i)
+        {
+                struct mpsc_node *node = mpsc_pop(&queue);
+
+                TEST_ASSERT(node != NULL);
+                TEST_ASSERT(mpsc_entry(node, struct item, node)->seq == i);
+        }
+        TEST_ASSERT(mpsc_pop(&queue) == NULL);
+        TEST_ASSERT(mpsc_empty(&queue));
+
+        /* the queue can be reused after being emptied */
+        for(i = 0; i < ARRAY_SIZE(items); ++i)
+        {
+                mpsc_push(&queue, &items[i].node);
+        }
+        TEST_ASSERT(mpsc_pop_batch(&queue, nodes, ARRAY_SIZE(nodes)) == 3);
+        for(i = 0; i < ARRAY_SIZE(items); ++i)
+        {
+                TEST_ASSERT(nodes[i] == &items[i].node);
+        }
+        TEST_ASSERT(mpsc_pop_batch(&queue, nodes, ARRAY_SIZE(nodes)) == 0);
+}
+
+TEST_DEF(test_mpsc_stress)
+{
+        struct mpsc_queue queue;
+        struct producer producers[PRODUCERS_COUNT];
+        pthread_t threads[PRODUCERS_COUNT];
+        unsigned int next_seq[PRODUCERS_COUNT] = { 0 };
+        struct mpsc_node *nodes[64];
+        unsigned int i,
+                received = 0,
+                ordered = 1;
+        size_t n,
+                j;
+
+        mpsc_queue_init(&queue);
+
+        for(i = 0; i < PRODUCERS_COUNT; ++i)
+        {
+                producers[i].queue = &queue;
+                producers[i].id = i;
+                producers[i].items = calloc(ITEMS_PER_PRODUCER,
+                                            sizeof(struct item));
+                TEST_ASSERT(producers[i].items != NULL);
+        }
+
+        for(i = 0; i < PRODUCERS_COUNT; ++i)
+        {
+                TEST_ASSERT(pthread_create(&threads[i], NULL, producer_run,
+                                           &producers[i]) == 0);
+        }
+
+        /* items of one producer are popped in push order */
+        while(received < PRODUCERS_COUNT * ITEMS_PER_PRODUCER)
+        {
+                n = mpsc_pop_batch(&queue, nodes, ARRAY_SIZE(nodes));
+                for(j = 0; j < n; ++j)
+                {
+                        struct item *item = mpsc_entry(nodes[j], struct item,
+                                                       node);
+
+                        if(item->seq != next_seq[item->producer])
+                        {
+                                ordered = 0;
+                        }
+                        next_seq[item->producer] = item->seq + 1;
+                }
+
+                received += (unsigned int) n;
+        }
+
+        for(i = 0; i < PRODUCERS_COUNT; ++i)
+        {
+                pthread_join(threads[i], NULL);
+                TEST_ASSERT(next_seq[i] == ITEMS_PER_PRODUCER);
+                free(producers[i].items);
+        }
+
+        TEST_ASSERT(ordered);
+        TEST_ASSERT(mpsc_pop(&queue) == NULL);
+        TEST_ASSERT(mpsc_empty(&queue));
+}
+
+TEST_DEF(test_spsc_ring)
+{
+        struct spsc_ring ring;
+        void *items[4];
+        int values[5];
+        unsigned int i;
+
+        TEST_ASSERT(spsc_ring_init(&ring, 3) == 0);
+        TEST_ASSERT(ring.mask == 3);
+        TEST_ASSERT(spsc_ring_pop(&ring) == NULL);
+
+        for(i = 0; i < 4; ++i)
+        {
+                TEST_ASSERT(spsc_ring_push(&ring, &values[i]) == 0);
+        }
+        TEST_ASSERT(spsc_ring_push(&ring, &values[4]) == -1);
+
+        TEST_ASSERT(spsc_ring_pop(&ring) == &values[0]);
+        TEST_ASSERT(spsc_ring_push(&ring, &values[4]) == 0);
+
+        TEST_ASSERT(spsc_ring_pop_batch(&ring, items, ARRAY_SIZE(items)) == 4);
+        for(i = 0; i < 4; ++i)
+        {
+                TEST_ASSERT(items[i] == &values[i + 1]);
+        }
+        TEST_ASSERT(spsc_ring_pop_batch(&ring, items, ARRAY_SIZE(items)) == 0);
+
+        spsc_ring_cleanup(&ring);
+}
+
+TEST_DEF(test_spsc_ring_stress)
+{
+        struct spsc_ring ring;
+        pthread_t thread;
+        void *items[32];
+        uintptr_t expected = 1;
+        unsigned int ordered = 1;
+        size_t n,
+                i;
+
+        TEST_ASSERT(spsc_ring_init(&ring, 256) == 0);
+        TEST_ASSERT(pthread_create(&thread, NULL, ring_producer_run,
+                                   &ring) == 0);
+
+        while(expected <= RING_ITEMS)
+        {
+                n = spsc_ring_pop_batch(&ring, items, ARRAY_SIZE(items));
+                for(i = 0; i < n; ++i)
+                {
+                        if((uintptr_t) items[i] != expected)
+                        {
+                                ordered = 0;
+                        }
+                        ++expected;
+                }
+        }
+
+        pthread_join(thread, NULL);
+
+        TEST_ASSERT(ordered);
+        TEST_ASSERT(spsc_ring_pop(&ring) == NULL);
+
+        spsc_ring_cleanup(&ring);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/queue");
+
+        TEST_RUN(test_mpsc);
+        TEST_RUN(test_mpsc_stress);
+        TEST_RUN(test_spsc_ring);
+        TEST_RUN(test_spsc_ring_stress);
+
+        return TEST_MODULE_RETURN;
+}
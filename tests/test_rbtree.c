@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/rbtree.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <stdlib.h>
+
+#define ITEMS_COUNT 10000
+
+struct item {
+        unsigned int key;
+        unsigned int id;
+        struct rb_node node;
+};
+
+static int item_less(const struct rb_node *a, const struct rb_node *b)
+{
+        return rb_entry(a, const struct item, node)->key
+                < rb_entry(b, const struct item, node)->key;
+}
+
+static int item_cmp(const void *key, const struct rb_node *node)
+{
+        unsigned int k = *(const unsigned int *) key,
+                nk = rb_entry(node, const struct item, node)->key;
+
+        return (k > nk) - (k < nk);
+}
+
+/* return the black height or -1 if the tree is broken */
+static int rb_check(const struct rb_node *node, const struct rb_node *parent)
+{
+        int left,
+                right;
+
+        if(node == NULL)
+        {
+                return 1;
+        }
+
+        if(rb_parent(node) != parent)
+        {
+                return -1;
+        }
+
+        /* a red node has black children */
+        if(!(node->__rb_parent_color & 1)
+           && ((node->rb_left && !(node->rb_left->__rb_parent_color & 1))
+               || (node->rb_right
+                   && !(node->rb_right->__rb_parent_color & 1))))
+        {
+                return -1;
+        }
+
+        left = rb_check(node->rb_left, node);
+        right = rb_check(node->rb_right, node);
+        if(left < 0 || left != right)
+        {
+                return -1;
+        }
+
+        return left + (int) (node->__rb_parent_color & 1);
+}
+
+static int rb_sorted(const struct rb_root *root, unsigned int *count)
+{
+        struct item *item = NULL;
+        unsigned int prev = 0;
+
+        *count = 0;
+        rb_for_each_entry(item, root, node)
+        {
+                if(item->key < prev)
+                {
+                        return 0;
+                }
+                prev = item->key;
+                ++*count;
+        }
+
+        return 1;
+}
+
+TEST_DEF(test_rbtree)
+{
+        struct rb_root root = RB_ROOT;
+        struct item *items = NULL,
+                *item = NULL;
+        struct rb_node *node = NULL;
+        unsigned int i,
+                count,
+                key;
+
+        TEST_ASSERT(RB_EMPTY_ROOT(&root));
+        TEST_ASSERT(rb_first(&root) == NULL);
+        TEST_ASSERT(rb_last(&root) == NULL);
+
+        items = calloc(ITEMS_COUNT, sizeof(*items));
+        TEST_ASSERT(items != NULL);
+
+        srand(42);
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                /* even keys only, with duplicates */
+                items[i].key = ((unsigned int) rand() % (ITEMS_COUNT / 2)) * 2;
+                items[i].id = i;
+                rb_add(&items[i].node, &root, item_less);
+        }
+
+        TEST_ASSERT(rb_check(root.rb_node, NULL) > 0);
+        TEST_ASSERT(rb_sorted(&root, &count));
+        TEST_ASSERT(count == ITEMS_COUNT);
+
+        /* equal keys keep the insertion order */
+        for(node = rb_first(&root); rb_next(node) != NULL; node = rb_next(node))
+        {
+                struct item *a = rb_entry(node, struct item, node),
+                        *b = rb_entry(rb_next(node), struct item, node);
+
+                TEST_ASSERT(a->key != b->key || a->id < b->id);
+        }
+
+        /* reverse order */
+        count = 0;
+        key = ~0U;
+        rb_for_each_entry_reverse(item, &root, node)
+        {
+                TEST_ASSERT(item->key <= key);
+                key = item->key;
+                ++count;
+        }
+        TEST_ASSERT(count == ITEMS_COUNT);
+
+        /* bounds */
+        for(key = 0; key < ITEMS_COUNT; ++key)
+        {
+                struct rb_node *lower = rb_lower_bound(&key, &root, item_cmp),
+                        *upper = rb_upper_bound(&key, &root, item_cmp),
+                        *found = rb_find(&key, &root, item_cmp),
+                        *first = rb_find_first(&key, &root, item_cmp);
+
+                if(lower != NULL)
+                {
+                        TEST_ASSERT(rb_entry(lower, struct item, node)->key >= key);
+                        TEST_ASSERT(rb_prev(lower) == NULL
+                                    || rb_entry(rb_prev(lower), struct item, node)->key < key);
+                }
+                if(upper != NULL)
+                {
+                        TEST_ASSERT(rb_entry(upper, struct item, node)->key > key);
+                        TEST_ASSERT(rb_prev(upper) == NULL
+                                    || rb_entry(rb_prev(upper), struct item, node)->key <= key);
+                }
+
+                if(key % 2 == 1)
+                {
+                        TEST_ASSERT(found == NULL);
+                        TEST_ASSERT(lower == upper);
+                }
+                else if(found != NULL)
+                {
+                        TEST_ASSERT(first == lower);
+                        TEST_ASSERT(rb_entry(found, struct item, node)->key == key);
+                }
+        }
+
+        /* erase one item out of two */
+        for(i = 0; i < ITEMS_COUNT; i += 2)
+        {
+                rb_erase(&items[i].node, &root);
+                RB_CLEAR_NODE(&items[i].node);
+                TEST_ASSERT(RB_EMPTY_NODE(&items[i].node));
+        }
+
+        TEST_ASSERT(rb_check(root.rb_node, NULL) > 0);
+        TEST_ASSERT(rb_sorted(&root, &count));
+        TEST_ASSERT(count == ITEMS_COUNT / 2);
+
+        /* replace a node */
+        items[0] = items[1];
+        rb_replace_node(&items[1].node, &items[0].node, &root);
+        TEST_ASSERT(rb_check(root.rb_node, NULL) > 0);
+
+        for(i = 0; i < ITEMS_COUNT; i += 2)
+        {
+                rb_erase(&items[i ? i + 1 : 0].node, &root);
+        }
+
+        TEST_ASSERT(RB_EMPTY_ROOT(&root));
+
+        free(items);
+}
+
+TEST_DEF(test_rbtree_cached)
+{
+        struct rb_root_cached root = RB_ROOT_CACHED;
+        struct item *items = NULL;
+        unsigned int i,
+                count;
+
+        TEST_ASSERT(rb_first_cached(&root) == NULL);
+
+        items = calloc(ITEMS_COUNT, sizeof(*items));
+        TEST_ASSERT(items != NULL);
+
+        srand(4242);
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                struct rb_node *leftmost;
+
+                items[i].key = (unsigned int) rand();
+                leftmost = rb_add_cached(&items[i].node, &root, item_less);
+
+                TEST_ASSERT(rb_first_cached(&root) == rb_first(&root.rb_root));
+                TEST_ASSERT(leftmost == NULL
+                            || leftmost == rb_first_cached(&root));
+        }
+
+        TEST_ASSERT(rb_check(root.rb_root.rb_node, NULL) > 0);
+
+        /* pop the first nodes like a timer queue */
+        for(i = 0; i < ITEMS_COUNT / 2; ++i)
+        {
+                rb_erase_cached(rb_first_cached(&root), &root);
+                TEST_ASSERT(rb_first_cached(&root) == rb_first(&root.rb_root));
+        }
+
+        /* then erase the others in random order */
+        for(i = 0; i < ITEMS_COUNT; ++i)
+        {
+                if(!RB_EMPTY_ROOT(&root.rb_root)
+                   && rb_find(&items[i].key, &root.rb_root, item_cmp) == &items[i].node)
+                {
+                        rb_erase_cached(&items[i].node, &root);
+                        TEST_ASSERT(rb_first_cached(&root) == rb_first(&root.rb_root));
+                }
+        }
+
+        TEST_ASSERT(rb_check(root.rb_root.rb_node, NULL) > 0);
+        TEST_ASSERT(rb_sorted(&root.rb_root, &count));
+
+        free(items);
+}
+
+TEST_DEF(test_rbtree_postorder)
+{
+        struct rb_root root = RB_ROOT;
+        struct item *item = NULL,
+                *tmp = NULL;
+        unsigned int i,
+                count = 0;
+
+        for(i = 0; i < 1000; ++i)
+        {
+                item = malloc(sizeof(*item));
+                TEST_ASSERT(item != NULL);
+
+                item->key = i * 7 % 1000;
+                rb_add(&item->node, &root, item_less);
+        }
+
+        rbtree_postorder_for_each_entry_safe(item, tmp, &root, node)
+        {
+                free(item);
+                ++count;
+        }
+
+        TEST_ASSERT(count == 1000);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/rbtree");
+
+        TEST_RUN(test_rbtree);
+        TEST_RUN(test_rbtree_cached);
+        TEST_RUN(test_rbtree_postorder);
+
+        return TEST_MODULE_RETURN;
+}
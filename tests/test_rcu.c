@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/rcu.h>
+#include <flibc/flibc.h>
+#include <flibc/list.h>
+#include <flibc/unit.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#define READERS_COUNT 4
+#define ROUTES_COUNT 16
+#define UPDATES_COUNT 20000
+
+#define ROUTE_ALIVE 0x600dUL
+#define ROUTE_DEAD 0xdeadUL
+
+struct route {
+        unsigned long magic;
+        unsigned int id;
+        struct list_head node;
+        struct rcu_head rcu;
+};
+
+static LIST_HEAD(routes);
+static _Atomic int updating;
+static _Atomic unsigned int freed;
+static _Atomic unsigned int errors;
+
+static void route_free(struct rcu_head *head)
+{
+        struct route *route = container_of(head, struct route, rcu);
+
+        route->magic = ROUTE_DEAD;
+        free(route);
+        atomic_fetch_add(&freed, 1);
+}
+
+static struct route *route_new(unsigned int id)
+{
+        struct route *route = malloc(sizeof(*route));
+
+        if(route != NULL)
+        {
+                route->magic = ROUTE_ALIVE;
+                route->id = id;
+        }
+
+        return route;
+}
+
+static void *reader_run(void *arg)
+{
+        struct route *route = NULL;
+        unsigned int count;
+
+        UNUSED(arg);
+
+        rcu_register_thread();
+
+        while(atomic_load(&updating))
+        {
+                count = 0;
+
+                rcu_read_lock();
+                /* nested sections are allowed */
+                rcu_read_lock();
+                list_for_each_entry_rcu(route, &routes, node)
+                {
+                        if(route->magic != ROUTE_ALIVE
+                           || route->id >= ROUTES_COUNT)
+                        {
+                                atomic_fetch_add(&errors, 1);
+                        }
+                        ++count;
+                }
+                rcu_read_unlock();
+                rcu_read_unlock();
+
+                /*
+                 * count isn't checked: a reader preempted during a walk
+                 * can miss moved routes or see them twice
+                 */
+                if(count == 0)
+                {
+                        atomic_fetch_add(&errors, 1);
+                }
+        }
+
+        rcu_unregister_thread();
+
+        return NULL;
+}
+
+TEST_DEF(test_rcu_pointer)
+{
+        static struct route *current = NULL;
+        struct route *route = NULL,
+                *old = NULL;
+
+        rcu_register_thread();
+
+        route = route_new(1);
+        TEST_ASSERT(route != NULL);
+        rcu_assign_pointer(current, route);
+
+        rcu_read_lock();
+        TEST_ASSERT(rcu_dereference(current)->id == 1);
+        rcu_read_unlock();
+
+        /* no reader: returns at once */
+        route = route_new(2);
+        TEST_ASSERT(route != NULL);
+        old = current;
+        rcu_assign_pointer(current, route);
+        synchronize_rcu();
+        free(old);
+
+        atomic_store(&freed, 0);
+        call_rcu(&current->rcu, route_free);
+        current = NULL;
+        TEST_ASSERT(rcu_reclaim() == 1);
+        TEST_ASSERT(atomic_load(&freed) == 1);
+        TEST_ASSERT(rcu_reclaim() == 0);
+
+        rcu_unregister_thread();
+}
+
+TEST_DEF(test_rcu_reader_blocks_reclaim)
+{
+        struct route *route = route_new(3);
+
+        TEST_ASSERT(route != NULL);
+
+        rcu_register_thread();
+        atomic_store(&freed, 0);
+
+        /* an object removed during our critical section isn't freed */
+        rcu_read_lock();
+        call_rcu(&route->rcu, route_free);
+        TEST_ASSERT(rcu_reclaim() == 0);
+        TEST_ASSERT(route->magic == ROUTE_ALIVE);
+        rcu_read_unlock();
+
+        TEST_ASSERT(rcu_reclaim() == 1);
+        TEST_ASSERT(atomic_load(&freed) == 1);
+
+        rcu_unregister_thread();
+}
+
+TEST_DEF(test_rcu_list_stress)
+{
+        pthread_t threads[READERS_COUNT];
+        struct route *route = NULL,
+                *old = NULL;
+        unsigned int i,
+                pos = 0;
+
+        atomic_store(&freed, 0);
+        atomic_store(&errors, 0);
+        atomic_store(&updating, 1);
+
+        for(i = 0; i < ROUTES_COUNT; ++i)
+        {
+                route = route_new(i);
+                TEST_ASSERT(route != NULL);
+                list_add_tail_rcu(&route->node, &routes);
+        }
+
+        for(i = 0; i < READERS_COUNT; ++i)
+        {
+                TEST_ASSERT(pthread_create(&threads[i], NULL,
+                                           reader_run, NULL) == 0);
+        }
+
+        for(i = 0; i < UPDATES_COUNT; ++i)
+        {
+                /* pick the pos-th route and replace or move it */
+                pos = (pos + 7) % ROUTES_COUNT;
+                old = list_entry(routes.next, struct route, node);
+                while(pos-- > 0)
+                {
+                        old = list_entry(old->node.next, struct route, node);
+                }
+                pos = old->id;
+
+                route = route_new(old->id);
+                TEST_ASSERT(route != NULL);
+
+                if(i % 2 == 0)
+                {
+                        list_replace_rcu(&old->node, &route->node);
+                }
+                else
+                {
+                        list_del_rcu(&old->node);
+                        list_add_rcu(&route->node, &routes);
+                }
+
+                if(i % 100 == 0)
+                {
+                        synchronize_rcu();
+                        route_free(&old->rcu);
+                }
+                else
+                {
+                        call_rcu(&old->rcu, route_free);
+                }
+
+                if(i % 1000 == 0)
+                {
+                        sched_yield();
+                }
+        }
+
+        atomic_store(&updating, 0);
+        for(i = 0; i < READERS_COUNT; ++i)
+        {
+                pthread_join(threads[i], NULL);
+        }
+
+        rcu_barrier();
+        TEST_ASSERT(atomic_load(&freed) == UPDATES_COUNT);
+        TEST_ASSERT(atomic_load(&errors) == 0);
+
+        while(!list_empty(&routes))
+        {
+                route = list_entry(routes.next, struct route, node);
+                list_del(&route->node);
+                free(route);
+        }
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/rcu");
+
+        TEST_RUN(test_rcu_pointer);
+        TEST_RUN(test_rcu_reader_blocks_reclaim);
+        TEST_RUN(test_rcu_list_stress);
+
+        return TEST_MODULE_RETURN;
+}
@@ -19,6 +19,9 @@
 
 #define ENABLE_VT102_COLOR 1
 #include <flibc/str.h>
+#include <flibc/pool.h>
+#include <flibc/arena.h>
+#include <flibc/str_intern.h>
 #include <flibc/flibc.h>
 #include <flibc/math.h>
 #include <flibc/list.h>
@@ -556,6 +559,240 @@ TEST_DEF(test_str_list_toarray)
         str_list_cleanup(&list);
 }
 
+TEST_DEF(test_str_list_tovec)
+{
+	struct str_list list;
+        struct str_vec vec;
+        unsigned int count,
+		i;
+        const char *items_expect[] = {
+                "192",
+                "168",
+                "1",
+                "1",
+        };
+
+        count = str_split("192.168.1.1", ".", &list);
+        TEST_ASSERT(count == 4);
+
+        str_vec_init(&vec);
+        TEST_ASSERT(str_vec_push(&vec, "ip") == 0);
+        TEST_ASSERT(str_list_tovec(&list, &vec) == 0);
+        TEST_ASSERT(vec_len(&vec) == count + 1);
+
+        TEST_ASSERT(strcmp(vec_at(&vec, 0), "ip") == 0);
+        for(i = 0; i < ARRAY_SIZE(items_expect); ++i)
+        {
+                TEST_ASSERT(strcmp(vec_at(&vec, i + 1), items_expect[i]) == 0);
+        }
+
+        str_vec_cleanup(&vec);
+        str_list_cleanup(&list);
+}
+
+TEST_DEF(test_str_list_sort)
+{
+	struct str_list list;
+        struct str_list_item *item = NULL;
+        unsigned int i;
+        const char *sorted[] = { "10", "2", "9", "abc", "b" };
+        const char *sorted_len[] = { "2", "9", "b", "10", "abc" };
+
+        str_split("9 abc 2 b 10", " ", &list);
+
+        str_list_sort(&list, NULL);
+        i = 0;
+        str_list_for_each_entry(&list, item)
+        {
+                TEST_ASSERT(strcmp(item->value, sorted[i]) == 0);
+                ++i;
+        }
+        TEST_ASSERT(i == ARRAY_SIZE(sorted));
+
+        str_list_sort(&list, str_lencmp);
+        i = 0;
+        str_list_for_each_entry(&list, item)
+        {
+                TEST_ASSERT(strcmp(item->value, sorted_len[i]) == 0);
+                ++i;
+        }
+        TEST_ASSERT(i == ARRAY_SIZE(sorted_len));
+        TEST_ASSERT(str_list_length(&list) == ARRAY_SIZE(sorted_len));
+
+        str_list_cleanup(&list);
+}
+
+TEST_DEF(test_str_list_pool)
+{
+        struct pool pool;
+	struct str_list list;
+        struct str_list_item *item = NULL;
+        char long_word[64];
+        unsigned int count,
+                i;
+        const char *items_expect[] = {
+                "192",
+                "168",
+                "",
+                "1",
+        };
+
+        TEST_ASSERT(pool_init(&pool, STR_LIST_POOL_SIZE(8), 0) == 0);
+
+        count = str_split_pool("192.168..1", ".", &list, &pool);
+        TEST_ASSERT(count == 4);
+        TEST_ASSERT(list.pool == &pool);
+
+        i = 0;
+        str_list_for_each_entry(&list, item)
+        {
+                TEST_ASSERT(strcmp(item->value, items_expect[i]) == 0);
+                /* short strings are stored in the item */
+                TEST_ASSERT(item->value == (char *) (item + 1));
+                ++i;
+        }
+
+        /* long strings are allocated */
+        memset(long_word, 'a', sizeof(long_word) - 1);
+        long_word[sizeof(long_word) - 1] = '\0';
+        TEST_ASSERT(str_list_add(&list, long_word) == 0);
+        item = list_entry(list.head.prev, struct str_list_item, node);
+        TEST_ASSERT(strcmp(item->value, long_word) == 0);
+        TEST_ASSERT(item->value != (char *) (item + 1));
+
+        TEST_ASSERT(str_list_remove(&list, "168") == 1);
+        TEST_ASSERT(str_list_remove(&list, long_word) == 1);
+        TEST_ASSERT(str_list_length(&list) == 3);
+
+        str_list_cleanup(&list);
+        TEST_ASSERT(str_list_length(&list) == 0);
+
+        pool_cleanup(&pool);
+}
+
+TEST_DEF(test_str_list_arena)
+{
+        struct arena arena;
+        struct str_list list;
+        struct str_list_item *item = NULL;
+        unsigned int count,
+                i;
+        const char *items_expect[] = {
+                "usr",
+                "local",
+                "lib",
+        };
+
+        TEST_ASSERT(arena_init(&arena, 0, 0) == 0);
+
+        count = str_split_arena("usr/local/lib", "/", &list, &arena);
+        TEST_ASSERT(count == 3);
+        TEST_ASSERT(list.arena == &arena);
+
+        i = 0;
+        str_list_for_each_entry(&list, item)
+        {
+                TEST_ASSERT(strcmp(item->value, items_expect[i]) == 0);
+                ++i;
+        }
+
+        TEST_ASSERT(str_list_add(&list, "share") == 0);
+        TEST_ASSERT(str_list_remove(&list, "local") == 1);
+        TEST_ASSERT(str_list_length(&list) == 3);
+
+        str_list_cleanup(&list);
+        arena_reset(&arena);
+        arena_cleanup(&arena);
+}
+
+TEST_DEF(test_str_list_intern)
+{
+        struct str_intern intern;
+        struct str_list list,
+                other;
+        struct str_list_item *item = NULL;
+        const char *values[4];
+
+        TEST_ASSERT(str_intern_init(&intern, 0) == 0);
+
+        TEST_ASSERT(str_split_intern("GET/HEAD/GET/HEAD", "/", &list,
+                                     &intern) == 4);
+        TEST_ASSERT(list.intern == &intern);
+        TEST_ASSERT(str_list_toarray(&list, values, 4) == 4);
+        TEST_ASSERT(strcmp(values[0], "GET") == 0);
+        TEST_ASSERT(strcmp(values[1], "HEAD") == 0);
+
+        /* stored once, in all the lists of the table */
+        TEST_ASSERT(values[0] == values[2] && values[1] == values[3]);
+        TEST_ASSERT(str_intern_count(&intern) == 2);
+
+        str_list_init_intern(&other, &intern);
+        TEST_ASSERT(str_list_add(&other, "GET") == 0);
+        str_list_for_each_entry(&other, item)
+        {
+                TEST_ASSERT(item->value == values[0]);
+        }
+
+        TEST_ASSERT(str_list_remove(&list, "GET") == 2);
+        TEST_ASSERT(str_list_length(&list) == 2);
+
+        /* only items are allocated for known strings */
+        TEST_ASSERT_ALLOC_COUNT(2, {
+                TEST_ASSERT(str_list_add(&list, "GET") == 0);
+                TEST_ASSERT(str_list_add(&list, "HEAD") == 0);
+        });
+
+        str_list_cleanup(&list);
+        str_list_cleanup(&other);
+        TEST_ASSERT(str_intern_find(&intern, "GET", 3) == values[0]);
+
+        str_intern_cleanup(&intern);
+}
+
+TEST_DEF(test_str_alloc_count)
+{
+        struct str_list list;
+        struct pool pool;
+        struct arena arena;
+
+        /* one allocation per item */
+        TEST_ASSERT_ALLOC_COUNT(3, {
+                TEST_ASSERT(str_split("usr/local/lib", "/", &list) == 3);
+        });
+        TEST_ASSERT_ALLOC_COUNT(1, {
+                TEST_ASSERT(str_list_add(&list, "share") == 0);
+        });
+        TEST_ASSERT_NO_ALLOC({
+                TEST_ASSERT(str_list_remove(&list, "local") == 1);
+                str_list_cleanup(&list);
+        });
+
+        /* pool and arena: nothing once they have memory */
+        TEST_ASSERT(pool_init(&pool, STR_LIST_POOL_SIZE(32), 0) == 0);
+        str_split_pool("usr/local/lib", "/", &list, &pool);
+        str_list_cleanup(&list);
+        TEST_ASSERT_NO_ALLOC({
+                TEST_ASSERT(str_split_pool("usr/local/lib", "/", &list,
+                                           &pool) == 3);
+                TEST_ASSERT(str_list_add(&list, "share") == 0);
+                str_list_cleanup(&list);
+        });
+        pool_cleanup(&pool);
+
+        TEST_ASSERT(arena_init(&arena, 0, 0) == 0);
+        str_split_arena("usr/local/lib", "/", &list, &arena);
+        str_list_cleanup(&list);
+        arena_reset(&arena);
+        TEST_ASSERT_NO_ALLOC({
+                TEST_ASSERT(str_split_arena("usr/local/lib", "/", &list,
+                                            &arena) == 3);
+                TEST_ASSERT(str_list_add(&list, "share") == 0);
+                str_list_cleanup(&list);
+                arena_reset(&arena);
+        });
+        arena_cleanup(&arena);
+}
+
 TEST_DEF(test_str_list_add_remove)
 {
 	struct str_list str_list;
@@ -609,6 +846,335 @@ TEST_DEF(test_str_list_add_remove)
 	str_list_cleanup(&str_list);
 }
 
+/*
+ * Call an implementation of str_utf8_valid() or str_utf8_len(),
+ * STR_UTF8_IMPLS for the one chosen for this CPU
+ */
+static int test_utf8_valid(int impl, const char *str, size_t len)
+{
+        return impl == STR_UTF8_IMPLS ? str_utf8_valid(str, len)
+                : __str_utf8_valid_impl((enum str_utf8_impl)impl, str, len);
+}
+
+static size_t test_utf8_len(int impl, const char *str, size_t len)
+{
+        return impl == STR_UTF8_IMPLS ? str_utf8_len(str, len)
+                : __str_utf8_len_impl((enum str_utf8_impl)impl, str, len);
+}
+
+struct utf8_case {
+        const char *str;
+        int valid;
+};
+
+static const struct utf8_case utf8_cases[] = {
+        { "", 1 },
+        { "hello", 1 },
+        { "\xc3\xa9t\xc3\xa9", 1 },                     /* été */
+        { "\xe2\x82\xac", 1 },                          /* U+20AC */
+        { "\xf0\x9f\x98\x80", 1 },                      /* U+1F600 */
+        { "\xc2\x80\xdf\xbf", 1 },                      /* U+80, U+7FF */
+        { "\xe0\xa0\x80\xef\xbf\xbf", 1 },              /* U+800, U+FFFF */
+        { "\xf0\x90\x80\x80\xf4\x8f\xbf\xbf", 1 },      /* U+10000..10FFFF */
+        { "\xed\x9f\xbf\xee\x80\x80", 1 },              /* around surrogates */
+        { "\x80", 0 },                                  /* lone continuation */
+        { "\xc3", 0 },                                  /* truncated */
+        { "\xe2\x82", 0 },
+        { "\xf0\x9f\x98", 0 },
+        { "\xc3t", 0 },                                 /* too short */
+        { "\xc3\xa9\xa9", 0 },                          /* too long */
+        { "\xc0\xaf", 0 },                              /* overlong */
+        { "\xc1\xbf", 0 },
+        { "\xe0\x9f\xbf", 0 },
+        { "\xf0\x8f\xbf\xbf", 0 },
+        { "\xed\xa0\x80", 0 },                          /* surrogates */
+        { "\xed\xbf\xbf", 0 },
+        { "\xf4\x90\x80\x80", 0 },                      /* > U+10FFFF */
+        { "\xf5\x80\x80\x80", 0 },
+        { "\xf8\x88\x80\x80\x80", 0 },
+        { "\xff", 0 },
+};
+
+TEST_DEF(test_str_utf8_valid)
+{
+        char buf[128];
+        unsigned int i;
+        size_t len,
+                offset;
+        int impl;
+
+        /* every implementation the CPU can run, then the dispatcher */
+        for(impl = 0; impl <= STR_UTF8_IMPLS; ++impl)
+        {
+                if(impl < STR_UTF8_IMPLS
+                   && !__str_utf8_impl_supported((enum str_utf8_impl)impl))
+                {
+                        continue;
+                }
+
+                for(i = 0; i < ARRAY_SIZE(utf8_cases); ++i)
+                {
+                        len = strlen(utf8_cases[i].str);
+
+                        /* at every position in 16 and 32 bytes blocks */
+                        for(offset = 0; offset + len <= sizeof(buf); ++offset)
+                        {
+                                memset(buf, 'a', sizeof(buf));
+                                memcpy(buf + offset, utf8_cases[i].str, len);
+
+                                TEST_ASSERT(test_utf8_valid(impl, buf,
+                                                            offset + len)
+                                            == utf8_cases[i].valid);
+                                TEST_ASSERT(test_utf8_valid(impl, buf,
+                                                            sizeof(buf))
+                                            == utf8_cases[i].valid);
+                        }
+                }
+        }
+}
+
+TEST_DEF(test_str_utf8_valid_random)
+{
+        /* mix of 1 to 4 bytes characters */
+        static const char text[] =
+                "L'\xc3\xa9t\xc3\xa9 \xe2\x82\xac 100 \xf0\x9f\x98\x80 "
+                "\xce\xb1\xce\xb2\xce\xb3 \xe6\x97\xa5\xe6\x9c\xac ok";
+        char buf[256];
+        unsigned int seed = 42,
+                i,
+                j;
+        size_t len;
+        int impl;
+
+        for(i = 0; i < 5000; ++i)
+        {
+                /* a few characters with some bytes replaced */
+                len = (size_t)rand_r(&seed) % sizeof(buf);
+                for(j = 0; j < len; ++j)
+                {
+                        buf[j] = text[(j + i) % (sizeof(text) - 1)];
+                }
+                for(j = (unsigned int)rand_r(&seed) % 3; j > 0 && len > 0; --j)
+                {
+                        buf[(size_t)rand_r(&seed) % len] = (char)rand_r(&seed);
+                }
+
+                for(impl = 0; impl <= STR_UTF8_IMPLS; ++impl)
+                {
+                        TEST_ASSERT(test_utf8_valid(impl, buf, len)
+                                    == str_utf8_valid_scalar(buf, len));
+                        TEST_ASSERT(test_utf8_len(impl, buf, len)
+                                    == str_utf8_len_scalar(buf, len));
+                }
+        }
+}
+
+TEST_DEF(test_str_utf8_len)
+{
+        char buf[100];
+        unsigned int i;
+        int impl;
+
+        /* 25 characters of 4 bytes, crossing blocks */
+        for(i = 0; i < sizeof(buf); i += 4)
+        {
+                memcpy(buf + i, "\xf0\x9f\x98\x80", 4);
+        }
+
+        /* unsupported implementations fall back to the scalar one */
+        for(impl = 0; impl <= STR_UTF8_IMPLS; ++impl)
+        {
+                TEST_ASSERT(test_utf8_len(impl, "", 0) == 0);
+                TEST_ASSERT(test_utf8_len(impl, "hello", 5) == 5);
+                TEST_ASSERT(test_utf8_len(impl, "\xc3\xa9t\xc3\xa9", 5) == 3);
+                TEST_ASSERT(test_utf8_len(impl, "\xf0\x9f\x98\x80!", 5) == 2);
+
+                TEST_ASSERT(test_utf8_len(impl, buf, sizeof(buf)) == 25);
+                TEST_ASSERT(test_utf8_len(impl, buf, sizeof(buf) - 1) == 25);
+                TEST_ASSERT(test_utf8_len(impl, buf, 64) == 16);
+        }
+}
+
+TEST_DEF(test_str_utf8_truncate)
+{
+        const char *s = "\xc3\xa9t\xc3\xa9";
+
+        TEST_ASSERT(str_utf8_truncate(s, 5, 10) == 5);
+        TEST_ASSERT(str_utf8_truncate(s, 5, 5) == 5);
+        TEST_ASSERT(str_utf8_truncate(s, 5, 4) == 3);
+        TEST_ASSERT(str_utf8_truncate(s, 5, 3) == 3);
+        TEST_ASSERT(str_utf8_truncate(s, 5, 2) == 2);
+        TEST_ASSERT(str_utf8_truncate(s, 5, 1) == 0);
+        TEST_ASSERT(str_utf8_truncate(s, 5, 0) == 0);
+
+        s = "a\xf0\x9f\x98\x80";
+        TEST_ASSERT(str_utf8_truncate(s, 5, 4) == 1);
+        TEST_ASSERT(str_utf8_truncate(s, 5, 2) == 1);
+
+        /* not UTF-8: cut anyway */
+        s = "\x80\x80\x80\x80\x80\x80";
+        TEST_ASSERT(str_utf8_truncate(s, 6, 5) == 5);
+}
+
+TEST_DEF(test_str_copy_utf8)
+{
+        char buf5[5];
+        size_t ret;
+
+        ret = str_copy_utf8(buf5, sizeof(buf5), "\xc3\xa9t\xc3\xa9");
+        TEST_ASSERT(ret == 5);
+        TEST_ASSERT(strcmp(buf5, "\xc3\xa9t") == 0);
+
+        ret = str_copy_utf8(buf5, sizeof(buf5), "\xc3\xa9t");
+        TEST_ASSERT(ret == 3);
+        TEST_ASSERT(strcmp(buf5, "\xc3\xa9t") == 0);
+
+        ret = str_copy_utf8(buf5, sizeof(buf5), "abcdef");
+        TEST_ASSERT(ret == 6);
+        TEST_ASSERT(strcmp(buf5, "abcd") == 0);
+}
+
+TEST_DEF(test_str_tolower)
+{
+        char buf[64];
+        char mixed[] = "Content-Type: TEXT/Html; Charset="
+                "\xc3\x89t\xc3\xa9 @[`{ 0-9 Z";
+        size_t ret;
+
+        /* UTF-8 and bytes around the letters are left as is */
+        TEST_ASSERT(strcmp(str_tolower(mixed),
+                           "content-type: text/html; charset="
+                           "\xc3\x89t\xc3\xa9 @[`{ 0-9 z") == 0);
+        TEST_ASSERT(strcmp(str_toupper(mixed),
+                           "CONTENT-TYPE: TEXT/HTML; CHARSET="
+                           "\xc3\x89T\xc3\xa9 @[`{ 0-9 Z") == 0);
+
+        /* copies, truncated like str_copy() */
+        ret = str_tolower_copy(buf, sizeof(buf), "Accept-ENCODING");
+        TEST_ASSERT(ret == 15);
+        TEST_ASSERT(strcmp(buf, "accept-encoding") == 0);
+
+        ret = str_toupper_copy(buf, 7, "Accept-ENCODING");
+        TEST_ASSERT(ret == 15);
+        TEST_ASSERT(strcmp(buf, "ACCEPT") == 0);
+
+        /* only len bytes */
+        str_copy(buf, sizeof(buf), "ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+        str_tolower_len(buf, buf, 20);
+        TEST_ASSERT(strcmp(buf, "abcdefghijklmnopqrstUVWXYZ") == 0);
+}
+
+/* reference: byte per byte in the C locale */
+static int casecmp_ref(const char *a, const char *b)
+{
+        unsigned char ca,
+                cb;
+
+        do
+        {
+                ca = (unsigned char)*a++;
+                cb = (unsigned char)*b++;
+                ca = ca >= 'A' && ca <= 'Z' ? (unsigned char)(ca | 0x20) : ca;
+                cb = cb >= 'A' && cb <= 'Z' ? (unsigned char)(cb | 0x20) : cb;
+        }
+        while(ca == cb && ca != '\0');
+
+        return ca - cb;
+}
+
+static int sign(int value)
+{
+        return (value > 0) - (value < 0);
+}
+
+TEST_DEF(test_str_casecmp)
+{
+        static const char alphabet[] = "aAbBzZ@[`{\xc3\xa9-";
+        char a[48],
+                b[48];
+        unsigned int seed = 7,
+                i;
+        size_t len,
+                j;
+
+        TEST_ASSERT(str_casecmp("Content-Length", "content-length") == 0);
+        TEST_ASSERT(str_casecmp("abc", "ABD") < 0);
+        TEST_ASSERT(str_casecmp("abc", "AB") > 0);
+        TEST_ASSERT(str_casecmp("", "") == 0);
+        TEST_ASSERT(str_casecmp_len("HOST: x", 4, "host", 4) == 0);
+        TEST_ASSERT(str_casecmp_len("host", 4, "hosts", 5) < 0);
+
+        /* same sign as the reference, on short and long strings */
+        for(i = 0; i < 5000; ++i)
+        {
+                len = (size_t)rand_r(&seed) % (sizeof(a) - 1);
+                for(j = 0; j < len; ++j)
+                {
+                        a[j] = alphabet[(size_t)rand_r(&seed)
+                                        % (sizeof(alphabet) - 1)];
+                }
+                a[len] = '\0';
+
+                str_copy(b, sizeof(b), a);
+                if(len > 0 && rand_r(&seed) % 2)
+                {
+                        /* one byte changed */
+                        b[(size_t)rand_r(&seed) % len] =
+                                alphabet[(size_t)rand_r(&seed)
+                                         % (sizeof(alphabet) - 1)];
+                }
+                else if(rand_r(&seed) % 2)
+                {
+                        str_toupper(b);
+                }
+
+                TEST_ASSERT(sign(str_casecmp(a, b)) == sign(casecmp_ref(a, b)));
+                TEST_ASSERT(sign(str_casecmp(b, a)) == sign(casecmp_ref(b, a)));
+        }
+}
+
+TEST_DEF(test_str_casestartwith)
+{
+        TEST_ASSERT(str_casestartwith("Content-Type: text", "content-type"));
+        TEST_ASSERT(str_casestartwith("abc", ""));
+        TEST_ASSERT(!str_casestartwith("Content", "content-type"));
+        TEST_ASSERT(!str_casestartwith("Content-Type", "content_type"));
+
+        TEST_ASSERT(str_caseendwith("index.HTML", ".html"));
+        TEST_ASSERT(str_caseendwith("abc", ""));
+        TEST_ASSERT(!str_caseendwith("html", "index.html"));
+        TEST_ASSERT(!str_caseendwith("index.htm", ".html"));
+}
+
+TEST_DEF(test_str_casestr)
+{
+        char haystack[200];
+        unsigned int i;
+        const char *found;
+
+        TEST_ASSERT(str_casestr("Hello World", "") != NULL);
+        TEST_ASSERT(str_casestr("", "a") == NULL);
+        found = "Hello World";
+        TEST_ASSERT(str_casestr(found, "WORLD") == found + 6);
+        found = "Accept: text/html, Application/JSON";
+        TEST_ASSERT(str_casestr(found, "application/json") == found + 19);
+        TEST_ASSERT(str_casestr(found, "application/xml") == NULL);
+        TEST_ASSERT(str_casestr_len(found, 18, "text/HTML", 9) == found + 8);
+        TEST_ASSERT(str_casestr_len(found, 16, "text/HTML", 9) == NULL);
+
+        /* needle at every position, after partial matches ('!' is once) */
+        for(i = 0; i + 7 < sizeof(haystack); ++i)
+        {
+                memset(haystack, 'n', sizeof(haystack));
+                memcpy(haystack, "NEEDLNEEDLENEEDNEEDL", 20);
+                memcpy(haystack + i, "NeEdLe!", 7);
+                haystack[sizeof(haystack) - 1] = '\0';
+
+                found = str_casestr(haystack, "needle!");
+                TEST_ASSERT(found == haystack + i);
+        }
+}
+
 int main(void)
 {
         TEST_MODULE_INIT("flibc/str");
@@ -636,7 +1202,24 @@ int main(void)
         TEST_RUN(test_str_tol);
         TEST_RUN(test_str_toll);
 
+        TEST_RUN(test_str_utf8_valid);
+        TEST_RUN(test_str_utf8_valid_random);
+        TEST_RUN(test_str_utf8_len);
+        TEST_RUN(test_str_utf8_truncate);
+        TEST_RUN(test_str_copy_utf8);
+
+        TEST_RUN(test_str_tolower);
+        TEST_RUN(test_str_casecmp);
+        TEST_RUN(test_str_casestartwith);
+        TEST_RUN(test_str_casestr);
+
         TEST_RUN(test_str_list_toarray);
+        TEST_RUN(test_str_list_tovec);
+        TEST_RUN(test_str_list_sort);
+        TEST_RUN(test_str_list_pool);
+        TEST_RUN(test_str_list_arena);
+        TEST_RUN(test_str_list_intern);
+        TEST_RUN(test_str_alloc_count);
         TEST_RUN(test_str_list_add_remove);
 
         return TEST_MODULE_RETURN;
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/str_intern.h>
+#include <flibc/str.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <pthread.h>
+
+#define WORDS_COUNT 5000
+#define THREADS_COUNT 4
+
+TEST_DEF(test_str_intern)
+{
+        struct str_intern intern,
+                other;
+        const char *a,
+                *b;
+        char buf[16];
+
+        TEST_ASSERT(str_intern_init(&intern, 0) == 0);
+
+        a = str_intern_cstr(&intern, "status");
+        TEST_ASSERT(a != NULL && strcmp(a, "status") == 0);
+
+        /* same string, other buffer: same pointer */
+        str_copy(buf, sizeof(buf), "status");
+        TEST_ASSERT(a != buf);
+        TEST_ASSERT(str_intern_cstr(&intern, buf) == a);
+
+        /* a part of a buffer, not null terminated */
+        TEST_ASSERT(str_intern(&intern, "status_code", 6) == a);
+
+        b = str_intern(&intern, "status_code", 11);
+        TEST_ASSERT(b != a && strcmp(b, "status_code") == 0);
+
+        /* empty string and null bytes */
+        TEST_ASSERT(str_intern(&intern, "", 0) != NULL);
+        TEST_ASSERT(str_intern(&intern, "", 0) == str_intern(&intern, "", 0));
+        TEST_ASSERT(str_intern(&intern, "a\0b", 3)
+                    != str_intern(&intern, "a\0c", 3));
+
+        TEST_ASSERT(str_intern_count(&intern) == 5);
+        TEST_ASSERT(str_intern_find(&intern, "status", 6) == a);
+        TEST_ASSERT(str_intern_find(&intern, "missing", 7) == NULL);
+        TEST_ASSERT(str_intern_count(&intern) == 5);
+
+        /* each table hashes with its own seed */
+        TEST_ASSERT(str_intern_init(&other, 0) == 0);
+        TEST_ASSERT(other.seed != intern.seed);
+        TEST_ASSERT(strcmp(str_intern_cstr(&other, "status"), a) == 0);
+        str_intern_cleanup(&other);
+
+        str_intern_cleanup(&intern);
+}
+
+TEST_DEF(test_str_intern_grow)
+{
+        struct str_intern intern;
+        static const char *words[WORDS_COUNT];
+        char word[32];
+        unsigned int i;
+
+        TEST_ASSERT(str_intern_init(&intern, 0) == 0);
+
+        for(i = 0; i < WORDS_COUNT; ++i)
+        {
+                str_printf(word, sizeof(word), "word-%u", i);
+                words[i] = str_intern_cstr(&intern, word);
+                TEST_ASSERT(words[i] != NULL);
+        }
+        TEST_ASSERT(str_intern_count(&intern) == WORDS_COUNT);
+
+        /* pointers are stable when the table grows */
+        for(i = 0; i < WORDS_COUNT; ++i)
+        {
+                str_printf(word, sizeof(word), "word-%u", i);
+                TEST_ASSERT(str_intern_cstr(&intern, word) == words[i]);
+                TEST_ASSERT(strcmp(words[i], word) == 0);
+        }
+        TEST_ASSERT(str_intern_count(&intern) == WORDS_COUNT);
+
+        str_intern_cleanup(&intern);
+}
+
+struct intern_thread {
+        pthread_t thread;
+        struct str_intern *intern;
+        unsigned int first;
+        const char *words[WORDS_COUNT];
+};
+
+static void *intern_thread(void *arg)
+{
+        struct intern_thread *thread = arg;
+        char word[32];
+        unsigned int i,
+                n;
+
+        /* all the words, each thread in its own order */
+        for(i = 0; i < WORDS_COUNT; ++i)
+        {
+                n = (i + thread->first) % WORDS_COUNT;
+                str_printf(word, sizeof(word), "word-%u", n);
+                thread->words[n] = str_intern_cstr(thread->intern, word);
+        }
+
+        return NULL;
+}
+
+TEST_DEF(test_str_intern_threads)
+{
+        struct str_intern intern;
+        static struct intern_thread threads[THREADS_COUNT];
+        unsigned int i,
+                n;
+
+        TEST_ASSERT(str_intern_init(&intern, 5) == 0);
+        TEST_ASSERT(intern.shards_bits == 3);
+
+        for(i = 0; i < THREADS_COUNT; ++i)
+        {
+                threads[i].intern = &intern;
+                threads[i].first = i * WORDS_COUNT / THREADS_COUNT;
+                TEST_ASSERT(pthread_create(&threads[i].thread, NULL,
+                                           intern_thread, &threads[i]) == 0);
+        }
+        for(i = 0; i < THREADS_COUNT; ++i)
+        {
+                pthread_join(threads[i].thread, NULL);
+        }
+
+        /* one copy of each word, whoever interned it first */
+        TEST_ASSERT(str_intern_count(&intern) == WORDS_COUNT);
+        for(n = 0; n < WORDS_COUNT; ++n)
+        {
+                TEST_ASSERT(threads[0].words[n] != NULL);
+                for(i = 1; i < THREADS_COUNT; ++i)
+                {
+                        TEST_ASSERT(threads[i].words[n]
+                                    == threads[0].words[n]);
+                }
+        }
+
+        str_intern_cleanup(&intern);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/str_intern");
+
+        TEST_RUN(test_str_intern);
+        TEST_RUN(test_str_intern_grow);
+        TEST_RUN(test_str_intern_threads);
+
+        return TEST_MODULE_RETURN;
+}
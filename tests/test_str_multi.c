@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/str_multi.h>
+#include <flibc/str.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <stdlib.h>
+
+static int multi_find(const char *str, const char **patterns,
+                      unsigned int count, struct str_multi_match *match)
+{
+        struct str_multi multi;
+        unsigned int i;
+        int ret;
+
+        str_multi_init(&multi);
+        for(i = 0; i < count; ++i)
+        {
+                str_multi_add(&multi, patterns[i], NULL);
+        }
+        str_multi_compile(&multi);
+        ret = str_multi_find(&multi, str, strlen(str), match);
+        str_multi_cleanup(&multi);
+
+        return ret;
+}
+
+TEST_DEF(test_str_multi_find)
+{
+        const char *patterns[] = { "abc", "abcd", "bcd", "b", "he", "she",
+                                   "hers" };
+        struct str_multi_match match;
+
+        /* leftmost first, then longest */
+        TEST_ASSERT(multi_find("xabcde", patterns, 3, &match));
+        TEST_ASSERT(match.index == 1 && match.offset == 1 && match.len == 4);
+
+        TEST_ASSERT(multi_find("xabcde", patterns + 2, 2, &match));
+        TEST_ASSERT(match.index == 0 && match.offset == 2 && match.len == 3);
+
+        /* a longer pattern which doesn't complete */
+        TEST_ASSERT(multi_find("xabcx", patterns + 1, 3, &match));
+        TEST_ASSERT(match.index == 2 && match.offset == 2 && match.len == 1);
+
+        /* "she" starts before "he" and "hers" */
+        TEST_ASSERT(multi_find("ushers", patterns + 4, 3, &match));
+        TEST_ASSERT(match.index == 1 && match.offset == 1 && match.len == 3);
+
+        TEST_ASSERT(multi_find("hers", patterns + 4, 3, &match));
+        TEST_ASSERT(match.index == 2 && match.offset == 0 && match.len == 4);
+
+        TEST_ASSERT(!multi_find("xyz", patterns, ARRAY_SIZE(patterns),
+                                &match));
+        TEST_ASSERT(!multi_find("", patterns, ARRAY_SIZE(patterns), &match));
+}
+
+TEST_DEF(test_str_multi_replace)
+{
+        struct str_multi multi;
+        char output[128],
+                output8[8];
+        int ret;
+
+        str_multi_init(&multi);
+        TEST_ASSERT(str_multi_add(&multi, "{{name}}", "Bob") == 0);
+        TEST_ASSERT(str_multi_add(&multi, "{{city}}", "Paris") == 1);
+        TEST_ASSERT(str_multi_add(&multi, "password=", "password=***") == 2);
+        TEST_ASSERT(str_multi_add(&multi, "secret", NULL) == 3);
+        /* first one wins */
+        TEST_ASSERT(str_multi_add(&multi, "{{city}}", "Lyon") == 4);
+        TEST_ASSERT(str_multi_add(&multi, "", "x") == -1);
+
+        /* not compiled */
+        ret = str_multi_replace(&multi, "{{name}}", output, sizeof(output));
+        TEST_ASSERT(ret == 0 && strcmp(output, "{{name}}") == 0);
+
+        TEST_ASSERT(str_multi_compile(&multi) == 0);
+
+        ret = str_multi_replace(&multi, "Hi {{name}} from {{city}}, "
+                                "password=secret {{name}}{{name",
+                                output, sizeof(output));
+        TEST_ASSERT(ret == 0);
+        TEST_ASSERT(strcmp(output, "Hi Bob from Paris, password=*** "
+                           "Bob{{name") == 0);
+
+        /* replacements aren't scanned again */
+        TEST_ASSERT(str_multi_add(&multi, "Bob", "{{name}}") == 5);
+        TEST_ASSERT(str_multi_compile(&multi) == 0);
+        ret = str_multi_replace(&multi, "Bob {{name}}", output,
+                                sizeof(output));
+        TEST_ASSERT(ret == 0 && strcmp(output, "{{name}} Bob") == 0);
+
+        /* truncation */
+        ret = str_multi_replace(&multi, "{{city}}{{city}}", output8,
+                                sizeof(output8));
+        TEST_ASSERT(ret == -1);
+        TEST_ASSERT(strcmp(output8, "ParisPa") == 0);
+
+        str_multi_cleanup(&multi);
+}
+
+/* leftmost-longest match, brute force */
+static int naive_find(const char *str, size_t len, char patterns[][8],
+                      unsigned int count, struct str_multi_match *match)
+{
+        unsigned int i;
+        size_t pos,
+                plen;
+        int found = 0;
+
+        for(pos = 0; pos < len && !found; ++pos)
+        {
+                for(i = 0; i < count; ++i)
+                {
+                        plen = strlen(patterns[i]);
+                        if(plen <= len - pos
+                           && memcmp(str + pos, patterns[i], plen) == 0
+                           && (!found || plen > match->len))
+                        {
+                                match->index = i;
+                                match->offset = pos;
+                                match->len = plen;
+                                found = 1;
+                        }
+                }
+        }
+
+        return found;
+}
+
+TEST_DEF(test_str_multi_random)
+{
+        struct str_multi multi;
+        struct str_multi_match match,
+                expected;
+        char patterns[20][8],
+                text[64];
+        unsigned int seed = 1,
+                round,
+                count,
+                i;
+        size_t len,
+                j,
+                pos;
+        int found;
+
+        for(round = 0; round < 300; ++round)
+        {
+                /* distinct patterns over a small alphabet */
+                str_multi_init(&multi);
+                count = 1 + (unsigned int)rand_r(&seed) % ARRAY_SIZE(patterns);
+                for(i = 0; i < count; ++i)
+                {
+                        len = 1 + (size_t)rand_r(&seed) % (sizeof(patterns[i])
+                                                           - 1);
+                        for(j = 0; j < len; ++j)
+                        {
+                                patterns[i][j] = (char)('a'
+                                                        + rand_r(&seed) % 3);
+                        }
+                        patterns[i][len] = '\0';
+                        if(str_multi_add(&multi, patterns[i], NULL) < 0)
+                        {
+                                break;
+                        }
+                }
+                TEST_ASSERT(str_multi_compile(&multi) == 0);
+
+                for(j = 0; j < sizeof(text); ++j)
+                {
+                        text[j] = (char)('a' + rand_r(&seed) % 4);
+                }
+
+                /* all matches, like the reference */
+                for(pos = 0; pos < sizeof(text);
+                    pos += expected.offset + expected.len)
+                {
+                        found = naive_find(text + pos, sizeof(text) - pos,
+                                           patterns, count, &expected);
+                        TEST_ASSERT(str_multi_find(&multi, text + pos,
+                                                   sizeof(text) - pos, &match)
+                                    == found);
+                        if(!found)
+                        {
+                                break;
+                        }
+                        /* duplicates: same string, first index */
+                        TEST_ASSERT(match.offset == expected.offset
+                                    && match.len == expected.len);
+                        TEST_ASSERT(strcmp(patterns[match.index],
+                                           patterns[expected.index]) == 0);
+                        TEST_ASSERT(match.index <= expected.index);
+                }
+
+                str_multi_cleanup(&multi);
+        }
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/str_multi");
+
+        TEST_RUN(test_str_multi_find);
+        TEST_RUN(test_str_multi_replace);
+        TEST_RUN(test_str_multi_random);
+
+        return TEST_MODULE_RETURN;
+}
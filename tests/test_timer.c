@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/timer.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <stdlib.h>
+
+#define TIMERS_COUNT 200000
+
+struct item {
+        struct timer timer;
+        unsigned int fired;
+        /* tick of the timer_wheel_advance() which ran the timer */
+        uint64_t fired_at;
+        /* re-add the timer this number of ticks later */
+        uint64_t period;
+};
+
+static struct timer_wheel wheel;
+static uint64_t now;
+
+static void item_expired(struct timer *timer)
+{
+        struct item *item = container_of(timer, struct item, timer);
+
+        ++item->fired;
+        item->fired_at = now;
+
+        if(item->period)
+        {
+                timer_add(&wheel, timer, timer->expires + item->period);
+        }
+}
+
+static void item_init(struct item *item)
+{
+        timer_init(&item->timer, item_expired);
+        item->fired = 0;
+        item->fired_at = 0;
+        item->period = 0;
+}
+
+TEST_DEF(test_timer)
+{
+        struct item *items = NULL;
+        unsigned long run = 0;
+        unsigned int i;
+
+        items = calloc(TIMERS_COUNT, sizeof(*items));
+        TEST_ASSERT(items != NULL);
+
+        now = 1000;
+        timer_wheel_init(&wheel, now);
+        TEST_ASSERT(timer_wheel_next(&wheel) == UINT64_MAX);
+        TEST_ASSERT(timer_wheel_timeout(&wheel, now) == -1);
+
+        /* expiries spread on all levels */
+        srand(42);
+        for(i = 0; i < TIMERS_COUNT; ++i)
+        {
+                item_init(&items[i]);
+                timer_add(&wheel, &items[i].timer,
+                          now + ((uint64_t) rand() >> (i % 31)));
+                TEST_ASSERT(timer_pending(&items[i].timer));
+        }
+        TEST_ASSERT(wheel.count == TIMERS_COUNT);
+        TEST_ASSERT(timer_wheel_timeout(&wheel, now) >= 0);
+
+        /* random steps: nothing is left behind */
+        while(wheel.count)
+        {
+                now += (uint64_t) rand() % 100000;
+                run += timer_wheel_advance(&wheel, now);
+                TEST_ASSERT(timer_wheel_next(&wheel) > now);
+        }
+        TEST_ASSERT(run == TIMERS_COUNT);
+
+        for(i = 0; i < TIMERS_COUNT; ++i)
+        {
+                TEST_ASSERT(items[i].fired == 1);
+                TEST_ASSERT(!timer_pending(&items[i].timer));
+                TEST_ASSERT(items[i].timer.expires <= items[i].fired_at);
+        }
+
+        free(items);
+}
+
+TEST_DEF(test_timer_exact)
+{
+        struct item items[300];
+        unsigned int i;
+
+        now = 0;
+        timer_wheel_init(&wheel, now);
+
+        for(i = 0; i < 300; ++i)
+        {
+                item_init(&items[i]);
+                timer_add(&wheel, &items[i].timer, (uint64_t) i * 37 + 1);
+        }
+
+        /* tick by tick: never early, never late */
+        while(wheel.count)
+        {
+                ++now;
+                timer_wheel_advance(&wheel, now);
+        }
+
+        for(i = 0; i < 300; ++i)
+        {
+                TEST_ASSERT(items[i].fired == 1);
+                TEST_ASSERT(items[i].fired_at == items[i].timer.expires);
+        }
+}
+
+TEST_DEF(test_timer_cancel)
+{
+        struct item a,
+                b,
+                c;
+
+        now = 500;
+        timer_wheel_init(&wheel, now);
+        item_init(&a);
+        item_init(&b);
+        item_init(&c);
+
+        TEST_ASSERT(timer_cancel(&wheel, &a.timer) == 0);
+
+        timer_add(&wheel, &a.timer, 510);
+        timer_add(&wheel, &b.timer, 520);
+        timer_add(&wheel, &c.timer, 100);
+        TEST_ASSERT(timer_wheel_next(&wheel) == 500);
+        TEST_ASSERT(timer_wheel_timeout(&wheel, now) == 0);
+
+        TEST_ASSERT(timer_cancel(&wheel, &a.timer) == 1);
+        TEST_ASSERT(!timer_pending(&a.timer));
+
+        /* modify: b is moved later */
+        timer_add(&wheel, &b.timer, 600);
+        TEST_ASSERT(wheel.count == 2);
+
+        now = 520;
+        TEST_ASSERT(timer_wheel_advance(&wheel, now) == 1);
+        TEST_ASSERT(c.fired == 1 && a.fired == 0 && b.fired == 0);
+        TEST_ASSERT(timer_wheel_timeout(&wheel, now) <= 80);
+
+        now = 600;
+        TEST_ASSERT(timer_wheel_advance(&wheel, now) == 1);
+        TEST_ASSERT(b.fired == 1 && a.fired == 0);
+        TEST_ASSERT(wheel.count == 0);
+}
+
+TEST_DEF(test_timer_periodic)
+{
+        struct item item;
+
+        now = 0;
+        timer_wheel_init(&wheel, now);
+        item_init(&item);
+        item.period = 10;
+
+        timer_add(&wheel, &item.timer, 10);
+        now = 1000;
+        timer_wheel_advance(&wheel, now);
+        TEST_ASSERT(item.fired == 100);
+        TEST_ASSERT(timer_pending(&item.timer));
+        TEST_ASSERT(item.timer.expires == 1010);
+
+        TEST_ASSERT(timer_cancel(&wheel, &item.timer) == 1);
+        now = 2000;
+        TEST_ASSERT(timer_wheel_advance(&wheel, now) == 0);
+        TEST_ASSERT(item.fired == 100);
+}
+
+TEST_DEF(test_timer_far)
+{
+        struct item far,
+                near;
+
+        now = 12345;
+        timer_wheel_init(&wheel, now);
+        item_init(&far);
+        item_init(&near);
+
+        /* out of range: cascaded several times */
+        timer_add(&wheel, &far.timer, now + TIMER_WHEEL_RANGE * 3 + 5);
+        timer_add(&wheel, &near.timer, now + 3);
+
+        now += TIMER_WHEEL_RANGE * 3 + 4;
+        TEST_ASSERT(timer_wheel_advance(&wheel, now) == 1);
+        TEST_ASSERT(near.fired == 1 && far.fired == 0);
+
+        ++now;
+        TEST_ASSERT(timer_wheel_advance(&wheel, now) == 1);
+        TEST_ASSERT(far.fired == 1);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/timer");
+
+        TEST_RUN(test_timer);
+        TEST_RUN(test_timer_exact);
+        TEST_RUN(test_timer_cancel);
+        TEST_RUN(test_timer_periodic);
+        TEST_RUN(test_timer_far);
+
+        return TEST_MODULE_RETURN;
+}
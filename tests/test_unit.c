@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/unit.h>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* test function checked by test_unit_faster_than */
+TEST_DEF(test_unit_faster_than_1s)
+{
+        TEST_ASSERT_FASTER_THAN(1e9);
+}
+
+/*
+ * Run func as if it had started ago_ns nanoseconds ago
+ */
+static void test_unit_run_since(void (*func)(struct test_result *),
+                                struct test_result *tr, long long ago_ns)
+{
+        memset(tr, 0, sizeof(*tr));
+        clock_gettime(CLOCK_MONOTONIC, &tr->start);
+
+        tr->start.tv_sec -= (time_t)(ago_ns / 1000000000LL);
+        tr->start.tv_nsec -= (long)(ago_ns % 1000000000LL);
+        if(tr->start.tv_nsec < 0)
+        {
+                tr->start.tv_nsec += 1000000000L;
+                --tr->start.tv_sec;
+        }
+
+        func(tr);
+}
+
+TEST_DEF(test_unit_faster_than)
+{
+        struct test_result tr;
+
+        unsetenv("TEST_TIME_SCALE");
+
+        /* within the budget */
+        test_unit_run_since(test_unit_faster_than_1s, &tr, 0);
+        TEST_ASSERT(tr.ret == 0);
+
+        /* over the budget: the message gives both durations */
+        test_unit_run_since(test_unit_faster_than_1s, &tr, 2000000000LL);
+        TEST_ASSERT(tr.ret != 0);
+        TEST_ASSERT(strstr(tr.msg, "budget was 1000000000 ns") != NULL);
+
+        /* the budget is scaled by TEST_TIME_SCALE */
+        TEST_ASSERT(setenv("TEST_TIME_SCALE", "4", 1) == 0);
+        test_unit_run_since(test_unit_faster_than_1s, &tr, 2000000000LL);
+        TEST_ASSERT(tr.ret == 0);
+        test_unit_run_since(test_unit_faster_than_1s, &tr, 5000000000LL);
+        TEST_ASSERT(tr.ret != 0);
+
+        /* an invalid scale is ignored */
+        TEST_ASSERT(setenv("TEST_TIME_SCALE", "-1", 1) == 0);
+        test_unit_run_since(test_unit_faster_than_1s, &tr, 2000000000LL);
+        TEST_ASSERT(tr.ret != 0);
+
+        unsetenv("TEST_TIME_SCALE");
+}
+
+/* tests run by the parallel runner in test_unit_runner */
+TEST_DEF(test_unit_child_pass)
+{
+        TEST_ASSERT(1);
+}
+
+TEST_DEF(test_unit_child_fail)
+{
+        TEST_ASSERT(0);
+}
+
+TEST_DEF(test_unit_child_crash)
+{
+        abort();
+        TEST_ASSERT(0);
+}
+
+TEST_DEF(test_unit_child_hang)
+{
+        /* nothing wakes it up */
+        pause();
+        TEST_ASSERT(0);
+}
+
+static int test_unit_runner_module(void)
+{
+        TEST_MODULE_INIT("flibc/unit runner");
+
+        TEST_RUN(test_unit_child_pass);
+        TEST_RUN(test_unit_child_fail);
+        TEST_RUN(test_unit_child_crash);
+        TEST_RUN(test_unit_child_hang);
+
+        return TEST_MODULE_RETURN;
+}
+
+TEST_DEF(test_unit_runner)
+{
+        char buf[4096];
+        size_t len = 0;
+        ssize_t n;
+        pid_t pid;
+        int fds[2],
+                status;
+
+        TEST_ASSERT(pipe(fds) == 0);
+
+        /* a module run with TEST_JOBS, its output read from here */
+        fflush(stdout);
+        pid = fork();
+        TEST_ASSERT(pid >= 0);
+        if(pid == 0)
+        {
+                close(fds[0]);
+                if(dup2(fds[1], STDOUT_FILENO) < 0)
+                {
+                        _exit(EXIT_FAILURE);
+                }
+                setenv("TEST_JOBS", "4", 1);
+                setenv("TEST_TIMEOUT", "1", 1);
+                setenv("TEST_SLOW_MS", "0", 1);
+                status = test_unit_runner_module();
+                fflush(stdout);
+                _exit(status != 0 ? 2 : 0);
+        }
+        close(fds[1]);
+
+        while(len < sizeof(buf) - 1
+              && (n = read(fds[0], buf + len, sizeof(buf) - 1 - len)) != 0)
+        {
+                if(n > 0)
+                {
+                        len += (size_t)n;
+                }
+        }
+        buf[len] = '\0';
+        close(fds[0]);
+
+        TEST_ASSERT(waitpid(pid, &status, 0) == pid);
+
+        /* each child is reported, the others still run */
+        TEST_ASSERT(strstr(buf, "OK: test_unit_child_pass (") != NULL);
+        TEST_ASSERT(strstr(buf, "KO: test_unit_child_fail (line:") != NULL);
+        TEST_ASSERT(strstr(buf, "KO: test_unit_child_crash: killed by "
+                           "signal 6") != NULL);
+        TEST_ASSERT(strstr(buf, "KO: test_unit_child_hang: timeout (1 s)")
+                    != NULL);
+        TEST_ASSERT(strstr(buf, "4 tests in") != NULL);
+
+        /* and the module fails */
+        TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 2);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/unit");
+
+        TEST_RUN(test_unit_faster_than);
+        TEST_RUN(test_unit_runner);
+
+        return TEST_MODULE_RETURN;
+}
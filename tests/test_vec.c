@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_VT102_COLOR 1
+#include <flibc/vec.h>
+#include <flibc/flibc.h>
+#include <flibc/unit.h>
+
+#include <stdlib.h>
+
+#define SCAN_COUNT 1000000
+
+struct point {
+        int x;
+        int y;
+};
+
+VEC_DEFINE(int_vec, int)
+VEC_DEFINE(point_vec, struct point)
+
+static int int_cmp(const void *a, const void *b)
+{
+        int x = *(const int *) a,
+                y = *(const int *) b;
+
+        return (x > y) - (x < y);
+}
+
+TEST_DEF(test_vec)
+{
+        struct int_vec v;
+        int values[] = { 5, 6, 7 },
+                value = 0,
+                *pos = NULL;
+        int i;
+
+        int_vec_init(&v);
+        TEST_ASSERT(vec_len(&v) == 0);
+        TEST_ASSERT(int_vec_pop(&v, &value) == -1);
+        TEST_ASSERT(int_vec_remove(&v, 0, NULL) == -1);
+
+        /* iterate over an empty vector */
+        vec_for_each(pos, &v)
+        {
+                TEST_ASSERT(0);
+        }
+
+        for(i = 0; i < 5; ++i)
+        {
+                TEST_ASSERT(int_vec_push(&v, i) == 0);
+        }
+        TEST_ASSERT(vec_len(&v) == 5);
+        TEST_ASSERT(v.cap >= 5);
+
+        /* 0 1 2 3 4 5 6 7 */
+        TEST_ASSERT(int_vec_append(&v, values, ARRAY_SIZE(values)) == 0);
+        TEST_ASSERT(vec_len(&v) == 8);
+        for(i = 0; i < 8; ++i)
+        {
+                TEST_ASSERT(vec_at(&v, i) == i);
+        }
+
+        /* 42 0 1 2 3 4 5 6 7 43 */
+        TEST_ASSERT(int_vec_insert(&v, 0, 42) == 0);
+        TEST_ASSERT(int_vec_insert(&v, vec_len(&v), 43) == 0);
+        TEST_ASSERT(int_vec_insert(&v, vec_len(&v) + 1, 44) == -1);
+        TEST_ASSERT(vec_len(&v) == 10);
+        TEST_ASSERT(vec_at(&v, 0) == 42);
+        TEST_ASSERT(vec_at(&v, 1) == 0);
+        TEST_ASSERT(vec_at(&v, 9) == 43);
+
+        /* 42 0 1 3 4 5 6 7 43 */
+        TEST_ASSERT(int_vec_remove(&v, 3, &value) == 0);
+        TEST_ASSERT(value == 2);
+        TEST_ASSERT(vec_at(&v, 3) == 3);
+
+        TEST_ASSERT(int_vec_pop(&v, &value) == 0);
+        TEST_ASSERT(value == 43);
+        TEST_ASSERT(vec_len(&v) == 8);
+
+        int_vec_sort(&v, int_cmp);
+        value = -1;
+        vec_for_each(pos, &v)
+        {
+                TEST_ASSERT(*pos > value);
+                value = *pos;
+        }
+
+        value = 42;
+        pos = int_vec_bsearch(&v, &value, int_cmp);
+        TEST_ASSERT(pos != NULL && *pos == 42);
+        value = 2;
+        TEST_ASSERT(int_vec_bsearch(&v, &value, int_cmp) == NULL);
+
+        TEST_ASSERT(int_vec_shrink(&v) == 0);
+        TEST_ASSERT(v.cap == vec_len(&v));
+
+        int_vec_clear(&v);
+        TEST_ASSERT(vec_len(&v) == 0);
+        TEST_ASSERT(int_vec_bsearch(&v, &value, int_cmp) == NULL);
+        TEST_ASSERT(int_vec_shrink(&v) == 0);
+        TEST_ASSERT(v.data == NULL && v.cap == 0);
+
+        int_vec_cleanup(&v);
+}
+
+TEST_DEF(test_vec_struct)
+{
+        struct point_vec v;
+        struct point p,
+                *pos = NULL;
+        long sum = 0;
+        int i;
+
+        point_vec_init(&v);
+        TEST_ASSERT(point_vec_reserve(&v, SCAN_COUNT) == 0);
+        TEST_ASSERT(v.cap >= SCAN_COUNT);
+        TEST_ASSERT(point_vec_reserve(&v, (size_t) -1) == -1);
+        TEST_ASSERT(v.cap >= SCAN_COUNT);
+
+        for(i = 0; i < SCAN_COUNT; ++i)
+        {
+                p.x = i;
+                p.y = -i;
+                TEST_ASSERT(point_vec_push(&v, p) == 0);
+        }
+
+        /* a linear scan over 1M elements */
+        vec_for_each(pos, &v)
+        {
+                sum += pos->x + pos->y;
+        }
+        TEST_ASSERT(sum == 0);
+        TEST_ASSERT(vec_len(&v) == SCAN_COUNT);
+
+        point_vec_cleanup(&v);
+        TEST_ASSERT(v.data == NULL);
+}
+
+int main(void)
+{
+        TEST_MODULE_INIT("flibc/vec");
+
+        TEST_RUN(test_vec);
+        TEST_RUN(test_vec_struct);
+
+        return TEST_MODULE_RETURN;
+}
@@ -0,0 +1,530 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * flibc-benchcmp - compare benchmark results to a baseline
+ *
+ *  Both files are written by benchmarks of unit.h (BENCH_JSON): one
+ *  JSON object per line, with the time per iteration of each sample.
+ *  Several runs of the same benchmark in a file are merged.
+ *  For each benchmark, samples of the baseline and the current run are
+ *  compared with a Mann-Whitney U test: a change is significant if its
+ *  p-value is below alpha and the medians differ by more than the
+ *  threshold. Without enough samples, medians are compared with their
+ *  MAD (median absolute deviation) instead.
+ *
+ *  $ flibc-benchcmp [-t THRESHOLD%] [-a ALPHA] BASELINE CURRENT
+ *
+ *  Exit status is 1 if a benchmark is significantly slower, 2 on error.
+ */
+
+#include <flibc/flibc.h>
+#include <flibc/vec.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* below, samples are compared by median and MAD */
+#define BENCHCMP_MIN_SAMPLES 5
+/* with MAD: medians must be this number of MADs apart */
+#define BENCHCMP_MAD_FACTOR 3.0
+
+VEC_DEFINE(double_vec, double)
+
+struct bench_result {
+        char module[128];
+        char name[128];
+        double median;
+        struct double_vec samples;
+};
+
+VEC_DEFINE(bench_result_vec, struct bench_result)
+
+/* find the value of "key": in a JSON line */
+static const char *json_find(const char *line, const char *key)
+{
+        char pattern[160];
+        const char *p = NULL;
+
+        snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+        p = strstr(line, pattern);
+
+        return p ? p + strlen(pattern) : NULL;
+}
+
+static int json_get_string(const char *line, const char *key,
+                           char *value, size_t size)
+{
+        const char *p = json_find(line, key),
+                *end = NULL;
+        size_t len;
+
+        if(p == NULL || *p != '"')
+        {
+                return -1;
+        }
+
+        ++p;
+        end = strchr(p, '"');
+        if(end == NULL)
+        {
+                return -1;
+        }
+
+        len = (size_t) (end - p);
+        if(len >= size)
+        {
+                len = size - 1;
+        }
+        memcpy(value, p, len);
+        value[len] = '\0';
+
+        return 0;
+}
+
+static int json_get_number(const char *line, const char *key, double *value)
+{
+        const char *p = json_find(line, key);
+        char *end = NULL;
+
+        if(p == NULL)
+        {
+                return -1;
+        }
+
+        *value = strtod(p, &end);
+
+        return end == p ? -1 : 0;
+}
+
+static int json_get_numbers(const char *line, const char *key,
+                            struct double_vec *values)
+{
+        const char *p = json_find(line, key);
+        char *end = NULL;
+        double value;
+
+        if(p == NULL || *p != '[')
+        {
+                return -1;
+        }
+
+        for(++p; *p != ']'; p = end)
+        {
+                if(*p == ',')
+                {
+                        ++p;
+                }
+
+                value = strtod(p, &end);
+                if(end == p || double_vec_push(values, value) != 0)
+                {
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+static void results_cleanup(struct bench_result_vec *results)
+{
+        struct bench_result *result = NULL;
+
+        vec_for_each(result, results)
+        {
+                double_vec_cleanup(&result->samples);
+        }
+        bench_result_vec_cleanup(results);
+}
+
+static int double_cmp(const void *a, const void *b)
+{
+        double x = *(const double *) a,
+                y = *(const double *) b;
+
+        return (x > y) - (x < y);
+}
+
+/* median of values (sorted in place) */
+static double median(double *values, size_t count)
+{
+        qsort(values, count, sizeof(*values), double_cmp);
+
+        return count % 2 ? values[count / 2]
+                : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+/*
+ * Results of several runs of a benchmark are merged: the samples of all
+ * runs are compared, so the variation between runs is taken into
+ * account, not only the one inside a run.
+ */
+static int results_load(const char *path, struct bench_result_vec *results)
+{
+        struct bench_result result,
+                *old = NULL;
+        struct double_vec sorted;
+        char line[65536];
+        FILE *file = NULL;
+        size_t i;
+        int ret = 0;
+
+        file = fopen(path, "r");
+        if(file == NULL)
+        {
+                return -1;
+        }
+
+        while(ret == 0 && fgets(line, sizeof(line), file) != NULL)
+        {
+                memset(&result, 0, sizeof(result));
+                double_vec_init(&result.samples);
+
+                if(json_get_string(line, "module", result.module,
+                                   sizeof(result.module)) != 0
+                   || json_get_string(line, "name", result.name,
+                                      sizeof(result.name)) != 0
+                   || json_get_number(line, "median_ns",
+                                      &result.median) != 0)
+                {
+                        /* not a benchmark result */
+                        continue;
+                }
+                json_get_numbers(line, "samples_ns", &result.samples);
+
+                for(i = 0; i < vec_len(results); ++i)
+                {
+                        old = &vec_at(results, i);
+                        if(strcmp(old->module, result.module) == 0
+                           && strcmp(old->name, result.name) == 0)
+                        {
+                                break;
+                        }
+                }
+
+                if(i == vec_len(results))
+                {
+                        if(bench_result_vec_push(results, result) != 0)
+                        {
+                                double_vec_cleanup(&result.samples);
+                                ret = -1;
+                        }
+                        continue;
+                }
+
+                /* another run of a known benchmark */
+                ret = double_vec_append(&old->samples,
+                                        result.samples.data,
+                                        vec_len(&result.samples));
+                double_vec_cleanup(&result.samples);
+                if(ret == 0 && vec_len(&old->samples) > 0)
+                {
+                        double_vec_init(&sorted);
+                        ret = double_vec_append(&sorted, old->samples.data,
+                                                vec_len(&old->samples));
+                        if(ret == 0)
+                        {
+                                old->median = median(sorted.data,
+                                                     vec_len(&sorted));
+                        }
+                        double_vec_cleanup(&sorted);
+                }
+        }
+
+        fclose(file);
+        if(ret != 0)
+        {
+                errno = ENOMEM;
+        }
+
+        return ret;
+}
+
+static const struct bench_result *
+results_find(const struct bench_result_vec *results,
+             const struct bench_result *result)
+{
+        size_t i;
+
+        for(i = 0; i < vec_len(results); ++i)
+        {
+                if(strcmp(vec_at(results, i).module, result->module) == 0
+                   && strcmp(vec_at(results, i).name, result->name) == 0)
+                {
+                        return &vec_at(results, i);
+                }
+        }
+
+        return NULL;
+}
+
+/* median absolute deviation */
+static double mad(const struct double_vec *samples, double med)
+{
+        double *deviations = NULL,
+                value;
+        size_t i;
+
+        if(vec_len(samples) == 0)
+        {
+                return 0;
+        }
+
+        deviations = malloc(vec_len(samples) * sizeof(*deviations));
+        if(deviations == NULL)
+        {
+                return 0;
+        }
+
+        for(i = 0; i < vec_len(samples); ++i)
+        {
+                deviations[i] = fabs(vec_at(samples, i) - med);
+        }
+        value = median(deviations, vec_len(samples));
+        free(deviations);
+
+        return value;
+}
+
+struct rank {
+        double value;
+        int group;
+};
+
+static int rank_cmp(const void *a, const void *b)
+{
+        return double_cmp(&((const struct rank *) a)->value,
+                          &((const struct rank *) b)->value);
+}
+
+/*
+ * Two-sided p-value of the Mann-Whitney U test (normal approximation
+ * with tie correction): probability that samples of a and b come from
+ * the same distribution.
+ */
+static double mann_whitney(const struct double_vec *a,
+                           const struct double_vec *b)
+{
+        size_t n1 = vec_len(a),
+                n2 = vec_len(b),
+                n = n1 + n2,
+                i,
+                j;
+        struct rank *ranks = NULL;
+        double rank_sum = 0,
+                ties = 0,
+                rank,
+                t,
+                u,
+                mean,
+                sd,
+                z;
+
+        ranks = malloc(n * sizeof(*ranks));
+        if(ranks == NULL)
+        {
+                return 1;
+        }
+
+        for(i = 0; i < n1; ++i)
+        {
+                ranks[i].value = vec_at(a, i);
+                ranks[i].group = 0;
+        }
+        for(i = 0; i < n2; ++i)
+        {
+                ranks[n1 + i].value = vec_at(b, i);
+                ranks[n1 + i].group = 1;
+        }
+        qsort(ranks, n, sizeof(*ranks), rank_cmp);
+
+        /* equal values get the mean of their ranks */
+        for(i = 0; i < n; i = j)
+        {
+                for(j = i + 1; j < n && !(ranks[j].value > ranks[i].value);
+                    ++j)
+                {
+                }
+
+                rank = (double) (i + 1 + j) / 2;
+                t = (double) (j - i);
+                ties += t * t * t - t;
+
+                for(; i < j; ++i)
+                {
+                        if(ranks[i].group == 0)
+                        {
+                                rank_sum += rank;
+                        }
+                }
+        }
+        free(ranks);
+
+        u = rank_sum - (double) n1 * (double) (n1 + 1) / 2;
+        mean = (double) n1 * (double) n2 / 2;
+        sd = sqrt((double) n1 * (double) n2 / 12
+                  * ((double) (n + 1)
+                     - ties / ((double) n * (double) (n - 1))));
+        if(!(sd > 0))
+        {
+                return 1;
+        }
+
+        /* continuity correction */
+        z = (fabs(u - mean) - 0.5) / sd;
+        if(z < 0)
+        {
+                z = 0;
+        }
+
+        return erfc(z / sqrt(2.0));
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s [-t THRESHOLD%%] [-a ALPHA] BASELINE CURRENT\n"
+                "  -t  ignore changes of the median below this percentage "
+                "(default 5)\n"
+                "  -a  significance level of the Mann-Whitney test "
+                "(default 0.01)\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+        struct bench_result_vec baseline,
+                current;
+        const struct bench_result *base = NULL;
+        struct bench_result *result = NULL;
+        double threshold = 5,
+                alpha = 0.01,
+                change,
+                p,
+                base_mad,
+                cur_mad;
+        const char *verdict = NULL;
+        char label[260];
+        int opt,
+                significant,
+                slower = 0;
+
+        while((opt = getopt(argc, argv, "t:a:h")) != -1)
+        {
+                switch(opt)
+                {
+                case 't':
+                        threshold = strtod(optarg, NULL);
+                        break;
+                case 'a':
+                        alpha = strtod(optarg, NULL);
+                        break;
+                default:
+                        usage(argv[0]);
+                        return 2;
+                }
+        }
+
+        if(argc - optind != 2)
+        {
+                usage(argv[0]);
+                return 2;
+        }
+
+        bench_result_vec_init(&baseline);
+        bench_result_vec_init(&current);
+
+        if(results_load(argv[optind], &baseline) != 0
+           || results_load(argv[optind + 1], &current) != 0)
+        {
+                fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+                results_cleanup(&baseline);
+                results_cleanup(&current);
+                return 2;
+        }
+
+        printf("%-40s %12s %12s %9s %8s\n",
+               "benchmark", "baseline ns", "current ns", "change", "p");
+
+        vec_for_each(result, &current)
+        {
+                snprintf(label, sizeof(label), "%s %s",
+                         result->module, result->name);
+
+                base = results_find(&baseline, result);
+                if(base == NULL)
+                {
+                        printf("%-40s %12s %12.2f %9s %8s  new\n",
+                               label, "-", result->median, "", "");
+                        continue;
+                }
+
+                change = (result->median - base->median) / base->median * 100;
+
+                if(vec_len(&base->samples) >= BENCHCMP_MIN_SAMPLES
+                   && vec_len(&result->samples) >= BENCHCMP_MIN_SAMPLES)
+                {
+                        p = mann_whitney(&base->samples, &result->samples);
+                        significant = p < alpha;
+                }
+                else
+                {
+                        p = NAN;
+                        base_mad = mad(&base->samples, base->median);
+                        cur_mad = mad(&result->samples, result->median);
+                        significant = fabs(result->median - base->median)
+                                > BENCHCMP_MAD_FACTOR
+                                * (base_mad > cur_mad ? base_mad : cur_mad);
+                }
+
+                verdict = "";
+                if(significant && change > threshold)
+                {
+                        verdict = "SLOWER";
+                        slower = 1;
+                }
+                else if(significant && change < -threshold)
+                {
+                        verdict = "faster";
+                }
+
+                printf("%-40s %12.2f %12.2f %+8.1f%% %8.4f  %s\n",
+                       label, base->median, result->median, change, p,
+                       verdict);
+        }
+
+        vec_for_each(result, &baseline)
+        {
+                if(results_find(&current, result) == NULL)
+                {
+                        snprintf(label, sizeof(label), "%s %s",
+                                 result->module, result->name);
+                        printf("%-40s %12.2f %12s %9s %8s  removed\n",
+                               label, result->median, "-", "", "");
+                }
+        }
+
+        results_cleanup(&baseline);
+        results_cleanup(&current);
+
+        return slower;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2011-2013 Anthony Viallard
+ *
+ *    This file is part of Flibc.
+ *
+ * Flibc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Flibc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Flibc. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * flibc-logdump - print records of a flight recorder file in order
+ *
+ *  $ flibc-logdump /var/run/foo.ring
+ */
+
+#include <flibc/log.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+        int i,
+                ret = 0;
+
+        if(argc < 2)
+        {
+                fprintf(stderr, "usage: %s FILE...\n", argv[0]);
+                return 2;
+        }
+
+        for(i = 1; i < argc; ++i)
+        {
+                if(log_ring_dump(argv[i], STDOUT_FILENO) < 0)
+                {
+                        fprintf(stderr, "%s: %s: %s\n",
+                                argv[0], argv[i], strerror(errno));
+                        ret = 1;
+                }
+        }
+
+        return ret;
+}